@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Archive.h"
+
+/// <summary>
+/// Creates an empty archive
+/// </summary>
+/// <returns>A pointer to the archive,
+///			 NULL if there is not enough memory</returns>
+ColdArchive* createArchive()
+{
+	ColdArchive* archive = malloc(sizeof(ColdArchive));
+	if (archive == NULL) return NULL;
+
+	archive->records = malloc(ARCHIVE_INITIAL_SIZE * sizeof(SnapshotRecord));
+	archive->heap = malloc(ARCHIVE_INITIAL_HEAP);
+	if (archive->records == NULL || archive->heap == NULL)
+	{
+		free(archive->records);
+		free(archive->heap);
+		free(archive);
+		return NULL;
+	}
+
+	archive->length = 0;
+	archive->capacity = ARCHIVE_INITIAL_SIZE;
+	archive->retained = 0;
+	archive->heapSize = 0;
+	archive->heapCapacity = ARCHIVE_INITIAL_HEAP;
+	archive->retainedHeap = 0;
+
+	return archive;
+}
+
+/// <summary>
+/// Destroys the archive
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+void destroyArchive(ColdArchive* archive)
+{
+	if (archive == NULL) return;
+
+	free(archive->records);
+	free(archive->heap);
+	free(archive);
+
+	archive = NULL;
+}
+
+/// <summary>
+/// Checks if a product belongs to the cold tier: it expired or ran out
+/// </summary>
+/// <param name="p">A pointer to the product</param>
+/// <param name="today">The current day, as returned by daysFromCivil</param>
+/// <returns>1 if the product is cold,
+///			 0, otherwise</returns>
+int isColdProduct(Product* p, int today)
+{
+	return p->units <= 0 || daysFromCivil(p->expiration) < today;
+}
+
+/// <summary>
+/// Checks if a repository has a cold product from its category aggregates, without
+/// looking at the products or building an index, so it can look at a published version
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="today">The current day, as returned by daysFromCivil</param>
+/// <returns>1 if a product is cold,
+///			 0, otherwise</returns>
+int hasColdProducts(ProductRepo* repo, int today)
+{
+	for (Category i = none; i <= CATEGORY_END; i++)
+	{
+		CategoryAggregate* aggregate = &repo->aggregates[i];
+		if (aggregate->empty > 0) return 1;
+		if (aggregate->count > 0 && daysFromCivil(aggregate->heaps[heapEarliest][0]->expiration) < today) return 1;
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Finds a cold product: an empty one has the lowest quantity, an expired one is the
+/// earliest of its category. The quantity index is built by the first empty product.
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="today">The current day, as returned by daysFromCivil</param>
+/// <returns>A pointer to the product, valid until the repository changes,
+///			 NULL if no product is cold</returns>
+Product* findColdProduct(ProductRepo* repo, int today)
+{
+	int empty = 0;
+	for (Category i = none; i <= CATEGORY_END; i++)
+		empty += repo->aggregates[i].empty;
+
+	if (empty > 0)
+	{
+		Product* lowest = selectRepoQuantity(repo, 0);
+		if (lowest != NULL && lowest->units <= 0) return lowest;
+
+		// Without memory for the index the products are looked at one by one
+		for (int i = 0; i < getLength(repo); i++)
+			if (getProductAt(repo, i)->units <= 0) return getProductAt(repo, i);
+	}
+
+	for (Category i = none; i <= CATEGORY_END; i++)
+	{
+		CategoryAggregate* aggregate = &repo->aggregates[i];
+		if (aggregate->count > 0 && daysFromCivil(aggregate->heaps[heapEarliest][0]->expiration) < today)
+			return aggregate->heaps[heapEarliest][0];
+	}
+
+	return NULL;
+}
+
+/// <summary>
+/// Appends a copy of a product to the archive, entries cut off by undo are dropped
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product was archived,
+///			 0 if there is not enough memory</returns>
+int archiveProduct(ColdArchive* archive, Product* p)
+{
+	size_t nameSize = strlen(p->name) + 1;
+
+	if (archive->length == archive->capacity)
+	{
+		SnapshotRecord* tmp = realloc(archive->records, archive->capacity * REPOSITORY_SIZE_SCALE * sizeof(SnapshotRecord));
+		if (tmp == NULL) return 0;
+
+		archive->records = tmp;
+		archive->capacity *= REPOSITORY_SIZE_SCALE;
+	}
+
+	if (archive->heapSize + nameSize > archive->heapCapacity)
+	{
+		size_t capacity = archive->heapCapacity;
+		while (capacity < archive->heapSize + nameSize) capacity *= REPOSITORY_SIZE_SCALE;
+
+		char* tmp = realloc(archive->heap, capacity);
+		if (tmp == NULL) return 0;
+
+		archive->heap = tmp;
+		archive->heapCapacity = capacity;
+	}
+
+	setSnapshotRecord(&archive->records[archive->length], p, (uint32_t)archive->heapSize);
+	memcpy(archive->heap + archive->heapSize, p->name, nameSize);
+
+	archive->length++;
+	archive->heapSize += nameSize;
+	archive->retained = archive->length;
+	archive->retainedHeap = archive->heapSize;
+	return 1;
+}
+
+/// <summary>
+/// Gets the number of archived products, the same product can be archived more than once
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <returns>The number of entries</returns>
+int getArchiveLength(ColdArchive* archive)
+{
+	return archive->length;
+}
+
+/// <summary>
+/// Gets the current end of the archive
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <returns>The mark</returns>
+ArchiveMark getArchiveMark(ColdArchive* archive)
+{
+	ArchiveMark mark = { archive->length, archive->heapSize };
+	return mark;
+}
+
+/// <summary>
+/// Gets the end of the archive after the given number of entries
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <param name="length">The number of entries, at most the retained ones</param>
+/// <returns>The mark</returns>
+ArchiveMark getArchiveMarkAt(ColdArchive* archive, int length)
+{
+	if (length > archive->retained) length = archive->retained;
+	if (length < 0) length = 0;
+
+	// Names are appended in the order of the entries
+	SnapshotRecord* last = length > 0 ? &archive->records[length - 1] : NULL;
+	ArchiveMark mark = { length, last != NULL ? last->nameOffset + last->nameLength + 1 : 0 };
+	return mark;
+}
+
+/// <summary>
+/// Moves the end of the archive back or forth to a mark, used by undo and redo
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <param name="mark">The mark, beyond the retained entries it only brings back those</param>
+void resetArchive(ColdArchive* archive, ArchiveMark mark)
+{
+	archive->length = mark.length < archive->retained ? mark.length : archive->retained;
+	archive->heapSize = mark.heapSize < archive->retainedHeap ? mark.heapSize : archive->retainedHeap;
+}
+
+/// <summary>
+/// Filters the archived products by a given string, only the latest entry of a product is used
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <param name="name">A string to be found in the product names</param>
+/// <returns>A pointer to a repository that contains the filtered products,
+///			 NULL if there is not enough memory</returns>
+ProductRepo* filterArchiveByString(ColdArchive* archive, char* name)
+{
+	ProductRepo* repo = createRepo();
+	if (repo == NULL) return NULL;
+
+	for (int i = archive->length - 1; i >= 0; i--)
+	{
+		SnapshotRecord* record = &archive->records[i];
+		char* current = archive->heap + record->nameOffset;
+
+		if (strstr(current, name) == NULL || findProductRepo(repo, current, record->category) != NULL) continue;
+
+		Product* p = createProductUnits(current, record->category, record->units, date(record->year, record->month, record->day));
+		if (p == NULL || appendProductRepo(repo, p) == 0)
+		{
+			destroyProduct(p);
+			destroyRepo(repo);
+			return NULL;
+		}
+	}
+
+	return repo;
+}
+
+/// <summary>
+/// Builds an archive from the entries saved in a snapshot
+/// </summary>
+/// <param name="snap">A pointer to the snapshot</param>
+/// <returns>A pointer to the new archive,
+///			 NULL if an entry is invalid or there is not enough memory</returns>
+ColdArchive* snapshotToArchive(Snapshot* snap)
+{
+	ColdArchive* archive = createArchive();
+	if (archive == NULL) return NULL;
+
+	SnapshotArchive* saved = &snap->archive;
+	size_t capacity = archive->capacity;
+	size_t heapCapacity = archive->heapCapacity;
+	while (capacity < saved->count) capacity *= REPOSITORY_SIZE_SCALE;
+	while (heapCapacity < saved->heapSize) heapCapacity *= REPOSITORY_SIZE_SCALE;
+
+	SnapshotRecord* records = realloc(archive->records, capacity * sizeof(SnapshotRecord));
+	if (records != NULL) archive->records = records;
+	char* heap = records != NULL ? realloc(archive->heap, heapCapacity) : NULL;
+	if (heap != NULL) archive->heap = heap;
+
+	// Entries are filtered in place later, so every name must end inside the heap
+	int valid = records != NULL && heap != NULL;
+	for (uint32_t i = 0; i < saved->count && valid == 1; i++)
+	{
+		const SnapshotRecord* record = &saved->records[i];
+		valid = (size_t)record->nameOffset + record->nameLength < saved->heapSize && saved->heap[record->nameOffset + record->nameLength] == '\0';
+		valid = valid && record->category >= none && record->category <= CATEGORY_END;
+	}
+
+	if (valid == 0)
+	{
+		destroyArchive(archive);
+		return NULL;
+	}
+
+	memcpy(archive->records, saved->records, saved->count * sizeof(SnapshotRecord));
+	memcpy(archive->heap, saved->heap, saved->heapSize);
+	archive->capacity = (int)capacity;
+	archive->heapCapacity = heapCapacity;
+	archive->length = archive->retained = (int)saved->count;
+	archive->heapSize = archive->retainedHeap = saved->heapSize;
+	return archive;
+}
+
+/// <summary>
+/// Describes the entries of the archive for saveArchivedSnapshot, entries cut off by undo are left out
+/// </summary>
+/// <param name="archive">A pointer to the archive</param>
+/// <returns>The entries, valid until the archive changes</returns>
+SnapshotArchive getSnapshotArchive(ColdArchive* archive)
+{
+	SnapshotArchive saved = { archive->records, (uint32_t)archive->length, archive->heap, (uint32_t)archive->heapSize };
+	return saved;
+}
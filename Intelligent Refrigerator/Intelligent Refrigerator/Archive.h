@@ -0,0 +1,49 @@
+#pragma once
+#include <stddef.h>
+
+#include "Snapshot.h"
+
+#define ARCHIVE_INITIAL_SIZE 64
+#define ARCHIVE_INITIAL_HEAP 1024
+
+// Position of the end of the archive, saved with every undo state so that undo
+// and redo bring the archive back together with the products
+typedef struct
+{
+	int length;
+	size_t heapSize;
+} ArchiveMark;
+
+// Cold tier of the repository: products that expired or ran out are moved here, so the
+// hot repository stays small. Entries are compact records in the snapshot layout with
+// their names in a heap, they are only appended and looked at on request. Entries cut
+// off by undo are kept until the next append, so redo can bring them back.
+typedef struct
+{
+	SnapshotRecord* records;
+	int length;
+	int capacity;
+	int retained; // Entries that are still valid, undo only lowers the length
+
+	char* heap;
+	size_t heapSize;
+	size_t heapCapacity;
+	size_t retainedHeap;
+} ColdArchive;
+
+ColdArchive* createArchive();
+void destroyArchive(ColdArchive* archive);
+
+int isColdProduct(Product* p, int today);
+int hasColdProducts(ProductRepo* repo, int today);
+Product* findColdProduct(ProductRepo* repo, int today);
+int archiveProduct(ColdArchive* archive, Product* p);
+int getArchiveLength(ColdArchive* archive);
+ArchiveMark getArchiveMark(ColdArchive* archive);
+ArchiveMark getArchiveMarkAt(ColdArchive* archive, int length);
+void resetArchive(ColdArchive* archive, ArchiveMark mark);
+
+ColdArchive* snapshotToArchive(Snapshot* snap);
+SnapshotArchive getSnapshotArchive(ColdArchive* archive);
+
+ProductRepo* filterArchiveByString(ColdArchive* archive, char* name);
@@ -0,0 +1,1251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "EventQueue.h"
+#include "ExpiryWheel.h"
+#include "Fleet.h"
+#include "ImportExport.h"
+#include "Page.h"
+#include "Recovery.h"
+#include "Replication.h"
+#include "Script.h"
+#include "Session.h"
+#include "Sweeper.h"
+#include "SharedService.h"
+#include "Snapshot.h"
+#include "Parallel.h"
+#include "Writer.h"
+
+#define BENCHMARK_PRODUCTS 1000
+#define BENCHMARK_MAX_THREADS 8
+#define BENCHMARK_READS 20000
+#define BENCHMARK_SENSORS 4
+#define BENCHMARK_SENSOR_EVENTS 250000
+
+/// <summary>
+/// Gets the number of milliseconds elapsed since the given clock value
+/// </summary>
+/// <param name="start">The clock value at the start of the measurement</param>
+/// <returns>The elapsed time in milliseconds</returns>
+double elapsedMilliseconds(clock_t start)
+{
+	return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/// <summary>
+/// Gets the current wall clock time, which unlike clock() does not add up the time of every thread
+/// </summary>
+/// <returns>The time in milliseconds</returns>
+double wallMilliseconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	return (double)now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+/// <summary>
+/// Measures the recovery time for increasing journal lengths
+/// </summary>
+void benchmarkRecovery()
+{
+	const char* snapshotPath = "benchmark.snapshot";
+	const char* journalPath = "benchmark.journal";
+	int lengths[] = { 1000, 10000, 100000 };
+	char name[32];
+
+	printf("Recovery time by journal length:\n");
+	for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++)
+	{
+		remove(snapshotPath);
+		remove(journalPath);
+
+		Service* serv = createService(createRepo(), 0);
+		attachJournal(serv, openJournal(journalPath, 0));
+		checkpointService(serv, snapshotPath);
+
+		for (int j = 0; j < lengths[i]; j++)
+		{
+			sprintf(name, "product%d", j % BENCHMARK_PRODUCTS);
+			if (j % 10 == 9)
+				updateProductService(serv, name, dairy, j, date(2022, 3, 1 + j % 28));
+			else
+				addProductService(serv, name, dairy, 1, date(2022, 3, 1 + j % 28));
+		}
+		destroyService(serv);
+
+		clock_t start = clock();
+		serv = recoverService(snapshotPath, journalPath, 0, 0);
+		double recovery = elapsedMilliseconds(start);
+
+		printf("%8d operations: %10.2f ms (%d products)\n", lengths[i], recovery, getLength(getRepo(serv)));
+		destroyService(serv);
+	}
+
+	remove(snapshotPath);
+	remove(journalPath);
+}
+
+/// <summary>
+/// Measures the import and export throughput of both file formats
+/// </summary>
+void benchmarkImportExport()
+{
+	const char* paths[] = { "benchmark.csv", "benchmark.jsonl" };
+	FileFormat formats[] = { csvFormat, jsonLinesFormat };
+	TransferStats stats;
+	char name[32];
+
+	Service* serv = createService(createRepo(), 0);
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductService(serv, name, CATEGORY_START + i % CATEGORY_END, i % 100 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28));
+	}
+
+	printf("Import and export throughput:\n");
+	for (int i = 0; i < 2; i++)
+	{
+		exportProducts(getRepo(serv), paths[i], formats[i], &stats);
+		printf("%16s export: %8.2f MB/s (%.2f MB)\n", paths[i], getThroughput(&stats), stats.bytes / (1024.0 * 1024.0));
+
+		Service* imported = createService(createRepo(), 0);
+		importProducts(imported, paths[i], formats[i], &stats);
+		printf("%16s import: %8.2f MB/s (%d products)\n", paths[i], getThroughput(&stats), stats.products);
+
+		destroyService(imported);
+		remove(paths[i]);
+	}
+
+	destroyService(serv);
+}
+
+/// <summary>
+/// Compares printing a large listing with toString and printf against the buffered writer
+/// </summary>
+void benchmarkListing()
+{
+	const char* path = "benchmark.txt";
+	char name[32];
+	char productString[PRODUCT_STRING_SIZE];
+
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 100 / 4.0, date(2022, 1 + i % 12, 1 + i % 28)));
+	}
+
+	printf("Listing %d products to a file:\n", getLength(repo));
+
+	FILE* file = fopen(path, "wb");
+	clock_t start = clock();
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		toString(getProductAt(repo, i), productString);
+		fprintf(file, "%s\n", productString);
+	}
+	fclose(file);
+	printf("%16s: %10.2f ms\n", "toString", elapsedMilliseconds(start));
+
+	file = fopen(path, "wb");
+	start = clock();
+	Writer* out = createWriter(file);
+	for (int i = 0; i < getLength(repo); i++)
+		writeProduct(out, getProductAt(repo, i));
+	destroyWriter(out);
+	fclose(file);
+	printf("%16s: %10.2f ms\n", "writer", elapsedMilliseconds(start));
+
+	remove(path);
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Measures how many scripted commands per second the batch mode executes
+/// </summary>
+void benchmarkScript()
+{
+	int commands = 1000000;
+	ScriptStats stats;
+
+	FILE* input = tmpfile();
+	FILE* output = tmpfile();
+	if (input == NULL || output == NULL) return;
+
+	for (int i = 0; i < commands; i++)
+	{
+		if (i % 4 == 3)
+			fprintf(input, "update product%d dairy %d 2022-04-%02d\n", i % BENCHMARK_PRODUCTS, i % 50, 1 + i % 28);
+		else
+			fprintf(input, "add product%d dairy 1 2022-03-%02d\n", i % BENCHMARK_PRODUCTS, 1 + i % 28);
+	}
+	rewind(input);
+
+	Service* serv = createService(createRepo(), 0);
+	Writer* out = createWriter(output);
+	runScript(serv, input, out, 0, 0, &stats);
+
+	printf("Batch mode: %lld commands in %.2f ms, %.0f commands/s\n", stats.commands, stats.seconds * 1000, stats.commands / stats.seconds);
+
+	destroyWriter(out);
+	destroyService(serv);
+	fclose(output);
+	fclose(input);
+}
+
+typedef struct
+{
+	SharedService* shared;
+	atomic_int readersLeft;
+} ReadScalingState;
+
+/// <summary>
+/// Looks up every product of a version of the shared service, BENCHMARK_READS times
+/// </summary>
+/// <param name="arg">A pointer to the benchmark state</param>
+/// <returns>0</returns>
+int readShared(void* arg)
+{
+	ReadScalingState* state = arg;
+	int reader = registerReader(state->shared);
+	char name[32];
+
+	for (int i = 0; i < BENCHMARK_READS; i++)
+	{
+		ProductRepo* version = beginRead(state->shared, reader);
+		sprintf(name, "product%d", i % BENCHMARK_PRODUCTS);
+		findProductRepo(version, name, dairy);
+		endRead(state->shared, reader);
+	}
+
+	unregisterReader(state->shared, reader);
+	atomic_fetch_sub(&state->readersLeft, 1);
+	return 0;
+}
+
+/// <summary>
+/// Measures how reads of the shared service scale with the number of reader threads, while a writer keeps changing it
+/// </summary>
+void benchmarkReadScaling()
+{
+	char name[32];
+	Service* serv = createService(createRepo(), 0);
+	for (int i = 0; i < BENCHMARK_PRODUCTS; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductService(serv, name, dairy, 1, date(2022, 3, 1 + i % 28));
+	}
+
+	ReadScalingState state;
+	state.shared = createSharedService(serv);
+
+	printf("Shared reads with a concurrent writer:\n");
+	for (int threads = 1; threads <= BENCHMARK_MAX_THREADS; threads *= 2)
+	{
+		thrd_t readers[BENCHMARK_MAX_THREADS];
+		atomic_init(&state.readersLeft, threads);
+
+		double start = wallMilliseconds();
+		for (int i = 0; i < threads; i++)
+			thrd_create(&readers[i], readShared, &state);
+
+		int writes = 0;
+		while (atomic_load(&state.readersLeft) > 0)
+		{
+			sprintf(name, "product%d", writes % BENCHMARK_PRODUCTS);
+			sharedUpdateProduct(state.shared, name, dairy, writes++, date(2022, 4, 1));
+			sharedUndo(state.shared);
+			thrd_yield();
+		}
+
+		for (int i = 0; i < threads; i++)
+			thrd_join(readers[i], NULL);
+		double elapsed = wallMilliseconds() - start;
+
+		printf("%8d readers: %12.0f reads/s (%d writes)\n", threads, threads * (double)BENCHMARK_READS / elapsed * 1000, writes);
+	}
+
+	destroySharedService(state.shared);
+}
+
+/// <summary>
+/// Pushes sensor readings as fast as possible, without retrying the dropped ones
+/// </summary>
+/// <param name="arg">A pointer to the event queue</param>
+/// <returns>0</returns>
+int pushBenchmarkEvents(void* arg)
+{
+	EventQueue* queue = arg;
+	char name[32];
+
+	for (int i = 0; i < BENCHMARK_SENSOR_EVENTS; i++)
+	{
+		sprintf(name, "product%d", i % BENCHMARK_PRODUCTS);
+		pushEvent(queue, name, dairy, i % 100);
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Measures the throughput of sensor events from several producers into the shared service
+/// </summary>
+void benchmarkEventQueue()
+{
+	char name[32];
+	Service* serv = createService(createRepo(), 0);
+	for (int i = 0; i < BENCHMARK_PRODUCTS; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductService(serv, name, dairy, 1, date(2022, 3, 1 + i % 28));
+	}
+
+	SharedService* shared = createSharedService(serv);
+	EventQueue* queue = createEventQueue();
+	thrd_t sensors[BENCHMARK_SENSORS];
+	EventStats stats;
+
+	double start = wallMilliseconds();
+	startApplier(queue, shared);
+	for (int i = 0; i < BENCHMARK_SENSORS; i++)
+		thrd_create(&sensors[i], pushBenchmarkEvents, queue);
+	for (int i = 0; i < BENCHMARK_SENSORS; i++)
+		thrd_join(sensors[i], NULL);
+	stopApplier(queue);
+	double elapsed = wallMilliseconds() - start;
+
+	getEventStats(queue, &stats);
+	printf("Sensor events from %d producers: %.0f events/s\n", BENCHMARK_SENSORS, (stats.pushed + stats.dropped) / elapsed * 1000);
+	printf("%16s: %lld pushed, %lld dropped, %lld under backpressure\n", "queue", stats.pushed, stats.dropped, stats.backpressure);
+	printf("%16s: %lld applied, %lld coalesced, %lld batches\n", "applier", stats.applied, stats.coalesced, stats.batches);
+
+	destroyEventQueue(queue);
+	destroySharedService(shared);
+}
+
+/// <summary>
+/// Compares the filters and sorts on the calling thread with their parallel versions
+/// </summary>
+void benchmarkParallel()
+{
+	char name[32];
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 1000000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+
+	printf("Filtering and sorting %d products:\n", getLength(repo));
+
+	double start = wallMilliseconds();
+	ProductRepo* result = filterRepoByString(repo, "99");
+	printf("%24s: %10.2f ms (%d products)\n", "sequential string filter", wallMilliseconds() - start, getLength(result));
+	destroyRepo(result);
+
+	start = wallMilliseconds();
+	result = filterRepoByCategoryAndExpiration(repo, dairy, 365);
+	printf("%24s: %10.2f ms (%d products)\n", "sequential expiry filter", wallMilliseconds() - start, getLength(result));
+	destroyRepo(result);
+
+	int processors = getProcessorCount();
+	for (int threads = 1; threads <= processors; threads *= 2)
+	{
+		ThreadPool* pool = createThreadPool(threads);
+
+		start = wallMilliseconds();
+		result = parallelFilterByString(pool, repo, "99", matchSubstring);
+		printf("%11d threads string: %10.2f ms (%d products)\n", threads, wallMilliseconds() - start, getLength(result));
+		destroyRepo(result);
+
+		start = wallMilliseconds();
+		result = parallelFilterByCategoryAndExpiration(pool, repo, dairy, 365);
+		printf("%11d threads expiry: %10.2f ms (%d products)\n", threads, wallMilliseconds() - start, getLength(result));
+		destroyRepo(result);
+
+		result = filterRepoByString(repo, "");
+		start = wallMilliseconds();
+		parallelSort(pool, result, compareByQuantity, 1);
+		printf("%11d threads sort:   %10.2f ms\n", threads, wallMilliseconds() - start);
+		destroyRepo(result);
+
+		destroyThreadPool(pool);
+	}
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Measures the latency of a fleet wide query as the same products are spread over more fridges
+/// </summary>
+void benchmarkFleet()
+{
+	char name[32];
+	int total = 200000;
+	ThreadPool* pool = createThreadPool(getProcessorCount());
+
+	printf("Fleet wide query over %d products, dairy expiring within 3 days by expiration date:\n", total);
+
+	for (int fridges = 1; fridges <= 1000; fridges *= 10)
+	{
+		Fleet* fleet = createFleet(pool);
+		for (int i = 0; i < total; i++)
+		{
+			sprintf(name, "product%d", i);
+			fleetAddProduct(fleet, i % fridges, name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28));
+		}
+
+		double start = wallMilliseconds();
+		FleetResult* result = fleetFilterByCategoryAndExpiration(fleet, dairy, 3, compareByExpiration, 0);
+		printf("%12d fridges: %10.2f ms (%d products)\n", fridges, wallMilliseconds() - start, result != NULL ? result->length : 0);
+
+		destroyFleetResult(result);
+		destroyFleet(fleet);
+	}
+
+	destroyThreadPool(pool);
+}
+
+/// <summary>
+/// Compares daily expiry alerts from the timer wheel with a full scan of the fridge every day
+/// </summary>
+void benchmarkExpiryWheel()
+{
+	char name[32];
+	int days = 30;
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2030 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+
+	printf("Daily expiry alerts for %d products over %d days:\n", getLength(repo), days);
+
+	clock_t start = clock();
+	int found = 0;
+	for (int day = 0; day < days; day++)
+	{
+		ProductRepo* result = filterRepoByCategoryAndExpiration(repo, none, WHEEL_DEFAULT_DAYS);
+		found += getLength(result);
+		destroyRepo(result);
+	}
+	printf("%16s: %10.2f ms per day (%d alerts)\n", "full scan", elapsedMilliseconds(start) / days, found);
+
+	start = clock();
+	ExpiryWheel* wheel = createExpiryWheel(WHEEL_DEFAULT_DAYS, date(2030, 1, 1), NULL, NULL);
+	syncExpiryWheel(wheel, repo);
+	printf("%16s: %10.2f ms\n", "wheel schedule", elapsedMilliseconds(start));
+
+	found = 0;
+	start = clock();
+	for (Date day = date(2030, 1, 1); day.day <= days; day.day++)
+		found += advanceExpiryWheel(wheel, day);
+	printf("%16s: %10.2f ms per day (%d alerts)\n", "wheel advance", elapsedMilliseconds(start) / days, found);
+
+	destroyExpiryWheel(wheel);
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Compares answering a standing query from a materialized view with recomputing it on every request
+/// </summary>
+void benchmarkViews()
+{
+	char name[32];
+	int requests = 200;
+	Service* serv = createService(createRepo(), 0);
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(getRepo(serv), createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+
+	printf("Low stock dairy (below 1) among %d products, %d requests each after an update:\n", getLength(getRepo(serv)), requests);
+
+	clock_t start = clock();
+	MaterializedView* view = registerView(serv, createLowStockView(&serv->repo, dairy, 1));
+	printf("%18s: %10.2f ms (%d products)\n", "view creation", elapsedMilliseconds(start), getLength(atomic_load(&view->published)));
+
+	start = clock();
+	long long rows = 0;
+	for (int i = 0; i < requests; i++)
+	{
+		sprintf(name, "product%d", i * 4);
+		updateProductService(serv, name, dairy, i % 2 == 0 ? 0.5 : 5, date(2025, 1, 1));
+
+		// The sequential scan of the same query
+		ProductRepo* result = createRepo();
+		for (int j = 0; j < getLength(getRepo(serv)); j++)
+		{
+			Product* current = getProductAt(getRepo(serv), j);
+			if (current->category == dairy && current->quantity < 1)
+				appendProductRepo(result, createProduct(current->name, current->category, current->quantity, current->expiration));
+		}
+		rows += getLength(result);
+		destroyRepo(result);
+	}
+	printf("%18s: %10.2f ms per request (%lld rows)\n", "recompute", elapsedMilliseconds(start) / requests, rows);
+
+	start = clock();
+	rows = 0;
+	for (int i = 0; i < requests; i++)
+	{
+		sprintf(name, "product%d", i * 4);
+		updateProductService(serv, name, dairy, i % 2 == 0 ? 0.5 : 5, date(2025, 1, 1));
+
+		int ticket;
+		ProductRepo* result = beginViewRead(view, &ticket);
+		rows += getLength(result);
+		endViewRead(view, ticket);
+	}
+	printf("%18s: %10.2f ms per request (%lld rows)\n", "view", elapsedMilliseconds(start) / requests, rows);
+
+	destroyService(serv);
+}
+
+/// <summary>
+/// Compares the per category aggregates with a scan of the repository
+/// </summary>
+void benchmarkAggregates()
+{
+	char name[32];
+	int queries = 1000;
+	ProductRepo* repo = createRepo();
+
+	clock_t start = clock();
+	for (int i = 0; i < 1000000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+	printf("Summing up the dairy of %d products (filled in %.2f ms):\n", getLength(repo), elapsedMilliseconds(start));
+
+	start = clock();
+	double quantity = 0;
+	for (int i = 0; i < queries / 100; i++)
+	{
+		for (int j = 0; j < getLength(repo); j++)
+		{
+			Product* current = getProductAt(repo, j);
+			if (current->category == dairy) quantity += current->quantity;
+		}
+	}
+	printf("%12s: %12.6f ms per query (%.2f)\n", "scan", elapsedMilliseconds(start) / (queries / 100), quantity / (queries / 100));
+
+	start = clock();
+	quantity = 0;
+	for (int i = 0; i < queries; i++)
+		quantity += summarizeCategory(repo, dairy).quantity;
+	printf("%12s: %12.6f ms per query (%.2f)\n", "aggregate", elapsedMilliseconds(start) / queries, quantity / queries);
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Compares repeated filter queries answered by the query cache with recomputing them
+/// </summary>
+void benchmarkQueryCache()
+{
+	char name[32];
+	char* searches[] = { "product1", "product22", "product333", "" };
+	int queries = 200;
+	Service* serv = createService(createRepo(), 0);
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(getRepo(serv), createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+
+	printf("Repeating %d filters over %d products, one change every 50 queries:\n", queries, getLength(getRepo(serv)));
+
+	clock_t start = clock();
+	long long rows = 0;
+	for (int i = 0; i < queries; i++)
+	{
+		if (i % 50 == 0) updateProductService(serv, "product0", dairy, i, date(2025, 1, 1));
+
+		ProductRepo* result = filterByString(serv, searches[i % 4]);
+		rows += getLength(result);
+		destroyRepo(result);
+	}
+	printf("%10s: %10.3f ms per query (%lld rows)\n", "uncached", elapsedMilliseconds(start) / queries, rows);
+
+	start = clock();
+	rows = 0;
+	for (int i = 0; i < queries; i++)
+	{
+		if (i % 50 == 0) updateProductService(serv, "product0", dairy, i, date(2025, 1, 1));
+
+		ProductRepo* result = cachedFilterByString(serv, searches[i % 4]);
+		rows += getLength(result);
+		releaseResult(serv, result);
+	}
+
+	CacheStats stats;
+	getCacheStats(serv->cache, &stats);
+	printf("%10s: %10.3f ms per query (%lld rows, %lld hits, %lld misses)\n", "cached", elapsedMilliseconds(start) / queries, rows, stats.hits, stats.misses);
+
+	destroyService(serv);
+}
+
+/// <summary>
+/// Compares showing the first pages of a sorted listing with sorting every match
+/// </summary>
+void benchmarkPages()
+{
+	char name[32];
+	int pages = 5;
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 20000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+
+	printf("First %d pages of %d rows by quantity among %d products:\n", pages, PAGE_DEFAULT_SIZE, getLength(repo));
+
+	clock_t start = clock();
+	ProductRepo* sorted = filterRepoByString(repo, "");
+	sortByQuantity(sorted, 0);
+	printf("%12s: %10.2f ms (%d rows sorted)\n", "full sort", elapsedMilliseconds(start), getLength(sorted));
+	destroyRepo(sorted);
+
+	start = clock();
+	PageCursor cursor = { 0 };
+	Page page;
+	int rows = 0;
+	for (int i = 0; i < pages; i++)
+	{
+		pageByString(repo, "", matchSubstring, orderByQuantity, PAGE_DEFAULT_SIZE, &cursor, &page);
+		rows += getLength(page.rows);
+		takeNextCursor(&page, &cursor);
+		destroyPage(&page);
+	}
+	clearCursor(&cursor);
+	printf("%12s: %10.2f ms per page (%d rows)\n", "top-K pages", elapsedMilliseconds(start) / pages, rows);
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Measures the latency of completing a name on every keystroke, with the name index and with a scan
+/// </summary>
+void benchmarkNameTrie()
+{
+	char name[32];
+	char typed[16] = { 0 };
+	const char* word = "product123456";
+	int keystrokes = (int)strlen(word);
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 1000000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 1000 / 4.0, date(2022 + i % 5, 1 + i % 12, 1 + i % 28)));
+	}
+
+	Product* completions[TRIE_TOP_COUNT];
+	printf("Typing \"%s\" among %d names:\n", word, getLength(repo));
+
+	clock_t start = clock();
+	completeRepoNames(repo, "", completions, TRIE_TOP_COUNT);
+	printf("%12s: %10.2f ms\n", "index build", elapsedMilliseconds(start));
+
+	start = clock();
+	int found = 0;
+	for (int i = 0; i < keystrokes; i++)
+	{
+		typed[i] = word[i];
+		ProductRepo* result = filterRepoByString(repo, typed);
+		found += getLength(result) < TRIE_TOP_COUNT ? getLength(result) : TRIE_TOP_COUNT;
+		destroyRepo(result);
+	}
+	printf("%12s: %10.3f ms per keystroke (%d completions)\n", "scan", elapsedMilliseconds(start) / keystrokes, found);
+
+	// Many rounds, a single one is too fast for the clock
+	int rounds = 10000;
+	start = clock();
+	found = 0;
+	for (int round = 0; round < rounds; round++)
+	{
+		memset(typed, 0, sizeof(typed));
+		for (int i = 0; i < keystrokes; i++)
+		{
+			typed[i] = word[i];
+			found += completeRepoNames(repo, typed, completions, TRIE_TOP_COUNT);
+		}
+	}
+	printf("%12s: %10.6f ms per keystroke (%d completions)\n", "index", elapsedMilliseconds(start) / keystrokes / rounds, found / rounds);
+
+	start = clock();
+	for (int i = 0; i < 1000; i++)
+	{
+		sprintf(name, "product%d", i * 997);
+		updateProductRepo(repo, name, CATEGORY_START + i * 997 % CATEGORY_END, i % 7, date(2025, 1, 1));
+	}
+	printf("%12s: %10.6f ms per update\n", "maintenance", elapsedMilliseconds(start) / 1000);
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Compares "did you mean" searches in the name tree with comparing against every name
+/// </summary>
+void benchmarkBkTree()
+{
+	char name[32];
+	int queries = 100;
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 100000; i++)
+	{
+		sprintf(name, "product%d", i * 7919 % 1000000);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, 1, date(2022, 1, 1)));
+	}
+
+	Suggestion suggestions[BK_SUGGESTIONS];
+	printf("Misspelled names among %d names, %d queries:\n", getLength(repo), queries);
+
+	clock_t start = clock();
+	suggestRepoNames(repo, "", 0, suggestions, BK_SUGGESTIONS);
+	printf("%14s: %10.2f ms\n", "tree build", elapsedMilliseconds(start));
+
+	start = clock();
+	int found = 0;
+	for (int i = 0; i < queries; i++)
+	{
+		sprintf(name, "prodcut%d", i * 7919 % 1000000);
+		for (int j = 0; j < getLength(repo); j++)
+			if (editDistance(name, getProductAt(repo, j)->name) <= 2) found++;
+	}
+	printf("%14s: %10.3f ms per query (%d names)\n", "scan", elapsedMilliseconds(start) / queries, found);
+
+	for (int distance = 1; distance <= BK_MAX_DISTANCE; distance++)
+	{
+		long long comparisons = repo->similar->comparisons;
+		start = clock();
+		found = 0;
+		for (int i = 0; i < queries; i++)
+		{
+			sprintf(name, "prodcut%d", i * 7919 % 1000000);
+			found += suggestRepoNames(repo, name, distance, suggestions, BK_SUGGESTIONS);
+		}
+		printf("%11s %d: %10.3f ms per query (%d names, %lld distances per query)\n", "tree, k =", distance,
+			elapsedMilliseconds(start) / queries, found, (repo->similar->comparisons - comparisons) / queries);
+	}
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Benchmarks the searches that ignore case, scanning the folded names against folding every name per query
+/// </summary>
+void benchmarkFoldedSearch()
+{
+	char name[32];
+	char folded[32];
+	int queries = 20;
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, i % 2 == 0 ? "Product%d" : "PRODUCT%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, 1, date(2022, 1, 1)));
+	}
+
+	printf("Searches that ignore case among %d products, %d queries:\n", getLength(repo), queries);
+
+	clock_t start = clock();
+	int found = 0;
+	for (int i = 0; i < queries; i++)
+		for (int j = 0; j < getLength(repo); j++)
+		{
+			foldName(getProductAt(repo, j)->name, folded);
+			if (strstr(folded, "ct1") != NULL) found++;
+		}
+	printf("%20s: %10.2f ms per query (%d products)\n", "fold every name", elapsedMilliseconds(start) / queries, found);
+
+	const char* labels[] = { "exact substring", "folded substring", "folded equality" };
+	StringMatch modes[] = { matchSubstring, matchIgnoreCase, matchEqualIgnoreCase };
+	const char* texts[] = { "ct1", "ct1", "product12345" };
+	for (int mode = 0; mode < 3; mode++)
+	{
+		start = clock();
+		found = 0;
+		for (int i = 0; i < queries; i++)
+			for (int j = 0; j < getLength(repo); j++)
+				if (matchName(getProductAt(repo, j), texts[mode], modes[mode])) found++;
+		printf("%20s: %10.2f ms per query (%d products)\n", labels[mode], elapsedMilliseconds(start) / queries, found);
+	}
+
+	start = clock();
+	ProductRepo* result = filterRepoByStringMatch(repo, "CT1", matchIgnoreCase);
+	printf("%20s: %10.2f ms (%d products)\n", "filter, copies", elapsedMilliseconds(start), getLength(result));
+	destroyRepo(result);
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Benchmarks recording quantities and forecasting the whole inventory from the trends
+/// against recomputing the rates from every history
+/// </summary>
+void benchmarkConsumption()
+{
+	char name[32];
+	int products = 100000;
+	int passes = 10;
+	int start = daysFromCivil(date(2022, 1, 1)) * 1440;
+	ConsumptionLog* log = createConsumptionLog();
+
+	printf("Consumption of %d products, 12 samples each, %d forecasts:\n", products, passes);
+
+	clock_t begin = clock();
+	for (int sample = 0; sample < 12; sample++)
+		for (int i = 0; i < products; i++)
+		{
+			sprintf(name, "product%d", i);
+			recordConsumption(log, name, CATEGORY_START + i % CATEGORY_END, 100 - sample * (1 + i % 7), start + sample * 720);
+		}
+	printf("%16s: %10.3f us per sample\n", "record", elapsedMilliseconds(begin) * 1000 / (12.0 * products));
+
+	Forecast* forecasts = malloc(log->length * sizeof(Forecast));
+	Sample samples[HISTORY_RAW_SAMPLES + HISTORY_HOURLY_SAMPLES + HISTORY_DAILY_SAMPLES];
+	int now = start + 12 * 720;
+
+	begin = clock();
+	int found = 0;
+	for (int pass = 0; pass < passes; pass++)
+	{
+		found = 0;
+		for (int i = 0; i < log->length; i++)
+		{
+			HistoryEntry* entry = &log->entries[i];
+			int length = getHistorySamples(log, entry->name, entry->category, samples, 64);
+			double consumed = 0;
+			for (int j = 1; j < length; j++)
+				if (samples[j - 1].quantity > samples[j].quantity) consumed += samples[j - 1].quantity - samples[j].quantity;
+
+			double rate = consumed * 1440 / (now - samples[0].minute);
+			if (rate > 0 && floor((samples[length - 1].minute + samples[length - 1].quantity / rate * 1440 - now) / 1440) <= HISTORY_FORECAST_DAYS)
+				found++;
+		}
+	}
+	printf("%16s: %10.2f ms per pass (%d products)\n", "scan histories", elapsedMilliseconds(begin) / passes, found);
+
+	// Sorting every forecast costs more than the pass itself, so the first ten are measured too
+	int counts[] = { log->length, 10 };
+	const char* labels[] = { "trends, sorted", "trends, first 10" };
+	for (int i = 0; i < 2; i++)
+	{
+		begin = clock();
+		for (int pass = 0; pass < passes; pass++)
+			found = forecastConsumption(log, now, HISTORY_FORECAST_DAYS, forecasts, counts[i]);
+		printf("%16s: %10.2f ms per pass (%d products)\n", labels[i], elapsedMilliseconds(begin) / passes, found);
+	}
+
+	free(forecasts);
+	destroyConsumptionLog(log);
+}
+
+/// <summary>
+/// Compares two quantities for qsort
+/// </summary>
+/// <param name="first">A pointer to the first quantity</param>
+/// <param name="second">A pointer to the second quantity</param>
+/// <returns>A negative value, zero or a positive value</returns>
+int compareQuantities(const void* first, const void* second)
+{
+	double a = *(const double*)first;
+	double b = *(const double*)second;
+	return (a > b) - (a < b);
+}
+
+/// <summary>
+/// Benchmarks low stock counts and medians on the quantity index against scans and sorts
+/// </summary>
+void benchmarkQuantityTree()
+{
+	char name[32];
+	int queries = 100;
+	ProductRepo* repo = createRepo();
+	srand(7);
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, rand() % 10000 / 100.0, date(2022, 1, 1)));
+	}
+
+	printf("Quantity queries among %d products, %d queries:\n", getLength(repo), queries);
+
+	clock_t start = clock();
+	int found = 0;
+	for (int i = 0; i < queries; i++)
+	{
+		found = 0;
+		for (int j = 0; j < getLength(repo); j++)
+			if (getProductAt(repo, j)->quantity <= 0.5) found++;
+	}
+	printf("%14s: %10.3f ms per query (%d products)\n", "scan count", elapsedMilliseconds(start) / queries, found);
+
+	start = clock();
+	double* quantities = malloc(getLength(repo) * sizeof(double));
+	for (int j = 0; j < getLength(repo); j++)
+		quantities[j] = getProductAt(repo, j)->quantity;
+	qsort(quantities, getLength(repo), sizeof(double), compareQuantities);
+	printf("%14s: %10.3f ms (median %g)\n", "sort median", elapsedMilliseconds(start), quantities[getLength(repo) / 2]);
+	free(quantities);
+
+	start = clock();
+	countRepoQuantities(repo, 0, 0);
+	printf("%14s: %10.3f ms\n", "index build", elapsedMilliseconds(start));
+
+	start = clock();
+	for (int i = 0; i < queries; i++)
+		found = countRepoQuantities(repo, 0, 0.5);
+	printf("%14s: %10.4f ms per query (%d products)\n", "index count", elapsedMilliseconds(start) / queries, found);
+
+	start = clock();
+	Product* median = NULL;
+	for (int i = 0; i < queries; i++)
+		median = selectRepoQuantity(repo, getLength(repo) / 2);
+	printf("%14s: %10.4f ms per query (median %g)\n", "index median", elapsedMilliseconds(start) / queries, median->quantity);
+
+	start = clock();
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* p = getProductAt(repo, i);
+		updateProductRepo(repo, p->name, p->category, rand() % 10000 / 100.0, p->expiration);
+	}
+	printf("%14s: %10.3f us per update\n", "index update", elapsedMilliseconds(start) * 1000 / getLength(repo));
+
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Compares two products by quantity for qsort
+/// </summary>
+/// <param name="first">A pointer to the pointer to the first product</param>
+/// <param name="second">A pointer to the pointer to the second product</param>
+/// <returns>A negative value, zero or a positive value</returns>
+int compareProductQuantities(const void* first, const void* second)
+{
+	return compareByQuantity(*(Product* const*)first, *(Product* const*)second);
+}
+
+/// <summary>
+/// Benchmarks restocking with double and fixed point sums, and the radix sort on the fixed point quantities
+/// </summary>
+void benchmarkFixedQuantity()
+{
+	char name[32];
+	int restocks = 1000000;
+
+	printf("Restocking 0.1 %d times:\n", restocks);
+
+	clock_t start = clock();
+	double total = 0;
+	for (int i = 0; i < restocks; i++) total += 0.1;
+	printf("%14s: %10.2f ms (error %g)\n", "double", elapsedMilliseconds(start), total - restocks / 10);
+
+	start = clock();
+	Quantity units = 0;
+	Quantity step = toQuantity(0.1);
+	for (int i = 0; i < restocks; i++) units += step;
+	printf("%14s: %10.2f ms (error %g)\n", "fixed point", elapsedMilliseconds(start), fromQuantity(units) - restocks / 10);
+
+	ProductRepo* repo = createRepo();
+	srand(11);
+	for (int i = 0; i < 200000; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, rand() % 100000 / 100.0, date(2022, 1, 1)));
+	}
+
+	printf("Sorting %d products by quantity:\n", getLength(repo));
+
+	Product** products = malloc(getLength(repo) * sizeof(Product*));
+	memcpy(products, repo->products, getLength(repo) * sizeof(Product*));
+	start = clock();
+	qsort(products, getLength(repo), sizeof(Product*), compareProductQuantities);
+	printf("%14s: %10.2f ms\n", "comparison", elapsedMilliseconds(start));
+
+	start = clock();
+	sortByQuantity(repo, 0);
+	printf("%14s: %10.2f ms\n", "radix", elapsedMilliseconds(start));
+
+	for (int i = 0; i < getLength(repo); i++)
+		if (products[i]->quantity != getProductAt(repo, i)->quantity) printf("ERROR: The sorts disagree at %d!\n", i);
+
+	free(products);
+	destroyRepo(repo);
+}
+
+#define BENCHMARK_REPLICATED_OPERATIONS 20000
+#define BENCHMARK_LAG_SAMPLES 200
+
+typedef struct
+{
+	Service* serv;
+	FILE* input;
+	uint64_t sequence;
+	atomic_ullong applied;
+} StandbyState;
+
+/// <summary>
+/// Follows the shipped operations on a standby until the primary closes the pipe
+/// </summary>
+/// <param name="arg">A pointer to the standby state</param>
+/// <returns>0</returns>
+int followBenchmarkPrimary(void* arg)
+{
+	StandbyState* state = arg;
+	followJournal(state->serv, state->input, &state->sequence, &state->applied);
+	return 0;
+}
+
+/// <summary>
+/// Measures how fast a standby keeps up with a primary through a pipe, for several batch sizes
+/// </summary>
+void benchmarkReplication()
+{
+	char name[32];
+	int batches[] = { 1, 8, 64 };
+
+	printf("Shipping %d updates to a standby:\n", BENCHMARK_REPLICATED_OPERATIONS);
+	for (int b = 0; b < (int)(sizeof(batches) / sizeof(batches[0])); b++)
+	{
+		int fds[2];
+		if (createReplicationPipe(fds) == 0) return;
+
+		Service* primary = createService(createRepo(), 0);
+		for (int i = 0; i < BENCHMARK_PRODUCTS; i++)
+		{
+			sprintf(name, "product%d", i);
+			addProductService(primary, name, dairy, 1, date(2022, 3, 1 + i % 28));
+		}
+
+		StandbyState state;
+		state.serv = createService(createRepo(), 0);
+		state.input = openReplicationStream(fds[0]);
+		state.sequence = 0;
+		atomic_init(&state.applied, 0);
+		thrd_t standby;
+		thrd_create(&standby, followBenchmarkPrimary, &state);
+
+		attachShipper(primary, createShipper(fds[1], batches[b]));
+		Shipper* shipper = primary->shipper;
+
+		double start = wallMilliseconds();
+		for (int i = 0; i < BENCHMARK_REPLICATED_OPERATIONS; i++)
+		{
+			sprintf(name, "product%d", i % BENCHMARK_PRODUCTS);
+			updateProductService(primary, name, dairy, i, date(2022, 4, 1));
+		}
+		flushShipper(shipper);
+		while (atomic_load(&state.applied) < shipper->sequence) thrd_yield();
+		double elapsed = wallMilliseconds() - start;
+
+		// Lag from a flushed commit until the standby applied it, one update at a time
+		double lag = 0;
+		for (int i = 0; i < BENCHMARK_LAG_SAMPLES; i++)
+		{
+			sprintf(name, "product%d", i);
+			updateProductService(primary, name, dairy, i, date(2022, 5, 1));
+			double sent = wallMilliseconds();
+			flushShipper(shipper);
+			while (atomic_load(&state.applied) < shipper->sequence) thrd_yield();
+			lag += wallMilliseconds() - sent;
+		}
+
+		printf("%10d per batch: %10.0f updates/s, %6lld batches, %8.1f us lag\n", batches[b],
+			BENCHMARK_REPLICATED_OPERATIONS / elapsed * 1000, shipper->batches, lag / BENCHMARK_LAG_SAMPLES * 1000);
+
+		attachShipper(primary, NULL);
+		thrd_join(standby, NULL);
+		fclose(state.input);
+		destroyService(state.serv);
+		destroyService(primary);
+	}
+}
+
+#define BENCHMARK_SESSION_COMMITS 4000
+
+typedef struct
+{
+	SharedService* shared;
+	int commits; // Commits each thread makes
+	int hot; // 1 if every thread changes the same product
+	atomic_llong conflicts;
+	atomic_int next;
+} SessionBenchmarkState;
+
+/// <summary>
+/// Increments a product in a session, retrying the transactions that conflict
+/// </summary>
+/// <param name="arg">A pointer to the benchmark state</param>
+/// <returns>0</returns>
+int incrementBenchmarkSession(void* arg)
+{
+	SessionBenchmarkState* state = arg;
+	Session* session = openSession(state->shared);
+	char name[32];
+	Quantity units;
+	Date expiration;
+
+	sprintf(name, "product%d", state->hot == 1 ? 0 : atomic_fetch_add(&state->next, 1));
+	for (int i = 0; i < state->commits; i++)
+	{
+		do
+		{
+			readSessionProduct(session, name, dairy, &units, &expiration);
+			sessionUpdateProduct(session, name, dairy, fromQuantity(units) + 1, expiration);
+		} while (commitSession(session) == 0);
+	}
+
+	atomic_fetch_add(&state->conflicts, session->conflicts);
+	closeSession(session);
+	return 0;
+}
+
+/// <summary>
+/// Measures the commits of concurrent sessions, on different products and on the same one
+/// </summary>
+void benchmarkSessions()
+{
+	printf("Session commits:\n");
+	for (int hot = 0; hot <= 1; hot++)
+	{
+		for (int threads = 1; threads <= BENCHMARK_MAX_THREADS; threads *= 2)
+		{
+			char name[32];
+			Service* serv = createService(createRepo(), 0);
+			for (int i = 0; i < BENCHMARK_PRODUCTS; i++)
+			{
+				sprintf(name, "product%d", i);
+				addProductService(serv, name, dairy, 0, date(2022, 3, 1 + i % 28));
+			}
+
+			SessionBenchmarkState state;
+			state.shared = createSharedService(serv);
+			state.commits = BENCHMARK_SESSION_COMMITS / threads;
+			state.hot = hot;
+			atomic_init(&state.conflicts, 0);
+			atomic_init(&state.next, 0);
+
+			thrd_t sessions[BENCHMARK_MAX_THREADS];
+			double start = wallMilliseconds();
+			for (int i = 0; i < threads; i++)
+				thrd_create(&sessions[i], incrementBenchmarkSession, &state);
+			for (int i = 0; i < threads; i++)
+				thrd_join(sessions[i], NULL);
+			double elapsed = wallMilliseconds() - start;
+
+			long long conflicts = atomic_load(&state.conflicts);
+			printf("%16s %d: %10.0f commits/s, %lld conflicts (%.1f%% of attempts)\n", hot == 1 ? "same product" : "own products",
+				threads, threads * state.commits / elapsed * 1000, conflicts, 100.0 * conflicts / (conflicts + threads * state.commits));
+
+			destroySharedService(state.shared);
+		}
+	}
+}
+
+#define BENCHMARK_ARCHIVE_PRODUCTS 20000
+#define BENCHMARK_ARCHIVE_SCANS 50
+#define BENCHMARK_ARCHIVE_BATCH 512
+
+/// <summary>
+/// Measures filtering the published version of a shared service
+/// </summary>
+/// <param name="shared">A pointer to the shared service, nobody may be writing</param>
+/// <returns>The milliseconds of a filter</returns>
+double timeArchiveScans(SharedService* shared)
+{
+	double start = wallMilliseconds();
+	for (int i = 0; i < BENCHMARK_ARCHIVE_SCANS; i++)
+		destroyRepo(filterRepoByString(atomic_load(&shared->current), "product1"));
+
+	return (wallMilliseconds() - start) / BENCHMARK_ARCHIVE_SCANS;
+}
+
+/// <summary>
+/// Measures the scans of a repository that is mostly expired before and after the sweeper moved
+/// the cold products out, and the writes that are made while it sweeps in the background
+/// </summary>
+void benchmarkArchive()
+{
+	char name[32];
+	Service* serv = createService(createRepo(), 0);
+	int hot = 0;
+	for (int i = 0; i < BENCHMARK_ARCHIVE_PRODUCTS; i++)
+	{
+		sprintf(name, "product%d", i);
+		hot += i % 10 == 0;
+		addProductService(serv, name, dairy, 1 + i % 5, i % 10 == 0 ? date(2999, 1, 1) : date(2022, 3, 1 + i % 28));
+	}
+	SharedService* shared = createSharedService(serv);
+
+	printf("Archiving %d cold of %d products:\n", BENCHMARK_ARCHIVE_PRODUCTS - hot, BENCHMARK_ARCHIVE_PRODUCTS);
+	printf("%16s: %10.3f ms per filter\n", "before", timeArchiveScans(shared));
+
+	// The foreground writes a hot product all the time like the sensors do, so every sweep competes with it
+	Sweeper* sweeper = createSweeper(shared, BENCHMARK_ARCHIVE_BATCH, 1);
+	double start = wallMilliseconds();
+	int writes = 0;
+
+	startSweeper(sweeper);
+	while (getLength(atomic_load(&shared->current)) > hot)
+	{
+		serv = beginWrite(shared);
+		endWrite(shared, updateProductService(serv, "product0", dairy, writes++ % 5 + 1, date(2999, 1, 1)));
+	}
+	stopSweeper(sweeper);
+	double elapsed = wallMilliseconds() - start;
+
+	SweeperStats stats;
+	getSweeperStats(sweeper, &stats);
+	printf("%16s: %10.3f ms, %lld rounds, %lld given up to writers, %.0f writes/s meanwhile\n", "sweeping",
+		elapsed, stats.rounds, stats.deferred, writes / elapsed * 1000);
+	printf("%16s: %10.3f ms per filter\n", "after", timeArchiveScans(shared));
+
+	start = wallMilliseconds();
+	serv = beginWrite(shared);
+	ProductRepo* archived = filterArchiveByString(serv->archive, "product1");
+	endWrite(shared, 0);
+	printf("%16s: %10.3f ms for %d archived products\n", "archive query", wallMilliseconds() - start, getLength(archived));
+	destroyRepo(archived);
+
+	destroySweeper(sweeper);
+	destroySharedService(shared);
+}
+
+/// <summary>
+/// Runs all benchmarks
+/// </summary>
+void runAllBenchmarks()
+{
+	benchmarkRecovery();
+	benchmarkImportExport();
+	benchmarkListing();
+	benchmarkScript();
+	benchmarkReadScaling();
+	benchmarkEventQueue();
+	benchmarkParallel();
+	benchmarkFleet();
+	benchmarkExpiryWheel();
+	benchmarkViews();
+	benchmarkAggregates();
+	benchmarkQueryCache();
+	benchmarkPages();
+	benchmarkNameTrie();
+	benchmarkBkTree();
+	benchmarkFoldedSearch();
+	benchmarkConsumption();
+	benchmarkQuantityTree();
+	benchmarkFixedQuantity();
+	benchmarkReplication();
+	benchmarkSessions();
+	benchmarkArchive();
+}
@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BkTree.h"
+#include "Product.h"
+
+/// <summary>
+/// Computes the Levenshtein distance of two strings
+/// </summary>
+/// <param name="first">The first string</param>
+/// <param name="second">The second string</param>
+/// <returns>The number of insertions, deletions and substitutions that turn one string into the other</returns>
+int editDistance(const char* first, const char* second)
+{
+	int firstLength = (int)strlen(first);
+	int secondLength = (int)strlen(second);
+	int buffer[2 * PRODUCT_STRING_SIZE];
+	int* rows = buffer;
+
+	// Only two rows of the table are kept, long names get them from the heap
+	if (secondLength >= PRODUCT_STRING_SIZE)
+	{
+		rows = NULL;
+		while (rows == NULL) rows = malloc(2 * (secondLength + 1) * sizeof(int));
+	}
+
+	int* previous = rows;
+	int* current = rows + secondLength + 1;
+	for (int j = 0; j <= secondLength; j++) previous[j] = j;
+
+	for (int i = 1; i <= firstLength; i++)
+	{
+		current[0] = i;
+		for (int j = 1; j <= secondLength; j++)
+		{
+			int substitution = previous[j - 1] + (first[i - 1] != second[j - 1]);
+			int deletion = previous[j] + 1;
+			int insertion = current[j - 1] + 1;
+
+			current[j] = substitution < deletion ? substitution : deletion;
+			if (insertion < current[j]) current[j] = insertion;
+		}
+
+		int* tmp = previous;
+		previous = current;
+		current = tmp;
+	}
+
+	int distance = previous[secondLength];
+	if (rows != buffer) free(rows);
+	return distance;
+}
+
+/// <summary>
+/// Creates a node for a name
+/// </summary>
+/// <param name="name">The name</param>
+/// <param name="distance">The edit distance to the parent</param>
+/// <returns>A pointer to the node</returns>
+static BkNode* createNode(const char* name, int distance)
+{
+	BkNode* node = calloc(1, sizeof(BkNode));
+	if (node == NULL) return NULL;
+
+	node->name = malloc(strlen(name) + 1);
+	if (node->name == NULL)
+	{
+		free(node);
+		return NULL;
+	}
+	strcpy(node->name, name);
+	node->count = 1;
+	node->distance = distance;
+
+	return node;
+}
+
+/// <summary>
+/// Destroys a node and its subtree
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+static void destroyNode(BkNode* node)
+{
+	if (node == NULL) return;
+
+	for (int i = 0; i < node->childLength; i++)
+		destroyNode(node->children[i]);
+
+	free(node->children);
+	free(node->name);
+	free(node);
+}
+
+/// <summary>
+/// Creates an empty tree
+/// </summary>
+/// <returns>A pointer to the tree</returns>
+BkTree* createBkTree()
+{
+	return calloc(1, sizeof(BkTree));
+}
+
+/// <summary>
+/// Destroys the tree
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+void destroyBkTree(BkTree* tree)
+{
+	if (tree == NULL) return;
+
+	destroyNode(tree->root);
+	free(tree);
+
+	tree = NULL;
+}
+
+/// <summary>
+/// Finds the child of a node at an edit distance
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="distance">The edit distance</param>
+/// <returns>A pointer to the child,
+///			 NULL if there is none</returns>
+static BkNode* findChild(BkNode* node, int distance)
+{
+	for (int i = 0; i < node->childLength; i++)
+		if (node->children[i]->distance == distance) return node->children[i];
+
+	return NULL;
+}
+
+/// <summary>
+/// Counts a product with a name, the name is added if no other product has it
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="name">The name of the product</param>
+/// <returns>1 if the name was counted,
+///			 0 if there is not enough memory</returns>
+int insertBkTree(BkTree* tree, const char* name)
+{
+	if (tree->root == NULL)
+	{
+		tree->root = createNode(name, 0);
+		if (tree->root == NULL) return 0;
+
+		tree->live++;
+		return 1;
+	}
+
+	BkNode* node = tree->root;
+	while (1)
+	{
+		int distance = editDistance(name, node->name);
+		tree->comparisons++;
+
+		if (distance == 0)
+		{
+			if (node->count++ == 0)
+			{
+				tree->dead--;
+				tree->live++;
+			}
+			return 1;
+		}
+
+		BkNode* child = findChild(node, distance);
+		if (child != NULL)
+		{
+			node = child;
+			continue;
+		}
+
+		if (node->childLength == node->childCapacity)
+		{
+			int capacity = node->childCapacity == 0 ? BK_INITIAL_CHILDREN : node->childCapacity * 2;
+			BkNode** tmp = realloc(node->children, capacity * sizeof(BkNode*));
+			if (tmp == NULL) return 0;
+
+			node->children = tmp;
+			node->childCapacity = capacity;
+		}
+
+		child = createNode(name, distance);
+		if (child == NULL) return 0;
+
+		node->children[node->childLength++] = child;
+		tree->live++;
+		return 1;
+	}
+}
+
+/// <summary>
+/// Stops counting a product with a name, the node of the name stays in the tree
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="name">The name of the product</param>
+void removeBkTree(BkTree* tree, const char* name)
+{
+	BkNode* node = tree->root;
+
+	while (node != NULL)
+	{
+		int distance = editDistance(name, node->name);
+		tree->comparisons++;
+
+		if (distance == 0)
+		{
+			if (node->count > 0 && --node->count == 0)
+			{
+				tree->live--;
+				tree->dead++;
+			}
+			return;
+		}
+
+		node = findChild(node, distance);
+	}
+}
+
+/// <summary>
+/// Adds a name to the suggestions if it is among the closest ones
+/// </summary>
+/// <param name="suggestions">The suggestions, ordered by distance and name</param>
+/// <param name="length">A pointer to the number of suggestions</param>
+/// <param name="count">The maximum number of suggestions</param>
+/// <param name="name">The name</param>
+/// <param name="distance">The edit distance of the name</param>
+static void offerSuggestion(Suggestion* suggestions, int* length, int count, const char* name, int distance)
+{
+	int position = *length;
+	while (position > 0 && (suggestions[position - 1].distance > distance ||
+		(suggestions[position - 1].distance == distance && strcmp(suggestions[position - 1].name, name) > 0)))
+	{
+		if (position < count) suggestions[position] = suggestions[position - 1];
+		position--;
+	}
+
+	if (position == count) return;
+	suggestions[position].name = name;
+	suggestions[position].distance = distance;
+	if (*length < count) (*length)++;
+}
+
+/// <summary>
+/// Searches the subtree of a node for names within an edit distance
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="node">A pointer to the node</param>
+/// <param name="name">The name to search for</param>
+/// <param name="maxDistance">The maximum edit distance</param>
+/// <param name="suggestions">The suggestions found so far</param>
+/// <param name="length">A pointer to the number of suggestions</param>
+/// <param name="count">The maximum number of suggestions</param>
+static void searchNode(BkTree* tree, BkNode* node, const char* name, int maxDistance, Suggestion* suggestions, int* length, int count)
+{
+	int distance = editDistance(name, node->name);
+	tree->comparisons++;
+
+	if (distance <= maxDistance && node->count > 0)
+		offerSuggestion(suggestions, length, count, node->name, distance);
+
+	// By the triangle inequality, names further away from this node cannot be close enough
+	for (int i = 0; i < node->childLength; i++)
+	{
+		BkNode* child = node->children[i];
+		if (child->distance >= distance - maxDistance && child->distance <= distance + maxDistance)
+			searchNode(tree, child, name, maxDistance, suggestions, length, count);
+	}
+}
+
+/// <summary>
+/// Finds the names within an edit distance of a name, the closest ones first
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="name">The name to search for</param>
+/// <param name="maxDistance">The maximum edit distance</param>
+/// <param name="suggestions">Where to store the names</param>
+/// <param name="count">The maximum number of names</param>
+/// <returns>The number of names</returns>
+int searchBkTree(BkTree* tree, const char* name, int maxDistance, Suggestion* suggestions, int count)
+{
+	int length = 0;
+
+	if (tree->root != NULL && count > 0)
+		searchNode(tree, tree->root, name, maxDistance, suggestions, &length, count);
+
+	return length;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#define BK_MAX_DISTANCE 2
+#define BK_INITIAL_CHILDREN 2
+#define BK_SUGGESTIONS 5
+
+// A distinct product name, its children are grouped by their edit distance to it
+typedef struct BkNode
+{
+	char* name;
+	int count; // The products with this name, 0 once they were all removed
+	int distance; // The edit distance to the parent
+
+	struct BkNode** children;
+	int childLength;
+	int childCapacity;
+} BkNode;
+
+// Burkhard-Keller tree over the product names of a repository. The edit distance is
+// a metric, so a search only visits the children whose distance is within the
+// threshold of the distance to their parent. Removed names stay as empty nodes.
+typedef struct
+{
+	BkNode* root;
+	int live;
+	int dead;
+	long long comparisons; // Edit distances computed so far
+} BkTree;
+
+typedef struct
+{
+	const char* name; // Valid until the repository changes
+	int distance;
+} Suggestion;
+
+BkTree* createBkTree();
+void destroyBkTree(BkTree* tree);
+
+int insertBkTree(BkTree* tree, const char* name);
+void removeBkTree(BkTree* tree, const char* name);
+int searchBkTree(BkTree* tree, const char* name, int maxDistance, Suggestion* suggestions, int count);
+
+int editDistance(const char* first, const char* second);
@@ -0,0 +1,461 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "Consumption.h"
+
+#define MINUTES_PER_DAY 1440
+
+static const int tierOffset[HISTORY_TIERS] = { 0, HISTORY_RAW_SAMPLES, HISTORY_RAW_SAMPLES + HISTORY_HOURLY_SAMPLES };
+static const int tierCapacity[HISTORY_TIERS] = { HISTORY_RAW_SAMPLES, HISTORY_HOURLY_SAMPLES, HISTORY_DAILY_SAMPLES };
+static const int tierMinutes[HISTORY_TIERS] = { 1, 60, MINUTES_PER_DAY };
+
+/// <summary>
+/// Gets the current time in minutes
+/// </summary>
+/// <returns>The minutes since 1970-01-01 UTC</returns>
+int currentMinute()
+{
+	return (int)(time(NULL) / 60);
+}
+
+/// <summary>
+/// Hashes the name and category of a product
+/// </summary>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The FNV-1a hash of the name and category</returns>
+static unsigned int hashEntry(const char* name, Category category)
+{
+	unsigned int hash = 2166136261u;
+
+	for (; *name != '\0'; name++)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	hash ^= (unsigned int)category;
+	hash *= 16777619u;
+
+	return hash;
+}
+
+/// <summary>
+/// Creates an empty log
+/// </summary>
+/// <returns>A pointer to the log</returns>
+ConsumptionLog* createConsumptionLog()
+{
+	ConsumptionLog* log = calloc(1, sizeof(ConsumptionLog));
+	if (log == NULL) return NULL;
+
+	log->trends = malloc(HISTORY_INITIAL_SIZE * sizeof(Trend));
+	log->entries = malloc(HISTORY_INITIAL_SIZE * sizeof(HistoryEntry));
+	log->index = malloc(2 * HISTORY_INITIAL_SIZE * sizeof(int));
+	if (log->trends == NULL || log->entries == NULL || log->index == NULL)
+	{
+		free(log->trends);
+		free(log->entries);
+		free(log->index);
+		free(log);
+		return NULL;
+	}
+
+	memset(log->index, -1, 2 * HISTORY_INITIAL_SIZE * sizeof(int));
+	log->capacity = HISTORY_INITIAL_SIZE;
+	log->indexCapacity = 2 * HISTORY_INITIAL_SIZE;
+
+	return log;
+}
+
+/// <summary>
+/// Destroys the log and its histories
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+void destroyConsumptionLog(ConsumptionLog* log)
+{
+	if (log == NULL) return;
+
+	for (int i = 0; i < log->length; i++)
+		free(log->entries[i].name);
+
+	free(log->trends);
+	free(log->entries);
+	free(log->index);
+	free(log);
+
+	log = NULL;
+}
+
+/// <summary>
+/// Finds the index slot of a product
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The slot that holds the position of the product, or the empty slot where it belongs</returns>
+static int findSlot(ConsumptionLog* log, const char* name, Category category)
+{
+	unsigned int mask = (unsigned int)log->indexCapacity - 1;
+	unsigned int slot = hashEntry(name, category) & mask;
+
+	while (log->index[slot] >= 0)
+	{
+		HistoryEntry* entry = &log->entries[log->index[slot]];
+		if (entry->category == category && strcmp(entry->name, name) == 0)
+			break;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return (int)slot;
+}
+
+/// <summary>
+/// Makes room for one more product, the index stays at most half full
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <returns>1 if there is room,
+///			 0 if there is not enough memory</returns>
+static int reserveEntry(ConsumptionLog* log)
+{
+	if (log->length == log->capacity)
+	{
+		int capacity = log->capacity * 2;
+
+		Trend* trends = realloc(log->trends, capacity * sizeof(Trend));
+		if (trends == NULL) return 0;
+		log->trends = trends;
+
+		HistoryEntry* entries = realloc(log->entries, capacity * sizeof(HistoryEntry));
+		if (entries == NULL) return 0;
+		log->entries = entries;
+
+		log->capacity = capacity;
+	}
+
+	if ((log->length + 1) * 2 <= log->indexCapacity) return 1;
+
+	int* index = malloc(2 * log->indexCapacity * sizeof(int));
+	if (index == NULL) return 0;
+
+	free(log->index);
+	log->index = index;
+	log->indexCapacity *= 2;
+	memset(log->index, -1, log->indexCapacity * sizeof(int));
+
+	for (int i = 0; i < log->length; i++)
+		log->index[findSlot(log, log->entries[i].name, log->entries[i].category)] = i;
+
+	return 1;
+}
+
+/// <summary>
+/// Adds a sample to a ring of a history. Past the raw ring a sample replaces the newest one
+/// of the same hour or day, and the oldest sample of a full ring moves on to the next one.
+/// </summary>
+/// <param name="history">A pointer to the history</param>
+/// <param name="tier">The ring: 0 for the raw samples, 1 for hours, 2 for days</param>
+/// <param name="sample">The sample, not older than the samples of the ring</param>
+static void pushSample(History* history, int tier, Sample sample)
+{
+	SampleRing* ring = &history->rings[tier];
+	Sample* samples = history->samples + tierOffset[tier];
+	int capacity = tierCapacity[tier];
+
+	if (tier > 0 && ring->length > 0)
+	{
+		Sample* newest = &samples[(ring->start + ring->length - 1) % capacity];
+		if (newest->minute / tierMinutes[tier] == sample.minute / tierMinutes[tier])
+		{
+			*newest = sample;
+			return;
+		}
+	}
+
+	if (ring->length == capacity)
+	{
+		if (tier + 1 < HISTORY_TIERS) pushSample(history, tier + 1, samples[ring->start]);
+		ring->start = (unsigned char)((ring->start + 1) % capacity);
+		ring->length--;
+	}
+
+	samples[(ring->start + ring->length) % capacity] = sample;
+	ring->length++;
+}
+
+/// <summary>
+/// Computes the trend of a history from its samples of the recent window
+/// </summary>
+/// <param name="history">A pointer to the history, it has at least one sample</param>
+/// <param name="trend">Where to store the trend</param>
+static void computeTrend(History* history, Trend* trend)
+{
+	SampleRing* raw = &history->rings[0];
+	Sample newest = history->samples[(raw->start + raw->length - 1) % HISTORY_RAW_SAMPLES];
+	int from = newest.minute - HISTORY_WINDOW_DAYS * MINUTES_PER_DAY;
+
+	trend->quantity = newest.quantity;
+	trend->consumed = 0;
+	trend->first = newest.minute;
+	trend->last = newest.minute;
+
+	// The oldest samples are in the daily ring, restocking does not count as consumption
+	int found = 0;
+	float previous = 0;
+	for (int tier = HISTORY_TIERS - 1; tier >= 0; tier--)
+	{
+		SampleRing* ring = &history->rings[tier];
+		Sample* samples = history->samples + tierOffset[tier];
+
+		for (int i = 0; i < ring->length; i++)
+		{
+			Sample* current = &samples[(ring->start + i) % tierCapacity[tier]];
+			if (current->minute < from) continue;
+
+			if (found == 0) trend->first = current->minute;
+			else if (previous > current->quantity) trend->consumed += previous - current->quantity;
+
+			found = 1;
+			previous = current->quantity;
+		}
+	}
+}
+
+/// <summary>
+/// Removes the product at a position, the last product takes its place
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="slot">The index slot of the product</param>
+static void eraseEntry(ConsumptionLog* log, int slot)
+{
+	unsigned int mask = (unsigned int)log->indexCapacity - 1;
+	unsigned int next = ((unsigned int)slot + 1) & mask;
+	int position = log->index[slot];
+
+	// The following slots move back so that no probe stops early
+	log->index[slot] = -1;
+	while (log->index[next] >= 0)
+	{
+		int moved = log->index[next];
+		log->index[next] = -1;
+		log->index[findSlot(log, log->entries[moved].name, log->entries[moved].category)] = moved;
+
+		next = (next + 1) & mask;
+	}
+
+	free(log->entries[position].name);
+	if (--log->length == position) return;
+
+	log->entries[position] = log->entries[log->length];
+	log->trends[position] = log->trends[log->length];
+	log->index[findSlot(log, log->entries[position].name, log->entries[position].category)] = position;
+}
+
+/// <summary>
+/// Records the quantity of a product, a product that is not in the log yet gets a new history
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The quantity of the product</param>
+/// <param name="minute">The time of the quantity, not earlier than the previous samples of the product</param>
+/// <returns>1 if the quantity was recorded,
+///			 0 if there is not enough memory</returns>
+int recordConsumption(ConsumptionLog* log, char* name, Category category, double quantity, int minute)
+{
+	int position = log->index[findSlot(log, name, category)];
+
+	if (position < 0)
+	{
+		if (reserveEntry(log) == 0) return 0;
+
+		HistoryEntry* entry = &log->entries[log->length];
+		entry->name = malloc(strlen(name) + 1);
+		if (entry->name == NULL) return 0;
+
+		strcpy(entry->name, name);
+		entry->category = category;
+		memset(&entry->history, 0, sizeof(History));
+
+		position = log->length++;
+		log->index[findSlot(log, name, category)] = position;
+	}
+
+	// A change that kept the quantity, like a new expiration date, is not a sample
+	History* history = &log->entries[position].history;
+	SampleRing* raw = &history->rings[0];
+	if (raw->length > 0 && history->samples[(raw->start + raw->length - 1) % HISTORY_RAW_SAMPLES].quantity == (float)quantity)
+		return 1;
+
+	Sample sample = { minute, (float)quantity };
+	pushSample(history, 0, sample);
+	computeTrend(history, &log->trends[position]);
+
+	return 1;
+}
+
+/// <summary>
+/// Drops the history of a product
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>1 if the product had a history,
+///			 0, otherwise</returns>
+int forgetConsumption(ConsumptionLog* log, char* name, Category category)
+{
+	int slot = findSlot(log, name, category);
+	if (log->index[slot] < 0) return 0;
+
+	eraseEntry(log, slot);
+	return 1;
+}
+
+/// <summary>
+/// Records the quantities of every product of a repository and drops the histories
+/// of the products that are not in it
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="minute">The current time</param>
+void syncConsumptionLog(ConsumptionLog* log, ProductRepo* repo, int minute)
+{
+	for (int i = log->length - 1; i >= 0; i--)
+	{
+		HistoryEntry* entry = &log->entries[i];
+		if (findProductRepo(repo, entry->name, entry->category) == NULL)
+			eraseEntry(log, findSlot(log, entry->name, entry->category));
+	}
+
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* current = getProductAt(repo, i);
+		recordConsumption(log, current->name, current->category, current->quantity, minute);
+	}
+}
+
+/// <summary>
+/// Gets the samples of a product, the oldest first
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="samples">Where to store the samples</param>
+/// <param name="count">The maximum number of samples</param>
+/// <returns>The number of samples, 0 if the product has no history</returns>
+int getHistorySamples(ConsumptionLog* log, char* name, Category category, Sample* samples, int count)
+{
+	int position = log->index[findSlot(log, name, category)];
+	if (position < 0) return 0;
+
+	History* history = &log->entries[position].history;
+	int length = 0;
+
+	for (int tier = HISTORY_TIERS - 1; tier >= 0; tier--)
+	{
+		SampleRing* ring = &history->rings[tier];
+		for (int i = 0; i < ring->length && length < count; i++)
+			samples[length++] = history->samples[tierOffset[tier] + (ring->start + i) % tierCapacity[tier]];
+	}
+
+	return length;
+}
+
+/// <summary>
+/// Checks if a forecast runs out after another one, ties go by name
+/// </summary>
+/// <param name="first">A pointer to the first forecast</param>
+/// <param name="second">A pointer to the second forecast</param>
+/// <returns>1 if the first forecast comes after the second,
+///			 0, otherwise</returns>
+static int forecastAfter(Forecast* first, Forecast* second)
+{
+	if (first->daysLeft != second->daysLeft) return first->daysLeft > second->daysLeft;
+	return strcmp(first->name, second->name) > 0;
+}
+
+/// <summary>
+/// Moves a forecast down the heap until both of its children come before it
+/// </summary>
+/// <param name="heap">The heap, the forecast that runs out last is at the top</param>
+/// <param name="length">The number of forecasts in the heap</param>
+/// <param name="position">The position of the forecast</param>
+static void siftDown(Forecast* heap, int length, int position)
+{
+	while (1)
+	{
+		int largest = position;
+		int left = 2 * position + 1;
+		int right = left + 1;
+
+		if (left < length && forecastAfter(&heap[left], &heap[largest])) largest = left;
+		if (right < length && forecastAfter(&heap[right], &heap[largest])) largest = right;
+		if (largest == position) return;
+
+		Forecast tmp = heap[position];
+		heap[position] = heap[largest];
+		heap[largest] = tmp;
+		position = largest;
+	}
+}
+
+/// <summary>
+/// Estimates when the products run out at the rate they were consumed in the recent window.
+/// The pass only reads the trends, the histories are not visited.
+/// </summary>
+/// <param name="log">A pointer to the log</param>
+/// <param name="minute">The current time</param>
+/// <param name="days">Only products that run out within this many days are returned</param>
+/// <param name="forecasts">Where to store the forecasts, the earliest run out first</param>
+/// <param name="count">The maximum number of forecasts</param>
+/// <returns>The number of forecasts</returns>
+int forecastConsumption(ConsumptionLog* log, int minute, int days, Forecast* forecasts, int count)
+{
+	// A bounded heap keeps the earliest forecasts seen so far
+	int length = 0;
+	if (count < 1) return 0;
+
+	for (int i = 0; i < log->length; i++)
+	{
+		Trend* trend = &log->trends[i];
+		if (trend->consumed <= 0 || minute <= trend->first) continue;
+
+		// The time since the last sample without consumption slows the rate down
+		double rate = (double)trend->consumed * MINUTES_PER_DAY / (minute - trend->first);
+		double runOut = trend->last + trend->quantity / rate * MINUTES_PER_DAY;
+		double daysLeft = floor((runOut - minute) / MINUTES_PER_DAY);
+		if (daysLeft > days) continue;
+
+		Forecast forecast = { log->entries[i].name, log->entries[i].category, trend->quantity, rate,
+			civilFromDays((int)floor(runOut / MINUTES_PER_DAY)), (int)daysLeft };
+		if (length < count)
+		{
+			// The forecast moves up until its parent runs out after it
+			int position = length++;
+			while (position > 0 && forecastAfter(&forecast, &forecasts[(position - 1) / 2]))
+			{
+				forecasts[position] = forecasts[(position - 1) / 2];
+				position = (position - 1) / 2;
+			}
+			forecasts[position] = forecast;
+		}
+		else if (forecastAfter(&forecasts[0], &forecast))
+		{
+			forecasts[0] = forecast;
+			siftDown(forecasts, length, 0);
+		}
+	}
+
+	// Taking the top off the heap one by one leaves it in ascending order
+	for (int end = length - 1; end > 0; end--)
+	{
+		Forecast tmp = forecasts[0];
+		forecasts[0] = forecasts[end];
+		forecasts[end] = tmp;
+		siftDown(forecasts, end, 0);
+	}
+
+	return length;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "ProductRepository.h"
+
+#define HISTORY_TIERS 3
+#define HISTORY_RAW_SAMPLES 8
+#define HISTORY_HOURLY_SAMPLES 24
+#define HISTORY_DAILY_SAMPLES 30
+#define HISTORY_WINDOW_DAYS 7
+#define HISTORY_FORECAST_DAYS 7
+#define HISTORY_INITIAL_SIZE 32
+
+// A quantity at a point in time, minutes since 1970-01-01 keep it at eight bytes
+typedef struct
+{
+	int minute;
+	float quantity;
+} Sample;
+
+typedef struct
+{
+	unsigned char start;
+	unsigned char length;
+} SampleRing;
+
+// Fixed-size samples of one product in three rings: the latest changes as they were,
+// then the last sample of every hour, then the last sample of every day. A sample
+// that falls off a ring moves on to the next one.
+typedef struct
+{
+	Sample samples[HISTORY_RAW_SAMPLES + HISTORY_HOURLY_SAMPLES + HISTORY_DAILY_SAMPLES];
+	SampleRing rings[HISTORY_TIERS];
+} History;
+
+typedef struct
+{
+	char* name;
+	Category category;
+	History history;
+} HistoryEntry;
+
+// What a forecast needs of a product, kept apart from the samples so that a pass
+// over the whole inventory only reads this array
+typedef struct
+{
+	float quantity; // The latest quantity
+	float consumed; // Decreases of the quantity since the first sample of the recent window
+	int first; // Minute of the first sample of the recent window
+	int last; // Minute of the latest sample
+} Trend;
+
+// Consumption history of the products, trends[i] belongs to entries[i]
+typedef struct
+{
+	Trend* trends;
+	HistoryEntry* entries;
+	int length;
+	int capacity;
+
+	// Open addressing index from name and category to positions, -1 for an empty slot
+	int* index;
+	int indexCapacity;
+} ConsumptionLog;
+
+typedef struct
+{
+	const char* name; // Valid until the log changes
+	Category category;
+	double quantity;
+	double rate; // Quantity consumed per day
+	Date runOut;
+	int daysLeft;
+} Forecast;
+
+int currentMinute();
+
+ConsumptionLog* createConsumptionLog();
+void destroyConsumptionLog(ConsumptionLog* log);
+
+int recordConsumption(ConsumptionLog* log, char* name, Category category, double quantity, int minute);
+int forgetConsumption(ConsumptionLog* log, char* name, Category category);
+void syncConsumptionLog(ConsumptionLog* log, ProductRepo* repo, int minute);
+
+int getHistorySamples(ConsumptionLog* log, char* name, Category category, Sample* samples, int count);
+int forecastConsumption(ConsumptionLog* log, int minute, int days, Forecast* forecasts, int count);
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "EventQueue.h"
+
+#define EVENT_TABLE_SIZE (EVENT_BATCH_SIZE * 2)
+
+/// <summary>
+/// Creates an empty event queue
+/// </summary>
+/// <returns>A pointer to the queue</returns>
+EventQueue* createEventQueue()
+{
+	EventQueue* queue = malloc(sizeof(EventQueue));
+	if (queue == NULL) return NULL;
+
+	queue->cells = malloc(EVENT_QUEUE_SIZE * sizeof(EventCell));
+	queue->batch = malloc(EVENT_BATCH_SIZE * sizeof(SensorEvent));
+	queue->changes = malloc(EVENT_BATCH_SIZE * sizeof(ProductChange));
+	if (queue->cells == NULL || queue->batch == NULL || queue->changes == NULL)
+	{
+		free(queue->cells);
+		free(queue->batch);
+		free(queue->changes);
+		free(queue);
+		return NULL;
+	}
+
+	// A cell is free for the producer whose position equals its sequence
+	for (size_t i = 0; i < EVENT_QUEUE_SIZE; i++)
+		atomic_init(&queue->cells[i].sequence, i);
+
+	atomic_init(&queue->tail, 0);
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->pushed, 0);
+	atomic_init(&queue->dropped, 0);
+	atomic_init(&queue->backpressure, 0);
+	atomic_init(&queue->applied, 0);
+	atomic_init(&queue->coalesced, 0);
+	atomic_init(&queue->batches, 0);
+	atomic_init(&queue->stopping, 0);
+	queue->shared = NULL;
+
+	return queue;
+}
+
+/// <summary>
+/// Destroys the queue, the applier must be stopped first
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+void destroyEventQueue(EventQueue* queue)
+{
+	if (queue == NULL) return;
+
+	free(queue->cells);
+	free(queue->batch);
+	free(queue->changes);
+	free(queue);
+
+	queue = NULL;
+}
+
+/// <summary>
+/// Pushes a sensor reading, never waits for the applier or the repository
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The quantity that was measured</param>
+/// <returns>1 if the event was queued,
+///			 0 if it was dropped</returns>
+int pushEvent(EventQueue* queue, const char* name, Category category, double quantity)
+{
+	size_t length = strlen(name);
+	if (length >= EVENT_MAX_NAME)
+	{
+		atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+		return 0;
+	}
+
+	size_t position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	EventCell* cell;
+
+	while (1)
+	{
+		cell = &queue->cells[position & (EVENT_QUEUE_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		ptrdiff_t difference = (ptrdiff_t)(sequence - position);
+
+		// Free cell: claim it, a failed claim reloads the position
+		if (difference == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&queue->tail, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		// The applier has not freed the cell of the previous lap: the queue is full
+		else if (difference < 0)
+		{
+			atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+			return 0;
+		}
+		else
+		{
+			position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+		}
+	}
+
+	memcpy(cell->event.name, name, length + 1);
+	cell->event.category = category;
+	cell->event.quantity = quantity;
+	atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+	atomic_fetch_add_explicit(&queue->pushed, 1, memory_order_relaxed);
+	if (position - atomic_load_explicit(&queue->head, memory_order_relaxed) >= EVENT_HIGH_WATER)
+		atomic_fetch_add_explicit(&queue->backpressure, 1, memory_order_relaxed);
+
+	return 1;
+}
+
+/// <summary>
+/// Takes the oldest event out of the queue, only called by the applier
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+/// <param name="event">Where to store the event</param>
+/// <returns>1 if an event was taken,
+///			 0 if the queue is empty</returns>
+static int popEvent(EventQueue* queue, SensorEvent* event)
+{
+	size_t position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	EventCell* cell = &queue->cells[position & (EVENT_QUEUE_SIZE - 1)];
+
+	if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != position + 1) return 0;
+
+	*event = cell->event;
+	atomic_store_explicit(&cell->sequence, position + EVENT_QUEUE_SIZE, memory_order_release);
+	atomic_store_explicit(&queue->head, position + 1, memory_order_relaxed);
+
+	return 1;
+}
+
+/// <summary>
+/// Hashes the product of an event
+/// </summary>
+/// <param name="event">A pointer to the event</param>
+/// <returns>The FNV-1a hash of the name and category</returns>
+static unsigned int hashEvent(SensorEvent* event)
+{
+	unsigned int hash = 2166136261u;
+
+	for (const char* name = event->name; *name != '\0'; name++)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	hash ^= (unsigned int)event->category;
+	hash *= 16777619u;
+
+	return hash;
+}
+
+/// <summary>
+/// Applies a batch of queued events to the shared service, keeping only the last event of each product.
+/// The batch is a single operation with one journal commit, and it is undone as one like any other change.
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>The number of events taken from the queue</returns>
+int drainEvents(EventQueue* queue, SharedService* shared)
+{
+	int table[EVENT_TABLE_SIZE];
+	int taken = 0;
+	int unique = 0;
+	SensorEvent event;
+
+	memset(table, -1, sizeof(table));
+	while (taken < EVENT_BATCH_SIZE && popEvent(queue, &event) == 1)
+	{
+		taken++;
+
+		unsigned int slot = hashEvent(&event) & (EVENT_TABLE_SIZE - 1);
+		while (table[slot] != -1)
+		{
+			SensorEvent* current = &queue->batch[table[slot]];
+			if (current->category == event.category && strcmp(current->name, event.name) == 0) break;
+
+			slot = (slot + 1) & (EVENT_TABLE_SIZE - 1);
+		}
+
+		// Events come out in the order each sensor pushed them, so the later one wins
+		if (table[slot] == -1) table[slot] = unique++;
+		queue->batch[table[slot]] = event;
+	}
+
+	if (taken == 0) return 0;
+
+	// Readings of products that are not in the fridge are ignored
+	Service* serv = beginWrite(shared);
+	int changed = 0;
+	for (int i = 0; i < unique; i++)
+	{
+		SensorEvent* current = &queue->batch[i];
+		Product* p = findProductRepo(getRepo(serv), current->name, current->category);
+		Quantity units = toQuantity(current->quantity);
+
+		if (p == NULL || p->units == units) continue;
+
+		ProductChange change = { current->name, current->category, 1, units, p->expiration };
+		queue->changes[changed++] = change;
+	}
+
+	// Without memory for the undo state the history goes, so undo never skips over the readings
+	if (changed > 0 && addUpdateToUndoStack(serv, queue->changes, changed) == 0) clearHistory(serv);
+	if (changed > 0) applyChangesService(serv, journalUpdate, queue->changes, changed);
+	endWrite(shared, changed > 0);
+
+	atomic_fetch_add_explicit(&queue->applied, unique, memory_order_relaxed);
+	atomic_fetch_add_explicit(&queue->coalesced, taken - unique, memory_order_relaxed);
+	atomic_fetch_add_explicit(&queue->batches, 1, memory_order_relaxed);
+	return taken;
+}
+
+/// <summary>
+/// Gets the counters of the queue
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+/// <param name="stats">Where to store the counters</param>
+void getEventStats(EventQueue* queue, EventStats* stats)
+{
+	stats->pushed = atomic_load(&queue->pushed);
+	stats->dropped = atomic_load(&queue->dropped);
+	stats->backpressure = atomic_load(&queue->backpressure);
+	stats->applied = atomic_load(&queue->applied);
+	stats->coalesced = atomic_load(&queue->coalesced);
+	stats->batches = atomic_load(&queue->batches);
+}
+
+/// <summary>
+/// Drains the queue until the applier is stopped
+/// </summary>
+/// <param name="arg">A pointer to the queue</param>
+/// <returns>0</returns>
+static int runApplier(void* arg)
+{
+	EventQueue* queue = arg;
+	struct timespec pause = { 0, 1000000 };
+
+	while (1)
+	{
+		// The stop flag is read first, so the events pushed before it was set are drained
+		int stopping = atomic_load(&queue->stopping);
+		if (drainEvents(queue, queue->shared) > 0) continue;
+		if (stopping == 1) return 0;
+
+		thrd_sleep(&pause, NULL);
+	}
+}
+
+/// <summary>
+/// Starts the thread that applies the queued events
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+/// <param name="shared">A pointer to the shared service the events are applied to</param>
+/// <returns>1 if the applier was started,
+///			 0, otherwise</returns>
+int startApplier(EventQueue* queue, SharedService* shared)
+{
+	queue->shared = shared;
+	atomic_store(&queue->stopping, 0);
+
+	return thrd_create(&queue->applier, runApplier, queue) == thrd_success;
+}
+
+/// <summary>
+/// Applies the remaining events and stops the applier
+/// </summary>
+/// <param name="queue">A pointer to the queue</param>
+void stopApplier(EventQueue* queue)
+{
+	atomic_store(&queue->stopping, 1);
+	thrd_join(queue->applier, NULL);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <stddef.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "SharedService.h"
+
+#define EVENT_QUEUE_SIZE 4096 // Must be a power of two
+#define EVENT_HIGH_WATER (EVENT_QUEUE_SIZE / 4 * 3)
+#define EVENT_BATCH_SIZE 256
+#define EVENT_MAX_NAME 64
+
+// A sensor reading: the product now has the given quantity
+typedef struct
+{
+	char name[EVENT_MAX_NAME];
+	Category category;
+	double quantity;
+} SensorEvent;
+
+typedef struct
+{
+	atomic_size_t sequence; // Which lap of the ring the cell is ready for
+	SensorEvent event;
+} EventCell;
+
+typedef struct
+{
+	long long pushed;
+	long long dropped; // Rejected because the queue was full or the name too long
+	long long backpressure; // Accepted while the queue was above the high water mark
+	long long applied;
+	long long coalesced; // Replaced by a later event for the same product in the same batch
+	long long batches;
+} EventStats;
+
+// Bounded ring that any number of sensor threads push into without locks
+// and a single applier thread drains (Vyukov's bounded queue)
+typedef struct
+{
+	EventCell* cells;
+
+	_Alignas(SHARED_CACHE_LINE) atomic_size_t tail; // Next cell for producers
+	_Alignas(SHARED_CACHE_LINE) atomic_size_t head; // Next cell for the applier
+	_Alignas(SHARED_CACHE_LINE) atomic_llong pushed;
+	atomic_llong dropped;
+	atomic_llong backpressure;
+	_Alignas(SHARED_CACHE_LINE) atomic_llong applied;
+	atomic_llong coalesced;
+	atomic_llong batches;
+
+	SensorEvent* batch; // Only used by the applier
+	ProductChange* changes; // The batch as a single change set, only used by the applier
+	SharedService* shared;
+	thrd_t applier;
+	atomic_int stopping;
+} EventQueue;
+
+EventQueue* createEventQueue();
+void destroyEventQueue(EventQueue* queue);
+
+int pushEvent(EventQueue* queue, const char* name, Category category, double quantity);
+int drainEvents(EventQueue* queue, SharedService* shared);
+void getEventStats(EventQueue* queue, EventStats* stats);
+
+int startApplier(EventQueue* queue, SharedService* shared);
+void stopApplier(EventQueue* queue);
@@ -0,0 +1,382 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ExpiryWheel.h"
+
+/// <summary>
+/// Hashes the name and category of a product
+/// </summary>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The FNV-1a hash of the name and category</returns>
+static unsigned int hashEntry(const char* name, Category category)
+{
+	unsigned int hash = 2166136261u;
+
+	for (; *name != '\0'; name++)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	hash ^= (unsigned int)category;
+	hash *= 16777619u;
+
+	return hash;
+}
+
+/// <summary>
+/// Creates an empty timer wheel
+/// </summary>
+/// <param name="days">Alerts fire when products expire within this many days</param>
+/// <param name="today">The first day the wheel processes</param>
+/// <param name="callback">The function that is called for every alert, it must not change the wheel</param>
+/// <param name="context">The first argument of the callback</param>
+/// <returns>A pointer to the wheel</returns>
+ExpiryWheel* createExpiryWheel(int days, Date today, ExpiryCallback callback, void* context)
+{
+	ExpiryWheel* wheel = calloc(1, sizeof(ExpiryWheel));
+	if (wheel == NULL) return NULL;
+
+	wheel->index = calloc(WHEEL_INITIAL_INDEX, sizeof(ExpiryEntry*));
+	if (wheel->index == NULL)
+	{
+		free(wheel);
+		return NULL;
+	}
+
+	wheel->indexCapacity = WHEEL_INITIAL_INDEX;
+	wheel->current = daysFromCivil(today);
+	wheel->days = days;
+	wheel->callback = callback;
+	wheel->context = context;
+
+	return wheel;
+}
+
+/// <summary>
+/// Destroys the timer wheel and its entries
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+void destroyExpiryWheel(ExpiryWheel* wheel)
+{
+	if (wheel == NULL) return;
+
+	for (int i = 0; i < wheel->indexCapacity; i++)
+	{
+		ExpiryEntry* entry = wheel->index[i];
+		while (entry != NULL)
+		{
+			ExpiryEntry* chain = entry->chain;
+			free(entry->name);
+			free(entry);
+			entry = chain;
+		}
+	}
+
+	free(wheel->index);
+	free(wheel);
+
+	wheel = NULL;
+}
+
+/// <summary>
+/// Finds the entry of a product
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The pointer that points to the entry in its index bucket, it points to NULL if there is no entry</returns>
+static ExpiryEntry** findEntry(ExpiryWheel* wheel, const char* name, Category category)
+{
+	ExpiryEntry** entry = &wheel->index[hashEntry(name, category) & (wheel->indexCapacity - 1)];
+
+	while (*entry != NULL && ((*entry)->category != category || strcmp((*entry)->name, name) != 0))
+		entry = &(*entry)->chain;
+
+	return entry;
+}
+
+/// <summary>
+/// Doubles the index and moves every entry to its new bucket
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <returns>1 if the index grew,
+///			 0 if there is not enough memory</returns>
+static int growIndex(ExpiryWheel* wheel)
+{
+	int capacity = wheel->indexCapacity * 2;
+	ExpiryEntry** index = calloc(capacity, sizeof(ExpiryEntry*));
+	if (index == NULL) return 0;
+
+	for (int i = 0; i < wheel->indexCapacity; i++)
+	{
+		ExpiryEntry* entry = wheel->index[i];
+		while (entry != NULL)
+		{
+			ExpiryEntry* chain = entry->chain;
+			unsigned int bucket = hashEntry(entry->name, entry->category) & (capacity - 1);
+
+			entry->chain = index[bucket];
+			index[bucket] = entry;
+			entry = chain;
+		}
+	}
+
+	free(wheel->index);
+	wheel->index = index;
+	wheel->indexCapacity = capacity;
+
+	return 1;
+}
+
+/// <summary>
+/// Puts an entry in the slot of its alert day, relative to the current day
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="entry">A pointer to the entry</param>
+static void placeEntry(ExpiryWheel* wheel, ExpiryEntry* entry)
+{
+	int delta = entry->due - wheel->current;
+	ExpiryEntry** slot = &wheel->overflow;
+
+	for (int level = 0; level < WHEEL_LEVELS; level++)
+	{
+		if (delta < 1 << (WHEEL_BITS * (level + 1)))
+		{
+			slot = &wheel->slots[level][(entry->due >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+			break;
+		}
+	}
+
+	entry->next = *slot;
+	if (*slot != NULL) (*slot)->link = &entry->next;
+	entry->link = slot;
+	*slot = entry;
+}
+
+/// <summary>
+/// Takes an entry out of its slot
+/// </summary>
+/// <param name="entry">A pointer to the entry</param>
+static void unlinkEntry(ExpiryEntry* entry)
+{
+	*entry->link = entry->next;
+	if (entry->next != NULL) entry->next->link = entry->link;
+
+	entry->link = NULL;
+	entry->next = NULL;
+}
+
+/// <summary>
+/// Moves the entries of a slot to the slots they belong to now
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="slot">A pointer to the slot</param>
+static void cascadeSlot(ExpiryWheel* wheel, ExpiryEntry** slot)
+{
+	ExpiryEntry* entry = *slot;
+	*slot = NULL;
+
+	while (entry != NULL)
+	{
+		ExpiryEntry* next = entry->next;
+		placeEntry(wheel, entry);
+		entry = next;
+	}
+}
+
+/// <summary>
+/// Schedules the alert of a product, a product that is already scheduled is rescheduled
+/// if its expiration date changed. Products that already expire within the threshold
+/// alert on the next advance.
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>1 if the product was scheduled,
+///			 0 if there is not enough memory</returns>
+int scheduleExpiry(ExpiryWheel* wheel, char* name, Category category, Date expiration)
+{
+	ExpiryEntry* entry = *findEntry(wheel, name, category);
+	int day = daysFromCivil(expiration);
+
+	if (entry != NULL)
+	{
+		entry->generation = wheel->generation;
+		if (daysFromCivil(entry->expiration) == day) return 1;
+
+		if (entry->link != NULL)
+		{
+			unlinkEntry(entry);
+			wheel->pending--;
+		}
+	}
+	else
+	{
+		if (wheel->count == wheel->indexCapacity && growIndex(wheel) == 0) return 0;
+
+		entry = calloc(1, sizeof(ExpiryEntry));
+		if (entry == NULL) return 0;
+
+		entry->name = malloc(strlen(name) + 1);
+		if (entry->name == NULL)
+		{
+			free(entry);
+			return 0;
+		}
+		strcpy(entry->name, name);
+		entry->category = category;
+		entry->generation = wheel->generation;
+
+		ExpiryEntry** bucket = findEntry(wheel, name, category);
+		*bucket = entry;
+		wheel->count++;
+	}
+
+	entry->expiration = expiration;
+	entry->due = day - wheel->days < wheel->current ? wheel->current : day - wheel->days;
+	entry->fired = 0;
+
+	placeEntry(wheel, entry);
+	wheel->pending++;
+
+	return 1;
+}
+
+/// <summary>
+/// Removes the alert of a product
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>1 if the product had an alert,
+///			 0, otherwise</returns>
+int cancelExpiry(ExpiryWheel* wheel, char* name, Category category)
+{
+	ExpiryEntry** bucket = findEntry(wheel, name, category);
+	ExpiryEntry* entry = *bucket;
+	if (entry == NULL) return 0;
+
+	if (entry->link != NULL)
+	{
+		unlinkEntry(entry);
+		wheel->pending--;
+	}
+
+	*bucket = entry->chain;
+	wheel->count--;
+
+	free(entry->name);
+	free(entry);
+
+	return 1;
+}
+
+/// <summary>
+/// Makes the alerts match the products of a repository, after the repository was replaced
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="repo">A pointer to the repository</param>
+void syncExpiryWheel(ExpiryWheel* wheel, ProductRepo* repo)
+{
+	wheel->generation++;
+
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* current = getProductAt(repo, i);
+		scheduleExpiry(wheel, current->name, current->category, current->expiration);
+	}
+
+	// Entries the repository did not mention belong to products that are gone
+	for (int i = 0; i < wheel->indexCapacity; i++)
+	{
+		ExpiryEntry** entry = &wheel->index[i];
+		while (*entry != NULL)
+		{
+			if ((*entry)->generation == wheel->generation)
+			{
+				entry = &(*entry)->chain;
+				continue;
+			}
+
+			ExpiryEntry* stale = *entry;
+			if (stale->link != NULL)
+			{
+				unlinkEntry(stale);
+				wheel->pending--;
+			}
+
+			*entry = stale->chain;
+			wheel->count--;
+			free(stale->name);
+			free(stale);
+		}
+	}
+}
+
+/// <summary>
+/// Processes every day up to and including today, firing the alerts that are due
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <param name="today">The current date</param>
+/// <returns>The number of alerts that fired</returns>
+int advanceExpiryWheel(ExpiryWheel* wheel, Date today)
+{
+	int target = daysFromCivil(today);
+	int fired = 0;
+
+	while (wheel->current <= target)
+	{
+		// Nothing is scheduled, so no slot has to be visited
+		if (wheel->pending == 0)
+		{
+			wheel->current = target + 1;
+			break;
+		}
+
+		// When level 0 wraps around, the next slot of every level above that wrapped
+		// is spread over the levels below it, starting from the highest one
+		if ((wheel->current & (WHEEL_SLOTS - 1)) == 0)
+		{
+			int top = 1;
+			while (top < WHEEL_LEVELS && ((wheel->current >> (WHEEL_BITS * top)) & (WHEEL_SLOTS - 1)) == 0)
+				top++;
+
+			if (top == WHEEL_LEVELS)
+			{
+				cascadeSlot(wheel, &wheel->overflow);
+				top--;
+			}
+			for (int level = top; level >= 1; level--)
+				cascadeSlot(wheel, &wheel->slots[level][(wheel->current >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)]);
+		}
+
+		ExpiryEntry** slot = &wheel->slots[0][wheel->current & (WHEEL_SLOTS - 1)];
+		while (*slot != NULL)
+		{
+			ExpiryEntry* entry = *slot;
+			unlinkEntry(entry);
+			entry->fired = 1;
+			wheel->pending--;
+			fired++;
+
+			if (wheel->callback != NULL)
+				wheel->callback(wheel->context, entry, daysFromCivil(entry->expiration) - target);
+		}
+
+		wheel->current++;
+	}
+
+	return fired;
+}
+
+/// <summary>
+/// Gets the number of alerts that have not fired yet
+/// </summary>
+/// <param name="wheel">A pointer to the wheel</param>
+/// <returns>The number of pending alerts</returns>
+int getPendingExpiries(ExpiryWheel* wheel)
+{
+	return wheel->pending;
+}
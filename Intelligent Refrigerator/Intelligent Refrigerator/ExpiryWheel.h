@@ -0,0 +1,58 @@
+#pragma once
+#include "ProductRepository.h"
+
+#define WHEEL_LEVELS 3
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_INITIAL_INDEX 64
+#define WHEEL_DEFAULT_DAYS 3
+
+// A product waiting for its alert, the alert is due the day the product
+// starts to expire within the threshold of the wheel
+typedef struct ExpiryEntry
+{
+	char* name;
+	Category category;
+	Date expiration;
+	int due; // Day number of the alert
+	int fired;
+	unsigned int generation; // Last synchronization that saw the product
+
+	struct ExpiryEntry** link; // The pointer to the entry in its slot list, NULL once fired
+	struct ExpiryEntry* next;
+	struct ExpiryEntry* chain; // Link of the index bucket
+} ExpiryEntry;
+
+typedef void (*ExpiryCallback)(void* context, ExpiryEntry* entry, int daysLeft);
+
+// Hierarchical timer wheel on day numbers: level 0 has one slot per day,
+// every higher level has one slot per WHEEL_SLOTS days of the level below
+// and is cascaded down when the level below wraps around. Scheduling,
+// cancelling and firing an entry take constant time.
+typedef struct
+{
+	ExpiryEntry* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+	ExpiryEntry* overflow; // Alerts beyond the last level
+
+	int current; // Day number of the next day to process
+	int days; // Alerts fire when products expire within this many days
+	int pending; // Entries that have not fired yet
+
+	// Chained index from name and category to entries
+	ExpiryEntry** index;
+	int indexCapacity;
+	int count;
+	unsigned int generation;
+
+	ExpiryCallback callback;
+	void* context;
+} ExpiryWheel;
+
+ExpiryWheel* createExpiryWheel(int days, Date today, ExpiryCallback callback, void* context);
+void destroyExpiryWheel(ExpiryWheel* wheel);
+
+int scheduleExpiry(ExpiryWheel* wheel, char* name, Category category, Date expiration);
+int cancelExpiry(ExpiryWheel* wheel, char* name, Category category);
+void syncExpiryWheel(ExpiryWheel* wheel, ProductRepo* repo);
+int advanceExpiryWheel(ExpiryWheel* wheel, Date today);
+int getPendingExpiries(ExpiryWheel* wheel);
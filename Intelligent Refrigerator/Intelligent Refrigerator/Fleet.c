@@ -0,0 +1,454 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Fleet.h"
+#include "Parallel.h"
+
+typedef struct
+{
+	FridgeShard* shard;
+	FleetFilter filter;
+	void* arg;
+	ProductComparator compare;
+	int descending;
+	ProductRepo* result;
+} ShardQuery;
+
+typedef struct
+{
+	Category category;
+	int expiration;
+} ExpirationQuery;
+
+/// <summary>
+/// Hashes a fridge ID
+/// </summary>
+/// <param name="fridgeId">The fridge ID</param>
+/// <returns>The mixed bits of the ID</returns>
+static unsigned int hashFridge(int fridgeId)
+{
+	unsigned int hash = (unsigned int)fridgeId;
+
+	hash ^= hash >> 16;
+	hash *= 0x45D9F3Bu;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/// <summary>
+/// Finds the index slot of a fridge, called under the fleet lock
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="fridgeId">The fridge ID</param>
+/// <returns>The slot that holds the fridge, or the empty slot where it belongs</returns>
+static int findFridgeSlot(Fleet* fleet, int fridgeId)
+{
+	unsigned int mask = (unsigned int)fleet->tableCapacity - 1;
+	unsigned int slot = hashFridge(fridgeId) & mask;
+
+	while (fleet->table[slot] != 0 && fleet->shards[fleet->table[slot] - 1]->fridgeId != fridgeId)
+		slot = (slot + 1) & mask;
+
+	return (int)slot;
+}
+
+/// <summary>
+/// Creates an empty fleet
+/// </summary>
+/// <param name="pool">A pointer to the pool that runs fleet wide queries, NULL to run them on the calling thread</param>
+/// <returns>A pointer to the fleet</returns>
+Fleet* createFleet(ThreadPool* pool)
+{
+	Fleet* fleet = malloc(sizeof(Fleet));
+	if (fleet == NULL) return NULL;
+
+	fleet->shards = malloc(FLEET_INITIAL_SHARDS * sizeof(FridgeShard*));
+	fleet->table = calloc(FLEET_INITIAL_SHARDS * 2, sizeof(int));
+	if (fleet->shards == NULL || fleet->table == NULL || mtx_init(&fleet->lock, mtx_plain) != thrd_success)
+	{
+		free(fleet->shards);
+		free(fleet->table);
+		free(fleet);
+		return NULL;
+	}
+
+	fleet->capacity = FLEET_INITIAL_SHARDS;
+	fleet->length = 0;
+	fleet->tableCapacity = FLEET_INITIAL_SHARDS * 2;
+	fleet->pool = pool;
+
+	return fleet;
+}
+
+/// <summary>
+/// Destroys the fleet and every fridge in it, no thread may still be using it
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+void destroyFleet(Fleet* fleet)
+{
+	if (fleet == NULL) return;
+
+	for (int i = 0; i < fleet->length; i++)
+	{
+		destroyService(fleet->shards[i]->serv);
+		mtx_destroy(&fleet->shards[i]->lock);
+		free(fleet->shards[i]);
+	}
+
+	mtx_destroy(&fleet->lock);
+	free(fleet->shards);
+	free(fleet->table);
+	free(fleet);
+
+	fleet = NULL;
+}
+
+/// <summary>
+/// Gets the number of fridges in the fleet
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <returns>The number of fridges</returns>
+int getFleetSize(Fleet* fleet)
+{
+	mtx_lock(&fleet->lock);
+	int length = fleet->length;
+	mtx_unlock(&fleet->lock);
+
+	return length;
+}
+
+/// <summary>
+/// Adds an empty fridge, called under the fleet lock
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="fridgeId">The fridge ID</param>
+/// <returns>A pointer to the new shard,
+///			 NULL if there is not enough memory</returns>
+static FridgeShard* addFridge(Fleet* fleet, int fridgeId)
+{
+	FridgeShard* shard = malloc(sizeof(FridgeShard));
+	if (shard == NULL) return NULL;
+
+	shard->fridgeId = fridgeId;
+	shard->serv = createService(createRepo(), 0);
+	if (shard->serv == NULL || mtx_init(&shard->lock, mtx_plain) != thrd_success)
+	{
+		destroyService(shard->serv);
+		free(shard);
+		return NULL;
+	}
+
+	if (fleet->length == fleet->capacity)
+	{
+		fleet->capacity *= REPOSITORY_SIZE_SCALE;
+		FridgeShard** tmp = NULL;
+
+		while (tmp == NULL) tmp = realloc(fleet->shards, fleet->capacity * sizeof(FridgeShard*));
+		fleet->shards = tmp;
+	}
+
+	// Keep the index at most half full
+	if ((fleet->length + 1) * 2 > fleet->tableCapacity)
+	{
+		int* table = NULL;
+		while (table == NULL) table = calloc(fleet->tableCapacity * REPOSITORY_SIZE_SCALE, sizeof(int));
+
+		free(fleet->table);
+		fleet->table = table;
+		fleet->tableCapacity *= REPOSITORY_SIZE_SCALE;
+
+		for (int i = 0; i < fleet->length; i++)
+			fleet->table[findFridgeSlot(fleet, fleet->shards[i]->fridgeId)] = i + 1;
+	}
+
+	fleet->shards[fleet->length++] = shard;
+	fleet->table[findFridgeSlot(fleet, fridgeId)] = fleet->length;
+
+	return shard;
+}
+
+/// <summary>
+/// Locks a fridge for the calling thread, the fridge is created if it does not exist
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="fridgeId">The fridge ID</param>
+/// <returns>A pointer to the locked shard,
+///			 NULL if the fridge could not be created</returns>
+FridgeShard* acquireFridge(Fleet* fleet, int fridgeId)
+{
+	mtx_lock(&fleet->lock);
+
+	int slot = findFridgeSlot(fleet, fridgeId);
+	FridgeShard* shard = fleet->table[slot] != 0 ? fleet->shards[fleet->table[slot] - 1] : addFridge(fleet, fridgeId);
+
+	mtx_unlock(&fleet->lock);
+
+	if (shard != NULL) mtx_lock(&shard->lock);
+	return shard;
+}
+
+/// <summary>
+/// Unlocks a fridge
+/// </summary>
+/// <param name="shard">A pointer to the shard returned by acquireFridge</param>
+void releaseFridge(FridgeShard* shard)
+{
+	mtx_unlock(&shard->lock);
+}
+
+/// <summary>
+/// Adds a product to a fridge
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="fridgeId">The fridge ID</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The quantity of the product</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>1 if the product was added,
+///			 0, otherwise</returns>
+int fleetAddProduct(Fleet* fleet, int fridgeId, char* name, Category category, double quantity, Date expiration)
+{
+	FridgeShard* shard = acquireFridge(fleet, fridgeId);
+	if (shard == NULL) return 0;
+
+	int ret = addProductService(shard->serv, name, category, quantity, expiration);
+	releaseFridge(shard);
+
+	return ret;
+}
+
+/// <summary>
+/// Runs the query on one fridge and sorts its result
+/// </summary>
+/// <param name="arg">A pointer to the shard query</param>
+static void queryShard(void* arg)
+{
+	ShardQuery* query = arg;
+
+	mtx_lock(&query->shard->lock);
+	query->result = query->filter(getRepo(query->shard->serv), query->arg);
+	mtx_unlock(&query->shard->lock);
+
+	if (query->result != NULL && query->compare != NULL) parallelSort(NULL, query->result, query->compare, query->descending);
+}
+
+/// <summary>
+/// Checks if the head of one sorted part comes before the head of another
+/// </summary>
+/// <param name="queries">The shard queries</param>
+/// <param name="positions">The position of every part</param>
+/// <param name="first">The first part</param>
+/// <param name="second">The second part</param>
+/// <returns>1 if the first head comes first, ties go to the earlier fridge,
+///			 0, otherwise</returns>
+static int headBefore(ShardQuery* queries, int* positions, int first, int second)
+{
+	Product* a = getProductAt(queries[first].result, positions[first]);
+	Product* b = getProductAt(queries[second].result, positions[second]);
+
+	int result = queries[first].compare(a, b);
+	if (queries[first].descending == 1) result = -result;
+
+	return result != 0 ? result < 0 : first < second;
+}
+
+/// <summary>
+/// Moves a part of the heap down to its place
+/// </summary>
+/// <param name="heap">The heap of parts</param>
+/// <param name="length">The number of parts in the heap</param>
+/// <param name="i">The position of the part in the heap</param>
+/// <param name="queries">The shard queries</param>
+/// <param name="positions">The position of every part</param>
+static void siftDown(int* heap, int length, int i, ShardQuery* queries, int* positions)
+{
+	while (1)
+	{
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+
+		if (left < length && headBefore(queries, positions, heap[left], heap[smallest])) smallest = left;
+		if (right < length && headBefore(queries, positions, heap[right], heap[smallest])) smallest = right;
+		if (smallest == i) return;
+
+		int tmp = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = tmp;
+		i = smallest;
+	}
+}
+
+/// <summary>
+/// Runs a query on every fridge in parallel and merges the results
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="filter">The query to run on the repository of every fridge</param>
+/// <param name="arg">The argument of the query</param>
+/// <param name="compare">The order of the result, NULL to keep the products of each fridge together</param>
+/// <param name="descending">1 if the order should be descending, otherwise ascending</param>
+/// <returns>A pointer to the result,
+///			 NULL, if the query failed on any fridge</returns>
+FleetResult* fleetQuery(Fleet* fleet, FleetFilter filter, void* arg, ProductComparator compare, int descending)
+{
+	FleetResult* result = malloc(sizeof(FleetResult));
+	if (result == NULL) return NULL;
+
+	// The fridges that exist now are queried, fridges added meanwhile are not
+	mtx_lock(&fleet->lock);
+	int count = fleet->length;
+	ShardQuery* queries = NULL;
+	while (queries == NULL) queries = calloc(count + 1, sizeof(ShardQuery));
+	for (int i = 0; i < count; i++)
+	{
+		queries[i].shard = fleet->shards[i];
+		queries[i].filter = filter;
+		queries[i].arg = arg;
+		queries[i].compare = compare;
+		queries[i].descending = descending;
+	}
+	mtx_unlock(&fleet->lock);
+
+	parallelFor(fleet->pool, queryShard, queries, sizeof(ShardQuery), count);
+
+	// A partial result would silently miss the products of a fridge
+	int failed = 0;
+	for (int i = 0; i < count; i++)
+		if (queries[i].result == NULL) failed = 1;
+
+	if (failed == 1)
+	{
+		for (int i = 0; i < count; i++)
+			destroyRepo(queries[i].result);
+		free(queries);
+		free(result);
+
+		return NULL;
+	}
+
+	int total = 0;
+	for (int i = 0; i < count; i++)
+		total += getLength(queries[i].result);
+
+	result->items = NULL;
+	result->length = 0;
+	result->partCount = count;
+	result->parts = NULL;
+	while (result->items == NULL) result->items = malloc((total + 1) * sizeof(FleetItem));
+	while (result->parts == NULL) result->parts = malloc((count + 1) * sizeof(ProductRepo*));
+
+	int* positions = NULL;
+	int* heap = NULL;
+	while (positions == NULL) positions = calloc(count + 1, sizeof(int));
+	while (heap == NULL) heap = malloc((count + 1) * sizeof(int));
+
+	// K-way merge of the sorted parts, a heap holds every part that has products left
+	int heapLength = 0;
+	for (int i = 0; i < count; i++)
+	{
+		result->parts[i] = queries[i].result;
+		if (compare == NULL)
+		{
+			for (int j = 0; j < getLength(queries[i].result); j++)
+			{
+				result->items[result->length].fridgeId = queries[i].shard->fridgeId;
+				result->items[result->length++].product = getProductAt(queries[i].result, j);
+			}
+		}
+		else if (getLength(queries[i].result) > 0)
+		{
+			heap[heapLength++] = i;
+		}
+	}
+
+	for (int i = heapLength / 2 - 1; i >= 0; i--)
+		siftDown(heap, heapLength, i, queries, positions);
+
+	while (heapLength > 0)
+	{
+		int part = heap[0];
+		result->items[result->length].fridgeId = queries[part].shard->fridgeId;
+		result->items[result->length++].product = getProductAt(queries[part].result, positions[part]++);
+
+		if (positions[part] == getLength(queries[part].result)) heap[0] = heap[--heapLength];
+		siftDown(heap, heapLength, 0, queries, positions);
+	}
+
+	free(heap);
+	free(positions);
+	free(queries);
+
+	return result;
+}
+
+/// <summary>
+/// Runs a string filter on a repository, used as a fleet query
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="arg">The string to be found in the product names</param>
+/// <returns>A pointer to a new repository that contains the filtered products</returns>
+static ProductRepo* filterString(ProductRepo* repo, void* arg)
+{
+	return filterRepoByString(repo, arg);
+}
+
+/// <summary>
+/// Runs a category and expiration filter on a repository, used as a fleet query
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="arg">A pointer to the expiration query</param>
+/// <returns>A pointer to a new repository that contains the filtered products</returns>
+static ProductRepo* filterExpiration(ProductRepo* repo, void* arg)
+{
+	ExpirationQuery* query = arg;
+	return filterRepoByCategoryAndExpiration(repo, query->category, query->expiration);
+}
+
+/// <summary>
+/// Filters the products of every fridge by a given string
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="name">A string to be found in the product names</param>
+/// <param name="compare">The order of the result, NULL to keep the products of each fridge together</param>
+/// <param name="descending">1 if the order should be descending, otherwise ascending</param>
+/// <returns>A pointer to the result,
+///			 NULL, if the query failed on any fridge</returns>
+FleetResult* fleetFilterByString(Fleet* fleet, char* name, ProductComparator compare, int descending)
+{
+	return fleetQuery(fleet, filterString, name, compare, descending);
+}
+
+/// <summary>
+/// Filters the products of every fridge by category and expiration date
+/// </summary>
+/// <param name="fleet">A pointer to the fleet</param>
+/// <param name="category">The category of the products</param>
+/// <param name="expiration">The amount of days until products expire</param>
+/// <param name="compare">The order of the result, NULL to keep the products of each fridge together</param>
+/// <param name="descending">1 if the order should be descending, otherwise ascending</param>
+/// <returns>A pointer to the result,
+///			 NULL, if the query failed on any fridge</returns>
+FleetResult* fleetFilterByCategoryAndExpiration(Fleet* fleet, Category category, int expiration, ProductComparator compare, int descending)
+{
+	ExpirationQuery query = { category, expiration };
+	return fleetQuery(fleet, filterExpiration, &query, compare, descending);
+}
+
+/// <summary>
+/// Destroys the result of a fleet query and its products
+/// </summary>
+/// <param name="result">A pointer to the result</param>
+void destroyFleetResult(FleetResult* result)
+{
+	if (result == NULL) return;
+
+	for (int i = 0; i < result->partCount; i++)
+		destroyRepo(result->parts[i]);
+	free(result->parts);
+	free(result->items);
+	free(result);
+
+	result = NULL;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <threads.h>
+
+#include "Service.h"
+#include "ThreadPool.h"
+
+#define FLEET_INITIAL_SHARDS 16
+
+// Every fridge is a shard with its own service and lock, so operations on
+// different fridges never wait for each other
+typedef struct
+{
+	int fridgeId;
+	Service* serv;
+	mtx_t lock;
+} FridgeShard;
+
+typedef struct
+{
+	FridgeShard** shards;
+	int capacity;
+	int length;
+
+	// Open addressing index from fridge ID to shard position + 1, at most half full
+	int* table;
+	int tableCapacity;
+
+	mtx_t lock; // Guards the shard list and the index, never held while waiting for a shard
+	ThreadPool* pool;
+} Fleet;
+
+typedef struct
+{
+	int fridgeId;
+	Product* product;
+} FleetItem;
+
+typedef struct
+{
+	FleetItem* items;
+	int length;
+	ProductRepo** parts; // Owns the products of the items
+	int partCount;
+} FleetResult;
+
+typedef ProductRepo* (*FleetFilter)(ProductRepo* repo, void* arg);
+
+Fleet* createFleet(ThreadPool* pool);
+void destroyFleet(Fleet* fleet);
+int getFleetSize(Fleet* fleet);
+
+FridgeShard* acquireFridge(Fleet* fleet, int fridgeId);
+void releaseFridge(FridgeShard* shard);
+int fleetAddProduct(Fleet* fleet, int fridgeId, char* name, Category category, double quantity, Date expiration);
+
+FleetResult* fleetQuery(Fleet* fleet, FleetFilter filter, void* arg, ProductComparator compare, int descending);
+FleetResult* fleetFilterByString(Fleet* fleet, char* name, ProductComparator compare, int descending);
+FleetResult* fleetFilterByCategoryAndExpiration(Fleet* fleet, Category category, int expiration, ProductComparator compare, int descending);
+void destroyFleetResult(FleetResult* result);
@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ImportExport.h"
+
+/// <summary>
+/// Gets the current wall clock time
+/// </summary>
+/// <returns>The time in seconds</returns>
+static double wallSeconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// <summary>
+/// Chooses the file format from the extension of a path
+/// </summary>
+/// <param name="path">The path of the file</param>
+/// <returns>The CSV format for .csv files, JSON lines otherwise</returns>
+FileFormat formatFromPath(const char* path)
+{
+	const char* extension = strrchr(path, '.');
+
+	if (extension != NULL && strcmp(extension, ".csv") == 0)
+		return csvFormat;
+
+	return jsonLinesFormat;
+}
+
+/// <summary>
+/// Gets the throughput of a finished import or export
+/// </summary>
+/// <param name="stats">A pointer to the statistics of the transfer</param>
+/// <returns>The throughput in megabytes per second</returns>
+double getThroughput(TransferStats* stats)
+{
+	if (stats->seconds <= 0) return 0;
+
+	return stats->bytes / (1024.0 * 1024.0) / stats->seconds;
+}
+
+/// <summary>
+/// Cuts the next field out of a CSV line, unquoting it in place
+/// </summary>
+/// <param name="cursor">The position in the line, moved past the field</param>
+/// <returns>A pointer to the field,
+///			 NULL if there are no more fields or the quotes do not match</returns>
+static char* nextCsvField(char** cursor)
+{
+	char* field = *cursor;
+	if (field == NULL) return NULL;
+
+	if (*field != '"')
+	{
+		char* separator = strchr(field, ',');
+		if (separator == NULL)
+		{
+			*cursor = NULL;
+		}
+		else
+		{
+			*separator = '\0';
+			*cursor = separator + 1;
+		}
+		return field;
+	}
+
+	// Quoted field, "" stands for a quote
+	char* read = field + 1;
+	char* write = field;
+	while (1)
+	{
+		if (*read == '\0') return NULL;
+		if (*read == '"')
+		{
+			if (read[1] != '"') break;
+			read++;
+		}
+		*write++ = *read++;
+	}
+	*write = '\0';
+
+	read++;
+	if (*read == '\0')
+		*cursor = NULL;
+	else if (*read == ',')
+		*cursor = read + 1;
+	else
+		return NULL;
+
+	return field;
+}
+
+/// <summary>
+/// Parses a line of the form name,category,quantity,expiration
+/// </summary>
+/// <param name="line">The line to parse, it is modified in place</param>
+/// <param name="p">The product to fill in, its name points into the line</param>
+/// <returns>1 if the line is a valid product,
+///			 0, otherwise</returns>
+int parseCsvLine(char* line, Product* p)
+{
+	char* cursor = line;
+
+	char* name = nextCsvField(&cursor);
+	char* category = nextCsvField(&cursor);
+	char* quantity = nextCsvField(&cursor);
+	char* expiration = nextCsvField(&cursor);
+
+	if (expiration == NULL || cursor != NULL || *name == '\0') return 0;
+	if (parseCategory(category, &p->category) == 0) return 0;
+	if (parseFixedQuantity(quantity, &p->units) == 0) return 0;
+	if (parseDate(expiration, &p->expiration) == 0) return 0;
+
+	p->name = name;
+	p->quantity = fromQuantity(p->units);
+	return 1;
+}
+
+/// <summary>
+/// Skips spaces and tabs
+/// </summary>
+/// <param name="text">The current position</param>
+/// <returns>The first position that is not a space</returns>
+static char* skipSpaces(char* text)
+{
+	while (*text == ' ' || *text == '\t') text++;
+	return text;
+}
+
+/// <summary>
+/// Reads a JSON string in place, resolving the escape sequences
+/// </summary>
+/// <param name="cursor">The position of the opening quote, moved past the closing one</param>
+/// <returns>A pointer to the string,
+///			 NULL if the string is malformed</returns>
+static char* readJsonString(char** cursor)
+{
+	char* read = *cursor;
+	if (*read != '"') return NULL;
+
+	char* value = ++read;
+	char* write = value;
+	while (*read != '"')
+	{
+		if (*read == '\0') return NULL;
+		if (*read != '\\')
+		{
+			*write++ = *read++;
+			continue;
+		}
+
+		read++;
+		switch (*read)
+		{
+			case '"': case '\\': case '/': *write++ = *read; break;
+			case 'b': *write++ = '\b'; break;
+			case 'f': *write++ = '\f'; break;
+			case 'n': *write++ = '\n'; break;
+			case 'r': *write++ = '\r'; break;
+			case 't': *write++ = '\t'; break;
+			default: return NULL;
+		}
+		read++;
+	}
+
+	*write = '\0';
+	*cursor = read + 1;
+	return value;
+}
+
+/// <summary>
+/// Parses a JSON object with the name, category, quantity and expiration keys
+/// </summary>
+/// <param name="line">The line to parse, it is modified in place</param>
+/// <param name="p">The product to fill in, its name points into the line</param>
+/// <returns>1 if the line is a valid product,
+///			 0, otherwise</returns>
+int parseJsonLine(char* line, Product* p)
+{
+	char* cursor = skipSpaces(line);
+	int found = 0;
+
+	if (*cursor++ != '{') return 0;
+	cursor = skipSpaces(cursor);
+
+	while (*cursor != '}')
+	{
+		char* key = readJsonString(&cursor);
+		if (key == NULL) return 0;
+
+		cursor = skipSpaces(cursor);
+		if (*cursor++ != ':') return 0;
+		cursor = skipSpaces(cursor);
+
+		// Strings are unquoted in place, other values run until the next delimiter
+		char* value;
+		char* valueEnd = cursor;
+		if (*cursor == '"')
+		{
+			value = readJsonString(&cursor);
+			if (value == NULL) return 0;
+		}
+		else
+		{
+			value = cursor;
+			while (*cursor != '\0' && *cursor != ',' && *cursor != '}' && *cursor != ' ' && *cursor != '\t') cursor++;
+			valueEnd = cursor;
+		}
+
+		cursor = skipSpaces(cursor);
+		char delimiter = *cursor;
+		if (delimiter != ',' && delimiter != '}') return 0;
+		*cursor = '\0';
+		*valueEnd = '\0';
+
+		if (strcmp(key, "name") == 0 && *value != '\0')
+		{
+			p->name = value;
+			found |= 1;
+		}
+		else if (strcmp(key, "category") == 0)
+		{
+			if (parseCategory(value, &p->category) == 0) return 0;
+			found |= 2;
+		}
+		else if (strcmp(key, "quantity") == 0)
+		{
+			if (parseFixedQuantity(value, &p->units) == 0) return 0;
+			p->quantity = fromQuantity(p->units);
+			found |= 4;
+		}
+		else if (strcmp(key, "expiration") == 0)
+		{
+			if (parseDate(value, &p->expiration) == 0) return 0;
+			found |= 8;
+		}
+
+		if (delimiter == '}') break;
+		cursor = skipSpaces(cursor + 1);
+	}
+
+	return found == 15;
+}
+
+/// <summary>
+/// Adds the buffered products to the service
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="batch">The buffered products</param>
+/// <param name="length">The number of buffered products, reset to 0</param>
+/// <param name="stats">A pointer to the statistics of the import</param>
+static void flushBatch(Service* serv, Product** batch, int* length, TransferStats* stats)
+{
+	if (*length == 0) return;
+
+	stats->products += addProductsService(serv, batch, *length);
+	*length = 0;
+}
+
+/// <summary>
+/// Imports products from a CSV or JSON lines file, reading it through a fixed size buffer
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="path">The path of the file</param>
+/// <param name="format">The format of the file</param>
+/// <param name="stats">A pointer to the statistics of the import</param>
+/// <returns>1 if the file was read,
+///			 0, otherwise</returns>
+int importProducts(Service* serv, const char* path, FileFormat format, TransferStats* stats)
+{
+	memset(stats, 0, sizeof(TransferStats));
+	double start = wallSeconds();
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return 0;
+
+	char* buffer = malloc(IMPORT_BUFFER_SIZE + 1);
+	Product** batch = malloc(IMPORT_BATCH_SIZE * sizeof(Product*));
+	if (buffer == NULL || batch == NULL)
+	{
+		free(buffer);
+		free(batch);
+		fclose(file);
+		return 0;
+	}
+
+	int batchLength = 0;
+	int lineNumber = 0;
+	int skipping = 0;
+	size_t filled = 0;
+
+	while (1)
+	{
+		size_t read = fread(buffer + filled, 1, IMPORT_BUFFER_SIZE - filled, file);
+		int finished = read == 0;
+		stats->bytes += read;
+		filled += read;
+
+		char* start = buffer;
+		char* end = buffer + filled;
+		while (start < end)
+		{
+			char* newline = memchr(start, '\n', end - start);
+			if (newline == NULL)
+			{
+				if (finished == 0) break;
+				newline = end; // Last line without a line break
+			}
+			*newline = '\0';
+
+			char* line = start;
+			start = newline + 1;
+			if (skipping == 1)
+			{
+				skipping = 0;
+				continue;
+			}
+
+			size_t length = newline - line;
+			if (length > 0 && line[length - 1] == '\r') line[--length] = '\0';
+			if (length == 0) continue;
+
+			lineNumber++;
+			if (lineNumber == 1 && format == csvFormat && strncmp(line, "name,", 5) == 0) continue;
+
+			Product p;
+			int parsed = format == csvFormat ? parseCsvLine(line, &p) : parseJsonLine(line, &p);
+			Product* product = parsed == 1 ? createProductUnits(p.name, p.category, p.units, p.expiration) : NULL;
+			if (product == NULL)
+			{
+				stats->rejected++;
+				continue;
+			}
+
+			batch[batchLength++] = product;
+			if (batchLength == IMPORT_BATCH_SIZE) flushBatch(serv, batch, &batchLength, stats);
+		}
+
+		if (finished == 1) break;
+
+		// Keep the partial line, a line longer than the buffer is rejected and skipped
+		filled = end > start ? end - start : 0;
+		if (filled == IMPORT_BUFFER_SIZE)
+		{
+			stats->rejected++;
+			skipping = 1;
+			filled = 0;
+		}
+		memmove(buffer, start, filled);
+	}
+
+	flushBatch(serv, batch, &batchLength, stats);
+	free(batch);
+	free(buffer);
+	fclose(file);
+
+	stats->seconds = wallSeconds() - start;
+	return 1;
+}
+
+/// <summary>
+/// Writes a CSV field, quoting it if needed
+/// </summary>
+/// <param name="file">The output file</param>
+/// <param name="text">The text of the field</param>
+static void writeCsvText(FILE* file, const char* text)
+{
+	if (strpbrk(text, ",\"\r\n") == NULL)
+	{
+		fputs(text, file);
+		return;
+	}
+
+	fputc('"', file);
+	for (; *text != '\0'; text++)
+	{
+		if (*text == '"') fputc('"', file);
+		fputc(*text, file);
+	}
+	fputc('"', file);
+}
+
+/// <summary>
+/// Writes a JSON string with its quotes
+/// </summary>
+/// <param name="file">The output file</param>
+/// <param name="text">The text of the string</param>
+static void writeJsonText(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (; *text != '\0'; text++)
+	{
+		switch (*text)
+		{
+			case '"': fputs("\\\"", file); break;
+			case '\\': fputs("\\\\", file); break;
+			case '\n': fputs("\\n", file); break;
+			case '\r': fputs("\\r", file); break;
+			case '\t': fputs("\\t", file); break;
+			default: fputc(*text, file);
+		}
+	}
+	fputc('"', file);
+}
+
+/// <summary>
+/// Exports all products to a CSV or JSON lines file
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="path">The path of the file</param>
+/// <param name="format">The format of the file</param>
+/// <param name="stats">A pointer to the statistics of the export</param>
+/// <returns>1 if the file was written successfully,
+///			 0, otherwise</returns>
+int exportProducts(ProductRepo* repo, const char* path, FileFormat format, TransferStats* stats)
+{
+	memset(stats, 0, sizeof(TransferStats));
+	double start = wallSeconds();
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return 0;
+	setvbuf(file, NULL, _IOFBF, IMPORT_BUFFER_SIZE);
+
+	if (format == csvFormat) fputs("name,category,quantity,expiration\n", file);
+
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* current = getProductAt(repo, i);
+
+		// Written from the fixed point units, so an import reads back the exact quantity
+		char quantity[32];
+		formatQuantity(current->units, quantity, sizeof(quantity));
+
+		if (format == csvFormat)
+		{
+			writeCsvText(file, current->name);
+			fprintf(file, ",%s,%s,%04d-%02d-%02d\n", category_name[current->category], quantity,
+				current->expiration.year, current->expiration.month, current->expiration.day);
+		}
+		else
+		{
+			fputs("{\"name\":", file);
+			writeJsonText(file, current->name);
+			fprintf(file, ",\"category\":\"%s\",\"quantity\":%s,\"expiration\":\"%04d-%02d-%02d\"}\n",
+				category_name[current->category], quantity,
+				current->expiration.year, current->expiration.month, current->expiration.day);
+		}
+		stats->products++;
+	}
+
+	stats->bytes = ftell(file);
+	int result = ferror(file) == 0;
+	if (fclose(file) != 0) result = 0;
+
+	stats->seconds = wallSeconds() - start;
+	return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "Service.h"
+
+#define IMPORT_BUFFER_SIZE 65536
+#define IMPORT_BATCH_SIZE 1024
+
+typedef enum { csvFormat, jsonLinesFormat } FileFormat;
+
+typedef struct
+{
+	long long bytes;
+	int products;
+	int rejected;
+	double seconds;
+} TransferStats;
+
+FileFormat formatFromPath(const char* path);
+double getThroughput(TransferStats* stats);
+
+int parseCsvLine(char* line, Product* p);
+int parseJsonLine(char* line, Product* p);
+
+int importProducts(Service* serv, const char* path, FileFormat format, TransferStats* stats);
+int exportProducts(ProductRepo* repo, const char* path, FileFormat format, TransferStats* stats);
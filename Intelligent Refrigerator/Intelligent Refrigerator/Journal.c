@@ -0,0 +1,264 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Journal.h"
+#include "Snapshot.h"
+
+/// <summary>
+/// Computes the checksum of a record and its name
+/// </summary>
+/// <param name="record">A pointer to the record</param>
+/// <param name="name">The name stored after the record</param>
+/// <returns>The checksum of the record</returns>
+static uint32_t recordChecksum(JournalRecord* record, const char* name)
+{
+	const char* start = (const char*)record + offsetof(JournalRecord, nameLength);
+	uint32_t checksum = computeChecksum(start, sizeof(JournalRecord) - offsetof(JournalRecord, nameLength), JOURNAL_FORMAT);
+
+	return computeChecksum(name, record->nameLength, checksum);
+}
+
+/// <summary>
+/// Fills in a record, the name of the product follows it wherever it is written
+/// </summary>
+/// <param name="record">A pointer to the record</param>
+/// <param name="sequence">The operation the record belongs to</param>
+/// <param name="type">The type of the record</param>
+/// <param name="operation">The operation that produced the record</param>
+/// <param name="p">The product that was changed, NULL for a commit</param>
+/// <returns>1 if the record was filled in,
+///			 0 if the name is too long</returns>
+int encodeJournalRecord(JournalRecord* record, uint64_t sequence, JournalRecordType type, JournalOperation operation, Product* p)
+{
+	memset(record, 0, sizeof(JournalRecord));
+	const char* name = "";
+
+	record->sequence = sequence;
+	record->type = type;
+	record->operation = operation;
+	if (p != NULL)
+	{
+		name = p->name;
+		record->nameLength = (uint32_t)strlen(p->name);
+		record->category = p->category;
+		record->year = p->expiration.year;
+		record->month = p->expiration.month;
+		record->day = p->expiration.day;
+		record->units = p->units;
+	}
+	if (record->nameLength > JOURNAL_MAX_NAME) return 0;
+
+	record->checksum = recordChecksum(record, name);
+	return 1;
+}
+
+/// <summary>
+/// Fills in the commit record of an operation
+/// </summary>
+/// <param name="record">A pointer to the record</param>
+/// <param name="sequence">The operation to commit</param>
+/// <param name="operation">The type of the operation</param>
+/// <param name="archived">The length of the archive after the operation, -1 without an archive</param>
+void encodeCommitRecord(JournalRecord* record, uint64_t sequence, JournalOperation operation, int64_t archived)
+{
+	encodeJournalRecord(record, sequence, journalCommit, operation, NULL);
+	record->units = archived;
+	record->checksum = recordChecksum(record, "");
+}
+
+/// <summary>
+/// Opens a journal for appending
+/// </summary>
+/// <param name="path">The path of the journal file</param>
+/// <param name="sequence">The last operation that was already committed</param>
+/// <returns>A pointer to the journal,
+///			 NULL if the file could not be opened</returns>
+Journal* openJournal(const char* path, uint64_t sequence)
+{
+	Journal* journal = malloc(sizeof(Journal));
+	if (journal == NULL) return NULL;
+
+	journal->path = malloc(sizeof(char) * (strlen(path) + 1));
+	if (journal->path == NULL)
+	{
+		free(journal);
+		return NULL;
+	}
+	strcpy(journal->path, path);
+
+	journal->file = fopen(path, "ab");
+	if (journal->file == NULL)
+	{
+		free(journal->path);
+		free(journal);
+		return NULL;
+	}
+	fseek(journal->file, 0, SEEK_END);
+
+	journal->sequence = sequence;
+	return journal;
+}
+
+/// <summary>
+/// Closes the journal
+/// </summary>
+/// <param name="journal">A pointer to the journal</param>
+void closeJournal(Journal* journal)
+{
+	if (journal == NULL) return;
+
+	if (journal->file != NULL) fclose(journal->file);
+	free(journal->path);
+	free(journal);
+
+	journal = NULL;
+}
+
+/// <summary>
+/// Writes a record of the current operation, it becomes durable on commit
+/// </summary>
+/// <param name="journal">A pointer to the journal</param>
+/// <param name="type">The type of the record</param>
+/// <param name="operation">The operation that produced the record</param>
+/// <param name="p">The product that was changed, NULL for a commit</param>
+/// <returns>1 if the record was written,
+///			 0, otherwise</returns>
+int writeJournal(Journal* journal, JournalRecordType type, JournalOperation operation, Product* p)
+{
+	if (journal->file == NULL) return 0;
+
+	JournalRecord record;
+	const char* name = p != NULL ? p->name : "";
+	if (encodeJournalRecord(&record, journal->sequence + 1, type, operation, p) == 0) return 0;
+
+	if (fwrite(&record, sizeof(JournalRecord), 1, journal->file) != 1) return 0;
+	if (record.nameLength > 0 && fwrite(name, record.nameLength, 1, journal->file) != 1) return 0;
+
+	return 1;
+}
+
+/// <summary>
+/// Commits the current operation and flushes the journal
+/// </summary>
+/// <param name="journal">A pointer to the journal</param>
+/// <param name="operation">The operation to commit</param>
+/// <param name="archived">The length of the archive after the operation, -1 without an archive</param>
+/// <returns>1 if the operation was committed,
+///			 0, otherwise</returns>
+int commitJournal(Journal* journal, JournalOperation operation, int64_t archived)
+{
+	if (journal->file == NULL) return 0;
+
+	JournalRecord record;
+	encodeCommitRecord(&record, journal->sequence + 1, operation, archived);
+	if (fwrite(&record, sizeof(JournalRecord), 1, journal->file) != 1) return 0;
+	if (fflush(journal->file) != 0) return 0;
+
+	journal->sequence++;
+	return 1;
+}
+
+/// <summary>
+/// Empties the journal, used once its operations are saved in a snapshot
+/// </summary>
+/// <param name="journal">A pointer to the journal</param>
+/// <returns>1 if the journal was emptied,
+///			 0, otherwise</returns>
+int resetJournal(Journal* journal)
+{
+	if (journal->file != NULL) fclose(journal->file);
+
+	journal->file = fopen(journal->path, "wb");
+	return journal->file != NULL;
+}
+
+/// <summary>
+/// Opens a journal file for reading
+/// </summary>
+/// <param name="path">The path of the journal file</param>
+/// <returns>A pointer to the reader,
+///			 NULL if the file could not be opened</returns>
+JournalReader* openJournalReader(const char* path)
+{
+	JournalReader* reader = malloc(sizeof(JournalReader));
+	if (reader == NULL) return NULL;
+
+	reader->file = fopen(path, "rb");
+	if (reader->file == NULL)
+	{
+		free(reader);
+		return NULL;
+	}
+
+	reader->validEnd = 0;
+	return reader;
+}
+
+/// <summary>
+/// Closes the journal reader
+/// </summary>
+/// <param name="reader">A pointer to the reader</param>
+void closeJournalReader(JournalReader* reader)
+{
+	if (reader == NULL) return;
+
+	fclose(reader->file);
+	free(reader);
+
+	reader = NULL;
+}
+
+/// <summary>
+/// Reads the next record from the journal
+/// </summary>
+/// <param name="reader">A pointer to the reader</param>
+/// <returns>1 if a valid record was read,
+///			 0 at the end of the journal or at a torn or corrupted record</returns>
+int readJournalRecord(JournalReader* reader)
+{
+	JournalRecord* record = &reader->record;
+
+	if (fread(record, sizeof(JournalRecord), 1, reader->file) != 1) return 0;
+	if (record->nameLength > JOURNAL_MAX_NAME) return 0;
+	if (record->nameLength > 0 && fread(reader->name, record->nameLength, 1, reader->file) != 1) return 0;
+	reader->name[record->nameLength] = '\0';
+
+	if (record->checksum != recordChecksum(record, reader->name)) return 0;
+	if (record->type < journalPut || record->type > journalArchive) return 0;
+	if (record->category < none || record->category > CATEGORY_END) return 0;
+
+	reader->validEnd += (long)(sizeof(JournalRecord) + record->nameLength);
+	return 1;
+}
+
+/// <summary>
+/// Cuts the journal file to the given size
+/// </summary>
+/// <param name="path">The path of the journal file</param>
+/// <param name="size">The new size in bytes</param>
+/// <returns>1 if the file was truncated,
+///			 0, otherwise</returns>
+int truncateJournal(const char* path, long size)
+{
+	FILE* file = fopen(path, "r+b");
+	if (file == NULL) return 0;
+
+#ifdef _WIN32
+	int result = _chsize_s(_fileno(file), size) == 0;
+#else
+	int result = ftruncate(fileno(file), size) == 0;
+#endif
+
+	fclose(file);
+	return result;
+}
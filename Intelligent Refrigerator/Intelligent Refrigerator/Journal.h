@@ -0,0 +1,60 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Product.h"
+
+#define JOURNAL_DEFAULT_PATH "fridge.journal"
+#define JOURNAL_MAX_NAME 4096
+#define JOURNAL_FORMAT 2 // Seeds the record checksums, so records of an older layout never pass as current ones
+
+typedef enum { journalPut = 1, journalRemove, journalCommit, journalArchive } JournalRecordType;
+typedef enum { journalAdd = 1, journalDelete, journalUpdate, journalUndo, journalRedo, journalSweep } JournalOperation;
+
+// Every operation is logged as the products it changed (put or remove) and
+// the products it appended to the cold archive, followed by a commit record
+// that holds the length of the archive after it, -1 without an archive, so
+// undo and redo move the archive back and forth on replay too. Records of an
+// operation without a commit are treated as a torn write and discarded on recovery.
+typedef struct
+{
+	uint32_t checksum; // CRC-32 of the rest of the record, including the name
+	uint32_t nameLength;
+	uint64_t sequence; // The operation the record belongs to
+	int32_t type;
+	int32_t operation;
+	int32_t category;
+	int32_t year;
+	int32_t month;
+	int32_t day;
+	int64_t units; // The exact quantity, in units of 1 / QUANTITY_SCALE
+} JournalRecord;
+
+typedef struct
+{
+	FILE* file;
+	char* path;
+	uint64_t sequence; // Last committed operation
+} Journal;
+
+typedef struct
+{
+	FILE* file;
+	long validEnd; // End of the last record that passed validation
+	JournalRecord record;
+	char name[JOURNAL_MAX_NAME + 1];
+} JournalReader;
+
+int encodeJournalRecord(JournalRecord* record, uint64_t sequence, JournalRecordType type, JournalOperation operation, Product* p);
+void encodeCommitRecord(JournalRecord* record, uint64_t sequence, JournalOperation operation, int64_t archived);
+
+Journal* openJournal(const char* path, uint64_t sequence);
+void closeJournal(Journal* journal);
+int writeJournal(Journal* journal, JournalRecordType type, JournalOperation operation, Product* p);
+int commitJournal(Journal* journal, JournalOperation operation, int64_t archived);
+int resetJournal(Journal* journal);
+
+JournalReader* openJournalReader(const char* path);
+void closeJournalReader(JournalReader* reader);
+int readJournalRecord(JournalReader* reader);
+int truncateJournal(const char* path, long size);
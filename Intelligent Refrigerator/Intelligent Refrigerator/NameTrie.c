@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "NameTrie.h"
+
+/// <summary>
+/// Checks if a product is a better completion than another one: a higher quantity first,
+/// then the name and the category
+/// </summary>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>1 if the first product ranks before the second,
+///			 0, otherwise</returns>
+static int ranksBefore(Product* first, Product* second)
+{
+	if (first->units != second->units) return first->units > second->units;
+
+	int result = strcmp(first->name, second->name);
+	if (result != 0) return result < 0;
+	return first->category < second->category;
+}
+
+/// <summary>
+/// Creates a node without children or products
+/// </summary>
+/// <param name="label">The characters of the edge from the parent</param>
+/// <param name="length">The number of characters</param>
+/// <returns>A pointer to the node</returns>
+static TrieNode* createNode(const char* label, int length)
+{
+	TrieNode* node = calloc(1, sizeof(TrieNode));
+	if (node == NULL || length == 0) return node;
+
+	node->label = malloc(length);
+	if (node->label == NULL)
+	{
+		free(node);
+		return NULL;
+	}
+	memcpy(node->label, label, length);
+	node->labelLength = length;
+
+	return node;
+}
+
+/// <summary>
+/// Destroys a node and its subtree, the products belong to the repository
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+static void destroyNode(TrieNode* node)
+{
+	if (node == NULL) return;
+
+	for (int i = 0; i < node->childLength; i++)
+		destroyNode(node->children[i]);
+
+	free(node->children);
+	free(node->label);
+	free(node);
+}
+
+/// <summary>
+/// Creates an empty trie
+/// </summary>
+/// <returns>A pointer to the trie</returns>
+NameTrie* createNameTrie()
+{
+	NameTrie* trie = malloc(sizeof(NameTrie));
+	if (trie == NULL) return NULL;
+
+	trie->root = createNode(NULL, 0);
+	if (trie->root == NULL)
+	{
+		free(trie);
+		return NULL;
+	}
+	trie->count = 0;
+
+	return trie;
+}
+
+/// <summary>
+/// Destroys the trie, the products belong to the repository
+/// </summary>
+/// <param name="trie">A pointer to the trie</param>
+void destroyNameTrie(NameTrie* trie)
+{
+	if (trie == NULL) return;
+
+	destroyNode(trie->root);
+	free(trie);
+
+	trie = NULL;
+}
+
+/// <summary>
+/// Finds the child whose edge starts with a character
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="c">The first character of the edge</param>
+/// <returns>The index of the child,
+///			 -1 if there is none</returns>
+static int findChild(TrieNode* node, char c)
+{
+	for (int i = 0; i < node->childLength; i++)
+		if (node->children[i]->label[0] == c) return i;
+
+	return -1;
+}
+
+/// <summary>
+/// Adds a child to a node
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="child">A pointer to the child</param>
+/// <returns>1 if the child was added,
+///			 0 if there is not enough memory</returns>
+static int addChild(TrieNode* node, TrieNode* child)
+{
+	if (node->childLength == node->childCapacity)
+	{
+		int capacity = node->childCapacity == 0 ? TRIE_INITIAL_CHILDREN : node->childCapacity * 2;
+		TrieNode** tmp = realloc(node->children, capacity * sizeof(TrieNode*));
+		if (tmp == NULL) return 0;
+
+		node->children = tmp;
+		node->childCapacity = capacity;
+	}
+
+	node->children[node->childLength++] = child;
+	return 1;
+}
+
+/// <summary>
+/// Checks if the name of any product ends at a node
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <returns>1 if a product ends at the node,
+///			 0, otherwise</returns>
+static int hasProducts(TrieNode* node)
+{
+	for (int i = none; i <= CATEGORY_END; i++)
+		if (node->products[i] != NULL) return 1;
+
+	return 0;
+}
+
+/// <summary>
+/// Finds a product among the best products of a node
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product is one of the best,
+///			 0, otherwise</returns>
+static int isTop(TrieNode* node, Product* p)
+{
+	for (int i = 0; i < node->topLength; i++)
+		if (node->top[i] == p) return 1;
+
+	return 0;
+}
+
+/// <summary>
+/// Puts a product among the best products of a node if it ranks high enough
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="p">A pointer to the product, it must not be among the best products yet</param>
+static void offerTop(TrieNode* node, Product* p)
+{
+	int position = node->topLength;
+	while (position > 0 && ranksBefore(p, node->top[position - 1])) position--;
+	if (position == TRIE_TOP_COUNT) return;
+
+	// The last product falls off when the list is full
+	int last = node->topLength < TRIE_TOP_COUNT ? node->topLength : TRIE_TOP_COUNT - 1;
+	memmove(&node->top[position + 1], &node->top[position], (last - position) * sizeof(Product*));
+	node->top[position] = p;
+	if (node->topLength < TRIE_TOP_COUNT) node->topLength++;
+}
+
+/// <summary>
+/// Computes the best products of a node again from its own products and the best products
+/// of its children, after one of them dropped out or lost quantity
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+static void recomputeTop(TrieNode* node)
+{
+	node->topLength = 0;
+
+	for (int i = none; i <= CATEGORY_END; i++)
+		if (node->products[i] != NULL) offerTop(node, node->products[i]);
+
+	for (int i = 0; i < node->childLength; i++)
+		for (int j = 0; j < node->children[i]->topLength; j++)
+			offerTop(node, node->children[i]->top[j]);
+}
+
+/// <summary>
+/// Inserts a product below a node
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="rest">The part of the name below the node</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product was inserted,
+///			 0 if there is not enough memory</returns>
+static int insertNode(TrieNode* node, const char* rest, Product* p)
+{
+	if (*rest == '\0')
+	{
+		node->products[p->category] = p;
+		offerTop(node, p);
+		return 1;
+	}
+
+	int index = findChild(node, *rest);
+	if (index < 0)
+	{
+		TrieNode* leaf = createNode(rest, (int)strlen(rest));
+		if (leaf == NULL) return 0;
+		if (addChild(node, leaf) == 0)
+		{
+			destroyNode(leaf);
+			return 0;
+		}
+
+		leaf->products[p->category] = p;
+		offerTop(leaf, p);
+		offerTop(node, p);
+		return 1;
+	}
+
+	TrieNode* child = node->children[index];
+	int common = 0;
+	while (common < child->labelLength && rest[common] == child->label[common]) common++;
+
+	// The name leaves the edge in the middle, so the edge is split there
+	if (common < child->labelLength)
+	{
+		TrieNode* middle = createNode(child->label, common);
+		if (middle == NULL || addChild(middle, child) == 0)
+		{
+			destroyNode(middle);
+			return 0;
+		}
+
+		memmove(child->label, child->label + common, child->labelLength - common);
+		child->labelLength -= common;
+		memcpy(middle->top, child->top, child->topLength * sizeof(Product*));
+		middle->topLength = child->topLength;
+
+		node->children[index] = middle;
+		child = middle;
+	}
+
+	if (insertNode(child, rest + common, p) == 0) return 0;
+
+	offerTop(node, p);
+	return 1;
+}
+
+/// <summary>
+/// Inserts a product, the name and category pair must not be in the trie yet
+/// </summary>
+/// <param name="trie">A pointer to the trie</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product was inserted,
+///			 0 if there is not enough memory</returns>
+int insertNameTrie(NameTrie* trie, Product* p)
+{
+	if (insertNode(trie->root, p->name, p) == 0) return 0;
+
+	trie->count++;
+	return 1;
+}
+
+/// <summary>
+/// Removes a child that no longer holds anything, or merges it with its only child
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="index">The index of the child</param>
+static void compactChild(TrieNode* node, int index)
+{
+	TrieNode* child = node->children[index];
+	if (hasProducts(child) == 1) return;
+
+	if (child->childLength == 0)
+	{
+		node->children[index] = node->children[--node->childLength];
+		destroyNode(child);
+	}
+	else if (child->childLength == 1)
+	{
+		TrieNode* grandchild = child->children[0];
+		char* label = realloc(child->label, child->labelLength + grandchild->labelLength);
+		if (label == NULL) return;
+
+		memcpy(label + child->labelLength, grandchild->label, grandchild->labelLength);
+		free(grandchild->label);
+		grandchild->label = label;
+		grandchild->labelLength += child->labelLength;
+
+		child->label = NULL;
+		child->childLength = 0;
+		node->children[index] = grandchild;
+		destroyNode(child);
+	}
+}
+
+/// <summary>
+/// Removes a product below a node
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="rest">The part of the name below the node</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product was removed,
+///			 0 if it is not in the trie</returns>
+static int removeNode(TrieNode* node, const char* rest, Product* p)
+{
+	if (*rest == '\0')
+	{
+		if (node->products[p->category] != p) return 0;
+		node->products[p->category] = NULL;
+	}
+	else
+	{
+		int index = findChild(node, *rest);
+		if (index < 0) return 0;
+
+		TrieNode* child = node->children[index];
+		if (strncmp(rest, child->label, child->labelLength) != 0) return 0;
+		if (removeNode(child, rest + child->labelLength, p) == 0) return 0;
+
+		compactChild(node, index);
+	}
+
+	if (isTop(node, p) == 1) recomputeTop(node);
+	return 1;
+}
+
+/// <summary>
+/// Removes a product
+/// </summary>
+/// <param name="trie">A pointer to the trie</param>
+/// <param name="p">A pointer to the product</param>
+void removeNameTrie(NameTrie* trie, Product* p)
+{
+	if (removeNode(trie->root, p->name, p) == 1) trie->count--;
+}
+
+/// <summary>
+/// Moves a product whose quantity changed to its new rank below a node
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+/// <param name="rest">The part of the name below the node</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product was found,
+///			 0 if it is not in the trie</returns>
+static int rankNode(TrieNode* node, const char* rest, Product* p)
+{
+	if (*rest == '\0')
+	{
+		if (node->products[p->category] != p) return 0;
+	}
+	else
+	{
+		int index = findChild(node, *rest);
+		if (index < 0) return 0;
+
+		TrieNode* child = node->children[index];
+		if (strncmp(rest, child->label, child->labelLength) != 0) return 0;
+		if (rankNode(child, rest + child->labelLength, p) == 0) return 0;
+	}
+
+	// A product that was among the best might have to make room for another one
+	if (isTop(node, p) == 1) recomputeTop(node);
+	else offerTop(node, p);
+	return 1;
+}
+
+/// <summary>
+/// Moves a product to its new rank after its quantity changed
+/// </summary>
+/// <param name="trie">A pointer to the trie</param>
+/// <param name="p">A pointer to the product</param>
+void rankNameTrie(NameTrie* trie, Product* p)
+{
+	rankNode(trie->root, p->name, p);
+}
+
+/// <summary>
+/// Gets the products with the highest quantities whose name starts with a prefix,
+/// the time does not depend on the number of products
+/// </summary>
+/// <param name="trie">A pointer to the trie</param>
+/// <param name="prefix">The prefix</param>
+/// <param name="completions">Where to store the products</param>
+/// <param name="count">The maximum number of products, at most TRIE_TOP_COUNT are returned</param>
+/// <returns>The number of products</returns>
+int completeNameTrie(NameTrie* trie, const char* prefix, Product** completions, int count)
+{
+	TrieNode* node = trie->root;
+
+	while (*prefix != '\0')
+	{
+		int index = findChild(node, *prefix);
+		if (index < 0) return 0;
+
+		// The prefix may end in the middle of the edge
+		TrieNode* child = node->children[index];
+		int length = 0;
+		for (; length < child->labelLength && prefix[length] != '\0'; length++)
+			if (prefix[length] != child->label[length]) return 0;
+
+		prefix += length;
+		node = child;
+	}
+
+	int length = count < node->topLength ? count : node->topLength;
+	memcpy(completions, node->top, length * sizeof(Product*));
+	return length;
+}
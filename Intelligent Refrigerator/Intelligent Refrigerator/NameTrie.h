@@ -0,0 +1,37 @@
+#pragma once
+#include "Product.h"
+
+#define TRIE_TOP_COUNT 8
+#define TRIE_INITIAL_CHILDREN 2
+
+// A node of a radix trie, the edge from its parent holds a whole run of characters
+typedef struct TrieNode
+{
+	char* label; // Not terminated, NULL for the root
+	int labelLength;
+
+	struct TrieNode** children;
+	int childLength;
+	int childCapacity;
+
+	Product* products[CATEGORY_END + 1]; // The products whose name ends here, by category
+	Product* top[TRIE_TOP_COUNT]; // The products of the subtree with the highest quantities, in order
+	int topLength;
+} TrieNode;
+
+// Radix trie over the product names of a repository. Every node keeps the best
+// products of its subtree, so a prefix is completed without visiting the products.
+typedef struct
+{
+	TrieNode* root;
+	int count;
+} NameTrie;
+
+NameTrie* createNameTrie();
+void destroyNameTrie(NameTrie* trie);
+
+int insertNameTrie(NameTrie* trie, Product* p);
+void removeNameTrie(NameTrie* trie, Product* p);
+void rankNameTrie(NameTrie* trie, Product* p);
+
+int completeNameTrie(NameTrie* trie, const char* prefix, Product** completions, int count);
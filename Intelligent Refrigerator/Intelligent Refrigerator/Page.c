@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Page.h"
+
+// The products a page is selected from
+typedef struct
+{
+	char* name; // NULL if the names are not filtered, folded if the match ignores case
+	StringMatch match;
+	Category category; // none for every category
+	int expiration; // Products that expire within this many days, if the names are not filtered
+	int today;
+} PageFilter;
+
+/// <summary>
+/// Compares two products in the order of a page
+/// </summary>
+/// <param name="order">The order of the page</param>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>A negative value, zero or a positive value, like strcmp</returns>
+static int compareInOrder(PageOrder order, Product* first, Product* second)
+{
+	int result = 0;
+
+	if (order == orderByQuantity) result = compareByQuantity(first, second);
+	else if (order == orderByExpiration) result = compareByExpiration(first, second);
+
+	if (result == 0) result = compareByName(first, second);
+	if (result == 0) result = (int)first->category - (int)second->category;
+
+	return result;
+}
+
+/// <summary>
+/// Checks if a product passes the filter of a page
+/// </summary>
+/// <param name="filter">A pointer to the filter</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product passes,
+///			 0, otherwise</returns>
+static int matchFilter(PageFilter* filter, Product* p)
+{
+	if (filter->name != NULL) return matchName(p, filter->name, filter->match);
+
+	if (filter->category != none && p->category != filter->category) return 0;
+	return daysFromCivil(p->expiration) - filter->today <= filter->expiration;
+}
+
+/// <summary>
+/// Moves a product down the heap until both of its children come before it
+/// </summary>
+/// <param name="heap">The heap, the last product in the order is at the top</param>
+/// <param name="length">The number of products in the heap</param>
+/// <param name="order">The order of the page</param>
+/// <param name="position">The position of the product</param>
+static void siftDown(Product** heap, int length, PageOrder order, int position)
+{
+	while (1)
+	{
+		int largest = position;
+		int left = 2 * position + 1;
+		int right = left + 1;
+
+		if (left < length && compareInOrder(order, heap[left], heap[largest]) > 0) largest = left;
+		if (right < length && compareInOrder(order, heap[right], heap[largest]) > 0) largest = right;
+		if (largest == position) return;
+
+		Product* tmp = heap[position];
+		heap[position] = heap[largest];
+		heap[largest] = tmp;
+		position = largest;
+	}
+}
+
+/// <summary>
+/// Moves a product up the heap until its parent comes after it
+/// </summary>
+/// <param name="heap">The heap, the last product in the order is at the top</param>
+/// <param name="order">The order of the page</param>
+/// <param name="position">The position of the product</param>
+static void siftUp(Product** heap, PageOrder order, int position)
+{
+	while (position > 0)
+	{
+		int parent = (position - 1) / 2;
+		if (compareInOrder(order, heap[position], heap[parent]) <= 0) return;
+
+		Product* tmp = heap[position];
+		heap[position] = heap[parent];
+		heap[parent] = tmp;
+		position = parent;
+	}
+}
+
+/// <summary>
+/// Selects the first products after a cursor without sorting every match. A bounded heap
+/// keeps the best count + 1 products seen so far, the extra one tells if there is a next page.
+/// </summary>
+/// <param name="repo">A pointer to the repository, it is only read</param>
+/// <param name="filter">A pointer to the filter</param>
+/// <param name="order">The order of the page</param>
+/// <param name="count">The maximum number of rows</param>
+/// <param name="after">A pointer to the cursor the page starts after, NULL for the first page</param>
+/// <param name="page">Where to store the page</param>
+/// <returns>1 if the page was selected,
+///			 0 if there is not enough memory</returns>
+static int selectPage(ProductRepo* repo, PageFilter* filter, PageOrder order, int count, PageCursor* after, Page* page)
+{
+	if (count < 1) count = 1;
+
+	page->rows = createRepo();
+	page->next.valid = 0;
+	page->next.name = NULL;
+	if (page->rows == NULL) return 0;
+
+	Product** heap = malloc((count + 1) * sizeof(Product*));
+	if (heap == NULL)
+	{
+		destroyRepo(page->rows);
+		page->rows = NULL;
+		return 0;
+	}
+
+	Product start = { 0 };
+	if (after != NULL && after->valid == 1)
+	{
+		start.name = after->name;
+		start.category = after->category;
+		start.units = after->units;
+		start.quantity = fromQuantity(after->units);
+		start.expiration = after->expiration;
+	}
+
+	int length = 0;
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* current = getProductAt(repo, i);
+		if (matchFilter(filter, current) == 0) continue;
+		if (start.name != NULL && compareInOrder(order, current, &start) <= 0) continue;
+
+		if (length <= count)
+		{
+			heap[length] = current;
+			siftUp(heap, order, length++);
+		}
+		else if (compareInOrder(order, current, heap[0]) < 0)
+		{
+			heap[0] = current;
+			siftDown(heap, length, order, 0);
+		}
+	}
+
+	// Taking the top off the heap one by one leaves it in ascending order
+	for (int end = length - 1; end > 0; end--)
+	{
+		Product* tmp = heap[0];
+		heap[0] = heap[end];
+		heap[end] = tmp;
+		siftDown(heap, end, order, 0);
+	}
+
+	int rows = length > count ? count : length;
+	int ret = reserveRepo(page->rows, rows);
+	for (int i = 0; i < rows && ret == 1; i++)
+	{
+		Product* p = createProductUnits(heap[i]->name, heap[i]->category, heap[i]->units, heap[i]->expiration);
+		if (p == NULL || appendProductRepo(page->rows, p) == 0)
+		{
+			destroyProduct(p);
+			ret = 0;
+		}
+	}
+
+	if (ret == 1 && length > count)
+	{
+		Product* last = heap[count - 1];
+		page->next.name = malloc(strlen(last->name) + 1);
+		if (page->next.name == NULL) ret = 0;
+		else strcpy(page->next.name, last->name);
+
+		page->next.valid = ret;
+		page->next.units = last->units;
+		page->next.expiration = last->expiration;
+		page->next.category = last->category;
+	}
+	free(heap);
+
+	if (ret == 0)
+	{
+		destroyRepo(page->rows);
+		page->rows = NULL;
+	}
+
+	return ret;
+}
+
+/// <summary>
+/// Gets a page of the products whose name matches a given string
+/// </summary>
+/// <param name="repo">A pointer to the repository, it is only read</param>
+/// <param name="name">The string to match, empty for every product</param>
+/// <param name="match">How the product names are compared to the string</param>
+/// <param name="order">The order of the rows</param>
+/// <param name="count">The maximum number of rows</param>
+/// <param name="after">A pointer to the cursor of the previous page, NULL for the first page</param>
+/// <param name="page">Where to store the page, it must be destroyed with destroyPage</param>
+/// <returns>1 if the page was selected,
+///			 0 if there is not enough memory</returns>
+int pageByString(ProductRepo* repo, char* name, StringMatch match, PageOrder order, int count, PageCursor* after, Page* page)
+{
+	PageFilter filter = { name, match, none, 0, 0 };
+	if (match == matchSubstring) return selectPage(repo, &filter, order, count, after, page);
+
+	filter.name = malloc(strlen(name) + 1);
+	if (filter.name == NULL)
+	{
+		page->rows = NULL;
+		page->next.valid = 0;
+		page->next.name = NULL;
+		return 0;
+	}
+	foldName(name, filter.name);
+
+	int ret = selectPage(repo, &filter, order, count, after, page);
+	free(filter.name);
+	return ret;
+}
+
+/// <summary>
+/// Gets a page of the products in a given category that have expired or expire within the given days
+/// </summary>
+/// <param name="repo">A pointer to the repository, it is only read</param>
+/// <param name="category">The category of the products, none for every category</param>
+/// <param name="expiration">The amount of days until products expire</param>
+/// <param name="today">The current date</param>
+/// <param name="order">The order of the rows</param>
+/// <param name="count">The maximum number of rows</param>
+/// <param name="after">A pointer to the cursor of the previous page, NULL for the first page</param>
+/// <param name="page">Where to store the page, it must be destroyed with destroyPage</param>
+/// <returns>1 if the page was selected,
+///			 0 if there is not enough memory</returns>
+int pageByCategoryAndExpiration(ProductRepo* repo, Category category, int expiration, Date today, PageOrder order, int count, PageCursor* after, Page* page)
+{
+	PageFilter filter = { NULL, matchSubstring, category, expiration, daysFromCivil(today) };
+	return selectPage(repo, &filter, order, count, after, page);
+}
+
+/// <summary>
+/// Destroys the rows and the cursor of a page
+/// </summary>
+/// <param name="page">A pointer to the page</param>
+void destroyPage(Page* page)
+{
+	destroyRepo(page->rows);
+	page->rows = NULL;
+	clearCursor(&page->next);
+}
+
+/// <summary>
+/// Moves the cursor of the next page out of a page, the cursor it replaces is cleared
+/// </summary>
+/// <param name="page">A pointer to the page</param>
+/// <param name="cursor">Where to store the cursor, it must be cleared with clearCursor</param>
+void takeNextCursor(Page* page, PageCursor* cursor)
+{
+	clearCursor(cursor);
+	*cursor = page->next;
+
+	page->next.valid = 0;
+	page->next.name = NULL;
+}
+
+/// <summary>
+/// Frees the name of a cursor and makes it point to the first page
+/// </summary>
+/// <param name="cursor">A pointer to the cursor</param>
+void clearCursor(PageCursor* cursor)
+{
+	free(cursor->name);
+	cursor->name = NULL;
+	cursor->valid = 0;
+}
+
+/// <summary>
+/// Writes a cursor as a token without spaces: quantity/YYYY-MM-DD/category/name
+/// </summary>
+/// <param name="cursor">A pointer to the cursor</param>
+/// <param name="text">Where to write the token</param>
+/// <param name="size">The size of the text, PAGE_CURSOR_SIZE more than the length of the name is always enough</param>
+/// <returns>1 if the token was written,
+///			 0 if the cursor is not valid or the text is too small</returns>
+int formatCursor(PageCursor* cursor, char* text, size_t size)
+{
+	char quantity[32];
+	if (cursor->valid == 0) return 0;
+
+	// The fixed point quantity is written in full, so it comes back exactly
+	formatQuantity(cursor->units, quantity, sizeof(quantity));
+	int length = snprintf(text, size, "%s/%04d-%02d-%02d/%s/%s", quantity, cursor->expiration.year,
+		cursor->expiration.month, cursor->expiration.day, category_name[cursor->category], cursor->name);
+
+	return length > 0 && (size_t)length < size;
+}
+
+/// <summary>
+/// Reads a token written by formatCursor
+/// </summary>
+/// <param name="text">The token</param>
+/// <param name="cursor">Where to store the cursor, the cursor it held is cleared. It must be cleared with clearCursor</param>
+/// <returns>1 if the token is valid,
+///			 0 if it is not valid or there is not enough memory</returns>
+int parseCursor(const char* text, PageCursor* cursor)
+{
+	char part[PAGE_CURSOR_SIZE];
+
+	clearCursor(cursor);
+
+	// The quantity, the date and the category never contain a slash, the name might
+	for (int field = 0; field < 3; field++)
+	{
+		const char* slash = strchr(text, '/');
+		if (slash == NULL || slash - text >= (ptrdiff_t)sizeof(part)) return 0;
+
+		memcpy(part, text, slash - text);
+		part[slash - text] = '\0';
+		if (field == 0 && parseFixedQuantity(part, &cursor->units) == 0) return 0;
+		if (field == 1 && parseDate(part, &cursor->expiration) == 0) return 0;
+		if (field == 2 && strcmp(part, category_name[none]) == 0) cursor->category = none;
+		else if (field == 2 && parseCategory(part, &cursor->category) == 0) return 0;
+
+		text = slash + 1;
+	}
+
+	if (*text == '\0') return 0;
+
+	cursor->name = malloc(strlen(text) + 1);
+	if (cursor->name == NULL) return 0;
+	strcpy(cursor->name, text);
+
+	cursor->valid = 1;
+	return 1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+
+#include "ProductRepository.h"
+
+#define PAGE_DEFAULT_SIZE 10
+#define PAGE_CURSOR_SIZE 64 // Room for a token besides the name
+
+typedef enum { orderByQuantity = 1, orderByName, orderByExpiration } PageOrder;
+
+// The position right after the last row of a page. Rows are ordered by the key of the
+// order, then by name and category, so every product has its own position and the next
+// page continues there even if products were added or removed in between. The cursor
+// owns a copy of the whole name, a cut name would sort before the product it stands for.
+typedef struct
+{
+	int valid; // 0 for the first page, or after the last page
+	Quantity units; // The exact quantity
+	Date expiration;
+	Category category;
+	char* name; // NULL if the cursor is not valid
+} PageCursor;
+
+typedef struct
+{
+	ProductRepo* rows; // Copies of the products, in order
+	PageCursor next; // Where the next page starts
+} Page;
+
+int pageByString(ProductRepo* repo, char* name, StringMatch match, PageOrder order, int count, PageCursor* after, Page* page);
+int pageByCategoryAndExpiration(ProductRepo* repo, Category category, int expiration, Date today, PageOrder order, int count, PageCursor* after, Page* page);
+void destroyPage(Page* page);
+void takeNextCursor(Page* page, PageCursor* cursor);
+void clearCursor(PageCursor* cursor);
+
+int formatCursor(PageCursor* cursor, char* text, size_t size);
+int parseCursor(const char* text, PageCursor* cursor);
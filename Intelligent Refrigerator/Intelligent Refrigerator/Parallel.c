@@ -0,0 +1,296 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "Parallel.h"
+
+typedef struct FilterQuery
+{
+	int (*match)(Product* p, struct FilterQuery* query);
+	char* name;
+	StringMatch mode;
+	Category category;
+	int expiration;
+	time_t now;
+	time_t today; // Midnight of the current day, the way the sequential filter converts dates
+	int todayDays;
+} FilterQuery;
+
+typedef struct
+{
+	ProductRepo* source;
+	FilterQuery* query;
+	int start;
+	int end;
+	Product** matches; // Products of the source that matched
+	int count;
+	Product** copies; // Shared output array
+	int offset; // Where the chunk's copies start in the output array
+} FilterChunk;
+
+typedef struct
+{
+	ThreadPool* pool;
+	Product** items;
+	Product** buffer;
+	int count;
+	ProductComparator compare;
+	int descending;
+} SortRange;
+
+/// <summary>
+/// Checks if the name of a product matches the query string
+/// </summary>
+/// <param name="p">A pointer to the product</param>
+/// <param name="query">A pointer to the query</param>
+/// <returns>1 if the product matches,
+///			 0, otherwise</returns>
+static int matchString(Product* p, FilterQuery* query)
+{
+	return matchName(p, query->name, query->mode);
+}
+
+/// <summary>
+/// Checks if a product has the query category and expires within the query days
+/// </summary>
+/// <param name="p">A pointer to the product</param>
+/// <param name="query">A pointer to the query</param>
+/// <returns>1 if the product matches,
+///			 0, otherwise</returns>
+static int matchExpiration(Product* p, FilterQuery* query)
+{
+	// Day arithmetic instead of mktime, which takes a process wide lock
+	time_t productTime = query->today + (time_t)(daysFromCivil(p->expiration) - query->todayDays) * 86400;
+	double difference = round(difftime(productTime, query->now) / 86400);
+
+	return difference <= query->expiration && (query->category == none || p->category == query->category);
+}
+
+/// <summary>
+/// Collects the products of a chunk that match the query
+/// </summary>
+/// <param name="arg">A pointer to the chunk</param>
+static void scanChunk(void* arg)
+{
+	FilterChunk* chunk = arg;
+
+	while (chunk->matches == NULL) chunk->matches = malloc((chunk->end - chunk->start) * sizeof(Product*));
+
+	for (int i = chunk->start; i < chunk->end; i++)
+	{
+		Product* current = getProductAt(chunk->source, i);
+		if (chunk->query->match(current, chunk->query)) chunk->matches[chunk->count++] = current;
+	}
+}
+
+/// <summary>
+/// Copies the matches of a chunk to its place in the output array
+/// </summary>
+/// <param name="arg">A pointer to the chunk</param>
+static void copyChunk(void* arg)
+{
+	FilterChunk* chunk = arg;
+
+	for (int i = 0; i < chunk->count; i++)
+	{
+		Product* current = chunk->matches[i];
+		chunk->copies[chunk->offset + i] = createProductUnits(current->name, current->category, current->units, current->expiration);
+	}
+}
+
+/// <summary>
+/// Filters a repository in chunks on the pool, keeping the order of the products
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+/// <param name="repo">A pointer to the repository, it is only read</param>
+/// <param name="query">A pointer to the query</param>
+/// <returns>A pointer to a new repository that contains the filtered products</returns>
+static ProductRepo* parallelFilter(ThreadPool* pool, ProductRepo* repo, FilterQuery* query)
+{
+	int chunkCount = pool->threadCount * PARALLEL_CHUNKS_PER_THREAD;
+	int chunkSize = (repo->length + chunkCount - 1) / chunkCount;
+	if (chunkSize < PARALLEL_MIN_CHUNK) chunkSize = PARALLEL_MIN_CHUNK;
+	chunkCount = (repo->length + chunkSize - 1) / chunkSize;
+
+	FilterChunk* chunks = NULL;
+	while (chunks == NULL) chunks = calloc(chunkCount + 1, sizeof(FilterChunk));
+
+	for (int i = 0; i < chunkCount; i++)
+	{
+		chunks[i].source = repo;
+		chunks[i].query = query;
+		chunks[i].start = i * chunkSize;
+		chunks[i].end = i == chunkCount - 1 ? repo->length : (i + 1) * chunkSize;
+	}
+	parallelFor(pool, scanChunk, chunks, sizeof(FilterChunk), chunkCount);
+
+	// The prefix sum of the chunk counts places every chunk in the output
+	int total = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		chunks[i].offset = total;
+		total += chunks[i].count;
+	}
+
+	Product** copies = NULL;
+	while (copies == NULL) copies = malloc((total + 1) * sizeof(Product*));
+	for (int i = 0; i < chunkCount; i++)
+		chunks[i].copies = copies;
+	parallelFor(pool, copyChunk, chunks, sizeof(FilterChunk), chunkCount);
+
+	// The products of the source are unique, only the index is built here
+	ProductRepo* newRepo = createRepo();
+	reserveRepo(newRepo, total);
+	for (int i = 0; i < total; i++)
+	{
+		if (copies[i] == NULL) continue;
+		if (appendProductRepo(newRepo, copies[i]) == 0) destroyProduct(copies[i]);
+	}
+
+	for (int i = 0; i < chunkCount; i++)
+		free(chunks[i].matches);
+	free(chunks);
+	free(copies);
+
+	return newRepo;
+}
+
+/// <summary>
+/// Filters products by a given string on the pool
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+/// <param name="repo">A pointer to the repository, it is only read</param>
+/// <param name="name">The string to match, already folded if the match ignores case</param>
+/// <param name="match">How the names are compared to the string</param>
+/// <returns>A pointer to a new repository that contains the filtered products</returns>
+ProductRepo* parallelFilterByString(ThreadPool* pool, ProductRepo* repo, char* name, StringMatch match)
+{
+	FilterQuery query = { 0 };
+	query.match = matchString;
+	query.name = name;
+	query.mode = match;
+
+	return parallelFilter(pool, repo, &query);
+}
+
+/// <summary>
+/// Filters products by category and expiration date on the pool
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+/// <param name="repo">A pointer to the repository, it is only read</param>
+/// <param name="category">The category of the products</param>
+/// <param name="expiration">The amount of days until products expire</param>
+/// <returns>A pointer to a new repository that contains the filtered products</returns>
+ProductRepo* parallelFilterByCategoryAndExpiration(ThreadPool* pool, ProductRepo* repo, Category category, int expiration)
+{
+	FilterQuery query = { 0 };
+	query.match = matchExpiration;
+	query.category = category;
+	query.expiration = expiration;
+	query.now = time(NULL);
+
+	// Queries can run on several threads at once, so the reentrant localtime is used
+	struct tm local;
+#ifdef _WIN32
+	localtime_s(&local, &query.now);
+#else
+	localtime_r(&query.now, &local);
+#endif
+
+	struct tm midnight = { 0 };
+	midnight.tm_year = local.tm_year;
+	midnight.tm_mon = local.tm_mon;
+	midnight.tm_mday = local.tm_mday;
+	query.todayDays = daysFromCivil(date(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday));
+	query.today = mktime(&midnight);
+
+	return parallelFilter(pool, repo, &query);
+}
+
+/// <summary>
+/// Checks if two products are in order, equal products are, so the sort is stable
+/// </summary>
+/// <param name="range">A pointer to the sorted range</param>
+/// <param name="first">A pointer to the product that comes first</param>
+/// <param name="second">A pointer to the product that comes second</param>
+/// <returns>1 if the products are in order,
+///			 0, otherwise</returns>
+static int inOrder(SortRange* range, Product* first, Product* second)
+{
+	int result = range->compare(first, second);
+	return range->descending == 1 ? result >= 0 : result <= 0;
+}
+
+/// <summary>
+/// Sorts a range with merge sort, halves above the cutoff are sorted in parallel
+/// </summary>
+/// <param name="arg">A pointer to the range</param>
+static void sortRange(void* arg)
+{
+	SortRange* range = arg;
+	if (range->count < 2) return;
+
+	int half = range->count / 2;
+	SortRange left = *range;
+	SortRange right = *range;
+	left.count = half;
+	right.items += half;
+	right.buffer += half;
+	right.count = range->count - half;
+
+	if (range->count > PARALLEL_SORT_CUTOFF && range->pool != NULL)
+	{
+		atomic_int pending;
+		atomic_init(&pending, 1);
+
+		submitTask(range->pool, sortRange, &right, &pending);
+		sortRange(&left);
+		waitTasks(range->pool, &pending);
+	}
+	else
+	{
+		sortRange(&left);
+		sortRange(&right);
+	}
+
+	Product** items = range->items;
+	if (inOrder(range, items[half - 1], items[half])) return;
+
+	int i = 0;
+	int j = half;
+	int k = 0;
+	while (i < half && j < range->count)
+		range->buffer[k++] = inOrder(range, items[i], items[j]) ? items[i++] : items[j++];
+	while (i < half) range->buffer[k++] = items[i++];
+	while (j < range->count) range->buffer[k++] = items[j++];
+
+	memcpy(items, range->buffer, range->count * sizeof(Product*));
+}
+
+/// <summary>
+/// Sorts a repository with a stable parallel merge sort
+/// </summary>
+/// <param name="pool">A pointer to the pool, NULL to sort on the calling thread</param>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="compare">The function that compares two products</param>
+/// <param name="descending">1 if the sort should be descending, otherwise ascending</param>
+void parallelSort(ThreadPool* pool, ProductRepo* repo, ProductComparator compare, int descending)
+{
+	SortRange range;
+	range.pool = pool;
+	range.items = repo->products;
+	range.buffer = NULL;
+	range.count = repo->length;
+	range.compare = compare;
+	range.descending = descending;
+
+	while (range.buffer == NULL) range.buffer = malloc((repo->length + 1) * sizeof(Product*));
+	sortRange(&range);
+
+	free(range.buffer);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "ProductRepository.h"
+#include "ThreadPool.h"
+
+#define PARALLEL_MIN_CHUNK 1024
+#define PARALLEL_CHUNKS_PER_THREAD 4
+#define PARALLEL_SORT_CUTOFF 2048
+
+ProductRepo* parallelFilterByString(ThreadPool* pool, ProductRepo* repo, char* name, StringMatch match);
+ProductRepo* parallelFilterByCategoryAndExpiration(ThreadPool* pool, ProductRepo* repo, Category category, int expiration);
+void parallelSort(ThreadPool* pool, ProductRepo* repo, ProductComparator compare, int descending);
@@ -1,6 +1,14 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
+#include <limits.h>
 
 #include "Product.h"
 
@@ -17,6 +25,291 @@ Date date(int year, int month, int day)
 	return date;
 }
 
+/// <summary>
+/// Gets the local date of today
+/// </summary>
+/// <returns>The current date</returns>
+Date currentDate()
+{
+	time_t now = time(NULL);
+	struct tm local;
+#ifdef _WIN32
+	localtime_s(&local, &now);
+#else
+	localtime_r(&now, &local);
+#endif
+
+	return date(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+}
+
+/// <summary>
+/// Checks if a date exists and is in the range accepted by the fridge
+/// </summary>
+/// <param name="date">The date to check</param>
+/// <returns>1 if the date is valid,
+///			 0, otherwise</returns>
+int isValidDate(Date date)
+{
+	int monthDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	if (date.year < 2000 || date.year > 2100) return 0;
+	if (date.month < 1 || date.month > 12) return 0;
+	if (((date.year % 4 == 0) && (date.year % 100 != 0)) || (date.year % 400 == 0))
+		monthDays[1] = 29; // Leap year
+
+	return date.day >= 1 && date.day <= monthDays[date.month - 1];
+}
+
+/// <summary>
+/// Counts the days from 1970-01-01 to a date of the proleptic Gregorian calendar
+/// </summary>
+/// <param name="date">The date</param>
+/// <returns>The number of days, negative for earlier dates</returns>
+int daysFromCivil(Date date)
+{
+	int year = date.month <= 2 ? date.year - 1 : date.year;
+	int era = (year >= 0 ? year : year - 399) / 400;
+	int yearOfEra = year - era * 400;
+	int dayOfYear = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+	int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+	return era * 146097 + dayOfEra - 719468;
+}
+
+/// <summary>
+/// Gets the date a number of days after 1970-01-01, the inverse of daysFromCivil
+/// </summary>
+/// <param name="days">The number of days, negative for earlier dates</param>
+/// <returns>The date</returns>
+Date civilFromDays(int days)
+{
+	days += 719468;
+	int era = (days >= 0 ? days : days - 146096) / 146097;
+	int dayOfEra = days - era * 146097;
+	int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	int monthIndex = (5 * dayOfYear + 2) / 153;
+	int month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+
+	return date(yearOfEra + era * 400 + (month <= 2), month, dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+}
+
+/// <summary>
+/// Converts a quantity to fixed point, rounding half away from zero
+/// </summary>
+/// <param name="value">The quantity</param>
+/// <returns>The quantity in units of 1 / QUANTITY_SCALE, clamped to the range of Quantity</returns>
+Quantity toQuantity(double value)
+{
+	double scaled = value * QUANTITY_SCALE;
+
+	if (scaled != scaled) return 0;
+	if (scaled >= 9.2e18) return LLONG_MAX;
+	if (scaled <= -9.2e18) return -LLONG_MAX;
+	return llround(scaled);
+}
+
+/// <summary>
+/// Converts a fixed point quantity back to a double
+/// </summary>
+/// <param name="units">The quantity in units of 1 / QUANTITY_SCALE</param>
+/// <returns>The nearest double, the same one strtod gives for the decimal text of the quantity</returns>
+double fromQuantity(Quantity units)
+{
+	// Both operands are exact below 2^53, so the single rounding of the division is the only one
+	return (double)units / QUANTITY_SCALE;
+}
+
+/// <summary>
+/// Adds two fixed point quantities, a sum out of range is clamped like toQuantity clamps
+/// </summary>
+/// <param name="first">The first quantity, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="second">The second quantity, in units of 1 / QUANTITY_SCALE</param>
+/// <returns>The sum, clamped to the range of Quantity</returns>
+Quantity addQuantity(Quantity first, Quantity second)
+{
+	if (second > 0 && first > LLONG_MAX - second) return LLONG_MAX;
+	if (second < 0 && first < -LLONG_MAX - second) return -LLONG_MAX;
+	return first + second;
+}
+
+/// <summary>
+/// Parses a category name
+/// </summary>
+/// <param name="text">The name of the category</param>
+/// <param name="category">Where to store the category</param>
+/// <returns>1 if the category exists,
+///			 0, otherwise</returns>
+int parseCategory(const char* text, Category* category)
+{
+	for (int i = CATEGORY_START; i <= CATEGORY_END; i++)
+	{
+		if (strcmp(text, category_name[i]) == 0)
+		{
+			*category = i;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Parses a quantity, the whole text must be a number
+/// </summary>
+/// <param name="text">The text to parse</param>
+/// <param name="quantity">Where to store the quantity</param>
+/// <returns>1 if the text is a valid quantity,
+///			 0, otherwise</returns>
+int parseQuantity(const char* text, double* quantity)
+{
+	char* end;
+
+	if (*text == '\0') return 0;
+	*quantity = strtod(text, &end);
+
+	return *end == '\0';
+}
+
+/// <summary>
+/// Parses a quantity straight to fixed point, without going through a double. It accepts
+/// the decimal numbers parseQuantity does, with an optional exponent, and rounds the digits
+/// past QUANTITY_DECIMALS half away from zero like toQuantity.
+/// </summary>
+/// <param name="text">The text to parse</param>
+/// <param name="units">Where to store the quantity, in units of 1 / QUANTITY_SCALE</param>
+/// <returns>1 if the text is a valid quantity that fits in a Quantity,
+///			 0, otherwise</returns>
+int parseFixedQuantity(const char* text, Quantity* units)
+{
+	const char* cursor = text;
+	int negative = 0;
+	if (*cursor == '+' || *cursor == '-') negative = *cursor++ == '-';
+
+	const char* digits = cursor;
+	int integerDigits = 0;
+	int fractionDigits = 0;
+	while (isdigit((unsigned char)*cursor)) cursor++, integerDigits++;
+	if (*cursor == '.')
+	{
+		cursor++;
+		while (isdigit((unsigned char)*cursor)) cursor++, fractionDigits++;
+	}
+	if (integerDigits + fractionDigits == 0) return 0;
+	const char* digitsEnd = cursor;
+
+	int exponent = 0;
+	if (*cursor == 'e' || *cursor == 'E')
+	{
+		int exponentNegative = 0;
+		cursor++;
+		if (*cursor == '+' || *cursor == '-') exponentNegative = *cursor++ == '-';
+		if (!isdigit((unsigned char)*cursor)) return 0;
+
+		// Larger exponents overflow or round to zero anyway
+		for (; isdigit((unsigned char)*cursor); cursor++)
+			if (exponent < 1000) exponent = exponent * 10 + (*cursor - '0');
+		if (exponentNegative) exponent = -exponent;
+	}
+	if (*cursor != '\0') return 0;
+
+	// The first "whole" digits count in units, the one after them only rounds
+	int whole = integerDigits + exponent + QUANTITY_DECIMALS;
+	Quantity result = 0;
+	int index = 0;
+	int roundUp = 0;
+
+	for (const char* c = digits; c < digitsEnd; c++)
+	{
+		if (*c == '.') continue;
+
+		if (index < whole)
+		{
+			if (result > (LLONG_MAX - (*c - '0')) / 10) return 0;
+			result = result * 10 + (*c - '0');
+		}
+		else if (index == whole)
+		{
+			roundUp = *c >= '5';
+		}
+		index++;
+	}
+
+	for (; index < whole && result != 0; index++)
+	{
+		if (result > LLONG_MAX / 10) return 0;
+		result *= 10;
+	}
+
+	if (roundUp)
+	{
+		if (result == LLONG_MAX) return 0;
+		result++;
+	}
+
+	*units = negative ? -result : result;
+	return 1;
+}
+
+/// <summary>
+/// Writes a fixed point quantity as a decimal number, without trailing zeros
+/// </summary>
+/// <param name="units">The quantity in units of 1 / QUANTITY_SCALE</param>
+/// <param name="text">Where to write the number</param>
+/// <param name="size">The size of the text</param>
+/// <returns>1 if the number fits in the text,
+///			 0, otherwise</returns>
+int formatQuantity(Quantity units, char* text, size_t size)
+{
+	// Both parts are taken apart with the sign, so no negation can overflow
+	unsigned long long magnitude = units < 0 ? 0ULL - (unsigned long long)units : (unsigned long long)units;
+	unsigned long long integer = magnitude / QUANTITY_SCALE;
+	unsigned long long fraction = magnitude % QUANTITY_SCALE;
+
+	int length = snprintf(text, size, "%s%llu", units < 0 ? "-" : "", integer);
+	if (length < 0 || (size_t)length >= size) return 0;
+	if (fraction == 0) return 1;
+
+	int fractionLength = snprintf(text + length, size - length, ".%0*llu", QUANTITY_DECIMALS, fraction);
+	if (fractionLength < 0 || (size_t)(length + fractionLength) >= size) return 0;
+
+	length += fractionLength;
+	while (text[length - 1] == '0') text[--length] = '\0';
+	return 1;
+}
+
+/// <summary>
+/// Parses a date written as YYYY-MM-DD or YYYY/MM/DD
+/// </summary>
+/// <param name="text">The text to parse</param>
+/// <param name="expiration">Where to store the date</param>
+/// <returns>1 if the text is a valid date,
+///			 0, otherwise</returns>
+int parseDate(const char* text, Date* expiration)
+{
+	const char* digits = "dddd-dd-dd";
+	int values[3] = { 0 };
+	int part = 0;
+
+	for (int i = 0; digits[i] != '\0'; i++)
+	{
+		if (digits[i] == 'd')
+		{
+			if (text[i] < '0' || text[i] > '9') return 0;
+			values[part] = values[part] * 10 + (text[i] - '0');
+		}
+		else
+		{
+			if (text[i] != '-' && text[i] != '/') return 0;
+			part++;
+		}
+	}
+	if (text[10] != '\0') return 0;
+
+	*expiration = date(values[0], values[1], values[2]);
+	return isValidDate(*expiration);
+}
+
 /// <summary>
 /// Creates a new product
 /// </summary>
@@ -26,21 +319,41 @@ Date date(int year, int month, int day)
 /// <param name="expiration">The expiration date of the product</param>
 /// <returns></returns>
 Product* createProduct(char* name, Category category, double quantity, Date expiration)
+{
+	return createProductUnits(name, category, toQuantity(quantity), expiration);
+}
+
+/// <summary>
+/// Creates a new product from an exact quantity, copies and stored products are made this way
+/// </summary>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="units">The quantity of the product, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>A pointer to the product,
+///			 NULL if there is not enough memory</returns>
+Product* createProductUnits(char* name, Category category, Quantity units, Date expiration)
 {
 	Product* p = malloc(sizeof(Product));
 	if (p == NULL) return NULL;
 
-	p->name = malloc(sizeof(char) * (strlen(name) + 1));
+	// The folded name follows the name in the same allocation
+	size_t length = strlen(name);
+	p->name = malloc(sizeof(char) * 2 * (length + 1));
 	if (p->name == NULL)
 	{
 		free(p);
 		return NULL;
 	}
 	strcpy(p->name, name);
+	p->folded = p->name + length + 1;
+	foldName(name, p->folded);
 
 	p->expiration = expiration;
 	p->category = category;
-	p->quantity = quantity;
+	setQuantity(p, units);
+	p->heapPosition[0] = -1;
+	p->heapPosition[1] = -1;
 
 	return p;
 }
@@ -59,6 +372,34 @@ void destroyProduct(Product* p)
 	p = NULL;
 }
 
+/// <summary>
+/// Normalizes a name for searches that ignore case
+/// </summary>
+/// <param name="name">The name</param>
+/// <param name="folded">Where to write the name in lower case, it can be the name itself</param>
+void foldName(const char* name, char* folded)
+{
+	for (; *name != '\0'; name++, folded++)
+		*folded = (char)tolower((unsigned char)*name);
+	*folded = '\0';
+}
+
+/// <summary>
+/// Checks if the name of a product matches a text
+/// </summary>
+/// <param name="p">A pointer to the product</param>
+/// <param name="text">The text, already folded with foldName if the match ignores case</param>
+/// <param name="match">How the name is compared to the text</param>
+/// <returns>1 if the name matches,
+///			 0, otherwise</returns>
+int matchName(Product* p, const char* text, StringMatch match)
+{
+	// Only the text is folded per query, the names were folded when the products were created
+	if (match == matchEqualIgnoreCase) return strcmp(p->folded, text) == 0;
+	if (text[0] == '\0') return 1;
+	return strstr(match == matchIgnoreCase ? p->folded : p->name, text) != NULL;
+}
+
 /// <summary>
 /// Gets the name of the product
 /// </summary>
@@ -95,6 +436,17 @@ double getQuantity(Product* p)
 	return p->quantity;
 }
 
+/// <summary>
+/// Sets the quantity of the product, the double is derived from the exact quantity
+/// </summary>
+/// <param name="p">A pointer to the product</param>
+/// <param name="units">The quantity in units of 1 / QUANTITY_SCALE</param>
+void setQuantity(Product* p, Quantity units)
+{
+	p->units = units;
+	p->quantity = fromQuantity(units);
+}
+
 /// <summary>
 /// Gets the expiration date
 /// </summary>
@@ -112,9 +464,9 @@ Date getExpiration(Product* p)
 /// The string representation of the product
 /// </summary>
 /// <param name="p">A pointer to the product</param>
-/// <param name="str">The string to print to</param>
+/// <param name="str">The string to print to, of at least PRODUCT_STRING_SIZE characters</param>
 void toString(Product* p, char str[])
 {
 	if (p == NULL) return;
-	sprintf(str, "Product %s is part of the \"%s\" category, there is %g of it in the fridge, and it expires on %d/%02d/%02d.", p->name, category_name[p->category], p->quantity, p->expiration.year, p->expiration.month, p->expiration.day);
+	snprintf(str, PRODUCT_STRING_SIZE, "Product %s is part of the \"%s\" category, there is %g of it in the fridge, and it expires on %d/%02d/%02d.", p->name, category_name[p->category], p->quantity, p->expiration.year, p->expiration.month, p->expiration.day);
 }
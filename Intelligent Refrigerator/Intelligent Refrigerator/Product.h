@@ -1,5 +1,39 @@
 #pragma once
 
+#include <stddef.h>
+
+#define PRODUCT_STRING_SIZE 256
+
+// Quantities are also kept in fixed point, as whole multiples of 1 / QUANTITY_SCALE, so that
+// merging and summing them is exact. The decimals are configurable, the scale follows them.
+#ifndef QUANTITY_DECIMALS
+#define QUANTITY_DECIMALS 6
+#endif
+
+#if QUANTITY_DECIMALS == 0
+#define QUANTITY_SCALE 1LL
+#elif QUANTITY_DECIMALS == 1
+#define QUANTITY_SCALE 10LL
+#elif QUANTITY_DECIMALS == 2
+#define QUANTITY_SCALE 100LL
+#elif QUANTITY_DECIMALS == 3
+#define QUANTITY_SCALE 1000LL
+#elif QUANTITY_DECIMALS == 4
+#define QUANTITY_SCALE 10000LL
+#elif QUANTITY_DECIMALS == 5
+#define QUANTITY_SCALE 100000LL
+#elif QUANTITY_DECIMALS == 6
+#define QUANTITY_SCALE 1000000LL
+#elif QUANTITY_DECIMALS == 7
+#define QUANTITY_SCALE 10000000LL
+#elif QUANTITY_DECIMALS == 8
+#define QUANTITY_SCALE 100000000LL
+#elif QUANTITY_DECIMALS == 9
+#define QUANTITY_SCALE 1000000000LL
+#else
+#error QUANTITY_DECIMALS must be between 0 and 9
+#endif
+
 typedef enum { none, dairy, sweets, meat, fruit } Category;
 #define CATEGORY_START dairy
 #define CATEGORY_END fruit
@@ -20,6 +54,23 @@ typedef struct
 	int day;
 } Date;
 Date date(int year, int month, int day);
+Date currentDate();
+int isValidDate(Date date);
+int daysFromCivil(Date date);
+Date civilFromDays(int days);
+
+typedef long long Quantity;
+Quantity toQuantity(double value);
+double fromQuantity(Quantity units);
+Quantity addQuantity(Quantity first, Quantity second);
+
+int parseCategory(const char* text, Category* category);
+int parseQuantity(const char* text, double* quantity);
+int parseFixedQuantity(const char* text, Quantity* units);
+int formatQuantity(Quantity units, char* text, size_t size);
+int parseDate(const char* text, Date* expiration);
+
+typedef enum { matchSubstring, matchIgnoreCase, matchEqualIgnoreCase } StringMatch;
 
 typedef struct
 {
@@ -27,14 +78,22 @@ typedef struct
 	Category category;
 	double quantity;
 	Date expiration;
+
+	int heapPosition[2]; // Positions in the expiration heaps of the repository that owns the product
+	char* folded; // The name in lower case, it shares the allocation of the name
+	Quantity units; // The exact quantity, the quantity above is its nearest double
 } Product;
 
 Product* createProduct(char* name, Category category, double quantity, Date expiration);
+Product* createProductUnits(char* name, Category category, Quantity units, Date expiration);
 void destroyProduct(Product* p);
 
 char* getName(Product* p);
+void foldName(const char* name, char* folded);
+int matchName(Product* p, const char* text, StringMatch match);
 Category getCategory(Product* p);
 double getQuantity(Product* p);
+void setQuantity(Product* p, Quantity units);
 Date getExpiration(Product* p);
 
 void toString(Product* p, char str[]);
@@ -2,6 +2,246 @@
 #include <string.h>
 
 #include "ProductRepository.h"
+#include "Parallel.h"
+
+/// <summary>
+/// Hashes the name and category of a product
+/// </summary>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The FNV-1a hash of the key</returns>
+unsigned int hashProductKey(const char* name, Category category)
+{
+	unsigned int hash = 2166136261u;
+
+	for (; *name != '\0'; name++)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	hash ^= (unsigned int)category;
+	hash *= 16777619u;
+
+	return hash;
+}
+
+/// <summary>
+/// Finds the index slot of a key
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The slot that holds the key, or the empty slot where it belongs</returns>
+static int findSlot(ProductRepo* repo, const char* name, Category category)
+{
+	unsigned int mask = (unsigned int)repo->tableCapacity - 1;
+	unsigned int slot = hashProductKey(name, category) & mask;
+
+	while (repo->table[slot] != NULL)
+	{
+		Product* current = repo->table[slot];
+		if (current->category == category && strcmp(current->name, name) == 0)
+			break;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return (int)slot;
+}
+
+/// <summary>
+/// Rebuilds the index with room for at least the given number of products
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="count">The number of products the index must hold</param>
+/// <returns>1 if the index is large enough,
+///			 0, otherwise</returns>
+static int growTable(ProductRepo* repo, int count)
+{
+	int tableCapacity = repo->tableCapacity;
+	while (count * 2 > tableCapacity) tableCapacity *= REPOSITORY_SIZE_SCALE;
+	if (tableCapacity == repo->tableCapacity) return 1;
+
+	Product** table = calloc(tableCapacity, sizeof(Product*));
+	if (table == NULL) return 0;
+
+	free(repo->table);
+	repo->table = table;
+	repo->tableCapacity = tableCapacity;
+
+	for (int i = 0; i < repo->length; i++)
+		repo->table[findSlot(repo, repo->products[i]->name, repo->products[i]->category)] = repo->products[i];
+
+	return 1;
+}
+
+/// <summary>
+/// Gets the index size a repository starts out with for the given number of products
+/// </summary>
+/// <param name="count">The number of products</param>
+/// <returns>The number of slots</returns>
+int getIndexCapacity(int count)
+{
+	int tableCapacity = REPOSITORY_INITIAL_SIZE * REPOSITORY_SIZE_SCALE;
+	while (count * 2 > tableCapacity) tableCapacity *= REPOSITORY_SIZE_SCALE;
+
+	return tableCapacity;
+}
+
+/// <summary>
+/// Removes a key from the index and moves the following entries back into place
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="slot">The slot of the key</param>
+static void eraseSlot(ProductRepo* repo, int slot)
+{
+	unsigned int mask = (unsigned int)repo->tableCapacity - 1;
+	unsigned int next = ((unsigned int)slot + 1) & mask;
+
+	repo->table[slot] = NULL;
+	while (repo->table[next] != NULL)
+	{
+		Product* current = repo->table[next];
+		repo->table[next] = NULL;
+		repo->table[findSlot(repo, current->name, current->category)] = current;
+
+		next = (next + 1) & mask;
+	}
+}
+
+/// <summary>
+/// Adds to the total of a category in two's complement, so a total that went out of range
+/// is exact again once enough is taken out, and no addition overflows
+/// </summary>
+/// <param name="total">The total, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="units">The quantity to add, negative to take it out</param>
+/// <returns>The new total</returns>
+static Quantity addToTotal(Quantity total, Quantity units)
+{
+	return (Quantity)((unsigned long long)total + (unsigned long long)units);
+}
+
+/// <summary>
+/// Checks if a product belongs above another one in an expiration heap
+/// </summary>
+/// <param name="heap">The heap</param>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>1 if the first product belongs above the second,
+///			 0, otherwise</returns>
+static int heapBefore(ExpirationHeap heap, Product* first, Product* second)
+{
+	int result = compareByExpiration(first, second);
+	return heap == heapEarliest ? result < 0 : result > 0;
+}
+
+/// <summary>
+/// Places a product of an expiration heap at a position
+/// </summary>
+/// <param name="aggregate">A pointer to the aggregate of the category</param>
+/// <param name="heap">The heap</param>
+/// <param name="position">The position</param>
+/// <param name="p">A pointer to the product</param>
+static void setHeapProduct(CategoryAggregate* aggregate, ExpirationHeap heap, int position, Product* p)
+{
+	aggregate->heaps[heap][position] = p;
+	p->heapPosition[heap] = position;
+}
+
+/// <summary>
+/// Moves a product of an expiration heap to its place
+/// </summary>
+/// <param name="aggregate">A pointer to the aggregate of the category</param>
+/// <param name="heap">The heap</param>
+/// <param name="position">The position of the product</param>
+static void fixHeap(CategoryAggregate* aggregate, ExpirationHeap heap, int position)
+{
+	Product** items = aggregate->heaps[heap];
+	Product* p = items[position];
+
+	while (position > 0 && heapBefore(heap, p, items[(position - 1) / 2]))
+	{
+		setHeapProduct(aggregate, heap, position, items[(position - 1) / 2]);
+		position = (position - 1) / 2;
+	}
+
+	while (1)
+	{
+		int child = 2 * position + 1;
+		if (child >= aggregate->count) break;
+		if (child + 1 < aggregate->count && heapBefore(heap, items[child + 1], items[child])) child++;
+		if (heapBefore(heap, items[child], p) == 0) break;
+
+		setHeapProduct(aggregate, heap, position, items[child]);
+		position = child;
+	}
+
+	setHeapProduct(aggregate, heap, position, p);
+}
+
+/// <summary>
+/// Counts a product that was added to the repository in the aggregate of its category
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product was counted,
+///			 0 if there is not enough memory</returns>
+static int aggregateProduct(ProductRepo* repo, Product* p)
+{
+	CategoryAggregate* aggregate = &repo->aggregates[p->category];
+
+	if (aggregate->count == aggregate->heapCapacity)
+	{
+		int capacity = aggregate->heapCapacity == 0 ? REPOSITORY_INITIAL_SIZE : aggregate->heapCapacity * REPOSITORY_SIZE_SCALE;
+
+		for (int heap = heapEarliest; heap <= heapLatest; heap++)
+		{
+			Product** tmp = realloc(aggregate->heaps[heap], capacity * sizeof(Product*));
+			if (tmp == NULL) return 0;
+			aggregate->heaps[heap] = tmp;
+		}
+		aggregate->heapCapacity = capacity;
+	}
+
+	int position = aggregate->count++;
+	aggregate->empty += p->units <= 0;
+	aggregate->units = addToTotal(aggregate->units, p->units);
+	for (int heap = heapEarliest; heap <= heapLatest; heap++)
+	{
+		setHeapProduct(aggregate, heap, position, p);
+		fixHeap(aggregate, heap, position);
+	}
+
+	return 1;
+}
+
+/// <summary>
+/// Takes a product that is removed from the repository out of the aggregate of its category
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="p">A pointer to the product</param>
+static void unaggregateProduct(ProductRepo* repo, Product* p)
+{
+	CategoryAggregate* aggregate = &repo->aggregates[p->category];
+
+	aggregate->count--;
+	for (int heap = heapEarliest; heap <= heapLatest; heap++)
+	{
+		// The last product of the heap takes the place of the removed one
+		int position = p->heapPosition[heap];
+		Product* moved = aggregate->heaps[heap][aggregate->count];
+
+		if (moved != p)
+		{
+			setHeapProduct(aggregate, heap, position, moved);
+			fixHeap(aggregate, heap, position);
+		}
+		p->heapPosition[heap] = -1;
+	}
+
+	aggregate->empty -= p->units <= 0;
+	aggregate->units = addToTotal(aggregate->units, -p->units);
+}
 
 /// <summary>
 /// Creates a new repository
@@ -19,8 +259,21 @@ ProductRepo* createRepo()
 		return NULL;
 	}
 
+	repo->tableCapacity = REPOSITORY_INITIAL_SIZE * REPOSITORY_SIZE_SCALE;
+	repo->table = calloc(repo->tableCapacity, sizeof(Product*));
+	if (repo->table == NULL)
+	{
+		free(repo->products);
+		free(repo);
+		return NULL;
+	}
+
 	repo->capacity = REPOSITORY_INITIAL_SIZE;
 	repo->length = 0;
+	memset(repo->aggregates, 0, sizeof(repo->aggregates));
+	repo->names = NULL;
+	repo->similar = NULL;
+	repo->quantities = NULL;
 	return repo;
 }
 
@@ -35,12 +288,42 @@ void destroyRepo(ProductRepo* repo)
 	for (int i = 0; i < repo->length; i++)
 		destroyProduct(repo->products[i]);
 
+	for (int i = none; i <= CATEGORY_END; i++)
+	{
+		free(repo->aggregates[i].heaps[heapEarliest]);
+		free(repo->aggregates[i].heaps[heapLatest]);
+	}
+
+	destroyNameTrie(repo->names);
+	destroyBkTree(repo->similar);
+	destroyQuantityTree(repo->quantities);
 	free(repo->products);
+	free(repo->table);
 	free(repo);
 
 	repo = NULL;
 }
 
+/// <summary>
+/// Grows the repository so it can hold at least the given number of products
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="capacity">The minimum capacity</param>
+/// <returns>1 if the repository can hold the products,
+///			 0, otherwise</returns>
+int reserveRepo(ProductRepo* repo, int capacity)
+{
+	if (growTable(repo, capacity) == 0) return 0;
+	if (capacity <= repo->capacity) return 1;
+
+	Product** tmp = realloc(repo->products, capacity * sizeof(Product*));
+	if (tmp == NULL) return 0;
+
+	repo->products = tmp;
+	repo->capacity = capacity;
+	return 1;
+}
+
 /// <summary>
 /// Adds a product to the repository
 /// </summary>
@@ -49,31 +332,133 @@ void destroyRepo(ProductRepo* repo)
 /// <returns></returns>
 int addProductRepo(ProductRepo* repo, Product* p)
 {
-	for (int i = 0; i < repo->length; i++)
+	Product* current = findProductRepo(repo, p->name, p->category);
+	if (current != NULL)
 	{
-		Product* current = getProductAt(repo, i);
+		// Merging adds the exact quantities, so restocking in small steps does not drift
+		Quantity units = addQuantity(current->units, p->units);
+		CategoryAggregate* aggregate = &repo->aggregates[current->category];
 
-		if (strcmp(current->name, p->name) == 0 && current->category == p->category)
-		{
-			current->quantity += p->quantity;
-			destroyProduct(p);
-			return 1;
-		}
+		aggregate->empty += (units <= 0) - (current->units <= 0);
+		aggregate->units = addToTotal(addToTotal(aggregate->units, units), -current->units);
+		if (repo->quantities != NULL) setQuantityTree(repo->quantities, current, units);
+		else setQuantity(current, units);
+		if (repo->names != NULL) rankNameTrie(repo->names, current);
+		destroyProduct(p);
+		return 1;
 	}
 
-	if (repo->length == repo->capacity)
-	{
-		repo->capacity *= REPOSITORY_SIZE_SCALE;
-		Product** tmp = NULL;
+	return appendProductRepo(repo, p);
+}
 
-		while (tmp == NULL) tmp = realloc(repo->products, repo->capacity * sizeof(Product*));
-		repo->products = tmp;
+/// <summary>
+/// Links a product into the indexes and the aggregates, the repository must have room for it
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="p">The product to link</param>
+/// <param name="slot">The empty index slot where the key belongs</param>
+/// <returns>1 if the product was linked,
+///			 0 if there is not enough memory</returns>
+static int linkProduct(ProductRepo* repo, Product* p, int slot)
+{
+	if (aggregateProduct(repo, p) == 0)
+		return 0;
+	if (repo->names != NULL && insertNameTrie(repo->names, p) == 0)
+	{
+		unaggregateProduct(repo, p);
+		return 0;
+	}
+	if (repo->similar != NULL && insertBkTree(repo->similar, p->name) == 0)
+	{
+		if (repo->names != NULL) removeNameTrie(repo->names, p);
+		unaggregateProduct(repo, p);
+		return 0;
+	}
+	if (repo->quantities != NULL && insertQuantityTree(repo->quantities, p) == 0)
+	{
+		if (repo->similar != NULL) removeBkTree(repo->similar, p->name);
+		if (repo->names != NULL) removeNameTrie(repo->names, p);
+		unaggregateProduct(repo, p);
+		return 0;
 	}
 
+	repo->table[slot] = p;
 	repo->products[repo->length++] = p;
 	return 1;
 }
 
+/// <summary>
+/// Appends a product to the repository without checking for duplicates,
+/// the caller must guarantee that the name and category pair is unique
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="p">The product to append</param>
+/// <returns>1 if the product was appended,
+///			 0, otherwise</returns>
+int appendProductRepo(ProductRepo* repo, Product* p)
+{
+	if (repo->length == repo->capacity && reserveRepo(repo, repo->capacity * REPOSITORY_SIZE_SCALE) == 0)
+		return 0;
+	if (growTable(repo, repo->length + 1) == 0)
+		return 0;
+
+	return linkProduct(repo, p, findSlot(repo, p->name, p->category));
+}
+
+/// <summary>
+/// Appends a product whose index slot is already known, used when loading a prebuilt index.
+/// The caller must reserve room first, since growing would move the slots, and must
+/// guarantee that the pair is unique and that the slot is where the key belongs
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="p">The product to append</param>
+/// <param name="slot">The index slot of the product</param>
+/// <returns>1 if the product was appended,
+///			 0 if there is no room, the slot is taken or there is not enough memory</returns>
+int placeProductRepo(ProductRepo* repo, Product* p, int slot)
+{
+	if (repo->length == repo->capacity || (repo->length + 1) * 2 > repo->tableCapacity)
+		return 0;
+	if (slot < 0 || slot >= repo->tableCapacity || repo->table[slot] != NULL)
+		return 0;
+
+	return linkProduct(repo, p, slot);
+}
+
+/// <summary>
+/// Creates a deep copy of the repository
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <returns>A pointer to the copy,
+///			 NULL if there is not enough memory</returns>
+ProductRepo* copyRepo(ProductRepo* repo)
+{
+	ProductRepo* copy = createRepo();
+	if (copy == NULL) return NULL;
+
+	if (reserveRepo(copy, repo->length) == 0)
+	{
+		destroyRepo(copy);
+		return NULL;
+	}
+
+	// The products of a repository are unique, so the duplicate scan is skipped
+	for (int i = 0; i < repo->length; i++)
+	{
+		Product* current = getProductAt(repo, i);
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
+
+		if (p == NULL || appendProductRepo(copy, p) == 0)
+		{
+			destroyProduct(p);
+			destroyRepo(copy);
+			return NULL;
+		}
+	}
+
+	return copy;
+}
+
 /// <summary>
 /// Removes a product from the repository
 /// </summary>
@@ -83,25 +468,42 @@ int addProductRepo(ProductRepo* repo, Product* p)
 /// <returns></returns>
 int removeProductRepo(ProductRepo* repo, char* name, Category category)
 {
-	for (int i = 0; i < repo->length; i++)
+	int slot = findSlot(repo, name, category);
+	Product* current = repo->table[slot];
+	if (current == NULL) return 0;
+
+	eraseSlot(repo, slot);
+	unaggregateProduct(repo, current);
+	if (repo->names != NULL) removeNameTrie(repo->names, current);
+	if (repo->quantities != NULL) removeQuantityTree(repo->quantities, current);
+	if (repo->similar != NULL)
 	{
-		Product* current = getProductAt(repo, i);
+		removeBkTree(repo->similar, current->name);
 
-		if (strcmp(current->name, name) == 0 && current->category == category)
+		// Mostly removed names are dropped, the next suggestion builds the tree again
+		if (repo->similar->dead > repo->similar->live)
+		{
+			destroyBkTree(repo->similar);
+			repo->similar = NULL;
+		}
+	}
+	for (int i = 0; i < repo->length; i++)
+	{
+		if (repo->products[i] == current)
 		{
-			destroyProduct(current);
 			// Copy everything over by 1
 			for (int j = i; j < repo->length - 1; j++)
 			{
 				repo->products[j] = repo->products[j + 1];
 			}
 
-			repo->products[repo->length--] = NULL;
-			return 1;
+			repo->products[--repo->length] = NULL;
+			break;
 		}
 	}
 
-	return 0;
+	destroyProduct(current);
+	return 1;
 }
 
 /// <summary>
@@ -115,19 +517,35 @@ int removeProductRepo(ProductRepo* repo, char* name, Category category)
 /// <returns></returns>
 int updateProductRepo(ProductRepo* repo, char* name, Category category, double quantity, Date expiration)
 {
-	for (int i = 0; i < repo->length; i++)
-	{
-		Product* current = getProductAt(repo, i);
+	return updateProductUnitsRepo(repo, name, category, toQuantity(quantity), expiration);
+}
 
-		if (strcmp(current->name, name) == 0 && current->category == category)
-		{
-			current->expiration = expiration;
-			current->quantity = quantity;
-			return 1;
-		}
-	}
+/// <summary>
+/// Updates a product with new values, the quantity is exact
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="units">The quantity of the product, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>1 if the product was updated,
+///			 0 if it does not exist</returns>
+int updateProductUnitsRepo(ProductRepo* repo, char* name, Category category, Quantity units, Date expiration)
+{
+	Product* current = findProductRepo(repo, name, category);
+	if (current == NULL) return 0;
+
+	CategoryAggregate* aggregate = &repo->aggregates[category];
+	aggregate->empty += (units <= 0) - (current->units <= 0);
+	aggregate->units = addToTotal(addToTotal(aggregate->units, units), -current->units);
 
-	return 0;
+	current->expiration = expiration;
+	if (repo->quantities != NULL) setQuantityTree(repo->quantities, current, units);
+	else setQuantity(current, units);
+	fixHeap(aggregate, heapEarliest, current->heapPosition[heapEarliest]);
+	fixHeap(aggregate, heapLatest, current->heapPosition[heapLatest]);
+	if (repo->names != NULL) rankNameTrie(repo->names, current);
+	return 1;
 }
 
 /// <summary>
@@ -140,6 +558,196 @@ int getLength(ProductRepo* repo)
 	return repo->length;
 }
 
+/// <summary>
+/// Sums up the products of a category, without looking at the products
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="category">The category, none for every category</param>
+/// <returns>The number of products, their total quantity and the products that expire first and last</returns>
+CategorySummary summarizeCategory(ProductRepo* repo, Category category)
+{
+	CategorySummary summary = { 0, 0, NULL, NULL };
+	Quantity units = 0;
+	Category first = category == none ? none : category;
+	Category last = category == none ? CATEGORY_END : category;
+
+	for (Category i = first; i <= last; i++)
+	{
+		CategoryAggregate* aggregate = &repo->aggregates[i];
+		if (aggregate->count == 0) continue;
+
+		Product* earliest = aggregate->heaps[heapEarliest][0];
+		Product* latest = aggregate->heaps[heapLatest][0];
+
+		summary.count += aggregate->count;
+		units = addQuantity(units, aggregate->units);
+		if (summary.earliest == NULL || compareByExpiration(earliest, summary.earliest) < 0) summary.earliest = earliest;
+		if (summary.latest == NULL || compareByExpiration(latest, summary.latest) > 0) summary.latest = latest;
+	}
+
+	summary.quantity = fromQuantity(units);
+	return summary;
+}
+
+/// <summary>
+/// Gets the products with the highest quantities whose name starts with a prefix. The
+/// name index is built by the first call and kept up to date by every change afterwards,
+/// so later calls do not depend on the number of products.
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="prefix">The prefix</param>
+/// <param name="completions">Where to store the products, they are valid until the repository changes</param>
+/// <param name="count">The maximum number of products, at most TRIE_TOP_COUNT are returned</param>
+/// <returns>The number of products,
+///			 -1 if there is not enough memory for the index</returns>
+int completeRepoNames(ProductRepo* repo, const char* prefix, Product** completions, int count)
+{
+	if (repo->names == NULL)
+	{
+		repo->names = createNameTrie();
+		if (repo->names == NULL) return -1;
+
+		for (int i = 0; i < repo->length; i++)
+		{
+			if (insertNameTrie(repo->names, repo->products[i]) == 0)
+			{
+				destroyNameTrie(repo->names);
+				repo->names = NULL;
+				return -1;
+			}
+		}
+	}
+
+	return completeNameTrie(repo->names, prefix, completions, count);
+}
+
+/// <summary>
+/// Gets the names within an edit distance of a name, the closest ones first. The name
+/// tree is built by the first call and kept up to date by every change afterwards.
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="name">The name, possibly misspelled</param>
+/// <param name="maxDistance">The maximum number of edits</param>
+/// <param name="suggestions">Where to store the names, they are valid until the repository changes</param>
+/// <param name="count">The maximum number of names</param>
+/// <returns>The number of names,
+///			 -1 if there is not enough memory for the tree</returns>
+int suggestRepoNames(ProductRepo* repo, const char* name, int maxDistance, Suggestion* suggestions, int count)
+{
+	if (repo->similar == NULL)
+	{
+		repo->similar = createBkTree();
+		if (repo->similar == NULL) return -1;
+
+		for (int i = 0; i < repo->length; i++)
+		{
+			if (insertBkTree(repo->similar, repo->products[i]->name) == 0)
+			{
+				destroyBkTree(repo->similar);
+				repo->similar = NULL;
+				return -1;
+			}
+		}
+	}
+
+	return searchBkTree(repo->similar, name, maxDistance, suggestions, count);
+}
+
+/// <summary>
+/// Gets the quantity index of a repository, the first call builds it and every change
+/// afterwards keeps it up to date
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <returns>A pointer to the index,
+///			 NULL if there is not enough memory</returns>
+static QuantityTree* getQuantities(ProductRepo* repo)
+{
+	if (repo->quantities != NULL) return repo->quantities;
+
+	repo->quantities = createQuantityTree();
+	if (repo->quantities == NULL) return NULL;
+
+	for (int i = 0; i < repo->length; i++)
+	{
+		if (insertQuantityTree(repo->quantities, repo->products[i]) == 0)
+		{
+			destroyQuantityTree(repo->quantities);
+			repo->quantities = NULL;
+			return NULL;
+		}
+	}
+
+	return repo->quantities;
+}
+
+/// <summary>
+/// Counts the products whose quantity is within a range, without visiting them
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="low">The lowest quantity</param>
+/// <param name="high">The highest quantity</param>
+/// <returns>The number of products,
+///			 -1 if there is not enough memory for the index</returns>
+int countRepoQuantities(ProductRepo* repo, double low, double high)
+{
+	QuantityTree* tree = getQuantities(repo);
+	if (tree == NULL) return -1;
+	if (high < low) return 0;
+
+	return rankQuantityTree(tree, toQuantity(high), 1) - rankQuantityTree(tree, toQuantity(low), 0);
+}
+
+/// <summary>
+/// Gets the products whose quantity is within a range, the lowest quantity first
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="low">The lowest quantity</param>
+/// <param name="high">The highest quantity</param>
+/// <param name="offset">The number of products of the range to skip</param>
+/// <param name="products">Where to store the products, they are valid until the repository changes</param>
+/// <param name="count">The maximum number of products</param>
+/// <returns>The number of products,
+///			 -1 if there is not enough memory for the index</returns>
+int rangeRepoQuantities(ProductRepo* repo, double low, double high, int offset, Product** products, int count)
+{
+	int total = countRepoQuantities(repo, low, high);
+	if (total < 0) return -1;
+	if (offset >= total) return 0;
+
+	if (count > total - offset) count = total - offset;
+	return listQuantityTree(repo->quantities, rankQuantityTree(repo->quantities, toQuantity(low), 0) + offset, products, count);
+}
+
+/// <summary>
+/// Counts the products with a lower quantity
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="quantity">The quantity</param>
+/// <returns>The number of products, the rank of the quantity,
+///			 -1 if there is not enough memory for the index</returns>
+int rankRepoQuantity(ProductRepo* repo, double quantity)
+{
+	QuantityTree* tree = getQuantities(repo);
+	if (tree == NULL) return -1;
+
+	return rankQuantityTree(tree, toQuantity(quantity), 0);
+}
+
+/// <summary>
+/// Gets the product at a rank in order of quantity, length / 2 gives the median
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="rank">The rank, 0 for the product with the lowest quantity</param>
+/// <returns>A pointer to the product, valid until the repository changes,
+///			 NULL if the rank is out of range or there is not enough memory for the index</returns>
+Product* selectRepoQuantity(ProductRepo* repo, int rank)
+{
+	QuantityTree* tree = getQuantities(repo);
+	if (tree == NULL) return NULL;
+
+	return selectQuantityTree(tree, rank);
+}
+
 /// <summary>
 /// Gets the product at the given index
 /// </summary>
@@ -155,79 +763,148 @@ Product* getProductAt(ProductRepo* repo, int index)
 }
 
 /// <summary>
-/// Sorts the repo by quantity
+/// Finds a product by its name and category
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>A pointer to the product,
+///			 NULL if it does not exist</returns>
+Product* findProductRepo(ProductRepo* repo, char* name, Category category)
+{
+	return repo->table[findSlot(repo, name, category)];
+}
+
+/// <summary>
+/// Compares two products by quantity
+/// </summary>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>A negative value, zero or a positive value, like strcmp</returns>
+int compareByQuantity(Product* first, Product* second)
+{
+	return (first->units > second->units) - (first->units < second->units);
+}
+
+/// <summary>
+/// Compares two products by name
+/// </summary>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>A negative value, zero or a positive value, like strcmp</returns>
+int compareByName(Product* first, Product* second)
+{
+	return strcmp(first->name, second->name);
+}
+
+/// <summary>
+/// Compares two products by expiration date
+/// </summary>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>A negative value, zero or a positive value, like strcmp</returns>
+int compareByExpiration(Product* first, Product* second)
+{
+	if (first->expiration.year != second->expiration.year) return first->expiration.year - second->expiration.year;
+	if (first->expiration.month != second->expiration.month) return first->expiration.month - second->expiration.month;
+	return first->expiration.day - second->expiration.day;
+}
+
+/// <summary>
+/// Sorts the repo by quantity with a stable least significant digit radix sort over the
+/// fixed point quantities, a byte at a time. Bytes that are the same for every product
+/// are skipped, so small quantities only take a few passes.
 /// </summary>
 /// <param name="repo">A pointer to the repository</param>
 /// <param name="descending">1 if the sort should be descending, otherwise ascending</param>
-void sortByQuantity(ProductRepo* repo, int descending)
+/// <returns>1 if the repo was sorted,
+///			 0 if there is not enough memory</returns>
+static int radixSortByQuantity(ProductRepo* repo, int descending)
 {
-	if (repo->length < 2)
-		return;
+	int length = repo->length;
+	unsigned long long* keys = malloc(2 * length * sizeof(unsigned long long));
+	Product** products = malloc(length * sizeof(Product*));
+	if (keys == NULL || products == NULL)
+	{
+		free(keys);
+		free(products);
+		return 0;
+	}
+
+	// Flipping the sign bit orders negative quantities first, complementing reverses the order
+	unsigned long long* sourceKeys = keys;
+	unsigned long long* targetKeys = keys + length;
+	Product** source = repo->products;
+	Product** target = products;
+	for (int i = 0; i < length; i++)
+	{
+		unsigned long long key = (unsigned long long)source[i]->units ^ (1ULL << 63);
+		sourceKeys[i] = descending == 1 ? ~key : key;
+	}
 
-	for (int i = 0; i < repo->length - 1; i++)
+	for (int shift = 0; shift < 64; shift += 8)
 	{
-		for (int j = 0; j < repo->length - i - 1; j++)
+		int offsets[256] = { 0 };
+		for (int i = 0; i < length; i++) offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+		if (offsets[(sourceKeys[0] >> shift) & 0xFF] == length) continue;
+
+		int position = 0;
+		for (int digit = 0; digit < 256; digit++)
 		{
-			Product* current = getProductAt(repo, j);
-			Product* next = getProductAt(repo, j + 1);
+			int count = offsets[digit];
+			offsets[digit] = position;
+			position += count;
+		}
 
-			if (descending == 0)
-			{
-				if (current->quantity > next->quantity)
-				{
-					Product tmp = *current;
-					*current = *next;
-					*next = tmp;
-				}
-			}
-			else
-			{
-				if (current->quantity < next->quantity)
-				{
-					Product tmp = *current;
-					*current = *next;
-					*next = tmp;
-				}
-			}
+		for (int i = 0; i < length; i++)
+		{
+			int slot = offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+			targetKeys[slot] = sourceKeys[i];
+			target[slot] = source[i];
 		}
+
+		unsigned long long* tmpKeys = sourceKeys;
+		sourceKeys = targetKeys;
+		targetKeys = tmpKeys;
+		Product** tmp = source;
+		source = target;
+		target = tmp;
 	}
+
+	if (source != repo->products) memcpy(repo->products, source, length * sizeof(Product*));
+	free(keys);
+	free(products);
+	return 1;
 }
 
 /// <summary>
-/// Sorts products by name
+/// Sorts the repo by quantity, products with the same quantity keep their order
 /// </summary>
 /// <param name="repo">A pointer to the repository</param>
 /// <param name="descending">1 if the sort should be descending, otherwise ascending</param>
-void sortByName(ProductRepo* repo, int descending)
+void sortByQuantity(ProductRepo* repo, int descending)
 {
 	if (repo->length < 2)
 		return;
 
-	for (int i = 0; i < repo->length - 1; i++)
-	{
-		for (int j = 0; j < repo->length - i - 1; j++)
-		{
-			Product* current = getProductAt(repo, j);
-			Product* next = getProductAt(repo, j + 1);
+	// Large repositories are merged on the pool, small ones by the radix sort or on this thread
+	ThreadPool* pool = getParallelPool(repo->length);
+	if (pool == NULL && radixSortByQuantity(repo, descending) == 1)
+		return;
 
-			if (descending == 0)
-			{
-				if (strcmp(current->name, next->name) > 0)
-				{
-					Product tmp = *current;
-					*current = *next;
-					*next = tmp;
-				}
-			}
-			else
-			{
-				if (strcmp(current->name, next->name) < 0)
-				{
-					Product tmp = *current;
-					*current = *next;
-					*next = tmp;
-				}
-			}
-		}
-	}
+	parallelSort(pool, repo, compareByQuantity, descending);
+}
+
+/// <summary>
+/// Sorts products by name, products with the same name keep their order
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="descending">1 if the sort should be descending, otherwise ascending</param>
+void sortByName(ProductRepo* repo, int descending)
+{
+	if (repo->length < 2)
+		return;
+
+	// Without a pool the same merge sort runs on this thread
+	parallelSort(getParallelPool(repo->length), repo, compareByName, descending);
 }
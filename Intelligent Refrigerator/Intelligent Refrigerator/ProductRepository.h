@@ -1,24 +1,79 @@
 #pragma once
 #include "Product.h"
+#include "NameTrie.h"
+#include "BkTree.h"
+#include "QuantityTree.h"
 
 #define REPOSITORY_INITIAL_SIZE 32
 #define REPOSITORY_SIZE_SCALE 2
 
+typedef int (*ProductComparator)(Product* first, Product* second);
+
+typedef enum { heapEarliest, heapLatest } ExpirationHeap;
+
+// Running totals of one category, kept up to date by every change of the repository
+typedef struct
+{
+	int count;
+	int empty; // Products whose quantity ran out, at most 0
+	Quantity units; // Exact sum of the quantities, in units of 1 / QUANTITY_SCALE
+
+	// Binary heaps of the products by expiration date, each product knows its positions
+	Product** heaps[2];
+	int heapCapacity;
+} CategoryAggregate;
+
+typedef struct
+{
+	int count;
+	double quantity;
+	Product* earliest; // NULL if there are no products
+	Product* latest;
+} CategorySummary;
+
 typedef struct
 {
 	Product** products;
 	int capacity;
 	int length;
+
+	// Open addressing index on name and category, always at most half full
+	Product** table;
+	int tableCapacity;
+
+	CategoryAggregate aggregates[CATEGORY_END + 1];
+	NameTrie* names; // Built by the first completion, NULL until then
+	BkTree* similar; // Built by the first suggestion, NULL until then
+	QuantityTree* quantities; // Built by the first quantity query, NULL until then
 } ProductRepo;
 
+unsigned int hashProductKey(const char* name, Category category);
+int getIndexCapacity(int count);
+
 ProductRepo* createRepo();
 void destroyRepo(ProductRepo* repo);
+ProductRepo* copyRepo(ProductRepo* repo);
 
+int reserveRepo(ProductRepo* repo, int capacity);
 int addProductRepo(ProductRepo* repo, Product* p);
+int appendProductRepo(ProductRepo* repo, Product* p);
+int placeProductRepo(ProductRepo* repo, Product* p, int slot);
 int removeProductRepo(ProductRepo* repo, char* name, Category category);
 int updateProductRepo(ProductRepo* repo, char* name, Category category, double quantity, Date expiration);
+int updateProductUnitsRepo(ProductRepo* repo, char* name, Category category, Quantity units, Date expiration);
 Product* getProductAt(ProductRepo* repo, int index);
+Product* findProductRepo(ProductRepo* repo, char* name, Category category);
 
 int getLength(ProductRepo* repo);
+CategorySummary summarizeCategory(ProductRepo* repo, Category category);
+int completeRepoNames(ProductRepo* repo, const char* prefix, Product** completions, int count);
+int suggestRepoNames(ProductRepo* repo, const char* name, int maxDistance, Suggestion* suggestions, int count);
+int countRepoQuantities(ProductRepo* repo, double low, double high);
+int rangeRepoQuantities(ProductRepo* repo, double low, double high, int offset, Product** products, int count);
+int rankRepoQuantity(ProductRepo* repo, double quantity);
+Product* selectRepoQuantity(ProductRepo* repo, int rank);
+int compareByQuantity(Product* first, Product* second);
+int compareByName(Product* first, Product* second);
+int compareByExpiration(Product* first, Product* second);
 void sortByQuantity(ProductRepo* repo, int descending);
 void sortByName(ProductRepo* repo, int descending);
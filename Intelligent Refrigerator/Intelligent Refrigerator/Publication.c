@@ -0,0 +1,326 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "Publication.h"
+
+// The slots start on their own cache line, after the header
+#define PUBLICATION_SLOTS_OFFSET ((sizeof(PublicationHeader) + 63) / 64 * 64)
+
+/// <summary>
+/// Gets a slot of the segment
+/// </summary>
+/// <param name="pub">A pointer to the publication</param>
+/// <param name="index">The index of the slot, 0 or 1</param>
+/// <returns>A pointer to the slot</returns>
+static PublishedSlot* getSlot(Publication* pub, unsigned int index)
+{
+	return (PublishedSlot*)(pub->base + PUBLICATION_SLOTS_OFFSET + (index & 1) * pub->slotSize);
+}
+
+/// <summary>
+/// Maps a shared memory segment
+/// </summary>
+/// <param name="pub">A pointer to the publication, its name and writer flag are set</param>
+/// <param name="size">The size of a new segment, 0 to open an existing one</param>
+/// <returns>1 if the segment was mapped,
+///			 0, otherwise</returns>
+static int mapSegment(Publication* pub, size_t size)
+{
+#ifdef _WIN32
+	if (size > 0)
+	{
+		pub->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, pub->name);
+		if (pub->mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			CloseHandle(pub->mapping);
+			return 0;
+		}
+	}
+	else
+	{
+		pub->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, pub->name);
+	}
+	if (pub->mapping == NULL) return 0;
+
+	pub->base = MapViewOfFile(pub->mapping, size > 0 ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+	MEMORY_BASIC_INFORMATION info;
+	if (pub->base == NULL || VirtualQuery(pub->base, &info, sizeof(info)) == 0)
+	{
+		if (pub->base != NULL) UnmapViewOfFile(pub->base);
+		CloseHandle(pub->mapping);
+		return 0;
+	}
+	pub->size = size > 0 ? size : info.RegionSize;
+#else
+	// A segment left behind by an earlier writer is unlinked, readers that still map it keep it
+	if (size > 0) shm_unlink(pub->name);
+
+	int fd = size > 0 ? shm_open(pub->name, O_CREAT | O_EXCL | O_RDWR, 0644) : shm_open(pub->name, O_RDONLY, 0);
+	if (fd == -1) return 0;
+
+	struct stat status;
+	int sized = size > 0 ? ftruncate(fd, (off_t)size) == 0 : fstat(fd, &status) == 0;
+	if (sized == 0)
+	{
+		close(fd);
+		if (size > 0) shm_unlink(pub->name);
+		return 0;
+	}
+	pub->size = size > 0 ? size : (size_t)status.st_size;
+
+	void* base = pub->size == 0 ? MAP_FAILED : mmap(NULL, pub->size, size > 0 ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		if (size > 0) shm_unlink(pub->name);
+		return 0;
+	}
+	pub->base = base;
+#endif
+
+	pub->header = (PublicationHeader*)pub->base;
+	return 1;
+}
+
+/// <summary>
+/// Creates a shared memory segment that images of a repository are published to.
+/// The segment is fixed in size, so readers never have to map it again.
+/// </summary>
+/// <param name="name">The name of the segment, like "/fridge.inventory"</param>
+/// <param name="capacity">The number of bytes of an image, records and names included</param>
+/// <returns>A pointer to the publication,
+///			 NULL if the segment could not be created</returns>
+Publication* createPublication(const char* name, size_t capacity)
+{
+	if (strlen(name) >= PUBLICATION_NAME_SIZE) return NULL;
+
+	Publication* pub = calloc(1, sizeof(Publication));
+	if (pub == NULL) return NULL;
+
+	strcpy(pub->name, name);
+	pub->writer = 1;
+	pub->slotSize = (sizeof(PublishedSlot) + capacity + 1 + 63) / 64 * 64;
+
+	// A new segment is zeroed, so no slot holds an image yet and every slot ends with 0
+	if (mapSegment(pub, PUBLICATION_SLOTS_OFFSET + 2 * pub->slotSize) == 0)
+	{
+		free(pub);
+		return NULL;
+	}
+
+	pub->header->version = PUBLICATION_VERSION;
+	pub->header->slotSize = pub->slotSize;
+	atomic_store(&pub->header->active, 0);
+	atomic_thread_fence(memory_order_release);
+	pub->header->magic = PUBLICATION_MAGIC;
+
+	return pub;
+}
+
+/// <summary>
+/// Opens a segment published by another process for reading
+/// </summary>
+/// <param name="name">The name of the segment</param>
+/// <returns>A pointer to the publication,
+///			 NULL if the segment does not exist or is not a publication</returns>
+Publication* openPublication(const char* name)
+{
+	if (strlen(name) >= PUBLICATION_NAME_SIZE) return NULL;
+
+	Publication* pub = calloc(1, sizeof(Publication));
+	if (pub == NULL) return NULL;
+
+	strcpy(pub->name, name);
+	if (mapSegment(pub, 0) == 0)
+	{
+		free(pub);
+		return NULL;
+	}
+
+	PublicationHeader* header = pub->header;
+	pub->slotSize = pub->size >= PUBLICATION_SLOTS_OFFSET ? (size_t)header->slotSize : 0;
+
+	int valid = pub->size >= PUBLICATION_SLOTS_OFFSET && header->magic == PUBLICATION_MAGIC && header->version == PUBLICATION_VERSION;
+	valid = valid && pub->slotSize > sizeof(PublishedSlot) && pub->slotSize <= (pub->size - PUBLICATION_SLOTS_OFFSET) / 2;
+	if (valid == 0)
+	{
+		closePublication(pub);
+		return NULL;
+	}
+
+	return pub;
+}
+
+/// <summary>
+/// Unmaps the segment, the writer also removes its name so no new reader can open it
+/// </summary>
+/// <param name="pub">A pointer to the publication</param>
+void closePublication(Publication* pub)
+{
+	if (pub == NULL) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(pub->base);
+	CloseHandle(pub->mapping);
+#else
+	munmap(pub->base, pub->size);
+	if (pub->writer == 1) shm_unlink(pub->name);
+#endif
+	free(pub);
+
+	pub = NULL;
+}
+
+/// <summary>
+/// Sizes the images for a repository. The segment cannot grow once readers map it, so
+/// there is room for the repository to double, and never less than the default capacity.
+/// </summary>
+/// <param name="repo">A pointer to the repository that is going to be published</param>
+/// <returns>The number of bytes of an image</returns>
+size_t getPublicationCapacity(ProductRepo* repo)
+{
+	size_t needed = getLength(repo) * sizeof(SnapshotRecord);
+	for (int i = 0; i < getLength(repo); i++)
+		needed += strlen(getProductAt(repo, i)->name) + 1;
+
+	return 2 * needed > PUBLICATION_DEFAULT_CAPACITY ? 2 * needed : PUBLICATION_DEFAULT_CAPACITY;
+}
+
+/// <summary>
+/// Publishes an image of the repository. It is written to the slot that readers were not
+/// directed to by the previous image, so a reader is only disturbed if two images are
+/// published while it reads one.
+/// </summary>
+/// <param name="pub">A pointer to the publication, opened by createPublication</param>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="version">The version of the repository</param>
+/// <returns>1 if the image was published,
+///			 0 if it does not fit, readers keep the previous image then and see that it is stale</returns>
+int publishRepo(Publication* pub, ProductRepo* repo, unsigned long long version)
+{
+	if (pub->writer == 0) return 0;
+
+	uint32_t count = (uint32_t)getLength(repo);
+	size_t heapOffset = sizeof(PublishedSlot) + count * sizeof(SnapshotRecord);
+	size_t heapSize = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+		heapSize += strlen(getProductAt(repo, i)->name) + 1;
+	if (heapOffset + heapSize >= pub->slotSize)
+	{
+		if (atomic_load_explicit(&pub->header->staleSince, memory_order_relaxed) == 0)
+			atomic_store_explicit(&pub->header->staleSince, version, memory_order_release);
+		return 0;
+	}
+
+	unsigned int target = 1 - (atomic_load_explicit(&pub->header->active, memory_order_relaxed) & 1);
+	PublishedSlot* slot = getSlot(pub, target);
+
+	// Seqlock: readers that see an odd or changed sequence discard what they read
+	unsigned long long sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+	atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	SnapshotRecord* records = (SnapshotRecord*)(slot + 1);
+	char* heap = (char*)slot + heapOffset;
+	size_t heapPosition = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Product* current = getProductAt(repo, i);
+		size_t nameLength = strlen(current->name);
+
+		setSnapshotRecord(&records[i], current, (uint32_t)heapPosition);
+		memcpy(heap + heapPosition, current->name, nameLength + 1);
+		heapPosition += nameLength + 1;
+	}
+
+	slot->version = version;
+	slot->recordCount = count;
+	slot->heapOffset = (uint32_t)heapOffset;
+	slot->heapSize = (uint32_t)heapSize;
+
+	atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+	atomic_store_explicit(&pub->header->active, target, memory_order_release);
+	atomic_store_explicit(&pub->header->staleSince, 0, memory_order_release);
+	return 1;
+}
+
+/// <summary>
+/// Starts reading the latest image. The records and names are used in place and can be
+/// torn by the writer, so nothing read from them is final until endPublishedRead agrees;
+/// until then the image only guarantees that every access stays inside the segment.
+/// </summary>
+/// <param name="pub">A pointer to the publication</param>
+/// <param name="image">Where to store the image</param>
+/// <returns>1 if there is an image,
+///			 0 if nothing was published yet</returns>
+int beginPublishedRead(Publication* pub, PublishedImage* image)
+{
+	PublishedSlot* slot;
+	unsigned long long sequence;
+
+	// The latest slot is only being written if two images were published since it was chosen
+	do
+	{
+		unsigned int active = atomic_load_explicit(&pub->header->active, memory_order_acquire);
+		slot = getSlot(pub, active);
+		sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+	} while ((sequence & 1) == 1);
+
+	if (sequence == 0) return 0;
+
+	size_t slotSize = pub->slotSize;
+	size_t maxRecords = (slotSize - 1 - sizeof(PublishedSlot)) / sizeof(SnapshotRecord);
+	size_t heapOffset = slot->heapOffset;
+	if (heapOffset < sizeof(PublishedSlot) || heapOffset >= slotSize) heapOffset = slotSize - 1;
+
+	image->slot = slot;
+	image->sequence = sequence;
+	image->version = slot->version;
+	image->length = slot->recordCount < maxRecords ? (int)slot->recordCount : (int)maxRecords;
+	image->records = (const SnapshotRecord*)(slot + 1);
+	image->heap = (const char*)slot + heapOffset;
+	image->heapLimit = (uint32_t)(slotSize - 1 - heapOffset);
+
+	// A reader that sees the new image before the writer clears the flag compares versions
+	unsigned long long staleSince = atomic_load_explicit(&pub->header->staleSince, memory_order_acquire);
+	image->staleSince = staleSince > image->version ? staleSince : 0;
+	return 1;
+}
+
+/// <summary>
+/// Finishes reading an image
+/// </summary>
+/// <param name="image">A pointer to the image started by beginPublishedRead</param>
+/// <returns>1 if everything read from the image is consistent,
+///			 0 if the writer reused the slot meanwhile and the read has to start over</returns>
+int endPublishedRead(PublishedImage* image)
+{
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&image->slot->sequence, memory_order_relaxed) == image->sequence;
+}
+
+/// <summary>
+/// Gets the name of a record of an image
+/// </summary>
+/// <param name="image">A pointer to the image</param>
+/// <param name="index">The index of the record, below the length of the image</param>
+/// <returns>A pointer to the name inside the segment, empty if the record is torn</returns>
+const char* getPublishedName(PublishedImage* image, int index)
+{
+	uint32_t offset = image->records[index].nameOffset;
+	return image->heap + (offset < image->heapLimit ? offset : image->heapLimit);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "Snapshot.h"
+
+#define PUBLICATION_MAGIC 0x4C425550 // "PUBL"
+#define PUBLICATION_VERSION 3
+#define PUBLICATION_DEFAULT_NAME "/fridge.inventory"
+#define PUBLICATION_DEFAULT_CAPACITY (1 << 20) // Smallest image, about 25000 products with short names
+#define PUBLICATION_NAME_SIZE 64
+
+// Start of the shared memory segment, followed by two slots of slotSize bytes
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t slotSize;
+	atomic_uint active; // The slot that holds the latest image
+	atomic_ullong staleSince; // First version that did not fit since the last image, 0 if none
+} PublicationHeader;
+
+// Image of the repository in a slot: this header, the records in the snapshot layout,
+// then the names. Offsets are relative to the slot, so every process can map it anywhere.
+// The last byte of a slot is never written, so every name ends inside the slot.
+typedef struct
+{
+	atomic_ullong sequence; // Odd while the writer fills the slot, 0 before the first image
+	uint64_t version; // Version of the service the image was taken from
+	uint32_t recordCount;
+	uint32_t heapOffset;
+	uint32_t heapSize;
+	uint32_t reserved;
+} PublishedSlot;
+
+// A read-only image of the repository in shared memory. The writer fills the slot readers
+// are not directed to and then switches them over, and every slot is guarded by a seqlock:
+// readers never write to the segment and never wait, they use the records in place and
+// check afterwards that the slot was not reused while they were reading.
+typedef struct
+{
+	char name[PUBLICATION_NAME_SIZE];
+	char* base;
+	size_t size;
+	size_t slotSize;
+	int writer; // 1 if this process publishes, 0 if it only reads
+	PublicationHeader* header;
+#ifdef _WIN32
+	void* mapping;
+#endif
+} Publication;
+
+typedef struct
+{
+	PublishedSlot* slot;
+	unsigned long long sequence;
+
+	unsigned long long version;
+	unsigned long long staleSince; // First newer version that did not fit, 0 if the image is current
+	int length;
+	const SnapshotRecord* records;
+	const char* heap;
+	uint32_t heapLimit; // Bytes of the slot that can hold names
+} PublishedImage;
+
+Publication* createPublication(const char* name, size_t capacity);
+Publication* openPublication(const char* name);
+void closePublication(Publication* pub);
+size_t getPublicationCapacity(ProductRepo* repo);
+
+int publishRepo(Publication* pub, ProductRepo* repo, unsigned long long version);
+
+int beginPublishedRead(Publication* pub, PublishedImage* image);
+int endPublishedRead(PublishedImage* image);
+const char* getPublishedName(PublishedImage* image, int index);
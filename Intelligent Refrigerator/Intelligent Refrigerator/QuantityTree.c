@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "QuantityTree.h"
+
+/// <summary>
+/// Compares two products in the order of the tree: quantity, then name and category
+/// </summary>
+/// <param name="first">A pointer to the first product</param>
+/// <param name="second">A pointer to the second product</param>
+/// <returns>A negative value, zero or a positive value, like strcmp</returns>
+static int compareKeys(Product* first, Product* second)
+{
+	if (first->units != second->units) return first->units < second->units ? -1 : 1;
+
+	int result = strcmp(first->name, second->name);
+	if (result != 0) return result;
+	return (int)first->category - (int)second->category;
+}
+
+/// <summary>
+/// Gets the number of nodes of a subtree
+/// </summary>
+/// <param name="node">A pointer to the root of the subtree, NULL for an empty one</param>
+/// <returns>The number of nodes</returns>
+static int sizeOf(QuantityNode* node)
+{
+	return node == NULL ? 0 : node->size;
+}
+
+/// <summary>
+/// Computes the size of a node from its children
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+static void updateSize(QuantityNode* node)
+{
+	node->size = 1 + sizeOf(node->left) + sizeOf(node->right);
+}
+
+/// <summary>
+/// Creates an empty tree
+/// </summary>
+/// <returns>A pointer to the tree</returns>
+QuantityTree* createQuantityTree()
+{
+	QuantityTree* tree = malloc(sizeof(QuantityTree));
+	if (tree == NULL) return NULL;
+
+	tree->root = NULL;
+	tree->seed = QUANTITY_TREE_SEED;
+
+	return tree;
+}
+
+/// <summary>
+/// Destroys a node and its subtree, the products belong to the repository
+/// </summary>
+/// <param name="node">A pointer to the node</param>
+static void destroyNode(QuantityNode* node)
+{
+	if (node == NULL) return;
+
+	destroyNode(node->left);
+	destroyNode(node->right);
+	free(node);
+}
+
+/// <summary>
+/// Destroys the tree, the products belong to the repository
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+void destroyQuantityTree(QuantityTree* tree)
+{
+	if (tree == NULL) return;
+
+	destroyNode(tree->root);
+	free(tree);
+
+	tree = NULL;
+}
+
+/// <summary>
+/// Rotates the left child of a node up into its place
+/// </summary>
+/// <param name="link">The pointer to the node in its parent</param>
+static void rotateRight(QuantityNode** link)
+{
+	QuantityNode* node = *link;
+	QuantityNode* left = node->left;
+
+	node->left = left->right;
+	left->right = node;
+	left->size = node->size;
+	updateSize(node);
+
+	*link = left;
+}
+
+/// <summary>
+/// Rotates the right child of a node up into its place
+/// </summary>
+/// <param name="link">The pointer to the node in its parent</param>
+static void rotateLeft(QuantityNode** link)
+{
+	QuantityNode* node = *link;
+	QuantityNode* right = node->right;
+
+	node->right = right->left;
+	right->left = node;
+	right->size = node->size;
+	updateSize(node);
+
+	*link = right;
+}
+
+/// <summary>
+/// Inserts a node as a leaf and rotates it up while its priority is higher than its parent's
+/// </summary>
+/// <param name="link">The pointer to the root of the subtree</param>
+/// <param name="node">A pointer to the node, without children</param>
+static void insertNode(QuantityNode** link, QuantityNode* node)
+{
+	QuantityNode* current = *link;
+	if (current == NULL)
+	{
+		*link = node;
+		return;
+	}
+
+	current->size++;
+	if (compareKeys(node->product, current->product) < 0)
+	{
+		insertNode(&current->left, node);
+		if (current->left->priority > current->priority) rotateRight(link);
+	}
+	else
+	{
+		insertNode(&current->right, node);
+		if (current->right->priority > current->priority) rotateLeft(link);
+	}
+}
+
+/// <summary>
+/// Joins two subtrees, every product of the left one comes before the right one
+/// </summary>
+/// <param name="left">A pointer to the root of the left subtree</param>
+/// <param name="right">A pointer to the root of the right subtree</param>
+/// <returns>A pointer to the root of the joined subtree</returns>
+static QuantityNode* mergeNodes(QuantityNode* left, QuantityNode* right)
+{
+	if (left == NULL) return right;
+	if (right == NULL) return left;
+
+	if (left->priority > right->priority)
+	{
+		left->right = mergeNodes(left->right, right);
+		updateSize(left);
+		return left;
+	}
+
+	right->left = mergeNodes(left, right->left);
+	updateSize(right);
+	return right;
+}
+
+/// <summary>
+/// Takes the node of a product out of a subtree
+/// </summary>
+/// <param name="link">The pointer to the root of the subtree</param>
+/// <param name="p">A pointer to the product, with the quantity it was inserted with</param>
+/// <returns>A pointer to the node, without children,
+///			 NULL if the product is not in the subtree</returns>
+static QuantityNode* detachNode(QuantityNode** link, Product* p)
+{
+	QuantityNode* current = *link;
+	if (current == NULL) return NULL;
+
+	if (current->product == p)
+	{
+		*link = mergeNodes(current->left, current->right);
+		current->left = NULL;
+		current->right = NULL;
+		current->size = 1;
+		return current;
+	}
+
+	QuantityNode* node = detachNode(compareKeys(p, current->product) < 0 ? &current->left : &current->right, p);
+	if (node != NULL) current->size--;
+	return node;
+}
+
+/// <summary>
+/// Inserts a product
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="p">A pointer to the product, it must not be in the tree yet</param>
+/// <returns>1 if the product was inserted,
+///			 0 if there is not enough memory</returns>
+int insertQuantityTree(QuantityTree* tree, Product* p)
+{
+	QuantityNode* node = malloc(sizeof(QuantityNode));
+	if (node == NULL) return 0;
+
+	// Xorshift keeps the priorities the same from run to run
+	tree->seed ^= tree->seed << 13;
+	tree->seed ^= tree->seed >> 17;
+	tree->seed ^= tree->seed << 5;
+
+	node->product = p;
+	node->priority = tree->seed;
+	node->size = 1;
+	node->left = NULL;
+	node->right = NULL;
+
+	insertNode(&tree->root, node);
+	return 1;
+}
+
+/// <summary>
+/// Removes a product
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="p">A pointer to the product, with the quantity it was inserted with</param>
+void removeQuantityTree(QuantityTree* tree, Product* p)
+{
+	free(detachNode(&tree->root, p));
+}
+
+/// <summary>
+/// Changes the quantity of a product and moves it to its new place, the node is reused
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="p">A pointer to the product</param>
+/// <param name="units">The new quantity of the product, in units of 1 / QUANTITY_SCALE</param>
+void setQuantityTree(QuantityTree* tree, Product* p, Quantity units)
+{
+	QuantityNode* node = detachNode(&tree->root, p);
+	setQuantity(p, units);
+
+	if (node != NULL) insertNode(&tree->root, node);
+}
+
+/// <summary>
+/// Gets the number of products in the tree
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <returns>The number of products</returns>
+int getQuantityTreeSize(QuantityTree* tree)
+{
+	return sizeOf(tree->root);
+}
+
+/// <summary>
+/// Counts the products below a quantity
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="units">The quantity, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="inclusive">1 to count the products with exactly this quantity too</param>
+/// <returns>The number of products, also the rank of the first product at or above the quantity</returns>
+int rankQuantityTree(QuantityTree* tree, Quantity units, int inclusive)
+{
+	QuantityNode* node = tree->root;
+	int rank = 0;
+
+	while (node != NULL)
+	{
+		Quantity value = node->product->units;
+		if (value < units || (inclusive == 1 && value == units))
+		{
+			rank += sizeOf(node->left) + 1;
+			node = node->right;
+		}
+		else
+		{
+			node = node->left;
+		}
+	}
+
+	return rank;
+}
+
+/// <summary>
+/// Finds the product at a rank, the product with the lowest quantity has rank 0
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="rank">The rank</param>
+/// <returns>A pointer to the product,
+///			 NULL if the rank is out of range</returns>
+Product* selectQuantityTree(QuantityTree* tree, int rank)
+{
+	QuantityNode* node = tree->root;
+
+	while (node != NULL)
+	{
+		int leftSize = sizeOf(node->left);
+		if (rank == leftSize) return node->product;
+
+		if (rank < leftSize)
+		{
+			node = node->left;
+		}
+		else
+		{
+			rank -= leftSize + 1;
+			node = node->right;
+		}
+	}
+
+	return NULL;
+}
+
+/// <summary>
+/// Collects the products of a subtree in order, starting at a rank
+/// </summary>
+/// <param name="node">A pointer to the root of the subtree</param>
+/// <param name="first">The rank of the first product within the subtree</param>
+/// <param name="products">Where to store the products</param>
+/// <param name="length">A pointer to the number of products stored so far</param>
+/// <param name="count">The maximum number of products</param>
+static void listNode(QuantityNode* node, int first, Product** products, int* length, int count)
+{
+	if (node == NULL || *length == count) return;
+
+	// Subtrees that end before the first rank are skipped by their size
+	int leftSize = sizeOf(node->left);
+	if (first < leftSize) listNode(node->left, first, products, length, count);
+	if (*length == count) return;
+
+	if (first <= leftSize) products[(*length)++] = node->product;
+	listNode(node->right, first > leftSize ? first - leftSize - 1 : 0, products, length, count);
+}
+
+/// <summary>
+/// Gets consecutive products in order of quantity, in O(log n) plus the number of products
+/// </summary>
+/// <param name="tree">A pointer to the tree</param>
+/// <param name="first">The rank of the first product</param>
+/// <param name="products">Where to store the products, they are valid until the repository changes</param>
+/// <param name="count">The maximum number of products</param>
+/// <returns>The number of products</returns>
+int listQuantityTree(QuantityTree* tree, int first, Product** products, int count)
+{
+	int length = 0;
+
+	if (first >= 0 && count > 0)
+		listNode(tree->root, first, products, &length, count);
+
+	return length;
+}
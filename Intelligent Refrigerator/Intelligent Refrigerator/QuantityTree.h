@@ -0,0 +1,36 @@
+#pragma once
+#include "Product.h"
+
+#define QUANTITY_TREE_SEED 2463534242u
+
+// A product in the tree, the size counts the nodes of its subtree
+typedef struct QuantityNode
+{
+	Product* product;
+	unsigned int priority;
+	int size;
+
+	struct QuantityNode* left;
+	struct QuantityNode* right;
+} QuantityNode;
+
+// Treap over the products of a repository ordered by quantity, then name and category.
+// The random priorities keep it balanced in expectation and the subtree sizes answer
+// rank and select queries, so every operation takes O(log n).
+typedef struct
+{
+	QuantityNode* root;
+	unsigned int seed;
+} QuantityTree;
+
+QuantityTree* createQuantityTree();
+void destroyQuantityTree(QuantityTree* tree);
+
+int insertQuantityTree(QuantityTree* tree, Product* p);
+void removeQuantityTree(QuantityTree* tree, Product* p);
+void setQuantityTree(QuantityTree* tree, Product* p, Quantity units);
+
+int getQuantityTreeSize(QuantityTree* tree);
+int rankQuantityTree(QuantityTree* tree, Quantity units, int inclusive);
+Product* selectQuantityTree(QuantityTree* tree, int rank);
+int listQuantityTree(QuantityTree* tree, int first, Product** products, int count);
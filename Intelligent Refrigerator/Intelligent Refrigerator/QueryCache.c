@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "QueryCache.h"
+
+/// <summary>
+/// Creates an empty cache
+/// </summary>
+/// <param name="capacity">The number of results the cache keeps</param>
+/// <returns>A pointer to the cache</returns>
+QueryCache* createQueryCache(int capacity)
+{
+	QueryCache* cache = calloc(1, sizeof(QueryCache));
+	if (cache == NULL) return NULL;
+
+	cache->capacity = capacity > 0 ? capacity : 1;
+	return cache;
+}
+
+/// <summary>
+/// Frees an entry and its result
+/// </summary>
+/// <param name="entry">A pointer to the entry</param>
+static void destroyEntry(CacheEntry* entry)
+{
+	destroyRepo(entry->result);
+	free(entry->name);
+	free(entry);
+}
+
+/// <summary>
+/// Frees a list of entries and their results
+/// </summary>
+/// <param name="entry">A pointer to the first entry of the list</param>
+static void destroyEntries(CacheEntry* entry)
+{
+	while (entry != NULL)
+	{
+		CacheEntry* next = entry->next;
+		destroyEntry(entry);
+		entry = next;
+	}
+}
+
+/// <summary>
+/// Destroys the cache and every result in it, including the ones that were not released
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+void destroyQueryCache(QueryCache* cache)
+{
+	if (cache == NULL) return;
+
+	destroyEntries(cache->first);
+	destroyEntries(cache->detached);
+	free(cache);
+
+	cache = NULL;
+}
+
+/// <summary>
+/// Takes an entry out of the list it is in
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="entry">A pointer to the entry</param>
+static void unlinkEntry(QueryCache* cache, CacheEntry* entry)
+{
+	if (entry->previous != NULL) entry->previous->next = entry->next;
+	else if (entry->cached == 1) cache->first = entry->next;
+	else cache->detached = entry->next;
+
+	if (entry->next != NULL) entry->next->previous = entry->previous;
+	else if (entry->cached == 1) cache->last = entry->previous;
+
+	entry->previous = NULL;
+	entry->next = NULL;
+}
+
+/// <summary>
+/// Puts an entry at the front of the list of cached entries
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="entry">A pointer to the entry</param>
+static void pushFront(QueryCache* cache, CacheEntry* entry)
+{
+	entry->next = cache->first;
+	if (cache->first != NULL) cache->first->previous = entry;
+	else cache->last = entry;
+	cache->first = entry;
+}
+
+/// <summary>
+/// Removes an entry from the cache, it is freed now or when its last reference is released
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="entry">A pointer to the entry</param>
+static void evictEntry(QueryCache* cache, CacheEntry* entry)
+{
+	unlinkEntry(cache, entry);
+	entry->cached = 0;
+	cache->length--;
+
+	if (entry->references == 0)
+	{
+		destroyEntry(entry);
+		return;
+	}
+
+	entry->next = cache->detached;
+	if (cache->detached != NULL) cache->detached->previous = entry;
+	cache->detached = entry;
+}
+
+/// <summary>
+/// Looks up the result of a query, stale results are dropped
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="kind">The kind of the query</param>
+/// <param name="name">The string of string queries</param>
+/// <param name="category">The category of expiration queries</param>
+/// <param name="expiration">The days of expiration queries</param>
+/// <param name="version">The current version of the repository</param>
+/// <param name="day">The current day</param>
+/// <returns>A pointer to the shared result, it must be released with releaseCachedResult,
+///			 NULL if it is not cached</returns>
+ProductRepo* findCachedResult(QueryCache* cache, QueryKind kind, char* name, Category category, int expiration, unsigned long long version, int day)
+{
+	CacheEntry* entry = cache->first;
+	while (entry != NULL)
+	{
+		CacheEntry* next = entry->next;
+
+		// A result of an older repository or an earlier day never becomes valid again
+		if (entry->version != version || (entry->kind == queryExpiration && entry->day != day))
+		{
+			evictEntry(cache, entry);
+			cache->stats.invalidations++;
+		}
+		else if (entry->kind == kind && (kind == queryString ? strcmp(entry->name, name) == 0 : entry->category == category && entry->expiration == expiration))
+		{
+			unlinkEntry(cache, entry);
+			pushFront(cache, entry);
+			entry->references++;
+			cache->stats.hits++;
+			return entry->result;
+		}
+
+		entry = next;
+	}
+
+	cache->stats.misses++;
+	return NULL;
+}
+
+/// <summary>
+/// Caches the result of a query, evicting the least recently used result if the cache is full
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="kind">The kind of the query</param>
+/// <param name="name">The string of string queries</param>
+/// <param name="category">The category of expiration queries</param>
+/// <param name="expiration">The days of expiration queries</param>
+/// <param name="version">The version of the repository the result was computed on</param>
+/// <param name="day">The day the result was computed on</param>
+/// <param name="result">A pointer to the result, the cache takes ownership of it, NULL if the query failed</param>
+/// <returns>A pointer to the shared result, it must be released with releaseCachedResult,
+///			 NULL if the query failed or there is not enough memory, the result is destroyed then</returns>
+ProductRepo* storeCachedResult(QueryCache* cache, QueryKind kind, char* name, Category category, int expiration, unsigned long long version, int day, ProductRepo* result)
+{
+	// A failed query is not an answer, the next lookup has to run it again
+	if (result == NULL) return NULL;
+
+	CacheEntry* entry = calloc(1, sizeof(CacheEntry));
+	if (entry != NULL && kind == queryString)
+	{
+		entry->name = malloc(strlen(name) + 1);
+		if (entry->name != NULL) strcpy(entry->name, name);
+	}
+	if (entry == NULL || (kind == queryString && entry->name == NULL))
+	{
+		free(entry);
+		destroyRepo(result);
+		return NULL;
+	}
+
+	if (cache->length == cache->capacity)
+	{
+		evictEntry(cache, cache->last);
+		cache->stats.evictions++;
+	}
+
+	entry->kind = kind;
+	entry->category = category;
+	entry->expiration = expiration;
+	entry->version = version;
+	entry->day = day;
+	entry->result = result;
+	entry->references = 1;
+	entry->cached = 1;
+
+	pushFront(cache, entry);
+	cache->length++;
+
+	return result;
+}
+
+/// <summary>
+/// Releases a result returned by the cache
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="result">A pointer to the result</param>
+void releaseCachedResult(QueryCache* cache, ProductRepo* result)
+{
+	CacheEntry* entry = cache->first;
+	while (entry != NULL && entry->result != result) entry = entry->next;
+
+	if (entry == NULL)
+	{
+		entry = cache->detached;
+		while (entry != NULL && entry->result != result) entry = entry->next;
+	}
+	if (entry == NULL) return;
+
+	entry->references--;
+	if (entry->cached == 0 && entry->references == 0)
+	{
+		unlinkEntry(cache, entry);
+		destroyEntry(entry);
+	}
+}
+
+/// <summary>
+/// Gets the counters of the cache
+/// </summary>
+/// <param name="cache">A pointer to the cache</param>
+/// <param name="stats">Where to store the counters</param>
+void getCacheStats(QueryCache* cache, CacheStats* stats)
+{
+	*stats = cache->stats;
+}
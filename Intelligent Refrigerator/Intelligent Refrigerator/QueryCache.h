@@ -0,0 +1,52 @@
+#pragma once
+#include "ProductRepository.h"
+
+#define CACHE_CAPACITY 16
+
+typedef enum { queryString = 1, queryExpiration } QueryKind;
+
+// A cached filter result, shared read only by every caller that asked for it
+typedef struct CacheEntry
+{
+	QueryKind kind;
+	char* name;
+	Category category;
+	int expiration;
+	unsigned long long version; // Version of the repository the result was computed on
+	int day; // Expiration queries: the day the result was computed on
+
+	ProductRepo* result;
+	int references; // Callers that have not released the result yet
+	int cached; // 0 once evicted, the entry is freed with its last reference
+
+	struct CacheEntry* previous;
+	struct CacheEntry* next;
+} CacheEntry;
+
+typedef struct
+{
+	long long hits;
+	long long misses;
+	long long evictions;
+	long long invalidations; // Entries dropped because the repository or the day changed
+} CacheStats;
+
+// Least recently used list, the first entry is the most recent one
+typedef struct
+{
+	CacheEntry* first;
+	CacheEntry* last;
+	int length;
+	int capacity;
+
+	CacheEntry* detached; // Evicted entries that are still referenced
+	CacheStats stats;
+} QueryCache;
+
+QueryCache* createQueryCache(int capacity);
+void destroyQueryCache(QueryCache* cache);
+
+ProductRepo* findCachedResult(QueryCache* cache, QueryKind kind, char* name, Category category, int expiration, unsigned long long version, int day);
+ProductRepo* storeCachedResult(QueryCache* cache, QueryKind kind, char* name, Category category, int expiration, unsigned long long version, int day, ProductRepo* result);
+void releaseCachedResult(QueryCache* cache, ProductRepo* result);
+void getCacheStats(QueryCache* cache, CacheStats* stats);
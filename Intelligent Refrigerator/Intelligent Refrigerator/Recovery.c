@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Recovery.h"
+#include "Snapshot.h"
+
+typedef struct
+{
+	JournalRecord record;
+	char* name;
+} PendingRecord;
+
+static int allocationsLeft = -1; // Allocations the replay may still make, -1 if there is no limit
+
+/// <summary>
+/// Makes the allocations of the replay fail after the given number of them, to test the failure path.
+/// The limit is not synchronized, it must not be changed while a replay runs
+/// </summary>
+/// <param name="count">The number of allocations that succeed, -1 to remove the limit</param>
+void limitReplayAllocations(int count)
+{
+	allocationsLeft = count;
+}
+
+/// <summary>
+/// Allocates or resizes a block of memory for the replay, counting against the limit
+/// </summary>
+/// <param name="block">A pointer to the block, NULL for a new one</param>
+/// <param name="size">The new size in bytes</param>
+/// <returns>A pointer to the block,
+///			 NULL if there is not enough memory or the limit is reached</returns>
+static void* replayAllocate(void* block, size_t size)
+{
+	if (allocationsLeft == 0) return NULL;
+	if (allocationsLeft > 0) allocationsLeft--;
+
+	return realloc(block, size);
+}
+
+/// <summary>
+/// Applies a put, remove or archive record, the archive is created by the first archive record
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="pending">The record to apply</param>
+static void applyRecord(Service* serv, PendingRecord* pending)
+{
+	JournalRecord* record = &pending->record;
+	ProductRepo* repo = getRepo(serv);
+	Date expiration = date(record->year, record->month, record->day);
+
+	if (record->type == journalArchive)
+	{
+		if (serv->archive == NULL) attachArchive(serv, createArchive());
+
+		Product* p = createProductUnits(pending->name, record->category, record->units, expiration);
+		if (p != NULL && serv->archive != NULL) archiveProduct(serv->archive, p);
+		destroyProduct(p);
+	}
+	else if (record->type == journalRemove)
+	{
+		removeProductRepo(repo, pending->name, record->category);
+	}
+	else if (updateProductUnitsRepo(repo, pending->name, record->category, record->units, expiration) == 0)
+	{
+		Product* p = createProductUnits(pending->name, record->category, record->units, expiration);
+
+		int ret = addProductRepo(repo, p);
+		if (ret == 0) destroyProduct(p);
+	}
+}
+
+/// <summary>
+/// Applies a committed operation, rebuilding the undo history if requested
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="commit">The commit record of the operation</param>
+/// <param name="pending">The records of the operation</param>
+/// <param name="length">The number of records</param>
+/// <param name="keepHistory">1 if the undo and redo stacks should be rebuilt</param>
+static void applyOperation(Service* serv, JournalRecord* commit, PendingRecord* pending, int length, int keepHistory)
+{
+	JournalOperation operation = commit->operation;
+	int applied = 0;
+
+	if (keepHistory == 1)
+	{
+		if (operation == journalUndo) applied = undoOperation(serv);
+		else if (operation == journalRedo) applied = redoOperation(serv);
+		else if (operation == journalSweep) addSweepToUndoStack(serv);
+		else addToUndoStack(serv);
+	}
+
+	for (int i = 0; applied == 0 && i < length; i++)
+		applyRecord(serv, &pending[i]);
+	if (applied == 0) serv->version++;
+
+	// Undo and redo without history only bring back the products, the commit tells where the archive ends
+	if (serv->archive != NULL && commit->units >= 0 && commit->units != getArchiveLength(serv->archive))
+		resetArchive(serv->archive, getArchiveMarkAt(serv->archive, (int)commit->units));
+}
+
+/// <summary>
+/// Applies the committed operations that come after the given sequence number, as they are read
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="reader">A pointer to the reader</param>
+/// <param name="sequence">The last operation already applied, updated to the last applied one</param>
+/// <param name="keepHistory">1 if the undo and redo stacks should be rebuilt</param>
+/// <param name="committedEnd">Where to store the end of the last commit record</param>
+/// <param name="applied">Set to the last applied operation after every one, NULL if nobody watches</param>
+/// <returns>The number of applied operations,
+///			 -1 if there is not enough memory, the operations applied before stay applied</returns>
+static int replayRecords(Service* serv, JournalReader* reader, uint64_t* sequence, int keepHistory, long* committedEnd, atomic_ullong* applied)
+{
+	int capacity = REPOSITORY_INITIAL_SIZE;
+	int length = 0;
+	PendingRecord* pending = replayAllocate(NULL, capacity * sizeof(PendingRecord));
+	if (pending == NULL) return -1;
+
+	// The journal is detached so the replay is not journaled again
+	Journal* journal = serv->journal;
+	serv->journal = NULL;
+
+	int replayed = 0;
+	*committedEnd = 0;
+	while (readJournalRecord(reader) == 1)
+	{
+		JournalRecord* record = &reader->record;
+
+		if (record->type == journalCommit)
+		{
+			if (record->sequence > *sequence)
+			{
+				applyOperation(serv, record, pending, length, keepHistory);
+				*sequence = record->sequence;
+				replayed++;
+				if (applied != NULL) atomic_store(applied, *sequence);
+			}
+
+			for (int i = 0; i < length; i++)
+				free(pending[i].name);
+			length = 0;
+			*committedEnd = reader->validEnd;
+			continue;
+		}
+
+		if (length == capacity)
+		{
+			PendingRecord* tmp = replayAllocate(pending, capacity * REPOSITORY_SIZE_SCALE * sizeof(PendingRecord));
+			if (tmp == NULL)
+			{
+				replayed = -1;
+				break;
+			}
+
+			pending = tmp;
+			capacity *= REPOSITORY_SIZE_SCALE;
+		}
+
+		// Stopping here would look like the end of the journal and cost the records after it
+		pending[length].record = *record;
+		pending[length].name = replayAllocate(NULL, sizeof(char) * (record->nameLength + 1));
+		if (pending[length].name == NULL)
+		{
+			replayed = -1;
+			break;
+		}
+
+		strcpy(pending[length].name, reader->name);
+		length++;
+	}
+
+	for (int i = 0; i < length; i++)
+		free(pending[i].name);
+	free(pending);
+
+	// The replayed changes have no time of their own, they count as happening now
+	if (replayed != 0) syncConsumptionLog(serv->consumption, getRepo(serv), currentMinute());
+
+	serv->journal = journal;
+	return replayed;
+}
+
+/// <summary>
+/// Replays the operations of a journal that come after the given sequence number,
+/// a torn or corrupted tail is cut off the journal file
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="path">The path of the journal file</param>
+/// <param name="sequence">The last operation already applied, updated to the last replayed one</param>
+/// <param name="keepHistory">1 if the undo and redo stacks should be rebuilt</param>
+/// <returns>The number of replayed operations,
+///			 -1 if there is not enough memory, the journal is then left as it is</returns>
+int replayJournal(Service* serv, const char* path, uint64_t* sequence, int keepHistory)
+{
+	JournalReader* reader = openJournalReader(path);
+	if (reader == NULL) return 0;
+
+	long committedEnd;
+	int replayed = replayRecords(serv, reader, sequence, keepHistory, &committedEnd, NULL);
+
+	// Records after the last commit belong to an operation that never finished
+	fseek(reader->file, 0, SEEK_END);
+	long size = ftell(reader->file);
+	closeJournalReader(reader);
+
+	if (replayed != -1 && size > committedEnd) truncateJournal(path, committedEnd);
+	return replayed;
+}
+
+/// <summary>
+/// Follows the operations a primary ships, applying each one once its commit arrived,
+/// until the primary closes the stream or sends a corrupted record
+/// </summary>
+/// <param name="serv">A pointer to the service of the standby</param>
+/// <param name="input">The stream of records, e.g. from openReplicationStream</param>
+/// <param name="sequence">The last operation already applied, updated to the last applied one</param>
+/// <param name="applied">Set to the last applied operation after every one, NULL if nobody watches</param>
+/// <returns>The number of applied operations,
+///			 -1 if there is not enough memory</returns>
+int followJournal(Service* serv, FILE* input, uint64_t* sequence, atomic_ullong* applied)
+{
+	JournalReader* reader = malloc(sizeof(JournalReader));
+	if (reader == NULL) return -1;
+
+	reader->file = input;
+	reader->validEnd = 0;
+
+	// The undo history of the primary is not shipped, undo and redo arrive as the products they changed
+	long committedEnd;
+	int followed = replayRecords(serv, reader, sequence, 0, &committedEnd, applied);
+
+	free(reader);
+	return followed;
+}
+
+/// <summary>
+/// Rebuilds the service from the latest snapshot and the journal written after it,
+/// the journal is then attached to the service
+/// </summary>
+/// <param name="snapshotPath">The path of the snapshot file</param>
+/// <param name="journalPath">The path of the journal file</param>
+/// <param name="init">Initializes the repository with 10 values if 1 and there is no snapshot</param>
+/// <param name="keepHistory">1 if the undo and redo stacks should be rebuilt</param>
+/// <returns>A pointer to the service,
+///			 NULL if there is not enough memory to replay the journal, which is then left as it is</returns>
+Service* recoverService(const char* snapshotPath, const char* journalPath, int init, int keepHistory)
+{
+	ProductRepo* repo = NULL;
+	uint64_t sequence = 0;
+
+	ColdArchive* archive = NULL;
+	int archived = 0;
+
+	Snapshot* snap = openSnapshot(snapshotPath);
+	if (snap != NULL)
+	{
+		sequence = snap->header->sequence;
+		repo = snapshotToRepo(snap);
+		archived = snap->archive.count > 0;
+		if (archived == 1) archive = snapshotToArchive(snap);
+		closeSnapshot(snap);
+	}
+
+	// Losing the archive would lose the products swept into it
+	if (archived == 1 && archive == NULL)
+	{
+		destroyRepo(repo);
+		return NULL;
+	}
+
+	Service* serv = repo != NULL ? createService(repo, 0) : createService(createRepo(), init);
+	if (serv == NULL)
+	{
+		destroyArchive(archive);
+		return NULL;
+	}
+	attachArchive(serv, archive);
+
+	// New records must not follow committed ones that were never applied
+	if (replayJournal(serv, journalPath, &sequence, keepHistory) == -1)
+	{
+		destroyService(serv);
+		return NULL;
+	}
+	attachJournal(serv, openJournal(journalPath, sequence));
+
+	return serv;
+}
+
+/// <summary>
+/// Saves a snapshot of the service and its archive and empties its journal
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="snapshotPath">The path of the snapshot file</param>
+/// <returns>1 if the checkpoint was made successfully,
+///			 0, otherwise</returns>
+int checkpointService(Service* serv, const char* snapshotPath)
+{
+	uint64_t sequence = serv->journal != NULL ? serv->journal->sequence : 0;
+
+	SnapshotArchive archive;
+	if (serv->archive != NULL) archive = getSnapshotArchive(serv->archive);
+
+	if (saveArchivedSnapshot(getRepo(serv), serv->archive != NULL ? &archive : NULL, sequence, snapshotPath) == 0) return 0;
+	if (serv->journal != NULL) return resetJournal(serv->journal);
+
+	return 1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "Service.h"
+
+int replayJournal(Service* serv, const char* path, uint64_t* sequence, int keepHistory);
+int followJournal(Service* serv, FILE* input, uint64_t* sequence, atomic_ullong* applied);
+Service* recoverService(const char* snapshotPath, const char* journalPath, int init, int keepHistory);
+int checkpointService(Service* serv, const char* snapshotPath);
+void limitReplayAllocations(int count);
@@ -0,0 +1,251 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Replication.h"
+
+/// <summary>
+/// Creates a shipper that sends to a pipe or a socket
+/// </summary>
+/// <param name="fd">The file descriptor to send to, the shipper takes ownership of it</param>
+/// <param name="batch">The number of committed operations that are sent together</param>
+/// <returns>A pointer to the shipper,
+///			 NULL if there is not enough memory</returns>
+Shipper* createShipper(int fd, int batch)
+{
+	Shipper* shipper = malloc(sizeof(Shipper));
+	if (shipper == NULL) return NULL;
+
+	shipper->buffer = malloc(SHIPPER_INITIAL_SIZE);
+	if (shipper->buffer == NULL)
+	{
+		free(shipper);
+		return NULL;
+	}
+
+#ifdef _WIN32
+	_setmode(fd, _O_BINARY);
+#endif
+	shipper->fd = fd;
+	shipper->length = 0;
+	shipper->capacity = SHIPPER_INITIAL_SIZE;
+	shipper->committed = 0;
+	shipper->sequence = 0;
+	shipper->batch = batch > 0 ? batch : 1;
+	shipper->pending = 0;
+	shipper->failed = 0;
+	shipper->operations = 0;
+	shipper->batches = 0;
+	shipper->bytes = 0;
+
+	return shipper;
+}
+
+/// <summary>
+/// Sends the committed operations and closes the connection, which tells the standby to take over
+/// </summary>
+/// <param name="shipper">A pointer to the shipper</param>
+void destroyShipper(Shipper* shipper)
+{
+	if (shipper == NULL) return;
+
+	flushShipper(shipper);
+#ifdef _WIN32
+	_close(shipper->fd);
+#else
+	close(shipper->fd);
+#endif
+	free(shipper->buffer);
+	free(shipper);
+
+	shipper = NULL;
+}
+
+/// <summary>
+/// Appends bytes to the buffer
+/// </summary>
+/// <param name="shipper">A pointer to the shipper</param>
+/// <param name="data">The bytes</param>
+/// <param name="length">The number of bytes</param>
+/// <returns>1 if the bytes were appended,
+///			 0 if there is not enough memory</returns>
+static int appendBytes(Shipper* shipper, const void* data, size_t length)
+{
+	if (shipper->length + length > shipper->capacity)
+	{
+		size_t capacity = shipper->capacity;
+		while (capacity < shipper->length + length) capacity *= 2;
+
+		char* tmp = realloc(shipper->buffer, capacity);
+		if (tmp == NULL) return 0;
+
+		shipper->buffer = tmp;
+		shipper->capacity = capacity;
+	}
+
+	memcpy(shipper->buffer + shipper->length, data, length);
+	shipper->length += length;
+	return 1;
+}
+
+/// <summary>
+/// Buffers a record of the current operation, it is sent with the batch of its commit
+/// </summary>
+/// <param name="shipper">A pointer to the shipper</param>
+/// <param name="type">The type of the record</param>
+/// <param name="operation">The operation that produced the record</param>
+/// <param name="p">The product that was changed, NULL for a commit</param>
+/// <returns>1 if the record was buffered,
+///			 0, otherwise</returns>
+int shipRecord(Shipper* shipper, JournalRecordType type, JournalOperation operation, Product* p)
+{
+	if (shipper->failed == 1) return 0;
+
+	// A standby that misses a record would drift apart, so shipping stops instead
+	JournalRecord record;
+	if (encodeJournalRecord(&record, shipper->sequence + 1, type, operation, p) == 0 ||
+		appendBytes(shipper, &record, sizeof(JournalRecord)) == 0 ||
+		(record.nameLength > 0 && appendBytes(shipper, p->name, record.nameLength) == 0))
+	{
+		shipper->failed = 1;
+		return 0;
+	}
+
+	return 1;
+}
+
+/// <summary>
+/// Commits the current operation, a full batch is sent right away
+/// </summary>
+/// <param name="shipper">A pointer to the shipper</param>
+/// <param name="operation">The operation to commit</param>
+/// <param name="archived">The length of the archive after the operation, -1 without an archive</param>
+/// <returns>1 if the operation was committed,
+///			 0, otherwise</returns>
+int commitShipper(Shipper* shipper, JournalOperation operation, int64_t archived)
+{
+	if (shipper->failed == 1) return 0;
+
+	JournalRecord record;
+	encodeCommitRecord(&record, shipper->sequence + 1, operation, archived);
+	if (appendBytes(shipper, &record, sizeof(JournalRecord)) == 0)
+	{
+		shipper->failed = 1;
+		return 0;
+	}
+
+	shipper->sequence++;
+	shipper->operations++;
+	shipper->committed = shipper->length;
+	if (++shipper->pending >= shipper->batch) return flushShipper(shipper);
+
+	return 1;
+}
+
+/// <summary>
+/// Ships every product of a repository and every entry of its archive as a single operation,
+/// so that a standby that starts out empty reaches the state of the primary before it follows its changes
+/// </summary>
+/// <param name="shipper">A pointer to the shipper</param>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="archive">A pointer to the archive, NULL if there is none</param>
+/// <returns>1 if the repository was shipped,
+///			 0, otherwise</returns>
+int shipRepo(Shipper* shipper, ProductRepo* repo, ColdArchive* archive)
+{
+	for (int i = 0; i < getLength(repo); i++)
+		if (shipRecord(shipper, journalPut, journalAdd, getProductAt(repo, i)) == 0) return 0;
+
+	for (int i = 0; archive != NULL && i < getArchiveLength(archive); i++)
+	{
+		SnapshotRecord* record = &archive->records[i];
+		Product* p = createProductUnits(archive->heap + record->nameOffset, record->category, record->units, date(record->year, record->month, record->day));
+
+		int shipped = p != NULL && shipRecord(shipper, journalArchive, journalAdd, p) == 1;
+		destroyProduct(p);
+		if (shipped == 0)
+		{
+			shipper->failed = 1;
+			return 0;
+		}
+	}
+
+	return commitShipper(shipper, journalAdd, archive != NULL ? getArchiveLength(archive) : -1) == 1 && flushShipper(shipper) == 1;
+}
+
+/// <summary>
+/// Sends the committed operations, the records of an operation that is not committed yet stay buffered
+/// </summary>
+/// <param name="shipper">A pointer to the shipper</param>
+/// <returns>1 if everything committed was sent,
+///			 0 if the standby is gone</returns>
+int flushShipper(Shipper* shipper)
+{
+	if (shipper->failed == 1) return 0;
+	if (shipper->committed == 0) return 1;
+
+	size_t sent = 0;
+	while (sent < shipper->committed)
+	{
+#ifdef _WIN32
+		long long written = _write(shipper->fd, shipper->buffer + sent, (unsigned int)(shipper->committed - sent));
+#else
+		long long written = write(shipper->fd, shipper->buffer + sent, shipper->committed - sent);
+#endif
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0)
+		{
+			shipper->failed = 1;
+			return 0;
+		}
+		sent += (size_t)written;
+	}
+
+	memmove(shipper->buffer, shipper->buffer + sent, shipper->length - sent);
+	shipper->length -= sent;
+	shipper->committed = 0;
+	shipper->pending = 0;
+	shipper->batches++;
+	shipper->bytes += (long long)sent;
+	return 1;
+}
+
+/// <summary>
+/// Creates a pipe for shipping to a standby
+/// </summary>
+/// <param name="fds">Where to store the ends of the pipe: the one to read from, then the one to write to</param>
+/// <returns>1 if the pipe was created,
+///			 0, otherwise</returns>
+int createReplicationPipe(int fds[2])
+{
+#ifdef _WIN32
+	return _pipe(fds, 1 << 16, _O_BINARY) == 0;
+#else
+	return pipe(fds) == 0;
+#endif
+}
+
+/// <summary>
+/// Opens the receiving end of a pipe or a socket for reading the shipped records
+/// </summary>
+/// <param name="fd">The file descriptor, the stream takes ownership of it</param>
+/// <returns>The stream,
+///			 NULL if it could not be opened</returns>
+FILE* openReplicationStream(int fd)
+{
+#ifdef _WIN32
+	return _fdopen(fd, "rb");
+#else
+	return fdopen(fd, "rb");
+#endif
+}
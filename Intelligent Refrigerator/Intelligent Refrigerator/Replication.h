@@ -0,0 +1,41 @@
+#pragma once
+#include <stdio.h>
+
+#include "Journal.h"
+#include "Archive.h"
+
+#define SHIPPER_DEFAULT_BATCH 32
+#define SHIPPER_INITIAL_SIZE 4096
+
+// Ships the operations of a primary to a standby process over a pipe or a local socket,
+// as the same records the journal is made of. Records are buffered and sent in batches:
+// once enough operations were committed, or when the owner flushes, e.g. after every
+// round of the server loop. The standby applies an operation once its commit arrived.
+typedef struct
+{
+	int fd;
+	char* buffer;
+	size_t length;
+	size_t capacity;
+	size_t committed; // Bytes of the buffer up to the last commit
+
+	uint64_t sequence; // Last committed operation
+	int batch; // Committed operations that fill a batch
+	int pending; // Committed operations that were not sent yet
+	int failed; // 1 once the standby is gone, nothing is shipped afterwards
+
+	long long operations;
+	long long batches;
+	long long bytes;
+} Shipper;
+
+Shipper* createShipper(int fd, int batch);
+void destroyShipper(Shipper* shipper);
+
+int shipRecord(Shipper* shipper, JournalRecordType type, JournalOperation operation, Product* p);
+int commitShipper(Shipper* shipper, JournalOperation operation, int64_t archived);
+int shipRepo(Shipper* shipper, ProductRepo* repo, ColdArchive* archive);
+int flushShipper(Shipper* shipper);
+
+int createReplicationPipe(int fds[2]);
+FILE* openReplicationStream(int fd);
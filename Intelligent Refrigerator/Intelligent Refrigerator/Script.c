@@ -0,0 +1,1191 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "Script.h"
+#include "ImportExport.h"
+#include "Page.h"
+
+typedef int (*CommandHandler)(Service* serv, Writer* out, char* words[], int count, int history);
+
+typedef struct
+{
+	const char* name;
+	int minWords; // Including the name of the command
+	int maxWords;
+	const char* usage; // The error for a wrong number of words, NULL for an unknown command
+	CommandHandler handler;
+} ScriptCommand;
+
+/// <summary>
+/// Gets the current wall clock time
+/// </summary>
+/// <returns>The time in seconds</returns>
+static double wallSeconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// <summary>
+/// Splits a line into words in place
+/// </summary>
+/// <param name="line">The line to split</param>
+/// <param name="words">Where to store the words</param>
+/// <returns>The number of words,
+///			 -1 if there are too many</returns>
+static int splitWords(char* line, char* words[])
+{
+	int count = 0;
+
+	while (1)
+	{
+		while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n') *line++ = '\0';
+		if (*line == '\0') return count;
+		if (count == SCRIPT_MAX_ARGUMENTS) return -1;
+
+		words[count++] = line;
+		while (*line != '\0' && *line != ' ' && *line != '\t' && *line != '\r' && *line != '\n') line++;
+	}
+}
+
+/// <summary>
+/// Writes an error line
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="message">The error message</param>
+/// <returns>Always 0, so it can be returned as the command result</returns>
+static int writeError(Writer* out, const char* message)
+{
+	writeText(out, "ERROR: ");
+	writeText(out, message);
+	writeChars(out, "\n", 1);
+	return 0;
+}
+
+/// <summary>
+/// Writes the products of a repository followed by the success line, then destroys it
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="repo">A pointer to the repository</param>
+/// <returns>Always 1</returns>
+static int writeListing(Writer* out, ProductRepo* repo)
+{
+	for (int i = 0; i < getLength(repo); i++)
+		writeProduct(out, getProductAt(repo, i));
+	writeText(out, "OK\n");
+
+	destroyRepo(repo);
+	return 1;
+}
+
+/// <summary>
+/// Writes a result returned by a cached filter followed by the success line, then releases it
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="repo">A pointer to the result, NULL if the filter failed</param>
+/// <returns>1 if the products were written,
+///			 0 if there is not enough memory</returns>
+static int writeCachedListing(Service* serv, Writer* out, ProductRepo* repo)
+{
+	if (repo == NULL) return writeError(out, "Could not list the products due to memory issues.");
+
+	for (int i = 0; i < getLength(repo); i++)
+		writeProduct(out, getProductAt(repo, i));
+	writeText(out, "OK\n");
+
+	releaseResult(serv, repo);
+	return 1;
+}
+
+/// <summary>
+/// Writes a sorted copy of a result returned by a cached filter followed by the success line
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="result">A pointer to the result, it is released, NULL if the filter failed</param>
+/// <param name="byName">1 to sort by name, 0 to sort by quantity</param>
+/// <returns>1 if the products were written,
+///			 0 if there is not enough memory</returns>
+static int writeSortedListing(Service* serv, Writer* out, ProductRepo* result, int byName)
+{
+	if (result == NULL) return writeError(out, "Could not list the products due to memory issues.");
+
+	// The cached result is shared, so it is sorted on a copy
+	ProductRepo* repo = copyRepo(result);
+	releaseResult(serv, result);
+	if (repo == NULL) return writeError(out, "Could not list the products due to memory issues.");
+
+	if (byName == 1) sortByName(repo, 0);
+	else sortByQuantity(repo, 0);
+	return writeListing(out, repo);
+}
+
+/// <summary>
+/// Parses the order of a page
+/// </summary>
+/// <param name="text">The text to parse: quantity, name or expiration</param>
+/// <param name="order">Where to store the order</param>
+/// <returns>1 if the text is a valid order,
+///			 0, otherwise</returns>
+static int parseOrder(const char* text, PageOrder* order)
+{
+	if (strcmp(text, "quantity") == 0) *order = orderByQuantity;
+	else if (strcmp(text, "name") == 0) *order = orderByName;
+	else if (strcmp(text, "expiration") == 0) *order = orderByExpiration;
+	else return 0;
+
+	return 1;
+}
+
+/// <summary>
+/// Writes the rows of a page, the token of the next page if there is one and the success line, then destroys the page
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="page">A pointer to the page</param>
+/// <returns>1 if the page was written,
+///			 0 if there is not enough memory for the token</returns>
+static int writePage(Writer* out, Page* page)
+{
+	for (int i = 0; i < getLength(page->rows); i++)
+		writeProduct(out, getProductAt(page->rows, i));
+
+	if (page->next.valid == 1)
+	{
+		size_t size = PAGE_CURSOR_SIZE + strlen(page->next.name);
+		char* token = malloc(size);
+		if (token == NULL || formatCursor(&page->next, token, size) == 0)
+		{
+			free(token);
+			destroyPage(page);
+			return writeError(out, "Could not write the token of the next page due to memory issues.");
+		}
+
+		writeText(out, "NEXT ");
+		writeText(out, token);
+		writeChars(out, "\n", 1);
+		free(token);
+	}
+	writeText(out, "OK\n");
+
+	destroyPage(page);
+	return 1;
+}
+
+/// <summary>
+/// Writes the published result of a view followed by the success line
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="view">A pointer to the view</param>
+/// <returns>Always 1</returns>
+static int writeView(Writer* out, MaterializedView* view)
+{
+	int ticket;
+	ProductRepo* repo = beginViewRead(view, &ticket);
+
+	for (int i = 0; i < getLength(repo); i++)
+		writeProduct(out, getProductAt(repo, i));
+	writeText(out, "OK\n");
+
+	endViewRead(view, ticket);
+	return 1;
+}
+
+/// <summary>
+/// Writes the success line
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <returns>Always 1, so it can be returned as the command result</returns>
+static int writeSuccess(Writer* out)
+{
+	writeText(out, "OK\n");
+	return 1;
+}
+
+/// <summary>
+/// Parses a category, or none for every category
+/// </summary>
+/// <param name="text">The text to parse</param>
+/// <param name="category">Where to store the category</param>
+/// <returns>1 if the text is a valid category or none,
+///			 0, otherwise</returns>
+static int parseCategoryOrNone(const char* text, Category* category)
+{
+	if (strcmp(text, category_name[none]) != 0) return parseCategory(text, category);
+
+	*category = none;
+	return 1;
+}
+
+/// <summary>
+/// Parses a whole number of days
+/// </summary>
+/// <param name="text">The text to parse</param>
+/// <param name="days">Where to store the number of days</param>
+/// <returns>1 if the text is a whole number,
+///			 0, otherwise</returns>
+static int parseDays(const char* text, int* days)
+{
+	char* end;
+	long value = strtol(text, &end, 10);
+	if (*end != '\0') return 0;
+
+	*days = (int)value;
+	return 1;
+}
+
+/// <summary>
+/// Records the undo state of a change, or drops the history when changes cannot be undone
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="history">1 if changes can be undone</param>
+static void beginChange(Service* serv, int history)
+{
+	// Without history the stacks would no longer match the repository
+	if (history == 1) addToUndoStack(serv);
+	else clearHistory(serv);
+}
+
+/// <summary>
+/// Adds a product: add name category quantity date
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandAdd(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	Quantity units;
+	Date expiration;
+	(void)count;
+
+	if (parseCategory(words[2], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseFixedQuantity(words[3], &units) == 0) return writeError(out, "Invalid quantity!");
+	if (parseDate(words[4], &expiration) == 0) return writeError(out, "Invalid date!");
+
+	beginChange(serv, history);
+	if (addProductUnitsService(serv, words[1], category, units, expiration) == 0)
+	{
+		if (history == 1) popUndoStack(serv);
+		return writeError(out, "Could not add product due to memory issues.");
+	}
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Updates a product: update name category quantity date
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandUpdate(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	Quantity units;
+	Date expiration;
+	(void)count;
+
+	if (parseCategory(words[2], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseFixedQuantity(words[3], &units) == 0) return writeError(out, "Invalid quantity!");
+	if (parseDate(words[4], &expiration) == 0) return writeError(out, "Invalid date!");
+
+	beginChange(serv, history);
+	if (updateProductUnitsService(serv, words[1], category, units, expiration) == 0)
+	{
+		if (history == 1) popUndoStack(serv);
+		return writeError(out, "The product does not exist!");
+	}
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Deletes a product: delete name category
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandDelete(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	(void)count;
+
+	if (parseCategory(words[2], &category) == 0) return writeError(out, "Invalid category!");
+
+	beginChange(serv, history);
+	if (deleteProductService(serv, words[1], category) == 0)
+	{
+		if (history == 1) popUndoStack(serv);
+		return writeError(out, "The product does not exist!");
+	}
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Lists every product: list
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandList(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)words;
+	(void)count;
+	(void)history;
+
+	return writeCachedListing(serv, out, cachedFilterByString(serv, ""));
+}
+
+/// <summary>
+/// Lists every product by name: list-name
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandListByName(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)words;
+	(void)count;
+	(void)history;
+
+	return writeSortedListing(serv, out, cachedFilterByString(serv, ""), 1);
+}
+
+/// <summary>
+/// Lists the products whose name contains a string, by quantity: filter [text]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandFilter(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)history;
+
+	return writeSortedListing(serv, out, cachedFilterByString(serv, count == 2 ? words[1] : ""), 0);
+}
+
+/// <summary>
+/// Lists the products whose name contains a string in any case, by quantity: filter-i [text]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandFilterIgnoreCase(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)history;
+
+	ProductRepo* repo = filterByStringMatch(serv, count == 2 ? words[1] : "", matchIgnoreCase);
+	if (repo == NULL) return writeError(out, "Could not list the products due to memory issues.");
+
+	sortByQuantity(repo, 0);
+	return writeListing(out, repo);
+}
+
+/// <summary>
+/// Lists the products whose whole name matches in any case: find-i name
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandFindIgnoreCase(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)count;
+	(void)history;
+
+	ProductRepo* repo = filterByStringMatch(serv, words[1], matchEqualIgnoreCase);
+	if (repo == NULL) return writeError(out, "Could not list the products due to memory issues.");
+
+	return writeListing(out, repo);
+}
+
+/// <summary>
+/// Writes a page of the products whose name contains a string
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command: order, rows, the token if there is one and the text</param>
+/// <param name="count">The number of words</param>
+/// <param name="text">The position of the text, after the token if there is one</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int writeTopPage(Service* serv, Writer* out, char* words[], int count, int text)
+{
+	// Only the rows of the page are sorted, the token continues where the page ended
+	PageOrder order;
+	PageCursor cursor = { 0 };
+	Page page;
+	int rows = atoi(words[2]);
+
+	if (parseOrder(words[1], &order) == 0) return writeError(out, "Invalid order, use quantity, name or expiration!");
+	if (rows < 1) return writeError(out, "Invalid number of rows!");
+	if (text == 4 && parseCursor(words[3], &cursor) == 0) return writeError(out, "Invalid token!");
+
+	int ret = pageByString(getRepo(serv), count > text ? words[text] : "", matchSubstring, order, rows, &cursor, &page);
+	clearCursor(&cursor);
+	if (ret == 0) return writeError(out, "Could not list the products due to memory issues.");
+	return writePage(out, &page);
+}
+
+/// <summary>
+/// Writes the first page of the products whose name contains a string: top order rows [text]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandTop(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)history;
+
+	return writeTopPage(serv, out, words, count, 3);
+}
+
+/// <summary>
+/// Writes the page after a token: top-after order rows token [text]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandTopAfter(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)history;
+
+	return writeTopPage(serv, out, words, count, 4);
+}
+
+/// <summary>
+/// Writes a page of the products that expire soon: top-exp category days rows [token]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandTopExpiring(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	int days;
+	int rows = atoi(words[3]);
+	PageCursor cursor = { 0 };
+	Page page;
+	(void)history;
+
+	if (parseCategoryOrNone(words[1], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseDays(words[2], &days) == 0) return writeError(out, "Invalid number of days!");
+	if (rows < 1) return writeError(out, "Invalid number of rows!");
+	if (count == 5 && parseCursor(words[4], &cursor) == 0) return writeError(out, "Invalid token!");
+
+	int ret = pageByCategoryAndExpiration(getRepo(serv), category, days, currentDate(), orderByExpiration, rows, &cursor, &page);
+	clearCursor(&cursor);
+	if (ret == 0) return writeError(out, "Could not list the products due to memory issues.");
+	return writePage(out, &page);
+}
+
+/// <summary>
+/// Lists the products that expire soon: filter-exp category days
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandFilterExpiring(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	int days;
+	(void)count;
+	(void)history;
+
+	if (parseCategoryOrNone(words[1], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseDays(words[2], &days) == 0) return writeError(out, "Invalid number of days!");
+
+	// A registered view already holds the answer
+	MaterializedView* view = findView(serv, viewExpiring, category, days, 0);
+	if (view == NULL) return writeCachedListing(serv, out, cachedFilterByCategoryAndExpiration(serv, category, days));
+
+	advanceViews(serv, currentDate());
+	return writeView(out, view);
+}
+
+/// <summary>
+/// Registers a view of the products that expire soon: watch-exp category days
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandWatchExpiring(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	int days;
+	(void)count;
+	(void)history;
+
+	if (parseCategoryOrNone(words[1], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseDays(words[2], &days) == 0) return writeError(out, "Invalid number of days!");
+
+	MaterializedView* view = findView(serv, viewExpiring, category, days, 0);
+	if (view == NULL && registerView(serv, createExpiringView(&serv->repo, category, days, currentDate())) == NULL)
+		return writeError(out, "Could not register the view due to memory issues.");
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Lists the products of a registered low stock view: filter-low category quantity
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandFilterLow(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	double quantity;
+	(void)count;
+	(void)history;
+
+	if (parseCategoryOrNone(words[1], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseQuantity(words[2], &quantity) == 0) return writeError(out, "Invalid quantity!");
+
+	MaterializedView* view = findView(serv, viewLowStock, category, 0, quantity);
+	if (view == NULL) return writeError(out, "There is no such view, register it with watch-low first!");
+
+	return writeView(out, view);
+}
+
+/// <summary>
+/// Registers a view of the products with a lower quantity: watch-low category quantity
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandWatchLow(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category;
+	double quantity;
+	(void)count;
+	(void)history;
+
+	if (parseCategoryOrNone(words[1], &category) == 0) return writeError(out, "Invalid category!");
+	if (parseQuantity(words[2], &quantity) == 0) return writeError(out, "Invalid quantity!");
+
+	MaterializedView* view = findView(serv, viewLowStock, category, 0, quantity);
+	if (view == NULL && registerView(serv, createLowStockView(&serv->repo, category, quantity)) == NULL)
+		return writeError(out, "Could not register the view due to memory issues.");
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the summary of a category or of every product: summary [category]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandSummary(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Category category = none;
+	(void)history;
+
+	if (count == 2 && parseCategoryOrNone(words[1], &category) == 0) return writeError(out, "Invalid category!");
+
+	CategorySummary summary = summarizeCategory(getRepo(serv), category);
+	writeSummary(out, category, &summary);
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the products whose name starts with a prefix, by quantity: complete prefix [rows]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandComplete(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Product* completions[TRIE_TOP_COUNT];
+	int rows = count == 3 ? atoi(words[2]) : TRIE_TOP_COUNT;
+	(void)history;
+
+	if (rows < 1) return writeError(out, "Invalid number of rows!");
+
+	int found = completeRepoNames(getRepo(serv), words[1], completions, rows);
+	if (found < 0) return writeError(out, "Could not complete the name due to memory issues.");
+
+	for (int i = 0; i < found; i++)
+		writeProduct(out, completions[i]);
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the names that are close to a misspelled name: suggest name [distance]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandSuggest(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Suggestion suggestions[BK_SUGGESTIONS];
+	char* end = "";
+	long distance = count == 3 ? strtol(words[2], &end, 10) : BK_MAX_DISTANCE;
+	(void)history;
+
+	if (*end != '\0' || distance < 0) return writeError(out, "Invalid distance!");
+
+	int found = suggestRepoNames(getRepo(serv), words[1], (int)distance, suggestions, BK_SUGGESTIONS);
+	if (found < 0) return writeError(out, "Could not search the names due to memory issues.");
+
+	for (int i = 0; i < found; i++)
+	{
+		writeText(out, suggestions[i].name);
+		writeChars(out, " ", 1);
+		writeInteger(out, suggestions[i].distance);
+		writeChars(out, "\n", 1);
+	}
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the products in a quantity range and their count: range low high [rows]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandRange(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	double low, high;
+	(void)history;
+
+	if (parseQuantity(words[1], &low) == 0 || parseQuantity(words[2], &high) == 0) return writeError(out, "Invalid quantity!");
+
+	int total = countRepoQuantities(getRepo(serv), low, high);
+	int rows = count == 4 ? atoi(words[3]) : total;
+	if (rows < 0) return writeError(out, "Invalid number of rows!");
+
+	Product** products = malloc(((total > 0 ? rows : 0) + 1) * sizeof(Product*));
+	if (total < 0 || products == NULL)
+	{
+		free(products);
+		return writeError(out, "Could not list the products due to memory issues.");
+	}
+
+	int found = rangeRepoQuantities(getRepo(serv), low, high, 0, products, rows);
+	for (int i = 0; i < found; i++)
+		writeProduct(out, products[i]);
+	free(products);
+
+	writeText(out, "Count: ");
+	writeInteger(out, total);
+	writeChars(out, "\n", 1);
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the number of products below a quantity: rank quantity
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandRank(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	double quantity;
+	(void)count;
+	(void)history;
+
+	if (parseQuantity(words[1], &quantity) == 0) return writeError(out, "Invalid quantity!");
+
+	int rank = rankRepoQuantity(getRepo(serv), quantity);
+	if (rank < 0) return writeError(out, "Could not rank the quantity due to memory issues.");
+
+	writeInteger(out, rank);
+	writeChars(out, "\n", 1);
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the product at a rank by quantity: select rank
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandSelect(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	char* end;
+	long rank = strtol(words[1], &end, 10);
+	(void)count;
+	(void)history;
+
+	if (*end != '\0') return writeError(out, "Invalid rank!");
+
+	Product* p = selectRepoQuantity(getRepo(serv), (int)rank);
+	if (p == NULL) return writeError(out, "There is no product at this rank!");
+
+	writeProduct(out, p);
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the product with the median quantity: median
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandMedian(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)words;
+	(void)count;
+	(void)history;
+
+	Product* p = selectRepoQuantity(getRepo(serv), getLength(getRepo(serv)) / 2);
+	if (p == NULL) return writeError(out, "There is no product at this rank!");
+
+	writeProduct(out, p);
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes when the products will run out: forecast [days]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandForecast(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	int days = HISTORY_FORECAST_DAYS;
+	(void)history;
+
+	if (count == 2 && parseDays(words[1], &days) == 0) return writeError(out, "Invalid number of days!");
+
+	Forecast* forecasts = malloc((serv->consumption->length + 1) * sizeof(Forecast));
+	if (forecasts == NULL) return writeError(out, "Could not forecast due to memory issues.");
+
+	int found = forecastConsumption(serv->consumption, currentMinute(), days, forecasts, serv->consumption->length);
+	for (int i = 0; i < found; i++)
+	{
+		writeText(out, forecasts[i].name);
+		writeChars(out, " ", 1);
+		writeText(out, category_name[forecasts[i].category]);
+		writeChars(out, " ", 1);
+		writeQuantity(out, forecasts[i].quantity);
+		writeChars(out, " ", 1);
+		writeQuantity(out, forecasts[i].rate);
+		writeChars(out, " ", 1);
+		writeDate(out, forecasts[i].runOut);
+		writeChars(out, "\n", 1);
+	}
+	free(forecasts);
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the quantity samples of a product: history name category
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandHistory(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	Sample samples[HISTORY_RAW_SAMPLES + HISTORY_HOURLY_SAMPLES + HISTORY_DAILY_SAMPLES];
+	Category category;
+	(void)count;
+	(void)history;
+
+	if (parseCategory(words[2], &category) == 0) return writeError(out, "Invalid category!");
+
+	int found = getHistorySamples(serv->consumption, words[1], category, samples, sizeof(samples) / sizeof(samples[0]));
+	if (found == 0) return writeError(out, "The product does not exist!");
+
+	for (int i = 0; i < found; i++)
+	{
+		writeInteger(out, samples[i].minute);
+		writeChars(out, " ", 1);
+		writeQuantity(out, samples[i].quantity);
+		writeChars(out, "\n", 1);
+	}
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Writes the statistics of the query cache: cache-stats
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>Always 1</returns>
+static int commandCacheStats(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	CacheStats stats;
+	(void)words;
+	(void)count;
+	(void)history;
+
+	getCacheStats(serv->cache, &stats);
+
+	writeText(out, "Cache: ");
+	writeInteger(out, stats.hits);
+	writeText(out, " hits, ");
+	writeInteger(out, stats.misses);
+	writeText(out, " misses, ");
+	writeInteger(out, stats.evictions);
+	writeText(out, " evictions, ");
+	writeInteger(out, stats.invalidations);
+	writeText(out, " invalidations.\n");
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Undoes the last change: undo
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandUndo(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)words;
+	(void)count;
+	(void)history;
+
+	if (undoOperation(serv) == 0) return writeError(out, "Failed to undo previous operation.");
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Redoes the last undone change: redo
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandRedo(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)words;
+	(void)count;
+	(void)history;
+
+	if (redoOperation(serv) == 0) return writeError(out, "Failed to redo previous operation.");
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Lists the archived products whose name contains a string: archived [text]
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandArchived(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)history;
+
+	if (serv->archive == NULL) return writeError(out, "There is no archive!");
+
+	ProductRepo* repo = filterArchiveByString(serv->archive, count == 2 ? words[1] : "");
+	if (repo == NULL) return writeError(out, "Could not list the products due to memory issues.");
+	return writeListing(out, repo);
+}
+
+/// <summary>
+/// Moves the cold products to the archive: sweep
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandSweep(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	(void)words;
+	(void)count;
+
+	if (serv->archive == NULL) return writeError(out, "There is no archive!");
+
+	if (history == 1) addSweepToUndoStack(serv);
+	else clearHistory(serv);
+
+	int swept = sweepService(serv, currentDate(), INT_MAX);
+	if (swept == 0 && history == 1) popUndoStack(serv);
+
+	writeText(out, "Archived ");
+	writeInteger(out, swept);
+	writeText(out, " products.\n");
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Imports the products of a CSV or JSON file: import path
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandImport(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	TransferStats stats;
+	(void)count;
+
+	beginChange(serv, history);
+	if (importProducts(serv, words[1], formatFromPath(words[1]), &stats) == 0 || stats.products == 0)
+	{
+		if (history == 1) popUndoStack(serv);
+		return writeError(out, "The file does not contain any valid products!");
+	}
+
+	return writeSuccess(out);
+}
+
+/// <summary>
+/// Exports the products to a CSV or JSON file: export path
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="words">The words of the command</param>
+/// <param name="count">The number of words</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0, otherwise</returns>
+static int commandExport(Service* serv, Writer* out, char* words[], int count, int history)
+{
+	TransferStats stats;
+	(void)count;
+	(void)history;
+
+	if (exportProducts(getRepo(serv), words[1], formatFromPath(words[1]), &stats) == 0)
+		return writeError(out, "The file could not be written!");
+
+	return writeSuccess(out);
+}
+
+// Every command by name, with the number of words it takes including its name
+static const ScriptCommand commands[] =
+{
+	{ "add", 5, 5, "Usage: add|update <name> <category> <quantity> <YYYY-MM-DD>", commandAdd },
+	{ "update", 5, 5, "Usage: add|update <name> <category> <quantity> <YYYY-MM-DD>", commandUpdate },
+	{ "delete", 3, 3, "Usage: delete <name> <category>", commandDelete },
+	{ "list", 1, 1, NULL, commandList },
+	{ "list-name", 1, 1, NULL, commandListByName },
+	{ "filter", 1, 2, NULL, commandFilter },
+	{ "filter-i", 1, 2, NULL, commandFilterIgnoreCase },
+	{ "find-i", 2, 2, NULL, commandFindIgnoreCase },
+	{ "top", 3, 4, NULL, commandTop },
+	{ "top-after", 4, 5, NULL, commandTopAfter },
+	{ "top-exp", 4, 5, NULL, commandTopExpiring },
+	{ "filter-exp", 3, 3, NULL, commandFilterExpiring },
+	{ "watch-exp", 3, 3, NULL, commandWatchExpiring },
+	{ "filter-low", 3, 3, NULL, commandFilterLow },
+	{ "watch-low", 3, 3, NULL, commandWatchLow },
+	{ "summary", 1, 2, NULL, commandSummary },
+	{ "complete", 2, 3, NULL, commandComplete },
+	{ "suggest", 2, 3, NULL, commandSuggest },
+	{ "range", 3, 4, NULL, commandRange },
+	{ "rank", 2, 2, NULL, commandRank },
+	{ "select", 2, 2, NULL, commandSelect },
+	{ "median", 1, 1, NULL, commandMedian },
+	{ "forecast", 1, 2, NULL, commandForecast },
+	{ "history", 3, 3, NULL, commandHistory },
+	{ "cache-stats", 1, 1, NULL, commandCacheStats },
+	{ "undo", 1, 1, NULL, commandUndo },
+	{ "redo", 1, 1, NULL, commandRedo },
+	{ "archived", 1, 2, NULL, commandArchived },
+	{ "sweep", 1, 1, NULL, commandSweep },
+	{ "import", 2, 2, NULL, commandImport },
+	{ "export", 2, 2, NULL, commandExport },
+};
+
+/// <summary>
+/// Executes a single command of the script language and writes its result
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="line">The command line, it is modified in place</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the command succeeded,
+///			 0 if it failed,
+///			 -1 if the line is empty or a comment</returns>
+int executeCommand(Service* serv, Writer* out, char* line, int history)
+{
+	char* words[SCRIPT_MAX_ARGUMENTS];
+
+	int count = splitWords(line, words);
+	if (count == 0 || words[0][0] == '#') return -1;
+	if (count < 0) return writeError(out, "Too many arguments!");
+
+	for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+	{
+		const ScriptCommand* command = &commands[i];
+		if (strcmp(words[0], command->name) != 0) continue;
+
+		if (count >= command->minWords && count <= command->maxWords) return command->handler(serv, out, words, count, history);
+		if (command->usage != NULL) return writeError(out, command->usage);
+		break;
+	}
+
+	return writeError(out, "Unknown command!");
+}
+
+/// <summary>
+/// Runs every command of a script, without prompts or menus
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="input">The file to read the commands from</param>
+/// <param name="out">A pointer to the writer for the results</param>
+/// <param name="timing">1 if the duration of each command should be written</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <param name="stats">A pointer to the statistics of the run</param>
+/// <returns>1 if every command succeeded,
+///			 0, otherwise</returns>
+int runScript(Service* serv, FILE* input, Writer* out, int timing, int history, ScriptStats* stats)
+{
+	char* line = malloc(SCRIPT_MAX_LINE);
+	if (line == NULL) return 0;
+
+	memset(stats, 0, sizeof(ScriptStats));
+	double start = wallSeconds();
+
+	while (fgets(line, SCRIPT_MAX_LINE, input) != NULL)
+	{
+		// The rest of a line that does not fit is skipped
+		if (strchr(line, '\n') == NULL && !feof(input))
+		{
+			int c;
+			while ((c = fgetc(input)) != '\n' && c != EOF);
+
+			stats->commands++;
+			stats->failures++;
+			writeError(out, "Line too long!");
+			continue;
+		}
+
+		double commandStart = timing == 1 ? wallSeconds() : 0;
+		int result = executeCommand(serv, out, line, history);
+		if (result == -1) continue;
+
+		stats->commands++;
+		if (result == 0) stats->failures++;
+
+		if (timing == 1)
+		{
+			writeText(out, "# ");
+			writeInteger(out, (long long)((wallSeconds() - commandStart) * 1e9));
+			writeText(out, " ns\n");
+		}
+	}
+
+	stats->seconds = wallSeconds() - start;
+	flushWriter(out);
+	free(line);
+
+	return stats->failures == 0;
+}
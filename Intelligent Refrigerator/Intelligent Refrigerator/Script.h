@@ -0,0 +1,18 @@
+#pragma once
+#include <stdio.h>
+
+#include "Service.h"
+#include "Writer.h"
+
+#define SCRIPT_MAX_LINE 4096
+#define SCRIPT_MAX_ARGUMENTS 8
+
+typedef struct
+{
+	long long commands;
+	long long failures;
+	double seconds;
+} ScriptStats;
+
+int executeCommand(Service* serv, Writer* out, char* line, int history);
+int runScript(Service* serv, FILE* input, Writer* out, int timing, int history, ScriptStats* stats);
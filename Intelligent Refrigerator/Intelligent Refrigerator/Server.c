@@ -0,0 +1,693 @@
+#ifdef __linux__
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "Server.h"
+#include "Sweeper.h"
+
+/// <summary>
+/// Creates the state of a client connection
+/// </summary>
+/// <param name="fd">The socket of the connection</param>
+/// <returns>A pointer to the connection</returns>
+ServerConnection* createConnection(int fd)
+{
+	ServerConnection* conn = malloc(sizeof(ServerConnection));
+	if (conn == NULL) return NULL;
+
+	conn->out = createWriter(NULL);
+	if (conn->out == NULL)
+	{
+		free(conn);
+		return NULL;
+	}
+
+	conn->fd = fd;
+	conn->inputLength = 0;
+	conn->skipping = 0;
+	conn->closing = 0;
+	conn->events = 0;
+	conn->slot = -1;
+	return conn;
+}
+
+/// <summary>
+/// Destroys the state of a client connection, the socket stays open
+/// </summary>
+/// <param name="conn">A pointer to the connection</param>
+void destroyConnection(ServerConnection* conn)
+{
+	if (conn == NULL) return;
+
+	destroyWriter(conn->out);
+	free(conn);
+
+	conn = NULL;
+}
+
+/// <summary>
+/// Checks if a request asks the server to stop
+/// </summary>
+/// <param name="line">The request</param>
+/// <returns>1 if it is a shutdown request,
+///			 0, otherwise</returns>
+static int isShutdown(const char* line)
+{
+	while (*line == ' ' || *line == '\t') line++;
+	if (strncmp(line, "shutdown", 8) != 0) return 0;
+
+	for (line += 8; *line != '\0'; line++)
+		if (*line != ' ' && *line != '\t' && *line != '\r' && *line != '\n') return 0;
+
+	return 1;
+}
+
+/// <summary>
+/// Executes every complete request in the received data and buffers the responses
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="conn">A pointer to the connection</param>
+/// <param name="data">The received data, it may end in the middle of a request</param>
+/// <param name="length">The number of bytes received</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>The number of requests that were answered,
+///			 -1 if a shutdown was requested</returns>
+int receiveRequests(Service* serv, ServerConnection* conn, const char* data, size_t length, int history)
+{
+	int answered = 0;
+
+	while (length > 0)
+	{
+		const char* newline = memchr(data, '\n', length);
+		size_t chunk = newline != NULL ? (size_t)(newline - data) + 1 : length;
+
+		if (conn->skipping == 1)
+		{
+			conn->skipping = newline == NULL;
+		}
+		else if (conn->inputLength + chunk >= SCRIPT_MAX_LINE)
+		{
+			// The rest of a request that does not fit is dropped
+			writeText(conn->out, "ERROR: Line too long!\n");
+			answered++;
+
+			conn->inputLength = 0;
+			conn->skipping = newline == NULL;
+		}
+		else
+		{
+			memcpy(conn->input + conn->inputLength, data, chunk);
+			conn->inputLength += chunk;
+
+			if (newline != NULL)
+			{
+				conn->input[conn->inputLength] = '\0';
+				conn->inputLength = 0;
+
+				if (isShutdown(conn->input))
+				{
+					writeText(conn->out, "OK\n");
+					return -1;
+				}
+				if (executeCommand(serv, conn->out, conn->input, history) != -1) answered++;
+			}
+		}
+
+		data += chunk;
+		length -= chunk;
+	}
+
+	return answered;
+}
+
+#ifdef __linux__
+/// <summary>
+/// Gets the current wall clock time
+/// </summary>
+/// <returns>The time in seconds</returns>
+static double wallSeconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// <summary>
+/// Makes the operations on a socket return instead of waiting
+/// </summary>
+/// <param name="fd">The socket</param>
+/// <returns>1 if the socket is non-blocking,
+///			 0, otherwise</returns>
+static int setNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+/// <summary>
+/// Fills the address of a Unix domain socket
+/// </summary>
+/// <param name="address">A pointer to the address</param>
+/// <param name="path">The path of the socket</param>
+/// <returns>1 if the path fits in the address,
+///			 0, otherwise</returns>
+static int socketAddress(struct sockaddr_un* address, const char* path)
+{
+	memset(address, 0, sizeof(struct sockaddr_un));
+	if (strlen(path) >= sizeof(address->sun_path)) return 0;
+
+	address->sun_family = AF_UNIX;
+	strcpy(address->sun_path, path);
+	return 1;
+}
+
+/// <summary>
+/// Sends as many buffered responses as the socket accepts without waiting
+/// </summary>
+/// <param name="conn">A pointer to the connection</param>
+/// <returns>1 if the connection is still usable,
+///			 0, otherwise</returns>
+static int sendResponses(ServerConnection* conn)
+{
+	while (conn->out->length > 0)
+	{
+		ssize_t sent = send(conn->fd, conn->out->buffer, conn->out->length, MSG_NOSIGNAL);
+		if (sent > 0)
+		{
+			discardWriter(conn->out, (size_t)sent);
+			continue;
+		}
+
+		if (sent == -1 && errno == EINTR) continue;
+		return sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	return 1;
+}
+
+/// <summary>
+/// Reads the available data of a connection and answers its requests
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="conn">A pointer to the connection</param>
+/// <param name="buffer">A buffer of SERVER_READ_SIZE bytes</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the connection is still usable,
+///			 0 if it failed,
+///			 -1 if a shutdown was requested</returns>
+static int readRequests(Service* serv, ServerConnection* conn, char* buffer, int history)
+{
+	ssize_t received = read(conn->fd, buffer, SERVER_READ_SIZE);
+
+	if (received > 0)
+		return receiveRequests(serv, conn, buffer, (size_t)received, history) == -1 ? -1 : 1;
+
+	// The client stopped sending, the responses it is still owed are sent first
+	if (received == 0)
+	{
+		conn->closing = 1;
+		return 1;
+	}
+
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+/// <summary>
+/// Updates the events the event loop waits for on a connection
+/// </summary>
+/// <param name="loop">The epoll instance</param>
+/// <param name="conn">A pointer to the connection</param>
+/// <returns>1 if the connection is still usable,
+///			 0 if it is done or failed</returns>
+static int watchConnection(int loop, ServerConnection* conn)
+{
+	if (conn->closing == 1 && conn->out->length == 0) return 0;
+
+	// Clients that do not read their responses are not read from either
+	unsigned int events = 0;
+	if (conn->closing == 0 && conn->out->length < SERVER_MAX_PENDING) events |= EPOLLIN;
+	if (conn->out->length > 0) events |= EPOLLOUT;
+
+	if (events == conn->events) return 1;
+
+	struct epoll_event event = { 0 };
+	event.events = events;
+	event.data.ptr = conn;
+	if (epoll_ctl(loop, EPOLL_CTL_MOD, conn->fd, &event) == -1) return 0;
+
+	conn->events = events;
+	return 1;
+}
+
+/// <summary>
+/// Accepts every pending client
+/// </summary>
+/// <param name="loop">The epoll instance</param>
+/// <param name="listener">The listening socket</param>
+/// <param name="connections">The open connections</param>
+/// <param name="count">The number of open connections</param>
+/// <param name="capacity">The capacity of the connection list</param>
+static void acceptClients(int loop, int listener, ServerConnection*** connections, int* count, int* capacity)
+{
+	while (1)
+	{
+		int fd = accept(listener, NULL, NULL);
+		if (fd == -1) return;
+
+		ServerConnection* conn = NULL;
+		if (setNonBlocking(fd) == 1) conn = createConnection(fd);
+		if (conn == NULL)
+		{
+			close(fd);
+			continue;
+		}
+
+		if (*count == *capacity)
+		{
+			*capacity *= REPOSITORY_SIZE_SCALE;
+
+			ServerConnection** tmp = NULL;
+			while (tmp == NULL) tmp = realloc(*connections, *capacity * sizeof(ServerConnection*));
+			*connections = tmp;
+		}
+
+		struct epoll_event event = { 0 };
+		event.events = EPOLLIN;
+		event.data.ptr = conn;
+		if (epoll_ctl(loop, EPOLL_CTL_ADD, fd, &event) == -1)
+		{
+			destroyConnection(conn);
+			close(fd);
+			continue;
+		}
+
+		conn->events = EPOLLIN;
+		conn->slot = *count;
+		(*connections)[(*count)++] = conn;
+	}
+}
+
+/// <summary>
+/// Closes a connection and removes it from the connection list
+/// </summary>
+/// <param name="conn">A pointer to the connection</param>
+/// <param name="connections">The open connections</param>
+/// <param name="count">The number of open connections</param>
+static void closeConnection(ServerConnection* conn, ServerConnection** connections, int* count)
+{
+	connections[conn->slot] = connections[--(*count)];
+	connections[conn->slot]->slot = conn->slot;
+
+	close(conn->fd);
+	destroyConnection(conn);
+}
+
+/// <summary>
+/// Moves a batch of cold products to the archive while no client is waiting
+/// </summary>
+/// <param name="serv">A pointer to the service, with an archive attached</param>
+/// <param name="history">1 if changes can be undone</param>
+static void sweepIdle(Service* serv, int history)
+{
+	Date today = currentDate();
+
+	// The undo state is only saved when there is something to sweep
+	if (hasColdProducts(getRepo(serv), daysFromCivil(today)) == 0) return;
+
+	if (history == 1) addSweepToUndoStack(serv);
+	else clearHistory(serv);
+
+	if (sweepService(serv, today, SWEEPER_DEFAULT_BATCH) == 0 && history == 1) popUndoStack(serv);
+	if (serv->shipper != NULL) flushShipper(serv->shipper);
+}
+
+/// <summary>
+/// Serves requests from clients on a Unix domain socket until a shutdown is requested
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="path">The path of the socket</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>1 if the server stopped on request,
+///			 0 if it could not be started or failed</returns>
+int runServer(Service* serv, const char* path, int history)
+{
+	struct sockaddr_un address;
+	if (socketAddress(&address, path) == 0) return 0;
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == -1) return 0;
+
+	unlink(path);
+	if (bind(listener, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1 || setNonBlocking(listener) == 0)
+	{
+		close(listener);
+		return 0;
+	}
+
+	// The listener is the only watched socket without a connection
+	int loop = epoll_create1(0);
+	struct epoll_event event = { 0 };
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	char* buffer = malloc(SERVER_READ_SIZE);
+	int capacity = SERVER_MAX_EVENTS;
+	int count = 0;
+	ServerConnection** connections = malloc(capacity * sizeof(ServerConnection*));
+
+	if (loop == -1 || buffer == NULL || connections == NULL || epoll_ctl(loop, EPOLL_CTL_ADD, listener, &event) == -1)
+	{
+		if (loop != -1) close(loop);
+		free(buffer);
+		free(connections);
+		close(listener);
+		unlink(path);
+		return 0;
+	}
+
+	struct epoll_event events[SERVER_MAX_EVENTS];
+	int result = 0;
+	int running = 1;
+
+	// With an archive, the server sweeps whenever it was idle for an interval
+	int timeout = serv->archive != NULL ? SWEEPER_DEFAULT_INTERVAL : -1;
+
+	while (running)
+	{
+		int ready = epoll_wait(loop, events, SERVER_MAX_EVENTS, timeout);
+		if (ready == -1)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (ready == 0)
+		{
+			sweepIdle(serv, history);
+			continue;
+		}
+
+		for (int i = 0; i < ready; i++)
+		{
+			ServerConnection* conn = events[i].data.ptr;
+			if (conn == NULL)
+			{
+				acceptClients(loop, listener, &connections, &count, &capacity);
+				continue;
+			}
+
+			int usable = 1;
+			if (conn->closing == 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+			{
+				int status = readRequests(serv, conn, buffer, history);
+				if (status == -1)
+				{
+					running = 0;
+					result = 1;
+				}
+				usable = status != 0;
+			}
+
+			if (usable == 1) usable = sendResponses(conn);
+			if (usable == 1) usable = watchConnection(loop, conn);
+			if (usable == 0) closeConnection(conn, connections, &count);
+		}
+
+		// The changes of one round go to the standby together, a busy server sends larger batches
+		if (serv->shipper != NULL) flushShipper(serv->shipper);
+	}
+
+	// Responses that fit in the socket buffers are still delivered
+	while (count > 0)
+	{
+		sendResponses(connections[0]);
+		closeConnection(connections[0], connections, &count);
+	}
+
+	free(connections);
+	free(buffer);
+	close(loop);
+	close(listener);
+	unlink(path);
+
+	return result;
+}
+
+typedef struct
+{
+	int fd;
+	Writer* requests; // Requests that were not sent yet
+	int issued;
+	int answered;
+	double batchStart;
+	char line[8]; // Start of the response line being received
+	int lineLength;
+} LoadClient;
+
+/// <summary>
+/// Compares two latencies
+/// </summary>
+/// <param name="a">A pointer to the first latency</param>
+/// <param name="b">A pointer to the second latency</param>
+/// <returns>A negative value, zero or a positive value, like strcmp</returns>
+static int compareLatencies(const void* a, const void* b)
+{
+	double first = *(const double*)a;
+	double second = *(const double*)b;
+
+	return (first > second) - (first < second);
+}
+
+/// <summary>
+/// Queues the next batch of requests of a load generator client
+/// </summary>
+/// <param name="client">A pointer to the client</param>
+/// <param name="index">The index of the client</param>
+/// <param name="requests">The number of requests the client sends in total</param>
+/// <param name="pipeline">The number of requests sent without waiting</param>
+static void queueRequests(LoadClient* client, int index, int requests, int pipeline)
+{
+	char request[96];
+
+	for (int i = 0; i < pipeline && client->issued < requests; i++, client->issued++)
+	{
+		int j = client->issued;
+		int length;
+
+		// Mostly changes, with a search for the client's own products now and then
+		if (j % 4 == 3)
+			length = snprintf(request, sizeof(request), "filter load%d-\n", index);
+		else if (j % 4 == 2)
+			length = snprintf(request, sizeof(request), "update load%d-%d dairy %d 2022-04-15\n", index, (j - 1) % 100, j % 50);
+		else
+			length = snprintf(request, sizeof(request), "add load%d-%d dairy 1 2022-03-15\n", index, j % 100);
+
+		writeChars(client->requests, request, (size_t)length);
+	}
+
+	client->batchStart = wallSeconds();
+}
+
+/// <summary>
+/// Scans received data for the end of responses and records their latencies
+/// </summary>
+/// <param name="client">A pointer to the client</param>
+/// <param name="data">The received data</param>
+/// <param name="length">The number of bytes received</param>
+/// <param name="stats">A pointer to the statistics of the run</param>
+/// <param name="latencies">The latencies of the requests answered so far</param>
+static void scanResponses(LoadClient* client, const char* data, size_t length, LoadStats* stats, double* latencies)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		if (data[i] != '\n')
+		{
+			if (client->lineLength < (int)sizeof(client->line)) client->line[client->lineLength] = data[i];
+			client->lineLength++;
+			continue;
+		}
+
+		int ok = client->lineLength == 2 && strncmp(client->line, "OK", 2) == 0;
+		int error = client->lineLength >= 7 && strncmp(client->line, "ERROR: ", 7) == 0;
+		client->lineLength = 0;
+
+		if (ok == 0 && error == 0) continue;
+
+		latencies[stats->requests++] = (wallSeconds() - client->batchStart) * 1000;
+		client->answered++;
+		if (error == 1) stats->errors++;
+	}
+}
+
+/// <summary>
+/// Sends requests to a server over several connections and measures its throughput and latency
+/// </summary>
+/// <param name="path">The path of the server socket</param>
+/// <param name="clients">The number of connections</param>
+/// <param name="requests">The number of requests per connection</param>
+/// <param name="pipeline">The number of requests sent without waiting for responses</param>
+/// <param name="stats">A pointer to the statistics of the run</param>
+/// <returns>1 if every request was answered,
+///			 0, otherwise</returns>
+int runLoadGenerator(const char* path, int clients, int requests, int pipeline, LoadStats* stats)
+{
+	memset(stats, 0, sizeof(LoadStats));
+
+	struct sockaddr_un address;
+	if (clients < 1 || requests < 1 || pipeline < 1 || socketAddress(&address, path) == 0) return 0;
+
+	LoadClient* states = calloc(clients, sizeof(LoadClient));
+	struct pollfd* watched = calloc(clients, sizeof(struct pollfd));
+	double* latencies = malloc((size_t)clients * requests * sizeof(double));
+	char* buffer = malloc(SERVER_READ_SIZE);
+	int connected = 0;
+
+	if (states != NULL && watched != NULL && latencies != NULL && buffer != NULL)
+	{
+		for (connected = 0; connected < clients; connected++)
+		{
+			LoadClient* client = &states[connected];
+
+			client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (client->fd == -1) break;
+
+			client->requests = createWriter(NULL);
+			if (client->requests == NULL || connect(client->fd, (struct sockaddr*)&address, sizeof(address)) == -1 || setNonBlocking(client->fd) == 0)
+			{
+				destroyWriter(client->requests);
+				close(client->fd);
+				break;
+			}
+
+			watched[connected].fd = client->fd;
+		}
+	}
+
+	int result = connected == clients;
+	double start = wallSeconds();
+	int remaining = result == 1 ? clients : 0;
+
+	while (remaining > 0)
+	{
+		for (int i = 0; i < clients; i++)
+		{
+			LoadClient* client = &states[i];
+
+			// A new batch goes out once the previous one is fully answered
+			if (client->answered == client->issued && client->issued < requests)
+				queueRequests(client, i, requests, pipeline);
+
+			watched[i].events = 0;
+			if (client->answered < client->issued) watched[i].events = POLLIN;
+			if (client->requests->length > 0) watched[i].events |= POLLOUT;
+		}
+
+		if (poll(watched, clients, -1) == -1)
+		{
+			if (errno == EINTR) continue;
+			result = 0;
+			break;
+		}
+
+		for (int i = 0; i < clients && result == 1; i++)
+		{
+			LoadClient* client = &states[i];
+
+			if ((watched[i].revents & POLLOUT) != 0)
+			{
+				ssize_t sent = send(client->fd, client->requests->buffer, client->requests->length, MSG_NOSIGNAL);
+				if (sent > 0) discardWriter(client->requests, (size_t)sent);
+				else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) result = 0;
+			}
+
+			if ((watched[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+			{
+				ssize_t received = recv(client->fd, buffer, SERVER_READ_SIZE, 0);
+				if (received > 0)
+				{
+					int wasDone = client->answered == requests;
+					scanResponses(client, buffer, (size_t)received, stats, latencies);
+					if (wasDone == 0 && client->answered == requests) remaining--;
+				}
+				else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+				{
+					result = 0;
+				}
+			}
+		}
+
+		if (result == 0) break;
+	}
+
+	stats->seconds = wallSeconds() - start;
+	if (stats->requests > 0)
+	{
+		qsort(latencies, (size_t)stats->requests, sizeof(double), compareLatencies);
+		stats->p50 = latencies[(stats->requests - 1) * 50 / 100];
+		stats->p99 = latencies[(stats->requests - 1) * 99 / 100];
+	}
+
+	for (int i = 0; i < connected; i++)
+	{
+		destroyWriter(states[i].requests);
+		close(states[i].fd);
+	}
+
+	free(buffer);
+	free(latencies);
+	free(watched);
+	free(states);
+
+	return result;
+}
+#else
+/// <summary>
+/// Serves requests from clients on a Unix domain socket, only available on Linux
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="path">The path of the socket</param>
+/// <param name="history">1 if changes can be undone</param>
+/// <returns>Always 0</returns>
+int runServer(Service* serv, const char* path, int history)
+{
+	(void)serv;
+	(void)path;
+	(void)history;
+
+	return 0;
+}
+
+/// <summary>
+/// Measures the throughput and latency of a server, only available on Linux
+/// </summary>
+/// <param name="path">The path of the server socket</param>
+/// <param name="clients">The number of connections</param>
+/// <param name="requests">The number of requests per connection</param>
+/// <param name="pipeline">The number of requests sent without waiting for responses</param>
+/// <param name="stats">A pointer to the statistics of the run</param>
+/// <returns>Always 0</returns>
+int runLoadGenerator(const char* path, int clients, int requests, int pipeline, LoadStats* stats)
+{
+	(void)path;
+	(void)clients;
+	(void)requests;
+	(void)pipeline;
+
+	memset(stats, 0, sizeof(LoadStats));
+	return 0;
+}
+#endif
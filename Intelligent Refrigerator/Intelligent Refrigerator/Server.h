@@ -0,0 +1,41 @@
+#pragma once
+#include "Service.h"
+#include "Writer.h"
+#include "Script.h"
+
+#define SERVER_DEFAULT_PATH "fridge.sock"
+#define SERVER_MAX_EVENTS 64
+#define SERVER_READ_SIZE 65536
+#define SERVER_MAX_PENDING (1 << 20)
+
+// Requests are lines of the script language, any number of them can be sent
+// without waiting. Every request is answered in order by its listing lines, if
+// any, followed by a line that is either "OK" or starts with "ERROR: ".
+// Empty lines and comments are not answered. "shutdown" stops the server.
+typedef struct
+{
+	int fd;
+	char input[SCRIPT_MAX_LINE]; // Start of a request that is not complete yet
+	size_t inputLength;
+	int skipping; // The current request is too long and is being dropped
+	int closing; // The client stopped sending
+	Writer* out; // Responses that were not sent yet
+	unsigned int events; // Events the event loop waits for
+	int slot; // Position in the list of open connections
+} ServerConnection;
+
+typedef struct
+{
+	long long requests;
+	long long errors;
+	double seconds;
+	double p50; // Latencies in milliseconds
+	double p99;
+} LoadStats;
+
+ServerConnection* createConnection(int fd);
+void destroyConnection(ServerConnection* conn);
+int receiveRequests(Service* serv, ServerConnection* conn, const char* data, size_t length, int history);
+
+int runServer(Service* serv, const char* path, int history);
+int runLoadGenerator(const char* path, int clients, int requests, int pipeline, LoadStats* stats);
@@ -1,9 +1,11 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
 
 #include "Service.h"
+#include "Parallel.h"
 
 /// <summary>
 /// Creates the service
@@ -16,26 +18,65 @@ Service* createService(ProductRepo* repo, int init)
 	Service* serv = malloc(sizeof(Service));
 	if (serv == NULL) return NULL;
 
-	serv->undoStack = malloc(REPOSITORY_INITIAL_SIZE * sizeof(ProductRepo*));
+	serv->undoStack = malloc(REPOSITORY_INITIAL_SIZE * sizeof(UndoState));
 	if (serv->undoStack == NULL)
 	{
 		free(serv);
 		return NULL;
 	}
 
-	serv->redoStack = malloc(REPOSITORY_INITIAL_SIZE * sizeof(ProductRepo*));
+	serv->redoStack = malloc(REPOSITORY_INITIAL_SIZE * sizeof(UndoState));
 	if (serv->redoStack == NULL)
 	{
 		free(serv->undoStack);
 		free(serv);
 		return NULL;
 	}
+	serv->views = malloc(VIEW_INITIAL_COUNT * sizeof(MaterializedView*));
+	if (serv->views == NULL)
+	{
+		free(serv->redoStack);
+		free(serv->undoStack);
+		free(serv);
+		return NULL;
+	}
+	serv->viewCapacity = VIEW_INITIAL_COUNT;
+	serv->viewLength = 0;
+
+	serv->cache = createQueryCache(CACHE_CAPACITY);
+	if (serv->cache == NULL)
+	{
+		free(serv->views);
+		free(serv->redoStack);
+		free(serv->undoStack);
+		free(serv);
+		return NULL;
+	}
+	serv->version = 0;
+
+	serv->consumption = createConsumptionLog();
+	if (serv->consumption == NULL)
+	{
+		destroyQueryCache(serv->cache);
+		free(serv->views);
+		free(serv->redoStack);
+		free(serv->undoStack);
+		free(serv);
+		return NULL;
+	}
+
 	serv->undoCapacity = REPOSITORY_INITIAL_SIZE;
 	serv->redoCapacity = REPOSITORY_INITIAL_SIZE;
 	serv->undoLength = 0;
 	serv->redoLength = 0;
 
+	serv->journal = NULL;
+	serv->wheel = NULL;
+	serv->publication = NULL;
+	serv->shipper = NULL;
+	serv->archive = NULL;
 	serv->repo = repo;
+	syncConsumptionLog(serv->consumption, repo, currentMinute());
 	if (init == 1)
 	{
 		addProductService(serv, "milk", dairy, 1, date(2022, 3, 15));
@@ -65,17 +106,299 @@ void destroyService(Service* serv)
 	destroyRepo(serv->repo);
 
 	for (int i = 0; i < serv->undoLength; i++)
-		destroyRepo(serv->undoStack[i]);
+		destroyRepo(serv->undoStack[i].repo);
 	free(serv->undoStack);
 
 	for (int i = 0; i < serv->redoLength; i++)
-		destroyRepo(serv->redoStack[i]);
+		destroyRepo(serv->redoStack[i].repo);
 	free(serv->redoStack);
 
+	closeJournal(serv->journal);
+	destroyExpiryWheel(serv->wheel);
+	for (int i = 0; i < serv->viewLength; i++)
+		destroyView(serv->views[i]);
+	free(serv->views);
+	destroyQueryCache(serv->cache);
+	destroyConsumptionLog(serv->consumption);
+	closePublication(serv->publication);
+	destroyShipper(serv->shipper);
+	destroyArchive(serv->archive);
 	free(serv);
 	serv = NULL;
 }
 
+/// <summary>
+/// Attaches a journal that records every change made through the service,
+/// the service takes ownership of the journal
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="journal">A pointer to the journal, NULL to detach it</param>
+void attachJournal(Service* serv, Journal* journal)
+{
+	if (serv->journal != journal) closeJournal(serv->journal);
+	serv->journal = journal;
+}
+
+/// <summary>
+/// Attaches a timer wheel that is kept in step with every change made through the service,
+/// the service takes ownership of the wheel
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="wheel">A pointer to the wheel, NULL to detach it</param>
+void attachExpiryWheel(Service* serv, ExpiryWheel* wheel)
+{
+	if (serv->wheel != wheel) destroyExpiryWheel(serv->wheel);
+	serv->wheel = wheel;
+
+	if (wheel != NULL) syncExpiryWheel(wheel, serv->repo);
+}
+
+/// <summary>
+/// Publishes the repository to other processes once an operation is complete. The whole
+/// image is written again, an image that does not fit leaves readers on the previous one
+/// and marks it stale. The writer logs when that starts and when the images fit again.
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+static void publishImage(Service* serv)
+{
+	if (serv->publication == NULL) return;
+
+	int stale = atomic_load(&serv->publication->header->staleSince) != 0;
+	int published = publishRepo(serv->publication, serv->repo, serv->version);
+
+	if (published == 0 && stale == 0)
+		fprintf(stderr, "WARNING: %d products do not fit in the published image, readers stay on an older version!\n", getLength(serv->repo));
+	else if (published == 1 && stale == 1)
+		fprintf(stderr, "INFO: The published image is current again.\n");
+}
+
+/// <summary>
+/// Attaches a shared memory segment that an image of the repository is published to
+/// after every change made through the service, the service takes ownership of it
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="pub">A pointer to the publication, NULL to detach it</param>
+void attachPublication(Service* serv, Publication* pub)
+{
+	if (serv->publication != pub) closePublication(serv->publication);
+	serv->publication = pub;
+
+	publishImage(serv);
+}
+
+/// <summary>
+/// Attaches a shipper that sends every change made through the service to a standby,
+/// the service takes ownership of it. The repository is shipped first, so the standby
+/// has to start out empty.
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="shipper">A pointer to the shipper, NULL to detach it</param>
+void attachShipper(Service* serv, Shipper* shipper)
+{
+	if (serv->shipper != shipper) destroyShipper(serv->shipper);
+	serv->shipper = shipper;
+
+	if (shipper != NULL) shipRepo(shipper, serv->repo, serv->archive);
+}
+
+/// <summary>
+/// Attaches an archive that sweepService moves cold products to, the service takes ownership of it
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="archive">A pointer to the archive, NULL to detach it</param>
+void attachArchive(Service* serv, ColdArchive* archive)
+{
+	if (serv->archive != archive) destroyArchive(serv->archive);
+	serv->archive = archive;
+}
+
+/// <summary>
+/// Registers a view that is kept up to date with every change made through the service,
+/// the service takes ownership of the view
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="view">A pointer to a view created on the repository field of the service</param>
+/// <returns>A pointer to the view,
+///			 NULL if it could not be created</returns>
+MaterializedView* registerView(Service* serv, MaterializedView* view)
+{
+	if (view == NULL) return NULL;
+
+	if (serv->viewLength == serv->viewCapacity)
+	{
+		serv->viewCapacity *= REPOSITORY_SIZE_SCALE;
+		MaterializedView** tmp = NULL;
+
+		while (tmp == NULL) tmp = realloc(serv->views, serv->viewCapacity * sizeof(MaterializedView*));
+		serv->views = tmp;
+	}
+
+	serv->views[serv->viewLength++] = view;
+	return view;
+}
+
+/// <summary>
+/// Unregisters and destroys a view, no reader may still be using it
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="view">A pointer to the view</param>
+/// <returns>1 if the view was registered,
+///			 0, otherwise</returns>
+int unregisterView(Service* serv, MaterializedView* view)
+{
+	for (int i = 0; i < serv->viewLength; i++)
+	{
+		if (serv->views[i] == view)
+		{
+			serv->views[i] = serv->views[--serv->viewLength];
+			destroyView(view);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Finds a registered view with the given query
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="kind">The kind of the view</param>
+/// <param name="category">The category of the products, none for every category</param>
+/// <param name="days">The window of expiring views</param>
+/// <param name="quantity">The threshold of low stock views</param>
+/// <returns>A pointer to the view,
+///			 NULL if there is no such view</returns>
+MaterializedView* findView(Service* serv, ViewKind kind, Category category, int days, double quantity)
+{
+	for (int i = 0; i < serv->viewLength; i++)
+	{
+		MaterializedView* view = serv->views[i];
+		if (view->kind != kind || view->category != category) continue;
+
+		if ((kind == viewExpiring && view->days == days) || (kind == viewLowStock && view->units == toQuantity(quantity)))
+			return view;
+	}
+
+	return NULL;
+}
+
+/// <summary>
+/// Moves the window of every expiring view to a new day and publishes the results
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="today">The current date</param>
+void advanceViews(Service* serv, Date today)
+{
+	for (int i = 0; i < serv->viewLength; i++)
+	{
+		advanceView(serv->views[i], today);
+		publishView(serv->views[i]);
+	}
+}
+
+/// <summary>
+/// Tells the query cache, the consumption log, the timer wheel and the views that a product changed
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="current">A pointer to the product as it is now, NULL if it was removed</param>
+static void notifyChange(Service* serv, char* name, Category category, Product* current)
+{
+	serv->version++;
+
+	// Without memory for a sample the history only misses this change
+	if (current != NULL) recordConsumption(serv->consumption, name, category, current->quantity, currentMinute());
+	else forgetConsumption(serv->consumption, name, category);
+
+	if (serv->wheel != NULL)
+	{
+		if (current != NULL) scheduleExpiry(serv->wheel, name, category, current->expiration);
+		else cancelExpiry(serv->wheel, name, category);
+	}
+
+	for (int i = 0; i < serv->viewLength; i++)
+		refreshView(serv->views[i], name, category, current);
+}
+
+/// <summary>
+/// Publishes the views whose results changed during an operation
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+static void publishViews(Service* serv)
+{
+	for (int i = 0; i < serv->viewLength; i++)
+		publishView(serv->views[i]);
+}
+
+/// <summary>
+/// Logs a changed product of the current operation to the journal and the standby
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="type">The type of the record</param>
+/// <param name="operation">The operation that changed the product</param>
+/// <param name="p">A pointer to the product</param>
+static void logRecord(Service* serv, JournalRecordType type, JournalOperation operation, Product* p)
+{
+	if (serv->journal != NULL) writeJournal(serv->journal, type, operation, p);
+	if (serv->shipper != NULL) shipRecord(serv->shipper, type, operation, p);
+}
+
+/// <summary>
+/// Commits the current operation to the journal and the standby
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="operation">The operation to commit</param>
+static void logCommit(Service* serv, JournalOperation operation)
+{
+	// Replay moves the archive to the length it had after the operation
+	int64_t archived = serv->archive != NULL ? getArchiveLength(serv->archive) : -1;
+
+	if (serv->journal != NULL) commitJournal(serv->journal, operation, archived);
+	if (serv->shipper != NULL) commitShipper(serv->shipper, operation, archived);
+}
+
+/// <summary>
+/// Journals the products that differ between two states of the repository
+/// and passes them on to the timer wheel and the views
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="operation">The operation that caused the change</param>
+/// <param name="before">The repository before the operation</param>
+/// <param name="after">The repository after the operation</param>
+static void applyDifference(Service* serv, JournalOperation operation, ProductRepo* before, ProductRepo* after)
+{
+	for (int i = 0; i < getLength(after); i++)
+	{
+		Product* current = getProductAt(after, i);
+		Product* previous = findProductRepo(before, current->name, current->category);
+
+		if (previous == NULL || previous->units != current->units ||
+			previous->expiration.year != current->expiration.year ||
+			previous->expiration.month != current->expiration.month ||
+			previous->expiration.day != current->expiration.day)
+		{
+			logRecord(serv, journalPut, operation, current);
+			notifyChange(serv, current->name, current->category, current);
+		}
+	}
+
+	for (int i = 0; i < getLength(before); i++)
+	{
+		Product* previous = getProductAt(before, i);
+
+		if (findProductRepo(after, previous->name, previous->category) == NULL)
+		{
+			logRecord(serv, journalRemove, operation, previous);
+			notifyChange(serv, previous->name, previous->category, NULL);
+		}
+	}
+
+	logCommit(serv, operation);
+	publishViews(serv);
+}
+
 /// <summary>
 /// Adds a product to the repository
 /// </summary>
@@ -87,14 +410,75 @@ void destroyService(Service* serv)
 /// <returns></returns>
 int addProductService(Service* serv, char* name, Category category, double quantity, Date expiration)
 {
-	Product* p = createProduct(name, category, quantity, expiration);
+	return addProductUnitsService(serv, name, category, toQuantity(quantity), expiration);
+}
+
+/// <summary>
+/// Adds a product to the repository, the quantity is exact
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="units">The quantity of the product, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>1 if the product was added or merged,
+///			 0 if there is not enough memory</returns>
+int addProductUnitsService(Service* serv, char* name, Category category, Quantity units, Date expiration)
+{
+	Product* p = createProductUnits(name, category, units, expiration);
+	if (p == NULL) return 0;
 
 	int ret = addProductRepo(serv->repo, p);
 	if (ret == 0) destroyProduct(p);
 
+	if (ret == 1)
+	{
+		logRecord(serv, journalPut, journalAdd, findProductRepo(serv->repo, name, category));
+		logCommit(serv, journalAdd);
+		notifyChange(serv, name, category, findProductRepo(serv->repo, name, category));
+		publishViews(serv);
+		publishImage(serv);
+	}
+
 	return ret;
 }
 
+/// <summary>
+/// Adds a batch of products to the repository as a single operation
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="products">The products to add, the service takes ownership of all of them</param>
+/// <param name="count">The number of products</param>
+/// <returns>The number of products that were added or merged</returns>
+int addProductsService(Service* serv, Product** products, int count)
+{
+	reserveRepo(serv->repo, getLength(serv->repo) + count);
+
+	int added = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Product* existing = findProductRepo(serv->repo, products[i]->name, products[i]->category);
+
+		if (addProductRepo(serv->repo, products[i]) == 0)
+		{
+			destroyProduct(products[i]);
+			continue;
+		}
+		added++;
+
+		// A merged product keeps the expiration date it already had
+		Product* stored = existing != NULL ? existing : products[i];
+		logRecord(serv, journalPut, journalAdd, stored);
+		notifyChange(serv, stored->name, stored->category, stored);
+	}
+	publishViews(serv);
+	publishImage(serv);
+
+	if (added > 0) logCommit(serv, journalAdd);
+
+	return added;
+}
+
 /// <summary>
 /// Deletes a product from the repository
 /// </summary>
@@ -104,7 +488,27 @@ int addProductService(Service* serv, char* name, Category category, double quant
 /// <returns></returns>
 int deleteProductService(Service* serv, char* name, Category category)
 {
-	return removeProductRepo(getRepo(serv), name, category);
+	Product* current = findProductRepo(getRepo(serv), name, category);
+	if (current == NULL) return 0;
+
+	// The name may belong to the product, which is gone once it is removed
+	char* key = malloc(strlen(name) + 1);
+	if (key == NULL) return 0;
+	strcpy(key, name);
+
+	logRecord(serv, journalRemove, journalDelete, current);
+
+	int ret = removeProductRepo(getRepo(serv), key, category);
+	logCommit(serv, journalDelete);
+	if (ret == 1)
+	{
+		notifyChange(serv, key, category, NULL);
+		publishViews(serv);
+		publishImage(serv);
+	}
+
+	free(key);
+	return ret;
 }
 
 /// <summary>
@@ -118,7 +522,144 @@ int deleteProductService(Service* serv, char* name, Category category)
 /// <returns></returns>
 int updateProductService(Service* serv, char* name, Category category, double quantity, Date expiration)
 {
-	return updateProductRepo(getRepo(serv), name, category, quantity, expiration);
+	return updateProductUnitsService(serv, name, category, toQuantity(quantity), expiration);
+}
+
+/// <summary>
+/// Updates a product from the repository, the quantity is exact
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="units">The quantity of the product, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>1 if the product was updated,
+///			 0 if it does not exist</returns>
+int updateProductUnitsService(Service* serv, char* name, Category category, Quantity units, Date expiration)
+{
+	int ret = updateProductUnitsRepo(getRepo(serv), name, category, units, expiration);
+
+	if (ret == 1)
+	{
+		logRecord(serv, journalPut, journalUpdate, findProductRepo(serv->repo, name, category));
+		logCommit(serv, journalUpdate);
+		notifyChange(serv, name, category, findProductRepo(serv->repo, name, category));
+		publishViews(serv);
+		publishImage(serv);
+	}
+
+	return ret;
+}
+
+/// <summary>
+/// Brings products to the given states as a single operation, later changes of the same product win
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="operation">The operation the changes are journaled as</param>
+/// <param name="changes">The changes, in the order they are applied</param>
+/// <param name="count">The number of changes</param>
+/// <returns>1 if every change was applied,
+///			 0 if there is not enough memory, the changes before it stay applied</returns>
+int applyChangesService(Service* serv, JournalOperation operation, ProductChange* changes, int count)
+{
+	int ret = 1;
+	for (int i = 0; i < count && ret == 1; i++)
+	{
+		ProductChange* change = &changes[i];
+		Product* current = findProductRepo(serv->repo, change->name, change->category);
+
+		if (change->present == 0)
+		{
+			if (current == NULL) continue;
+
+			logRecord(serv, journalRemove, operation, current);
+			removeProductRepo(serv->repo, change->name, change->category);
+			notifyChange(serv, change->name, change->category, NULL);
+			continue;
+		}
+
+		if (current != NULL)
+		{
+			updateProductUnitsRepo(serv->repo, change->name, change->category, change->units, change->expiration);
+		}
+		else
+		{
+			Product* p = createProductUnits(change->name, change->category, change->units, change->expiration);
+			ret = p != NULL && addProductRepo(serv->repo, p);
+			if (ret == 0)
+			{
+				destroyProduct(p);
+				break;
+			}
+			current = findProductRepo(serv->repo, change->name, change->category);
+		}
+
+		logRecord(serv, journalPut, operation, current);
+		notifyChange(serv, change->name, change->category, current);
+	}
+
+	logCommit(serv, operation);
+	publishViews(serv);
+	publishImage(serv);
+	return ret;
+}
+
+/// <summary>
+/// Moves a product to the archive as part of the current operation
+/// </summary>
+/// <param name="serv">A pointer to the service, with an archive attached</param>
+/// <param name="operation">The operation that moves the product</param>
+/// <param name="current">A pointer to the product in the repository</param>
+/// <returns>1 if the product was moved,
+///			 0 if there is not enough memory</returns>
+static int sweepProduct(Service* serv, JournalOperation operation, Product* current)
+{
+	// The name belongs to the product, which is gone once it is removed
+	Category category = current->category;
+	char* key = malloc(strlen(current->name) + 1);
+	if (key == NULL || archiveProduct(serv->archive, current) == 0)
+	{
+		free(key);
+		return 0;
+	}
+	strcpy(key, current->name);
+
+	logRecord(serv, journalArchive, operation, current);
+	logRecord(serv, journalRemove, operation, current);
+	removeProductRepo(serv->repo, key, category);
+	notifyChange(serv, key, category, NULL);
+	free(key);
+	return 1;
+}
+
+/// <summary>
+/// Moves products that expired or ran out from the repository to the archive, as a single
+/// sweep operation. The caller saves an undo state with addSweepToUndoStack before, which
+/// brings the products back out of the archive.
+/// </summary>
+/// <param name="serv">A pointer to the service, with an archive attached</param>
+/// <param name="today">The current date, products that expire before it are cold</param>
+/// <param name="limit">The maximum number of products to move</param>
+/// <returns>The number of products that were moved</returns>
+int sweepService(Service* serv, Date today, int limit)
+{
+	if (serv->archive == NULL) return 0;
+
+	int day = daysFromCivil(today);
+	int swept = 0;
+
+	Product* current;
+	while (swept < limit && (current = findColdProduct(serv->repo, day)) != NULL && sweepProduct(serv, journalSweep, current) == 1)
+		swept++;
+
+	if (swept > 0)
+	{
+		logCommit(serv, journalSweep);
+		publishViews(serv);
+		publishImage(serv);
+	}
+
+	return swept;
 }
 
 /// <summary>
@@ -139,22 +680,126 @@ ProductRepo* getRepo(Service* serv)
 /// <returns>A pointer to a repository that contains the filtered products</returns>
 ProductRepo* filterByString(Service* serv, char* name)
 {
-	ProductRepo* repo = getRepo(serv);
-	ProductRepo* newRepo = createRepo();
+	return filterRepoByString(getRepo(serv), name);
+}
 
-	for (int i = 0; i < repo->length; i++)
+/// <summary>
+/// Filters products by a given string, optionally ignoring case
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="name">The string to match</param>
+/// <param name="match">How the product names are compared to the string</param>
+/// <returns>A pointer to a repository that contains the filtered products</returns>
+ProductRepo* filterByStringMatch(Service* serv, char* name, StringMatch match)
+{
+	return filterRepoByStringMatch(getRepo(serv), name, match);
+}
+
+/// <summary>
+/// Filters products by a given string, repeated queries share the result until the repository changes
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="name">A string to be found in the product names</param>
+/// <returns>A pointer to the shared result, it must not be changed and must be released with releaseResult,
+///			 NULL if there is not enough memory</returns>
+ProductRepo* cachedFilterByString(Service* serv, char* name)
+{
+	// The day lets the lookup drop expiration results of earlier days on the way
+	int day = daysFromCivil(currentDate());
+
+	ProductRepo* result = findCachedResult(serv->cache, queryString, name, none, 0, serv->version, day);
+	if (result != NULL) return result;
+
+	return storeCachedResult(serv->cache, queryString, name, none, 0, serv->version, day, filterByString(serv, name));
+}
+
+/// <summary>
+/// Filters products by category and expiration date, repeated queries share the result
+/// until the repository changes or the day rolls over
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="category">The category of the products</param>
+/// <param name="expiration">The amount of days until products expire</param>
+/// <returns>A pointer to the shared result, it must not be changed and must be released with releaseResult,
+///			 NULL if there is not enough memory</returns>
+ProductRepo* cachedFilterByCategoryAndExpiration(Service* serv, Category category, int expiration)
+{
+	int day = daysFromCivil(currentDate());
+
+	ProductRepo* result = findCachedResult(serv->cache, queryExpiration, NULL, category, expiration, serv->version, day);
+	if (result != NULL) return result;
+
+	return storeCachedResult(serv->cache, queryExpiration, NULL, category, expiration, serv->version, day,
+		filterByCategoryAndExpiration(serv, category, expiration));
+}
+
+/// <summary>
+/// Releases a result returned by a cached filter
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="result">A pointer to the result</param>
+void releaseResult(Service* serv, ProductRepo* result)
+{
+	releaseCachedResult(serv->cache, result);
+}
+
+/// <summary>
+/// Filters the products of a repository by a given string, the repository is only read
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="name">A string to be found in the product names</param>
+/// <returns>A pointer to a repository that contains the filtered products</returns>
+ProductRepo* filterRepoByString(ProductRepo* repo, char* name)
+{
+	return filterRepoByStringMatch(repo, name, matchSubstring);
+}
+
+/// <summary>
+/// Filters the products of a repository by a given string, optionally ignoring case. The names
+/// were folded when the products were created, so only the string is folded here.
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="name">The string to match</param>
+/// <param name="match">How the product names are compared to the string</param>
+/// <returns>A pointer to a repository that contains the filtered products</returns>
+ProductRepo* filterRepoByStringMatch(ProductRepo* repo, char* name, StringMatch match)
+{
+	char buffer[PRODUCT_STRING_SIZE];
+	char* text = name;
+
+	if (match != matchSubstring)
 	{
-		Product* current = getProductAt(repo, i);
+		text = buffer;
+		if (strlen(name) >= sizeof(buffer))
+		{
+			text = NULL;
+			while (text == NULL) text = malloc(strlen(name) + 1);
+		}
+		foldName(name, text);
+	}
+
+	ProductRepo* newRepo;
+	ThreadPool* pool = getParallelPool(repo->length);
+	if (pool != NULL) newRepo = parallelFilterByString(pool, repo, text, match);
+	else
+	{
+		newRepo = createRepo();
 
-		if (strlen(name) == 0 || strstr(current->name, name) != NULL)
+		for (int i = 0; i < repo->length; i++)
 		{
-			Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+			Product* current = getProductAt(repo, i);
 
-			int ret = addProductRepo(newRepo, p);
-			if (ret == 0) destroyProduct(p);
+			if (matchName(current, text, match))
+			{
+				Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
+
+				int ret = addProductRepo(newRepo, p);
+				if (ret == 0) destroyProduct(p);
+			}
 		}
 	}
 
+	if (text != name && text != buffer) free(text);
 	return newRepo;
 }
 
@@ -167,7 +812,21 @@ ProductRepo* filterByString(Service* serv, char* name)
 /// <returns>A pointer to a new repository that contains the filtered products</returns>
 ProductRepo* filterByCategoryAndExpiration(Service* serv, Category category, int expiration)
 {
-	ProductRepo* repo = getRepo(serv);
+	return filterRepoByCategoryAndExpiration(getRepo(serv), category, expiration);
+}
+
+/// <summary>
+/// Filters the products of a repository by category and expiration date, the repository is only read
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="category">The category of the products</param>
+/// <param name="expiration">The amount of days until products expire</param>
+/// <returns>A pointer to a new repository that contains the filtered products</returns>
+ProductRepo* filterRepoByCategoryAndExpiration(ProductRepo* repo, Category category, int expiration)
+{
+	ThreadPool* pool = getParallelPool(repo->length);
+	if (pool != NULL) return parallelFilterByCategoryAndExpiration(pool, repo, category, expiration);
+
 	ProductRepo* newRepo = createRepo();
 
 	time_t now = time(NULL);
@@ -187,7 +846,7 @@ ProductRepo* filterByCategoryAndExpiration(Service* serv, Category category, int
 
 		if (difference <= expiration && (category == none || current->category == category))
 		{
-			Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+			Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
 
 			int ret = addProductRepo(newRepo, p);
 			if (ret == 0) destroyProduct(p);
@@ -197,6 +856,20 @@ ProductRepo* filterByCategoryAndExpiration(Service* serv, Category category, int
 	return newRepo;
 }
 
+/// <summary>
+/// Pairs a copy of the products with the current end of the archive
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="copy">The copy of the products</param>
+/// <returns>The undo or redo state</returns>
+static UndoState undoState(Service* serv, ProductRepo* copy)
+{
+	UndoState entry = { copy, { 0, 0 }, stateCopy };
+	if (serv->archive != NULL) entry.archive = getArchiveMark(serv->archive);
+
+	return entry;
+}
+
 /// <summary>
 /// Adds a repository state to the undo stack
 /// </summary>
@@ -206,16 +879,16 @@ void addToUndoStack(Service* serv)
 {
 	// Clear redo stack
 	for (int i = 0; i < serv->redoLength; i++)
-		destroyRepo(serv->redoStack[i]);
+		destroyRepo(serv->redoStack[i].repo);
 	serv->redoLength = 0;
 
 	// Realloc undo stack if needed
 	if (serv->undoLength == serv->undoCapacity)
 	{
 		serv->undoCapacity *= REPOSITORY_SIZE_SCALE;
-		ProductRepo** tmp = NULL;
+		UndoState* tmp = NULL;
 
-		while (tmp == NULL) tmp = realloc(serv->undoStack, serv->undoCapacity * sizeof(ProductRepo*));
+		while (tmp == NULL) tmp = realloc(serv->undoStack, serv->undoCapacity * sizeof(UndoState));
 		serv->undoStack = tmp;
 	}
 
@@ -225,11 +898,103 @@ void addToUndoStack(Service* serv)
 	{
 		Product* current = getProductAt(serv->repo, i);
 
-		Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
 		int ret = addProductRepo(repoCopy, p);
 		if (ret == 0) destroyProduct(p);
 	}
-	serv->undoStack[serv->undoLength++] = repoCopy;
+	serv->undoStack[serv->undoLength++] = undoState(serv, repoCopy);
+}
+
+/// <summary>
+/// Adds the undo state of a sweep, which only holds the end of the archive before it.
+/// The redo stack is kept, a sweep only moves products that are no longer in use.
+/// </summary>
+/// <param name="serv">A pointer to the service, with an archive attached</param>
+void addSweepToUndoStack(Service* serv)
+{
+	// Realloc undo stack if needed
+	if (serv->undoLength == serv->undoCapacity)
+	{
+		serv->undoCapacity *= REPOSITORY_SIZE_SCALE;
+		UndoState* tmp = NULL;
+
+		while (tmp == NULL) tmp = realloc(serv->undoStack, serv->undoCapacity * sizeof(UndoState));
+		serv->undoStack = tmp;
+	}
+
+	UndoState entry = undoState(serv, NULL);
+	entry.kind = stateSweep;
+	serv->undoStack[serv->undoLength++] = entry;
+}
+
+/// <summary>
+/// Copies the products of the repository that a change set updates
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="names">The products, as a repository or as changes</param>
+/// <param name="changes">The changes, NULL if the products are given as a repository</param>
+/// <param name="count">The number of changes</param>
+/// <returns>A pointer to the copies,
+///			 NULL if there is not enough memory</returns>
+static ProductRepo* copyUpdated(Service* serv, ProductRepo* names, ProductChange* changes, int count)
+{
+	ProductRepo* copy = createRepo();
+	if (copy == NULL) return NULL;
+	if (changes == NULL) count = getLength(names);
+
+	for (int i = 0; i < count; i++)
+	{
+		char* name = changes != NULL ? changes[i].name : getProductAt(names, i)->name;
+		Category category = changes != NULL ? changes[i].category : getProductAt(names, i)->category;
+
+		Product* current = findProductRepo(serv->repo, name, category);
+		if (current == NULL || findProductRepo(copy, name, category) != NULL) continue;
+
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
+		if (p == NULL || appendProductRepo(copy, p) == 0)
+		{
+			destroyProduct(p);
+			destroyRepo(copy);
+			return NULL;
+		}
+	}
+
+	return copy;
+}
+
+/// <summary>
+/// Adds the undo state of an update of existing products, which only holds the products it
+/// changes, so frequent small updates such as sensor readings do not copy the repository
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="changes">The changes that are about to be applied, each of an existing product</param>
+/// <param name="count">The number of changes</param>
+/// <returns>1 if the state was added,
+///			 0 if there is not enough memory</returns>
+int addUpdateToUndoStack(Service* serv, ProductChange* changes, int count)
+{
+	ProductRepo* copy = copyUpdated(serv, NULL, changes, count);
+	if (copy == NULL) return 0;
+
+	// Clear redo stack
+	for (int i = 0; i < serv->redoLength; i++)
+		destroyRepo(serv->redoStack[i].repo);
+	serv->redoLength = 0;
+
+	// Realloc undo stack if needed
+	if (serv->undoLength == serv->undoCapacity)
+	{
+		serv->undoCapacity *= REPOSITORY_SIZE_SCALE;
+		UndoState* tmp = NULL;
+
+		while (tmp == NULL) tmp = realloc(serv->undoStack, serv->undoCapacity * sizeof(UndoState));
+		serv->undoStack = tmp;
+	}
+
+	UndoState entry = undoState(serv, copy);
+	entry.kind = stateUpdate;
+	serv->undoStack[serv->undoLength++] = entry;
+	return 1;
 }
 
 /// <summary>
@@ -239,7 +1004,132 @@ void addToUndoStack(Service* serv)
 void popUndoStack(Service* serv)
 {
 	if (serv->undoLength == 0) return;
-	destroyRepo(serv->undoStack[serv->undoLength-- - 1]);
+	destroyRepo(serv->undoStack[serv->undoLength-- - 1].repo);
+}
+
+/// <summary>
+/// Empties the undo and redo stacks, used when changes are made without history
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+void clearHistory(Service* serv)
+{
+	for (int i = 0; i < serv->undoLength; i++)
+		destroyRepo(serv->undoStack[i].repo);
+	serv->undoLength = 0;
+
+	for (int i = 0; i < serv->redoLength; i++)
+		destroyRepo(serv->redoStack[i].repo);
+	serv->redoLength = 0;
+}
+
+/// <summary>
+/// Undoes a sweep: the products it archived are put back and the archive ends where it
+/// did before, the products are kept on the redo stack. The redo stack has room for them.
+/// </summary>
+/// <param name="serv">A pointer to the service, with an archive attached</param>
+/// <param name="entry">The undo state of the sweep</param>
+/// <returns>1 if the sweep was undone,
+///			 0 if there is not enough memory</returns>
+static int undoSweep(Service* serv, UndoState entry)
+{
+	ColdArchive* archive = serv->archive;
+	int count = archive != NULL ? getArchiveLength(archive) - entry.archive.length : 0;
+	if (count < 0) count = 0;
+
+	ProductRepo* swept = createRepo();
+	ProductChange* changes = malloc((count > 0 ? count : 1) * sizeof(ProductChange));
+	if (swept == NULL || changes == NULL)
+	{
+		destroyRepo(swept);
+		free(changes);
+		return 0;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		SnapshotRecord* record = &archive->records[entry.archive.length + i];
+		ProductChange change = { archive->heap + record->nameOffset, record->category, 1, record->units, date(record->year, record->month, record->day) };
+		changes[i] = change;
+
+		Product* p = createProductUnits(change.name, change.category, change.units, change.expiration);
+		if (p == NULL || appendProductRepo(swept, p) == 0)
+		{
+			destroyProduct(p);
+			destroyRepo(swept);
+			free(changes);
+			return 0;
+		}
+	}
+
+	// The commit carries the length the archive is moved back to, its entries stay for redo
+	if (archive != NULL) resetArchive(archive, entry.archive);
+	applyChangesService(serv, journalUndo, changes, count);
+	free(changes);
+
+	UndoState redo = { swept, entry.archive, stateSweep };
+	serv->redoStack[serv->redoLength++] = redo;
+	return 1;
+}
+
+/// <summary>
+/// Redoes a sweep: the products it put back are archived again, the ones that are gone meanwhile
+/// are skipped. The undo state it leaves behind is that of a sweep.
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="entry">The redo state of the sweep</param>
+static void redoSweep(Service* serv, UndoState entry)
+{
+	addSweepToUndoStack(serv);
+
+	for (int i = 0; serv->archive != NULL && i < getLength(entry.repo); i++)
+	{
+		Product* p = getProductAt(entry.repo, i);
+		Product* current = findProductRepo(serv->repo, p->name, p->category);
+
+		if (current != NULL && sweepProduct(serv, journalRedo, current) == 0) break;
+	}
+
+	logCommit(serv, journalRedo);
+	publishViews(serv);
+	publishImage(serv);
+}
+
+/// <summary>
+/// Undoes or redoes an update: the products are brought back to the states of the entry,
+/// and the states they had are pushed on the other stack, which has room for them
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="entry">The undo or redo state of the update</param>
+/// <param name="operation">journalUndo or journalRedo</param>
+/// <param name="stack">The stack the states the products had are pushed on</param>
+/// <param name="length">A pointer to the length of that stack</param>
+/// <returns>1 if the update was undone or redone,
+///			 0 if there is not enough memory</returns>
+static int swapUpdate(Service* serv, UndoState entry, JournalOperation operation, UndoState* stack, int* length)
+{
+	int count = getLength(entry.repo);
+	ProductRepo* previous = copyUpdated(serv, entry.repo, NULL, 0);
+	ProductChange* changes = malloc((count > 0 ? count : 1) * sizeof(ProductChange));
+	if (previous == NULL || changes == NULL)
+	{
+		destroyRepo(previous);
+		free(changes);
+		return 0;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		Product* p = getProductAt(entry.repo, i);
+		ProductChange change = { p->name, p->category, 1, p->units, p->expiration };
+		changes[i] = change;
+	}
+	applyChangesService(serv, operation, changes, count);
+	free(changes);
+
+	UndoState swapped = undoState(serv, previous);
+	swapped.kind = stateUpdate;
+	stack[(*length)++] = swapped;
+	return 1;
 }
 
 /// <summary>
@@ -251,43 +1141,65 @@ void popUndoStack(Service* serv)
 int undoOperation(Service* serv)
 {
 	if (serv->undoLength == 0) return 0;
-	ProductRepo* repo = serv->undoStack[serv->undoLength - 1];
+	UndoState entry = serv->undoStack[serv->undoLength - 1];
+	ProductRepo* repo = entry.repo;
 
 	// Realloc redo stack if needed
 	if (serv->redoLength == serv->redoCapacity)
 	{
 		serv->redoCapacity *= REPOSITORY_SIZE_SCALE;
-		ProductRepo** tmp = NULL;
+		UndoState* tmp = NULL;
 
-		while (tmp == NULL) tmp = realloc(serv->redoStack, serv->redoCapacity * sizeof(ProductRepo*));
+		while (tmp == NULL) tmp = realloc(serv->redoStack, serv->redoCapacity * sizeof(UndoState));
 		serv->redoStack = tmp;
 	}
 
+	if (entry.kind == stateUpdate)
+	{
+		if (swapUpdate(serv, entry, journalUndo, serv->redoStack, &serv->redoLength) == 0) return 0;
+
+		destroyRepo(repo);
+		serv->undoLength--;
+		return 1;
+	}
+
+	if (entry.kind == stateSweep)
+	{
+		if (undoSweep(serv, entry) == 0) return 0;
+
+		serv->undoLength--;
+		return 1;
+	}
+
 	// Deep copy repo to redo stack
 	ProductRepo* redoCopy = createRepo();
 	for (int i = 0; i < serv->repo->length; i++)
 	{
 		Product* current = getProductAt(serv->repo, i);
-		Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
 		
 		int ret = addProductRepo(redoCopy, p);
 		if (ret == 0) destroyProduct(p);
 	}
-	serv->redoStack[serv->redoLength++] = redoCopy;
+	serv->redoStack[serv->redoLength++] = undoState(serv, redoCopy);
 
 	// Do the undo
 	ProductRepo* repoCopy = createRepo();
 	for (int i = 0; i < repo->length; i++)
 	{
 		Product* current = getProductAt(repo, i);
-		Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
 		
 		int ret = addProductRepo(repoCopy, p);
 		if (ret == 0) destroyProduct(p);
 	}
 
-	destroyRepo(serv-> repo);
+	// The commit carries the length the archive is moved to
+	if (serv->archive != NULL) resetArchive(serv->archive, entry.archive);
+	applyDifference(serv, journalUndo, serv->repo, repoCopy);
+	destroyRepo(serv->repo);
 	serv->repo = repoCopy;
+	publishImage(serv);
 
 	destroyRepo(repo);
 	serv->undoLength--;
@@ -303,43 +1215,66 @@ int undoOperation(Service* serv)
 int redoOperation(Service* serv)
 {
 	if (serv->redoLength == 0) return 0;
-	ProductRepo* repo = serv->redoStack[serv->redoLength - 1];
+	UndoState entry = serv->redoStack[serv->redoLength - 1];
+	ProductRepo* repo = entry.repo;
+
+	if (entry.kind == stateSweep)
+	{
+		redoSweep(serv, entry);
+
+		destroyRepo(repo);
+		serv->redoLength--;
+		return 1;
+	}
 
 	// Realloc undo stack if needed
 	if (serv->undoLength == serv->undoCapacity)
 	{
 		serv->undoCapacity *= REPOSITORY_SIZE_SCALE;
-		ProductRepo** tmp = NULL;
+		UndoState* tmp = NULL;
 
-		while (tmp == NULL) tmp = realloc(serv->undoStack, serv->undoCapacity * sizeof(ProductRepo*));
+		while (tmp == NULL) tmp = realloc(serv->undoStack, serv->undoCapacity * sizeof(UndoState));
 		serv->undoStack = tmp;
 	}
 
+	if (entry.kind == stateUpdate)
+	{
+		if (swapUpdate(serv, entry, journalRedo, serv->undoStack, &serv->undoLength) == 0) return 0;
+
+		destroyRepo(repo);
+		serv->redoLength--;
+		return 1;
+	}
+
 	// Deep copy repo to undo stack
 	ProductRepo* undoCopy = createRepo();
 	for (int i = 0; i < serv->repo->length; i++)
 	{
 		Product* current = getProductAt(serv->repo, i);
-		Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
 		
 		int ret = addProductRepo(undoCopy, p);
 		if (ret == 0) destroyProduct(p);
 	}
-	serv->undoStack[serv->undoLength++] = undoCopy;
+	serv->undoStack[serv->undoLength++] = undoState(serv, undoCopy);
 
 	// Do the redo
 	ProductRepo* repoCopy = createRepo();
 	for (int i = 0; i < repo->length; i++)
 	{
 		Product* current = getProductAt(repo, i);
-		Product* p = createProduct(current->name, current->category, current->quantity, current->expiration);
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
 		
 		int ret = addProductRepo(repoCopy, p);
 		if (ret == 0) destroyProduct(p);
 	}
 
+	// The commit carries the length the archive is moved to
+	if (serv->archive != NULL) resetArchive(serv->archive, entry.archive);
+	applyDifference(serv, journalRedo, serv->repo, repoCopy);
 	destroyRepo(serv->repo);
 	serv->repo = repoCopy;
+	publishImage(serv);
 
 	destroyRepo(repo);
 	serv->redoLength--;
@@ -1,31 +1,107 @@
 #pragma once
 #include "ProductRepository.h"
+#include "Journal.h"
+#include "ExpiryWheel.h"
+#include "View.h"
+#include "QueryCache.h"
+#include "Consumption.h"
+#include "Publication.h"
+#include "Replication.h"
+#include "Archive.h"
+
+// The state a product is brought to by applyChangesService
+typedef struct
+{
+	char* name;
+	Category category;
+	int present; // 0 if the product is removed
+	Quantity units;
+	Date expiration;
+} ProductChange;
+
+// What an undo or redo state holds besides the end of the archive
+typedef enum
+{
+	stateCopy = 0, // A copy of every product
+	stateSweep, // Nothing to undo a sweep, the products it put back to redo it
+	stateUpdate // The earlier states of the products an update changed
+} UndoKind;
+
+// An undo or redo state: the products and the end the archive had with them. A sweep
+// only records where the archive ended before it, undo puts back the entries after that
+// and keeps them for redo. An update only keeps the products it changed. Neither copies
+// the whole repository.
+typedef struct
+{
+	ProductRepo* repo; // NULL for the undo state of a sweep
+	ArchiveMark archive;
+	UndoKind kind;
+} UndoState;
 
 typedef struct
 {
 	ProductRepo* repo;
 
-	ProductRepo** undoStack;
+	UndoState* undoStack;
 	int undoCapacity;
 	int undoLength;
 
-	ProductRepo** redoStack;
+	UndoState* redoStack;
 	int redoCapacity;
 	int redoLength;
+
+	Journal* journal;
+	ExpiryWheel* wheel;
+
+	MaterializedView** views;
+	int viewCapacity;
+	int viewLength;
+
+	QueryCache* cache;
+	unsigned long long version; // Bumped by every change of the repository
+
+	ConsumptionLog* consumption;
+	Publication* publication; // Other processes read the repository from it, NULL if it is not published
+	Shipper* shipper; // Ships the journal records to a standby, NULL without one
+	ColdArchive* archive; // Expired and empty products are swept into it, NULL if they stay
 } Service;
 
 Service* createService(ProductRepo* repo, int init);
 void destroyService(Service* serv);
+void attachJournal(Service* serv, Journal* journal);
+void attachExpiryWheel(Service* serv, ExpiryWheel* wheel);
+void attachPublication(Service* serv, Publication* pub);
+void attachShipper(Service* serv, Shipper* shipper);
+void attachArchive(Service* serv, ColdArchive* archive);
+MaterializedView* registerView(Service* serv, MaterializedView* view);
+int unregisterView(Service* serv, MaterializedView* view);
+MaterializedView* findView(Service* serv, ViewKind kind, Category category, int days, double quantity);
+void advanceViews(Service* serv, Date today);
 
 int addProductService(Service* serv, char* name, Category category, double quantity, Date expiration);
+int addProductUnitsService(Service* serv, char* name, Category category, Quantity units, Date expiration);
+int addProductsService(Service* serv, Product** products, int count);
 int deleteProductService(Service* serv, char* name, Category category);
 int updateProductService(Service* serv, char* name, Category category, double quantity, Date expiration);
+int updateProductUnitsService(Service* serv, char* name, Category category, Quantity units, Date expiration);
+int applyChangesService(Service* serv, JournalOperation operation, ProductChange* changes, int count);
+int sweepService(Service* serv, Date today, int limit);
 
 ProductRepo* getRepo(Service* serv);
 ProductRepo* filterByString(Service* serv, char* name);
+ProductRepo* filterByStringMatch(Service* serv, char* name, StringMatch match);
 ProductRepo* filterByCategoryAndExpiration(Service* serv, Category category, int expiration);
+ProductRepo* filterRepoByString(ProductRepo* repo, char* name);
+ProductRepo* filterRepoByStringMatch(ProductRepo* repo, char* name, StringMatch match);
+ProductRepo* filterRepoByCategoryAndExpiration(ProductRepo* repo, Category category, int expiration);
+ProductRepo* cachedFilterByString(Service* serv, char* name);
+ProductRepo* cachedFilterByCategoryAndExpiration(Service* serv, Category category, int expiration);
+void releaseResult(Service* serv, ProductRepo* result);
 
 void addToUndoStack(Service* serv);
+void addSweepToUndoStack(Service* serv);
+int addUpdateToUndoStack(Service* serv, ProductChange* changes, int count);
 void popUndoStack(Service* serv);
+void clearHistory(Service* serv);
 int undoOperation(Service* serv);
 int redoOperation(Service* serv);
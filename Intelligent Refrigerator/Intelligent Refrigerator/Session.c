@@ -0,0 +1,576 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Session.h"
+
+/// <summary>
+/// Opens a session on the shared service, it holds one of the reader slots until it is closed
+/// but only enters it while it reads
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>A pointer to the session,
+///			 NULL if there is not enough memory or every reader slot is taken</returns>
+Session* openSession(SharedService* shared)
+{
+	Session* session = malloc(sizeof(Session));
+	if (session == NULL) return NULL;
+
+	session->undoStack = malloc(SESSION_INITIAL_SIZE * sizeof(SessionTransaction));
+	session->redoStack = malloc(SESSION_INITIAL_SIZE * sizeof(SessionTransaction));
+	session->reader = registerReader(shared);
+	if (session->undoStack == NULL || session->redoStack == NULL || session->reader == -1)
+	{
+		if (session->reader != -1) unregisterReader(shared, session->reader);
+		free(session->redoStack);
+		free(session->undoStack);
+		free(session);
+		return NULL;
+	}
+
+	session->shared = shared;
+	session->seen = NULL;
+	session->seenLength = 0;
+	session->seenCapacity = 0;
+
+	session->pending.operations = NULL;
+	session->pending.length = 0;
+	session->pending.capacity = 0;
+
+	session->undoCapacity = SESSION_INITIAL_SIZE;
+	session->undoLength = 0;
+	session->redoCapacity = SESSION_INITIAL_SIZE;
+	session->redoLength = 0;
+
+	session->commits = 0;
+	session->conflicts = 0;
+
+	return session;
+}
+
+/// <summary>
+/// Forgets the products the transaction looked at, the next one reads them again
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+static void clearSeen(Session* session)
+{
+	for (int i = 0; i < session->seenLength; i++)
+		free(session->seen[i].name);
+	session->seenLength = 0;
+}
+
+/// <summary>
+/// Empties a transaction, its array is kept for the next one
+/// </summary>
+/// <param name="transaction">A pointer to the transaction</param>
+static void clearTransaction(SessionTransaction* transaction)
+{
+	for (int i = 0; i < transaction->length; i++)
+		free(transaction->operations[i].name);
+	transaction->length = 0;
+}
+
+/// <summary>
+/// Destroys the operations of a transaction
+/// </summary>
+/// <param name="transaction">A pointer to the transaction</param>
+static void destroyTransaction(SessionTransaction* transaction)
+{
+	clearTransaction(transaction);
+	free(transaction->operations);
+	transaction->operations = NULL;
+	transaction->capacity = 0;
+}
+
+/// <summary>
+/// Closes the session, its pending operations are discarded
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+void closeSession(Session* session)
+{
+	if (session == NULL) return;
+
+	destroyTransaction(&session->pending);
+	for (int i = 0; i < session->undoLength; i++)
+		destroyTransaction(&session->undoStack[i]);
+	free(session->undoStack);
+	for (int i = 0; i < session->redoLength; i++)
+		destroyTransaction(&session->redoStack[i]);
+	free(session->redoStack);
+	clearSeen(session);
+	free(session->seen);
+
+	unregisterReader(session->shared, session->reader);
+	free(session);
+
+	session = NULL;
+}
+
+/// <summary>
+/// Pushes a transaction on an undo or redo stack, the stack takes over its operations
+/// </summary>
+/// <param name="stack">A pointer to the stack</param>
+/// <param name="capacity">A pointer to the capacity of the stack</param>
+/// <param name="length">A pointer to the length of the stack</param>
+/// <param name="transaction">A pointer to the transaction, it is left empty</param>
+/// <returns>1 if the transaction was pushed,
+///			 0 if there is not enough memory</returns>
+static int pushTransaction(SessionTransaction** stack, int* capacity, int* length, SessionTransaction* transaction)
+{
+	if (*length == *capacity)
+	{
+		SessionTransaction* tmp = realloc(*stack, *capacity * REPOSITORY_SIZE_SCALE * sizeof(SessionTransaction));
+		if (tmp == NULL) return 0;
+
+		*stack = tmp;
+		*capacity *= REPOSITORY_SIZE_SCALE;
+	}
+
+	(*stack)[(*length)++] = *transaction;
+	transaction->operations = NULL;
+	transaction->length = 0;
+	transaction->capacity = 0;
+	return 1;
+}
+
+/// <summary>
+/// Checks if two states of a product are the same
+/// </summary>
+/// <param name="first">A pointer to the first state</param>
+/// <param name="second">A pointer to the second state</param>
+/// <returns>1 if the product is missing in both or has the same quantity and expiration date,
+///			 0, otherwise</returns>
+static int sameState(ProductChange* first, ProductChange* second)
+{
+	if (first->present != second->present) return 0;
+	if (first->present == 0) return 1;
+
+	return first->units == second->units && daysFromCivil(first->expiration) == daysFromCivil(second->expiration);
+}
+
+/// <summary>
+/// Gets the state of a product: the last of the given changes to it, otherwise the product in the repository
+/// </summary>
+/// <param name="changes">The changes made so far</param>
+/// <param name="count">The number of changes</param>
+/// <param name="repo">A pointer to the repository the changes are made to</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="state">Where to store the state</param>
+static void lookupState(ProductChange* changes, int count, ProductRepo* repo, char* name, Category category, ProductChange* state)
+{
+	for (int i = count - 1; i >= 0; i--)
+	{
+		if (changes[i].category == category && strcmp(changes[i].name, name) == 0)
+		{
+			*state = changes[i];
+			state->name = name;
+			return;
+		}
+	}
+
+	Product* p = findProductRepo(repo, name, category);
+	state->name = name;
+	state->category = category;
+	state->present = p != NULL;
+	state->units = p != NULL ? p->units : 0;
+	state->expiration = p != NULL ? p->expiration : date(0, 0, 0);
+}
+
+/// <summary>
+/// Checks that two quantities can be added without overflowing
+/// </summary>
+/// <param name="first">The first quantity</param>
+/// <param name="second">The second quantity</param>
+/// <returns>1 if the sum fits in a Quantity,
+///			 0, otherwise</returns>
+static int sumFits(Quantity first, Quantity second)
+{
+	return second >= 0 ? first <= LLONG_MAX - second : first >= -LLONG_MAX - second;
+}
+
+/// <summary>
+/// Applies an operation to the state of its product and records the state it found
+/// </summary>
+/// <param name="operation">A pointer to the operation</param>
+/// <param name="state">A pointer to the state of the product, changed in place</param>
+/// <returns>1 if the operation applies,
+///			 0 if it deletes or updates a missing product or the merged quantity overflows</returns>
+static int stepForward(SessionOperation* operation, ProductChange* state)
+{
+	if (operation->kind != sessionAdd && state->present == 0) return 0;
+	if (operation->kind == sessionAdd && state->present == 1 && sumFits(state->units, operation->units) == 0) return 0;
+
+	operation->existed = state->present;
+	operation->previousUnits = state->units;
+	operation->previousExpiration = state->expiration;
+
+	if (operation->kind == sessionDelete)
+	{
+		state->present = 0;
+		return 1;
+	}
+
+	// A merged product keeps the expiration date it already had
+	if (operation->kind == sessionAdd && state->present == 1)
+	{
+		state->units += operation->units;
+		return 1;
+	}
+
+	state->present = 1;
+	state->units = operation->units;
+	state->expiration = operation->expiration;
+	return 1;
+}
+
+/// <summary>
+/// Compensates for an applied operation, changes made to the product by others since are kept where possible
+/// </summary>
+/// <param name="operation">A pointer to the operation, applied by stepForward</param>
+/// <param name="state">A pointer to the current state of the product, changed in place</param>
+/// <returns>1 if the operation was compensated for,
+///			 0 if the product changed in a way that conflicts with it</returns>
+static int stepBackward(SessionOperation* operation, ProductChange* state)
+{
+	if (operation->kind == sessionAdd)
+	{
+		// Only what this operation added is taken back
+		if (state->present == 0 || state->units < operation->units || sumFits(state->units, -operation->units) == 0) return 0;
+
+		state->units -= operation->units;
+		if (operation->existed == 0 && state->units == 0) state->present = 0;
+		return 1;
+	}
+
+	if (operation->kind == sessionDelete)
+	{
+		// What was deleted is put back, on top of what was added since
+		if (state->present == 1)
+		{
+			if (sumFits(state->units, operation->previousUnits) == 0) return 0;
+			state->units += operation->previousUnits;
+			return 1;
+		}
+
+		state->present = 1;
+		state->units = operation->previousUnits;
+		state->expiration = operation->previousExpiration;
+		return 1;
+	}
+
+	// An update sets absolute values, so it can only be taken back while they are still there
+	if (state->present == 0 || state->units != operation->units ||
+		daysFromCivil(state->expiration) != daysFromCivil(operation->expiration)) return 0;
+
+	state->units = operation->previousUnits;
+	state->expiration = operation->previousExpiration;
+	return 1;
+}
+
+/// <summary>
+/// Gets the state of a product as the transaction first saw it. A product it did not look at
+/// yet is read from the current version, which is only pinned during the lookup.
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="state">Where to store the state, its name is the given one</param>
+/// <returns>1 if the state was found,
+///			 0 if there is not enough memory to remember it</returns>
+static int lookupSeen(Session* session, char* name, Category category, ProductChange* state)
+{
+	for (int i = 0; i < session->seenLength; i++)
+	{
+		if (session->seen[i].category == category && strcmp(session->seen[i].name, name) == 0)
+		{
+			*state = session->seen[i];
+			state->name = name;
+			return 1;
+		}
+	}
+
+	if (session->seenLength == session->seenCapacity)
+	{
+		int capacity = session->seenCapacity == 0 ? SESSION_INITIAL_SIZE : session->seenCapacity * REPOSITORY_SIZE_SCALE;
+		ProductChange* tmp = realloc(session->seen, capacity * sizeof(ProductChange));
+		if (tmp == NULL) return 0;
+
+		session->seen = tmp;
+		session->seenCapacity = capacity;
+	}
+
+	char* copy = malloc(strlen(name) + 1);
+	if (copy == NULL) return 0;
+	strcpy(copy, name);
+
+	lookupState(NULL, 0, beginRead(session->shared, session->reader), name, category, state);
+	endRead(session->shared, session->reader);
+
+	session->seen[session->seenLength] = *state;
+	session->seen[session->seenLength++].name = copy;
+	return 1;
+}
+
+/// <summary>
+/// Gets the state of a product as the session sees it: as first seen, with its pending operations applied
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="state">Where to store the state</param>
+/// <returns>1 if the state was found,
+///			 0 if there is not enough memory</returns>
+static int viewState(Session* session, char* name, Category category, ProductChange* state)
+{
+	if (lookupSeen(session, name, category, state) == 0) return 0;
+
+	for (int i = 0; i < session->pending.length; i++)
+	{
+		// A copy, the recorded state of a pending operation is only set when it is committed
+		SessionOperation operation = session->pending.operations[i];
+		if (operation.category == category && strcmp(operation.name, name) == 0) stepForward(&operation, state);
+	}
+
+	return 1;
+}
+
+/// <summary>
+/// Adds an operation to the pending transaction
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="kind">The kind of the operation</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The quantity that is added or set</param>
+/// <param name="expiration">The expiration date that is set</param>
+/// <returns>1 if the operation was added,
+///			 0 if it does not apply to the products the session sees or there is not enough memory</returns>
+static int queueOperation(Session* session, SessionOperationKind kind, char* name, Category category, double quantity, Date expiration)
+{
+	SessionOperation operation = { kind, name, category, toQuantity(quantity), expiration, 0, 0, { 0 } };
+	ProductChange state;
+
+	if (viewState(session, name, category, &state) == 0 || stepForward(&operation, &state) == 0) return 0;
+
+	SessionTransaction* pending = &session->pending;
+	if (pending->length == pending->capacity)
+	{
+		int capacity = pending->capacity == 0 ? SESSION_INITIAL_SIZE : pending->capacity * REPOSITORY_SIZE_SCALE;
+		SessionOperation* tmp = realloc(pending->operations, capacity * sizeof(SessionOperation));
+		if (tmp == NULL) return 0;
+
+		pending->operations = tmp;
+		pending->capacity = capacity;
+	}
+
+	operation.name = malloc(strlen(name) + 1);
+	if (operation.name == NULL) return 0;
+	strcpy(operation.name, name);
+
+	pending->operations[pending->length++] = operation;
+	return 1;
+}
+
+/// <summary>
+/// Adds a product in the pending transaction, it is merged with an existing one like addProductService does
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The quantity to add</param>
+/// <param name="expiration">The expiration date of a new product</param>
+/// <returns>1 if the operation was added,
+///			 0 if there is not enough memory</returns>
+int sessionAddProduct(Session* session, char* name, Category category, double quantity, Date expiration)
+{
+	return queueOperation(session, sessionAdd, name, category, quantity, expiration);
+}
+
+/// <summary>
+/// Deletes a product in the pending transaction
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>1 if the operation was added,
+///			 0 if the session does not see the product or there is not enough memory</returns>
+int sessionDeleteProduct(Session* session, char* name, Category category)
+{
+	return queueOperation(session, sessionDelete, name, category, 0, date(0, 0, 0));
+}
+
+/// <summary>
+/// Updates a product in the pending transaction
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The new quantity of the product</param>
+/// <param name="expiration">The new expiration date of the product</param>
+/// <returns>1 if the operation was added,
+///			 0 if the session does not see the product or there is not enough memory</returns>
+int sessionUpdateProduct(Session* session, char* name, Category category, double quantity, Date expiration)
+{
+	return queueOperation(session, sessionUpdate, name, category, quantity, expiration);
+}
+
+/// <summary>
+/// Reads a product as the session sees it, without waiting for writers
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="units">Where to store the quantity, in units of 1 / QUANTITY_SCALE</param>
+/// <param name="expiration">Where to store the expiration date</param>
+/// <returns>1 if the session sees the product,
+///			 0 if it does not or there is not enough memory</returns>
+int readSessionProduct(Session* session, char* name, Category category, Quantity* units, Date* expiration)
+{
+	ProductChange state;
+	if (viewState(session, name, category, &state) == 0 || state.present == 0) return 0;
+
+	*units = state.units;
+	*expiration = state.expiration;
+	return 1;
+}
+
+/// <summary>
+/// Applies a transaction to the latest version as a single operation, forwards or backwards
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <param name="transaction">A pointer to the transaction</param>
+/// <param name="backward">1 to compensate for the transaction, 0 to apply it</param>
+/// <param name="validate">1 to fail if a product the transaction touches changed since the session first looked at it</param>
+/// <returns>1 if the transaction was applied,
+///			 0 if it conflicts with the latest version or there is not enough memory</returns>
+static int applyTransaction(Session* session, SessionTransaction* transaction, int backward, int validate)
+{
+	ProductChange* changes = malloc(transaction->length * sizeof(ProductChange));
+	if (changes == NULL) return 0;
+
+	Service* serv = beginWrite(session->shared);
+	ProductRepo* latest = getRepo(serv);
+	int ret = 1;
+
+	// First committer wins: the session must have seen every product it changes as it is now
+	for (int i = 0; i < transaction->length && validate == 1 && ret == 1; i++)
+	{
+		SessionOperation* operation = &transaction->operations[i];
+		ProductChange seen, current;
+
+		lookupState(NULL, 0, latest, operation->name, operation->category, &current);
+		ret = lookupSeen(session, operation->name, operation->category, &seen) == 1 && sameState(&seen, &current) == 1;
+	}
+
+	for (int i = 0; i < transaction->length && ret == 1; i++)
+	{
+		SessionOperation* operation = &transaction->operations[backward == 1 ? transaction->length - 1 - i : i];
+
+		lookupState(changes, i, latest, operation->name, operation->category, &changes[i]);
+		ret = backward == 1 ? stepBackward(operation, &changes[i]) : stepForward(operation, &changes[i]);
+	}
+
+	int applied = 0;
+	if (ret == 1)
+	{
+		// The history of the service restores whole versions, which would roll back other sessions
+		clearHistory(serv);
+		applyChangesService(serv, journalUpdate, changes, transaction->length);
+		applied = 1;
+	}
+	else
+	{
+		session->conflicts++;
+	}
+
+	endWrite(session->shared, applied);
+	free(changes);
+	return ret;
+}
+
+/// <summary>
+/// Commits the pending transaction, the next one starts from the latest version
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+/// <returns>1 if the transaction was committed and can be undone,
+///			 0 if it conflicts with a commit made since the session looked at a product, it is discarded then</returns>
+int commitSession(Session* session)
+{
+	SessionTransaction* pending = &session->pending;
+	int ret = pending->length == 0 || applyTransaction(session, pending, 0, 1) == 1;
+
+	if (ret == 1 && pending->length > 0)
+	{
+		session->commits++;
+		for (int i = 0; i < session->redoLength; i++)
+			destroyTransaction(&session->redoStack[i]);
+		session->redoLength = 0;
+
+		// Without memory for the history the transaction stays committed, it only cannot be undone
+		if (pushTransaction(&session->undoStack, &session->undoCapacity, &session->undoLength, pending) == 0)
+			clearTransaction(pending);
+	}
+
+	clearTransaction(pending);
+	clearSeen(session);
+	return ret;
+}
+
+/// <summary>
+/// Discards the pending transaction, the next one starts from the latest version
+/// </summary>
+/// <param name="session">A pointer to the session</param>
+void abortSession(Session* session)
+{
+	clearTransaction(&session->pending);
+	clearSeen(session);
+}
+
+/// <summary>
+/// Undoes the last transaction of this session, changes made by other sessions are kept
+/// </summary>
+/// <param name="session">A pointer to the session, without pending operations</param>
+/// <returns>1 if the transaction was undone,
+///			 0 if there is nothing to undo or the products changed in a way that conflicts with it</returns>
+int undoSession(Session* session)
+{
+	if (session->undoLength == 0 || session->pending.length > 0) return 0;
+
+	SessionTransaction* transaction = &session->undoStack[session->undoLength - 1];
+	int ret = applyTransaction(session, transaction, 1, 0);
+
+	if (ret == 1)
+	{
+		if (pushTransaction(&session->redoStack, &session->redoCapacity, &session->redoLength, transaction) == 0)
+			destroyTransaction(transaction);
+		session->undoLength--;
+	}
+
+	clearSeen(session);
+	return ret;
+}
+
+/// <summary>
+/// Redoes the last transaction this session undid
+/// </summary>
+/// <param name="session">A pointer to the session, without pending operations</param>
+/// <returns>1 if the transaction was redone,
+///			 0 if there is nothing to redo or it no longer applies</returns>
+int redoSession(Session* session)
+{
+	if (session->redoLength == 0 || session->pending.length > 0) return 0;
+
+	SessionTransaction* transaction = &session->redoStack[session->redoLength - 1];
+	int ret = applyTransaction(session, transaction, 0, 0);
+
+	if (ret == 1)
+	{
+		if (pushTransaction(&session->undoStack, &session->undoCapacity, &session->undoLength, transaction) == 0)
+			destroyTransaction(transaction);
+		session->redoLength--;
+	}
+
+	clearSeen(session);
+	return ret;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "SharedService.h"
+
+#define SESSION_INITIAL_SIZE 8
+
+typedef enum { sessionAdd, sessionDelete, sessionUpdate } SessionOperationKind;
+
+// A logical operation of a session: what was asked for, not the products it produced.
+// The state the product was in is recorded when the operation is applied, so that undo
+// can compensate for it while keeping the changes other sessions made in the meantime.
+typedef struct
+{
+	SessionOperationKind kind;
+	char* name;
+	Category category;
+	Quantity units; // Added by sessionAdd, set by sessionUpdate
+	Date expiration;
+
+	int existed; // 1 if the product was there when the operation was applied
+	Quantity previousUnits;
+	Date previousExpiration;
+} SessionOperation;
+
+typedef struct
+{
+	SessionOperation* operations;
+	int length;
+	int capacity;
+} SessionTransaction;
+
+// A client of the shared service with isolated transactions: a transaction reads every
+// product as it was the first time it looked at it, and nobody sees its operations until
+// it commits. A commit fails if any product it touched was changed by someone else since
+// then, the first committer wins. Every session undoes and redoes only its own transactions.
+// The session only pins a version while it reads one, so an idle session never keeps
+// replaced versions from being freed.
+typedef struct
+{
+	SharedService* shared;
+	int reader;
+
+	ProductChange* seen; // The products the transaction looked at, as it first saw them
+	int seenLength;
+	int seenCapacity;
+
+	SessionTransaction pending;
+
+	SessionTransaction* undoStack;
+	int undoCapacity;
+	int undoLength;
+
+	SessionTransaction* redoStack;
+	int redoCapacity;
+	int redoLength;
+
+	long long commits;
+	long long conflicts;
+} Session;
+
+Session* openSession(SharedService* shared);
+void closeSession(Session* session);
+
+int sessionAddProduct(Session* session, char* name, Category category, double quantity, Date expiration);
+int sessionDeleteProduct(Session* session, char* name, Category category);
+int sessionUpdateProduct(Session* session, char* name, Category category, double quantity, Date expiration);
+int readSessionProduct(Session* session, char* name, Category category, Quantity* units, Date* expiration);
+
+int commitSession(Session* session);
+void abortSession(Session* session);
+int undoSession(Session* session);
+int redoSession(Session* session);
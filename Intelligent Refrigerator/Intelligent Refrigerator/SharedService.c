@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <limits.h>
+
+#include "SharedService.h"
+
+/// <summary>
+/// Wraps a service so it can be read from many threads while it is changed
+/// </summary>
+/// <param name="serv">A pointer to the service, the shared service takes ownership of it</param>
+/// <returns>A pointer to the shared service</returns>
+SharedService* createSharedService(Service* serv)
+{
+	if (serv == NULL) return NULL;
+
+	SharedService* shared = malloc(sizeof(SharedService));
+	if (shared == NULL) return NULL;
+
+	ProductRepo* version = copyRepo(getRepo(serv));
+	shared->retired = malloc(REPOSITORY_INITIAL_SIZE * sizeof(RetiredVersion));
+	if (version == NULL || shared->retired == NULL || mtx_init(&shared->lock, mtx_plain) != thrd_success)
+	{
+		destroyRepo(version);
+		free(shared->retired);
+		free(shared);
+		return NULL;
+	}
+
+	shared->serv = serv;
+	shared->retiredCapacity = REPOSITORY_INITIAL_SIZE;
+	shared->retiredLength = 0;
+
+	atomic_init(&shared->current, version);
+	atomic_init(&shared->epoch, 1);
+	for (int i = 0; i < SHARED_MAX_READERS; i++)
+	{
+		atomic_init(&shared->readers[i].epoch, 0);
+		atomic_init(&shared->readers[i].used, 0);
+	}
+
+	return shared;
+}
+
+/// <summary>
+/// Destroys the shared service and its service, no thread may still be using it
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+void destroySharedService(SharedService* shared)
+{
+	if (shared == NULL) return;
+
+	for (int i = 0; i < shared->retiredLength; i++)
+		destroyRepo(shared->retired[i].repo);
+	free(shared->retired);
+
+	destroyRepo(atomic_load(&shared->current));
+	destroyService(shared->serv);
+	mtx_destroy(&shared->lock);
+	free(shared);
+
+	shared = NULL;
+}
+
+/// <summary>
+/// Reserves a reader slot for the calling thread
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>The reader slot,
+///			 -1 if all slots are taken</returns>
+int registerReader(SharedService* shared)
+{
+	for (int i = 0; i < SHARED_MAX_READERS; i++)
+	{
+		int expected = 0;
+		if (atomic_compare_exchange_strong(&shared->readers[i].used, &expected, 1)) return i;
+	}
+
+	return -1;
+}
+
+/// <summary>
+/// Releases a reader slot
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="reader">The reader slot</param>
+void unregisterReader(SharedService* shared, int reader)
+{
+	atomic_store(&shared->readers[reader].epoch, 0);
+	atomic_store(&shared->readers[reader].used, 0);
+}
+
+/// <summary>
+/// Starts a read, the returned version stays valid and unchanged until endRead
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="reader">The reader slot of the calling thread</param>
+/// <returns>A pointer to the current version of the repository, it must not be changed</returns>
+ProductRepo* beginRead(SharedService* shared, int reader)
+{
+	// The epoch is announced before the version is loaded, so a writer that
+	// replaces this version afterwards sees the reader and keeps it alive
+	atomic_store(&shared->readers[reader].epoch, atomic_load(&shared->epoch));
+	return atomic_load(&shared->current);
+}
+
+/// <summary>
+/// Ends a read, the version returned by beginRead must not be used anymore
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="reader">The reader slot of the calling thread</param>
+void endRead(SharedService* shared, int reader)
+{
+	atomic_store_explicit(&shared->readers[reader].epoch, 0, memory_order_release);
+}
+
+/// <summary>
+/// Filters the current products by a given string
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="reader">The reader slot of the calling thread</param>
+/// <param name="name">A string to be found in the product names</param>
+/// <returns>A pointer to a repository that contains the filtered products</returns>
+ProductRepo* sharedFilterByString(SharedService* shared, int reader, char* name)
+{
+	ProductRepo* result = filterRepoByString(beginRead(shared, reader), name);
+	endRead(shared, reader);
+
+	return result;
+}
+
+/// <summary>
+/// Filters the current products by category and expiration date
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="reader">The reader slot of the calling thread</param>
+/// <param name="category">The category of the products</param>
+/// <param name="expiration">The amount of days until products expire</param>
+/// <returns>A pointer to a repository that contains the filtered products</returns>
+ProductRepo* sharedFilterByCategoryAndExpiration(SharedService* shared, int reader, Category category, int expiration)
+{
+	ProductRepo* result = filterRepoByCategoryAndExpiration(beginRead(shared, reader), category, expiration);
+	endRead(shared, reader);
+
+	return result;
+}
+
+/// <summary>
+/// Frees the replaced versions that no reader can be using anymore, called under the lock
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+static void reclaimVersions(SharedService* shared)
+{
+	unsigned long long oldest = ULLONG_MAX;
+	for (int i = 0; i < SHARED_MAX_READERS; i++)
+	{
+		unsigned long long epoch = atomic_load(&shared->readers[i].epoch);
+		if (epoch != 0 && epoch < oldest) oldest = epoch;
+	}
+
+	// A reader that got a version entered at most in the epoch it was replaced in
+	int kept = 0;
+	for (int i = 0; i < shared->retiredLength; i++)
+	{
+		if (shared->retired[i].epoch < oldest)
+			destroyRepo(shared->retired[i].repo);
+		else
+			shared->retired[kept++] = shared->retired[i];
+	}
+	shared->retiredLength = kept;
+}
+
+/// <summary>
+/// Publishes a copy of the service's repository to the readers, called under the lock
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>1 if the new version was published,
+///			 0 if there is not enough memory, the readers keep the previous version</returns>
+static int publishVersion(SharedService* shared)
+{
+	ProductRepo* version = copyRepo(getRepo(shared->serv));
+	if (version == NULL) return 0;
+
+	if (shared->retiredLength == shared->retiredCapacity)
+	{
+		shared->retiredCapacity *= REPOSITORY_SIZE_SCALE;
+		RetiredVersion* tmp = NULL;
+
+		while (tmp == NULL) tmp = realloc(shared->retired, shared->retiredCapacity * sizeof(RetiredVersion));
+		shared->retired = tmp;
+	}
+
+	RetiredVersion* old = &shared->retired[shared->retiredLength++];
+	old->repo = atomic_exchange(&shared->current, version);
+	old->epoch = atomic_fetch_add(&shared->epoch, 1);
+
+	reclaimVersions(shared);
+	return 1;
+}
+
+/// <summary>
+/// Starts a change, other writers wait until endWrite while readers continue
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>A pointer to the service to change</returns>
+Service* beginWrite(SharedService* shared)
+{
+	mtx_lock(&shared->lock);
+	return shared->serv;
+}
+
+/// <summary>
+/// Starts a change only if no other writer is changing the service, for work that can wait
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>A pointer to the service to change, endWrite must follow,
+///			 NULL if another writer holds the lock</returns>
+Service* tryBeginWrite(SharedService* shared)
+{
+	if (mtx_trylock(&shared->lock) != thrd_success) return NULL;
+	return shared->serv;
+}
+
+/// <summary>
+/// Ends a change
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="changed">1 if the repository was changed and must be published</param>
+void endWrite(SharedService* shared, int changed)
+{
+	if (changed == 1) publishVersion(shared);
+	mtx_unlock(&shared->lock);
+}
+
+/// <summary>
+/// Ends a change, publishing its result if it succeeded
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="ret">The result of the change</param>
+/// <param name="history">1 if an undo state was saved for the change</param>
+/// <returns>The result of the change</returns>
+static int finishWrite(SharedService* shared, int ret, int history)
+{
+	if (ret == 0 && history == 1) popUndoStack(shared->serv);
+
+	endWrite(shared, ret);
+	return ret;
+}
+
+/// <summary>
+/// Adds a product, the change can be undone
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The quantity of the product</param>
+/// <param name="expiration">The expiration date of the product</param>
+/// <returns>1 if the product was added,
+///			 0, otherwise</returns>
+int sharedAddProduct(SharedService* shared, char* name, Category category, double quantity, Date expiration)
+{
+	addToUndoStack(beginWrite(shared));
+
+	return finishWrite(shared, addProductService(shared->serv, name, category, quantity, expiration), 1);
+}
+
+/// <summary>
+/// Deletes a product, the change can be undone
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>1 if the product was deleted,
+///			 0, otherwise</returns>
+int sharedDeleteProduct(SharedService* shared, char* name, Category category)
+{
+	addToUndoStack(beginWrite(shared));
+
+	return finishWrite(shared, deleteProductService(shared->serv, name, category), 1);
+}
+
+/// <summary>
+/// Updates a product, the change can be undone
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="quantity">The new quantity of the product</param>
+/// <param name="expiration">The new expiration date of the product</param>
+/// <returns>1 if the product was updated,
+///			 0, otherwise</returns>
+int sharedUpdateProduct(SharedService* shared, char* name, Category category, double quantity, Date expiration)
+{
+	addToUndoStack(beginWrite(shared));
+
+	return finishWrite(shared, updateProductService(shared->serv, name, category, quantity, expiration), 1);
+}
+
+/// <summary>
+/// Undoes the previous change
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>1 if the change was undone,
+///			 0, otherwise</returns>
+int sharedUndo(SharedService* shared)
+{
+	return finishWrite(shared, undoOperation(beginWrite(shared)), 0);
+}
+
+/// <summary>
+/// Redoes the previously undone change
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <returns>1 if the change was redone,
+///			 0, otherwise</returns>
+int sharedRedo(SharedService* shared)
+{
+	return finishWrite(shared, redoOperation(beginWrite(shared)), 0);
+}
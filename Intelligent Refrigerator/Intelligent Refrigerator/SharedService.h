@@ -0,0 +1,59 @@
+#pragma once
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "Service.h"
+
+#define SHARED_MAX_READERS 64
+#define SHARED_CACHE_LINE 64
+
+// Readers never take the lock: they use the published version of the
+// repository, which is never changed. Writers change the service under the
+// lock and publish a copy of the result. A replaced version is freed once
+// every reader that might still use it has left (epoch based reclamation).
+typedef struct
+{
+	_Alignas(SHARED_CACHE_LINE) atomic_ullong epoch; // Epoch the reader entered in, 0 when it is not reading
+	atomic_int used;
+} ReaderSlot;
+
+typedef struct
+{
+	ProductRepo* repo;
+	unsigned long long epoch; // Epoch the version was replaced in
+} RetiredVersion;
+
+typedef struct
+{
+	Service* serv; // Only used by writers, under the lock
+	mtx_t lock;
+
+	_Atomic(ProductRepo*) current;
+	atomic_ullong epoch;
+	ReaderSlot readers[SHARED_MAX_READERS];
+
+	RetiredVersion* retired;
+	int retiredCapacity;
+	int retiredLength;
+} SharedService;
+
+SharedService* createSharedService(Service* serv);
+void destroySharedService(SharedService* shared);
+
+int registerReader(SharedService* shared);
+void unregisterReader(SharedService* shared, int reader);
+ProductRepo* beginRead(SharedService* shared, int reader);
+void endRead(SharedService* shared, int reader);
+
+ProductRepo* sharedFilterByString(SharedService* shared, int reader, char* name);
+ProductRepo* sharedFilterByCategoryAndExpiration(SharedService* shared, int reader, Category category, int expiration);
+
+Service* beginWrite(SharedService* shared);
+Service* tryBeginWrite(SharedService* shared);
+void endWrite(SharedService* shared, int changed);
+
+int sharedAddProduct(SharedService* shared, char* name, Category category, double quantity, Date expiration);
+int sharedDeleteProduct(SharedService* shared, char* name, Category category);
+int sharedUpdateProduct(SharedService* shared, char* name, Category category, double quantity, Date expiration);
+int sharedUndo(SharedService* shared);
+int sharedRedo(SharedService* shared);
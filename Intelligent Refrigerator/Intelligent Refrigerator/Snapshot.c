@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Snapshot.h"
+
+/// <summary>
+/// Computes the CRC-32 checksum of a block of memory
+/// </summary>
+/// <param name="data">A pointer to the data</param>
+/// <param name="length">The number of bytes</param>
+/// <param name="checksum">The checksum of the previous blocks, 0 for the first one</param>
+/// <returns>The updated checksum</returns>
+uint32_t computeChecksum(const void* data, size_t length, uint32_t checksum)
+{
+	static uint32_t table[256];
+	static int tableReady = 0;
+
+	if (tableReady == 0)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++)
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+
+			table[i] = value;
+		}
+		tableReady = 1;
+	}
+
+	const unsigned char* bytes = data;
+	checksum = ~checksum;
+	for (size_t i = 0; i < length; i++)
+		checksum = table[(checksum ^ bytes[i]) & 0xFF] ^ (checksum >> 8);
+
+	return ~checksum;
+}
+
+/// <summary>
+/// Fills in the record of a product
+/// </summary>
+/// <param name="record">A pointer to the record</param>
+/// <param name="p">A pointer to the product</param>
+/// <param name="nameOffset">Where the name of the product is in the string heap</param>
+void setSnapshotRecord(SnapshotRecord* record, Product* p, uint32_t nameOffset)
+{
+	record->nameOffset = nameOffset;
+	record->nameLength = (uint32_t)strlen(p->name);
+	record->category = p->category;
+	record->year = p->expiration.year;
+	record->month = p->expiration.month;
+	record->day = p->expiration.day;
+	record->units = p->units;
+}
+
+/// <summary>
+/// Writes the repository to a snapshot file
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="sequence">The last journaled operation the repository contains</param>
+/// <param name="path">The path of the snapshot file</param>
+/// <returns>1 if the snapshot was written successfully,
+///			 0, otherwise</returns>
+int saveSnapshot(ProductRepo* repo, uint64_t sequence, const char* path)
+{
+	return saveArchivedSnapshot(repo, NULL, sequence, path);
+}
+
+/// <summary>
+/// Writes the repository and the entries of its cold archive to a snapshot file
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="archive">The entries of the archive, NULL if there is none</param>
+/// <param name="sequence">The last journaled operation the repository and the archive contain</param>
+/// <param name="path">The path of the snapshot file</param>
+/// <returns>1 if the snapshot was written successfully,
+///			 0, otherwise</returns>
+int saveArchivedSnapshot(ProductRepo* repo, SnapshotArchive* archive, uint64_t sequence, const char* path)
+{
+	uint32_t count = (uint32_t)getLength(repo);
+	size_t heapSize = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+		heapSize += strlen(getProductAt(repo, i)->name) + 1;
+
+	uint32_t indexCapacity = (uint32_t)getIndexCapacity((int)count);
+	size_t recordsOffset = sizeof(SnapshotHeader);
+	size_t indexOffset = recordsOffset + count * sizeof(SnapshotRecord);
+	size_t heapOffset = indexOffset + indexCapacity * sizeof(uint32_t);
+	size_t archiveOffset = (heapOffset + heapSize + 7) / 8 * 8;
+	size_t archiveCount = archive != NULL ? archive->count : 0;
+	size_t archiveHeapSize = archive != NULL ? archive->heapSize : 0;
+	size_t size = archiveOffset + archiveCount * sizeof(SnapshotRecord) + archiveHeapSize;
+
+	char* buffer = calloc(size, 1);
+	if (buffer == NULL) return 0;
+
+	// Records, hash index and string heap
+	SnapshotRecord* records = (SnapshotRecord*)(buffer + recordsOffset);
+	uint32_t* slots = (uint32_t*)(buffer + indexOffset);
+	char* heap = buffer + heapOffset;
+	size_t heapPosition = 0;
+	uint32_t mask = indexCapacity - 1;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Product* current = getProductAt(repo, i);
+		size_t nameLength = strlen(current->name);
+
+		setSnapshotRecord(&records[i], current, (uint32_t)heapPosition);
+
+		memcpy(heap + heapPosition, current->name, nameLength + 1);
+		heapPosition += nameLength + 1;
+
+		// Probed in record order, like a repository that appends the records one by one
+		uint32_t slot = hashProductKey(current->name, current->category) & mask;
+		while (slots[slot] != 0) slot = (slot + 1) & mask;
+		slots[slot] = i + 1;
+	}
+
+	if (archiveCount > 0)
+	{
+		memcpy(buffer + archiveOffset, archive->records, archiveCount * sizeof(SnapshotRecord));
+		memcpy(buffer + archiveOffset + archiveCount * sizeof(SnapshotRecord), archive->heap, archiveHeapSize);
+	}
+
+	SnapshotHeader* header = (SnapshotHeader*)buffer;
+	header->magic = SNAPSHOT_MAGIC;
+	header->version = SNAPSHOT_VERSION;
+	header->recordCount = count;
+	header->recordsOffset = (uint32_t)recordsOffset;
+	header->indexOffset = (uint32_t)indexOffset;
+	header->indexCapacity = indexCapacity;
+	header->heapOffset = (uint32_t)heapOffset;
+	header->heapSize = (uint32_t)heapSize;
+	header->archiveOffset = (uint32_t)archiveOffset;
+	header->archiveCount = (uint32_t)archiveCount;
+	header->archiveHeapSize = (uint32_t)archiveHeapSize;
+	header->sequence = sequence;
+	header->checksum = computeChecksum(buffer + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader), 0);
+
+	// Write next to the old snapshot and swap it in, so a failed write keeps the old one
+	char tmpPath[FILENAME_MAX];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+	FILE* file = fopen(tmpPath, "wb");
+	if (file == NULL)
+	{
+		free(buffer);
+		return 0;
+	}
+
+	size_t written = fwrite(buffer, 1, size, file);
+	int closed = fclose(file);
+	free(buffer);
+
+	if (written != size || closed != 0)
+	{
+		remove(tmpPath);
+		return 0;
+	}
+
+	remove(path);
+	return rename(tmpPath, path) == 0;
+}
+
+/// <summary>
+/// Opens a snapshot file and validates its header and checksum
+/// </summary>
+/// <param name="path">The path of the snapshot file</param>
+/// <returns>A pointer to the snapshot,
+///			 NULL if the file is missing or corrupted</returns>
+Snapshot* openSnapshot(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	rewind(file);
+
+	if (fileSize < (long)sizeof(SnapshotHeader))
+	{
+		fclose(file);
+		return NULL;
+	}
+
+	Snapshot* snap = malloc(sizeof(Snapshot));
+	if (snap == NULL)
+	{
+		fclose(file);
+		return NULL;
+	}
+
+	// The whole file is brought in with a single read, records are used in place
+	snap->size = (size_t)fileSize;
+	snap->buffer = malloc(snap->size);
+	if (snap->buffer == NULL || fread(snap->buffer, 1, snap->size, file) != snap->size)
+	{
+		fclose(file);
+		closeSnapshot(snap);
+		return NULL;
+	}
+	fclose(file);
+
+	SnapshotHeader* header = (SnapshotHeader*)snap->buffer;
+	size_t count = header->recordCount;
+
+	int valid = header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION;
+	valid = valid && header->recordsOffset == sizeof(SnapshotHeader);
+	valid = valid && header->indexOffset == header->recordsOffset + count * sizeof(SnapshotRecord);
+	valid = valid && header->indexCapacity == (uint32_t)getIndexCapacity((int)count);
+	valid = valid && header->heapOffset == header->indexOffset + (size_t)header->indexCapacity * sizeof(uint32_t);
+	valid = valid && header->archiveOffset == ((size_t)header->heapOffset + header->heapSize + 7) / 8 * 8;
+	valid = valid && header->archiveOffset + (size_t)header->archiveCount * sizeof(SnapshotRecord) + header->archiveHeapSize == snap->size;
+	valid = valid && (header->heapSize == 0 || snap->buffer[header->heapOffset + header->heapSize - 1] == '\0');
+	valid = valid && (header->archiveHeapSize == 0 || snap->buffer[snap->size - 1] == '\0');
+	valid = valid && header->checksum == computeChecksum(snap->buffer + sizeof(SnapshotHeader), snap->size - sizeof(SnapshotHeader), 0);
+
+	if (valid == 0)
+	{
+		closeSnapshot(snap);
+		return NULL;
+	}
+
+	snap->header = header;
+	snap->records = (SnapshotRecord*)(snap->buffer + header->recordsOffset);
+	snap->slots = (uint32_t*)(snap->buffer + header->indexOffset);
+	snap->heap = snap->buffer + header->heapOffset;
+	snap->archive.records = (SnapshotRecord*)(snap->buffer + header->archiveOffset);
+	snap->archive.count = header->archiveCount;
+	snap->archive.heap = snap->buffer + header->archiveOffset + header->archiveCount * sizeof(SnapshotRecord);
+	snap->archive.heapSize = header->archiveHeapSize;
+	return snap;
+}
+
+/// <summary>
+/// Closes the snapshot and frees its memory
+/// </summary>
+/// <param name="snap">A pointer to the snapshot</param>
+void closeSnapshot(Snapshot* snap)
+{
+	if (snap == NULL) return;
+
+	free(snap->buffer);
+	free(snap);
+
+	snap = NULL;
+}
+
+/// <summary>
+/// Gets the number of records in the snapshot
+/// </summary>
+/// <param name="snap">A pointer to the snapshot</param>
+/// <returns>The number of records</returns>
+int getSnapshotLength(Snapshot* snap)
+{
+	return (int)snap->header->recordCount;
+}
+
+/// <summary>
+/// Gets the name of the record at the given index
+/// </summary>
+/// <param name="snap">A pointer to the snapshot</param>
+/// <param name="index">The index of the record</param>
+/// <returns>A pointer to the name inside the snapshot,
+///			 NULL if the index or the record is invalid</returns>
+char* getSnapshotName(Snapshot* snap, int index)
+{
+	if (index < 0 || index >= getSnapshotLength(snap)) return NULL;
+	if (snap->records[index].nameOffset >= snap->header->heapSize) return NULL;
+
+	return snap->heap + snap->records[index].nameOffset;
+}
+
+/// <summary>
+/// Finds a record using the prebuilt hash index
+/// </summary>
+/// <param name="snap">A pointer to the snapshot</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <returns>The index of the record,
+///			 -1 if it does not exist</returns>
+int findSnapshotRecord(Snapshot* snap, char* name, Category category)
+{
+	uint32_t mask = snap->header->indexCapacity - 1;
+	uint32_t slot = hashProductKey(name, category) & mask;
+
+	// The index is at most half full, so the probe always reaches an empty slot
+	for (; snap->slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		int record = (int)snap->slots[slot] - 1;
+
+		char* current = getSnapshotName(snap, record);
+		if (current == NULL) return -1;
+
+		if (snap->records[record].category == (int)category && strcmp(current, name) == 0)
+			return record;
+	}
+
+	return -1;
+}
+
+/// <summary>
+/// Builds a repository from the records of the snapshot, the products are put
+/// straight into the slots of the prebuilt index
+/// </summary>
+/// <param name="snap">A pointer to the snapshot</param>
+/// <returns>A pointer to the new repository,
+///			 NULL if a record is invalid or there is not enough memory</returns>
+ProductRepo* snapshotToRepo(Snapshot* snap)
+{
+	ProductRepo* repo = createRepo();
+	if (repo == NULL) return NULL;
+
+	int count = getSnapshotLength(snap);
+	int* slotOf = malloc((count + 1) * sizeof(int));
+	if (slotOf == NULL || reserveRepo(repo, count) == 0 || repo->tableCapacity != (int)snap->header->indexCapacity)
+	{
+		free(slotOf);
+		destroyRepo(repo);
+		return NULL;
+	}
+
+	// Every record must own exactly one slot
+	int placed = 0;
+	for (int i = 0; i < count; i++) slotOf[i] = -1;
+	for (int slot = 0; slot < repo->tableCapacity; slot++)
+	{
+		uint32_t record = snap->slots[slot];
+		if (record == 0) continue;
+
+		if (record > (uint32_t)count || slotOf[record - 1] != -1) break;
+		slotOf[record - 1] = slot;
+		placed++;
+	}
+
+	for (int i = 0; i < count && placed == count; i++)
+	{
+		SnapshotRecord* record = &snap->records[i];
+		char* name = getSnapshotName(snap, i);
+
+		if (name == NULL || record->category < none || record->category > CATEGORY_END)
+		{
+			placed = -1;
+			break;
+		}
+
+		Product* p = createProductUnits(name, record->category, record->units, date(record->year, record->month, record->day));
+		if (p == NULL || placeProductRepo(repo, p, slotOf[i]) == 0)
+		{
+			destroyProduct(p);
+			placed = -1;
+		}
+	}
+	free(slotOf);
+
+	if (placed != count)
+	{
+		destroyRepo(repo);
+		return NULL;
+	}
+
+	return repo;
+}
+
+/// <summary>
+/// Loads a repository from a snapshot file
+/// </summary>
+/// <param name="path">The path of the snapshot file</param>
+/// <returns>A pointer to the new repository,
+///			 NULL if the snapshot could not be loaded</returns>
+ProductRepo* loadSnapshot(const char* path)
+{
+	Snapshot* snap = openSnapshot(path);
+	if (snap == NULL) return NULL;
+
+	ProductRepo* repo = snapshotToRepo(snap);
+	closeSnapshot(snap);
+
+	return repo;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ProductRepository.h"
+
+#define SNAPSHOT_MAGIC 0x50414E53 // "SNAP"
+#define SNAPSHOT_VERSION 5
+#define SNAPSHOT_DEFAULT_PATH "fridge.snapshot"
+
+// On-disk layout: header, fixed-width records, hash index, string heap, then the
+// entries of the cold archive and their names. Sections are addressed by byte
+// offsets so the file can be used in place. The hash index is laid out exactly
+// like the index of a repository that holds the records, so loading places
+// every product without hashing it.
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t checksum; // CRC-32 of everything after the header
+	uint32_t recordCount;
+	uint32_t recordsOffset;
+	uint32_t indexOffset; // Record number + 1 for every slot of the hash index, 0 if the slot is empty
+	uint32_t indexCapacity;
+	uint32_t heapOffset;
+	uint32_t heapSize;
+	uint32_t archiveOffset; // Archived records, 8 byte aligned after the heap, followed by their names
+	uint32_t archiveCount;
+	uint32_t archiveHeapSize;
+	uint64_t sequence; // Last journaled operation contained in the snapshot
+} SnapshotHeader;
+
+typedef struct
+{
+	uint32_t nameOffset; // Offset of the null terminated name in the heap
+	uint32_t nameLength;
+	int32_t category;
+	int32_t year;
+	int32_t month;
+	int32_t day;
+	int64_t units; // The exact quantity, in units of 1 / QUANTITY_SCALE
+} SnapshotRecord;
+
+// The entries of a cold archive, saved along with the products
+typedef struct
+{
+	const SnapshotRecord* records;
+	uint32_t count;
+	const char* heap;
+	uint32_t heapSize;
+} SnapshotArchive;
+
+typedef struct
+{
+	char* buffer;
+	size_t size;
+
+	SnapshotHeader* header;
+	SnapshotRecord* records;
+	uint32_t* slots;
+	char* heap;
+	SnapshotArchive archive; // Empty if the products were saved without an archive
+} Snapshot;
+
+uint32_t computeChecksum(const void* data, size_t length, uint32_t checksum);
+void setSnapshotRecord(SnapshotRecord* record, Product* p, uint32_t nameOffset);
+
+int saveSnapshot(ProductRepo* repo, uint64_t sequence, const char* path);
+int saveArchivedSnapshot(ProductRepo* repo, SnapshotArchive* archive, uint64_t sequence, const char* path);
+Snapshot* openSnapshot(const char* path);
+void closeSnapshot(Snapshot* snap);
+
+int getSnapshotLength(Snapshot* snap);
+char* getSnapshotName(Snapshot* snap, int index);
+int findSnapshotRecord(Snapshot* snap, char* name, Category category);
+
+ProductRepo* snapshotToRepo(Snapshot* snap);
+ProductRepo* loadSnapshot(const char* path);
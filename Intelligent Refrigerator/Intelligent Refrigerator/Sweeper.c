@@ -0,0 +1,164 @@
+#include <stdlib.h>
+
+#include "Sweeper.h"
+
+/// <summary>
+/// Creates a sweeper for a shared service, an archive is attached to the service if it has none
+/// </summary>
+/// <param name="shared">A pointer to the shared service</param>
+/// <param name="batch">The maximum number of products moved in a round</param>
+/// <param name="interval">The milliseconds between rounds</param>
+/// <returns>A pointer to the sweeper,
+///			 NULL if there is not enough memory</returns>
+Sweeper* createSweeper(SharedService* shared, int batch, int interval)
+{
+	Sweeper* sweeper = malloc(sizeof(Sweeper));
+	if (sweeper == NULL) return NULL;
+
+	Service* serv = beginWrite(shared);
+	if (serv->archive == NULL) attachArchive(serv, createArchive());
+	int ready = serv->archive != NULL;
+	endWrite(shared, 0);
+
+	if (ready == 0)
+	{
+		free(sweeper);
+		return NULL;
+	}
+
+	sweeper->shared = shared;
+	sweeper->reader = registerReader(shared);
+	sweeper->batch = batch > 0 ? batch : 1;
+	sweeper->interval = interval > 0 ? interval : 1;
+	sweeper->running = 0;
+	sweeper->deferredInRow = 0;
+
+	atomic_init(&sweeper->stopping, 0);
+	atomic_init(&sweeper->rounds, 0);
+	atomic_init(&sweeper->swept, 0);
+	atomic_init(&sweeper->deferred, 0);
+
+	return sweeper;
+}
+
+/// <summary>
+/// Stops and destroys the sweeper, the archive stays with the service
+/// </summary>
+/// <param name="sweeper">A pointer to the sweeper</param>
+void destroySweeper(Sweeper* sweeper)
+{
+	if (sweeper == NULL) return;
+
+	stopSweeper(sweeper);
+	if (sweeper->reader != -1) unregisterReader(sweeper->shared, sweeper->reader);
+	free(sweeper);
+
+	sweeper = NULL;
+}
+
+/// <summary>
+/// Checks if the published version has a cold product, without taking the lock. Only
+/// the category aggregates of the version are looked at, so a round that finds nothing is cheap.
+/// </summary>
+/// <param name="sweeper">A pointer to the sweeper</param>
+/// <param name="today">The current day, as returned by daysFromCivil</param>
+/// <returns>1 if there is a cold product or the version can not be read,
+///			 0, otherwise</returns>
+static int isSweepDue(Sweeper* sweeper, int today)
+{
+	if (sweeper->reader == -1) return 1;
+
+	int cold = hasColdProducts(beginRead(sweeper->shared, sweeper->reader), today);
+
+	endRead(sweeper->shared, sweeper->reader);
+	return cold;
+}
+
+/// <summary>
+/// Moves a batch of cold products to the archive, the move can be undone like any other change
+/// </summary>
+/// <param name="sweeper">A pointer to the sweeper</param>
+/// <param name="today">The current date</param>
+/// <returns>The number of products that were moved</returns>
+int sweepRound(Sweeper* sweeper, Date today)
+{
+	// Most rounds find nothing, so they are over before they get in the way of a writer
+	if (isSweepDue(sweeper, daysFromCivil(today)) == 0) return 0;
+
+	Service* serv = sweeper->deferredInRow < SWEEPER_MAX_DEFERRED ? tryBeginWrite(sweeper->shared) : beginWrite(sweeper->shared);
+	if (serv == NULL)
+	{
+		sweeper->deferredInRow++;
+		atomic_fetch_add(&sweeper->deferred, 1);
+		return 0;
+	}
+	sweeper->deferredInRow = 0;
+
+	addSweepToUndoStack(serv);
+	int swept = sweepService(serv, today, sweeper->batch);
+	if (swept == 0) popUndoStack(serv);
+	endWrite(sweeper->shared, swept > 0);
+
+	atomic_fetch_add(&sweeper->rounds, 1);
+	atomic_fetch_add(&sweeper->swept, swept);
+	return swept;
+}
+
+/// <summary>
+/// Runs a round every interval until the sweeper is stopped
+/// </summary>
+/// <param name="arg">A pointer to the sweeper</param>
+/// <returns>0</returns>
+static int runSweeper(void* arg)
+{
+	Sweeper* sweeper = arg;
+	struct timespec pause = { sweeper->interval / 1000, (sweeper->interval % 1000) * 1000000L };
+
+	while (atomic_load(&sweeper->stopping) == 0)
+	{
+		sweepRound(sweeper, currentDate());
+		thrd_sleep(&pause, NULL);
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Starts the thread that sweeps in the background
+/// </summary>
+/// <param name="sweeper">A pointer to the sweeper</param>
+/// <returns>1 if the thread was started,
+///			 0, otherwise</returns>
+int startSweeper(Sweeper* sweeper)
+{
+	if (sweeper->running == 1) return 1;
+
+	atomic_store(&sweeper->stopping, 0);
+	sweeper->running = thrd_create(&sweeper->thread, runSweeper, sweeper) == thrd_success;
+	return sweeper->running;
+}
+
+/// <summary>
+/// Stops the background thread, a round that is under way is finished first
+/// </summary>
+/// <param name="sweeper">A pointer to the sweeper</param>
+void stopSweeper(Sweeper* sweeper)
+{
+	if (sweeper->running == 0) return;
+
+	atomic_store(&sweeper->stopping, 1);
+	thrd_join(sweeper->thread, NULL);
+	sweeper->running = 0;
+}
+
+/// <summary>
+/// Gets the counters of the sweeper
+/// </summary>
+/// <param name="sweeper">A pointer to the sweeper</param>
+/// <param name="stats">Where to store the counters</param>
+void getSweeperStats(Sweeper* sweeper, SweeperStats* stats)
+{
+	stats->rounds = atomic_load(&sweeper->rounds);
+	stats->swept = atomic_load(&sweeper->swept);
+	stats->deferred = atomic_load(&sweeper->deferred);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "SharedService.h"
+
+#define SWEEPER_DEFAULT_BATCH 256
+#define SWEEPER_DEFAULT_INTERVAL 100 // Milliseconds
+#define SWEEPER_MAX_DEFERRED 8 // Rounds given up in a row before one waits for the lock
+
+typedef struct
+{
+	long long rounds; // Rounds that took the lock
+	long long swept;
+	long long deferred; // Rounds given up because a foreground writer held the lock
+} SweeperStats;
+
+// Background task that moves the cold products of a shared service to its archive.
+// A round moves at most a batch and rounds are at least an interval apart, which limits
+// the time it takes from the writers. It looks for cold products in the published version
+// without the lock, and gives up a round instead of waiting for a foreground writer,
+// unless it gave up so many in a row that a busy service would never be swept.
+typedef struct
+{
+	SharedService* shared;
+	int reader; // Reader slot for looking at the published version, -1 if none was free
+	int batch;
+	int interval;
+	int deferredInRow; // Only used by the thread that runs the rounds
+
+	thrd_t thread;
+	int running;
+	atomic_int stopping;
+
+	atomic_llong rounds;
+	atomic_llong swept;
+	atomic_llong deferred;
+} Sweeper;
+
+Sweeper* createSweeper(SharedService* shared, int batch, int interval);
+void destroySweeper(Sweeper* sweeper);
+
+int sweepRound(Sweeper* sweeper, Date today);
+int startSweeper(Sweeper* sweeper);
+void stopSweeper(Sweeper* sweeper);
+void getSweeperStats(Sweeper* sweeper, SweeperStats* stats);
@@ -1,9 +1,80 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <signal.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "Product.h"
 #include "ProductRepository.h"
+#include "EventQueue.h"
+#include "ExpiryWheel.h"
+#include "Fleet.h"
+#include "ImportExport.h"
+#include "Page.h"
+#include "Parallel.h"
+#include "Publication.h"
+#include "QueryCache.h"
+#include "Recovery.h"
+#include "Replication.h"
+#include "Script.h"
+#include "Server.h"
+#include "Session.h"
+#include "Sweeper.h"
 #include "Service.h"
+#include "SharedService.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+#include "Writer.h"
+
+#define TEST_DIRECTORY_SIZE 1024
+
+// The temporary directory that holds the files written by the tests
+static char testDirectory[TEST_DIRECTORY_SIZE];
+
+/// <summary>
+/// Creates a new temporary directory for the files written by the tests
+/// </summary>
+/// <returns>1 if the directory was created,
+///			 0, otherwise</returns>
+static int createTestDirectory()
+{
+#ifdef _WIN32
+	const char* base = getenv("TEMP");
+	if (base == NULL) base = ".";
+#else
+	const char* base = getenv("TMPDIR");
+	if (base == NULL) base = "/tmp";
+#endif
+
+	snprintf(testDirectory, sizeof(testDirectory), "%s/fridge-test-XXXXXX", base);
+#ifdef _WIN32
+	return _mktemp_s(testDirectory, strlen(testDirectory) + 1) == 0 && _mkdir(testDirectory) == 0;
+#else
+	return mkdtemp(testDirectory) != NULL;
+#endif
+}
+
+/// <summary>
+/// Builds the path of a file in the temporary test directory
+/// </summary>
+/// <param name="name">The name of the file</param>
+/// <param name="path">Where to store the path, FILENAME_MAX characters</param>
+static void testPath(const char* name, char* path)
+{
+	snprintf(path, FILENAME_MAX, "%s/%s", testDirectory, name);
+}
 
 /// <summary>
 /// Runs tests for the domain
@@ -77,6 +148,8 @@ void testRepo()
 	assert(strcmp(getProductAt(repo, 1)->name, "test4") == 0);
 	assert(strcmp(getProductAt(repo, 2)->name, "test6") == 0);
 	assert(strcmp(getProductAt(repo, 3)->name, "test7") == 0);
+	sortByName(repo, 1);
+	assert(strcmp(getProductAt(repo, 0)->name, "test7") == 0 && strcmp(getProductAt(repo, 3)->name, "test1") == 0);
 
 	destroyRepo(repo);
 }
@@ -133,11 +206,2431 @@ void testService()
 }
 
 /// <summary>
-/// Runts all tests
+/// Runs tests for the snapshot file format
 /// </summary>
-void runAllTests()
+void testSnapshot()
 {
-	testDomain();
-	testRepo();
-	testService();
+	char path[FILENAME_MAX];
+	testPath("test.snapshot", path);
+	ProductRepo* repo = createRepo();
+
+	addProductRepo(repo, createProduct("milk", dairy, 1.5, date(2022, 3, 15)));
+	addProductRepo(repo, createProduct("beef", meat, 2, date(2022, 3, 17)));
+	addProductRepo(repo, createProduct("milk", sweets, 3, date(2022, 4, 1)));
+	assert(saveSnapshot(repo, 7, path) == 1);
+
+	Snapshot* snap = openSnapshot(path);
+	assert(snap != NULL);
+	assert(getSnapshotLength(snap) == 3);
+	assert(snap->header->sequence == 7);
+	assert(findSnapshotRecord(snap, "beef", meat) == 1);
+	assert(findSnapshotRecord(snap, "milk", sweets) == 2);
+	assert(findSnapshotRecord(snap, "milk", meat) == -1);
+	assert(strcmp(getSnapshotName(snap, 0), "milk") == 0);
+
+	ProductRepo* loaded = snapshotToRepo(snap);
+	assert(getLength(loaded) == 3);
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* expected = getProductAt(repo, i);
+		Product* actual = getProductAt(loaded, i);
+
+		assert(strcmp(expected->name, actual->name) == 0);
+		assert(expected->category == actual->category);
+		assert(expected->quantity == actual->quantity);
+		assert(expected->expiration.day == actual->expiration.day);
+	}
+	assert(loaded->tableCapacity == (int)snap->header->indexCapacity);
+	assert(findProductRepo(loaded, "milk", sweets) == getProductAt(loaded, 2));
+	assert(removeProductRepo(loaded, "milk", dairy) == 1);
+	assert(findProductRepo(loaded, "milk", sweets) == getProductAt(loaded, 1));
+	destroyRepo(loaded);
+	closeSnapshot(snap);
+
+	// Enough products for the index to grow and for probes to collide
+	char name[16];
+	for (int i = 0; i < 500; i++)
+	{
+		sprintf(name, "item%d", i);
+		addProductRepo(repo, createProduct(name, i % (CATEGORY_END + 1), i, date(2022, 5, 1)));
+	}
+	assert(saveSnapshot(repo, 8, path) == 1);
+
+	snap = openSnapshot(path);
+	loaded = snapshotToRepo(snap);
+	assert(getLength(loaded) == getLength(repo));
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* expected = getProductAt(repo, i);
+		assert(findSnapshotRecord(snap, expected->name, expected->category) == i);
+		assert(findProductRepo(loaded, expected->name, expected->category) == getProductAt(loaded, i));
+	}
+	destroyRepo(loaded);
+	closeSnapshot(snap);
+
+	// A flipped byte must be caught by the checksum
+	FILE* file = fopen(path, "r+b");
+	assert(file != NULL);
+	fseek(file, -2, SEEK_END);
+	fputc('X', file);
+	fclose(file);
+	assert(openSnapshot(path) == NULL);
+
+	remove(path);
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Checks if two repositories contain the same products, in any order
+/// </summary>
+/// <param name="first">A pointer to the first repository</param>
+/// <param name="second">A pointer to the second repository</param>
+/// <returns>1 if the contents are equal,
+///			 0, otherwise</returns>
+int sameProducts(ProductRepo* first, ProductRepo* second)
+{
+	if (getLength(first) != getLength(second)) return 0;
+
+	for (int i = 0; i < getLength(first); i++)
+	{
+		Product* expected = getProductAt(first, i);
+		Product* actual = findProductRepo(second, expected->name, expected->category);
+
+		if (actual == NULL || actual->units != expected->units) return 0;
+		if (actual->expiration.year != expected->expiration.year ||
+			actual->expiration.month != expected->expiration.month ||
+			actual->expiration.day != expected->expiration.day) return 0;
+	}
+
+	return 1;
+}
+
+/// <summary>
+/// Runs tests for crash recovery by cutting the journal at random offsets,
+/// as if the process was killed in the middle of a write
+/// </summary>
+void testRecovery()
+{
+	char snapshotPath[FILENAME_MAX];
+	char journalPath[FILENAME_MAX];
+	testPath("test.snapshot", snapshotPath);
+	testPath("test.journal", journalPath);
+	ProductRepo* states[16];
+	int undoLengths[16];
+	long ends[16];
+	int steps = 0;
+
+	remove(snapshotPath);
+	remove(journalPath);
+
+	Service* serv = createService(createRepo(), 0);
+	attachJournal(serv, openJournal(journalPath, 0));
+	addProductService(serv, "base", fruit, 1, date(2022, 5, 1));
+	assert(checkpointService(serv, snapshotPath) == 1);
+
+	states[steps] = filterByString(serv, "");
+	undoLengths[steps] = serv->undoLength;
+	ends[steps++] = ftell(serv->journal->file);
+
+	for (int op = 0; op < 11; op++)
+	{
+		if (op == 6 || op == 9)
+		{
+			assert(undoOperation(serv) == 1);
+		}
+		else if (op == 7)
+		{
+			assert(redoOperation(serv) == 1);
+		}
+		else
+		{
+			addToUndoStack(serv);
+			if (op == 3)
+				deleteProductService(serv, "milk", dairy);
+			else if (op == 4)
+				updateProductService(serv, "beef", meat, 7.5, date(2022, 4, 2));
+			else if (op % 2 == 0)
+				addProductService(serv, "milk", dairy, 1.25, date(2022, 3, 15));
+			else
+				addProductService(serv, "beef", meat, 2, date(2022, 3, 17));
+		}
+
+		states[steps] = filterByString(serv, "");
+		undoLengths[steps] = serv->undoLength;
+		ends[steps++] = ftell(serv->journal->file);
+	}
+	destroyService(serv);
+
+	FILE* file = fopen(journalPath, "rb");
+	assert(file != NULL);
+	long size = ends[steps - 1];
+	char* journal = malloc(size);
+	assert(journal != NULL && fread(journal, 1, size, file) == (size_t)size);
+	fclose(file);
+
+	srand(26);
+	for (int trial = 0; trial < 200; trial++)
+	{
+		long cut = trial < steps ? ends[trial] : rand() % (size + 1);
+		int keepHistory = trial % 2;
+
+		file = fopen(journalPath, "wb");
+		assert(file != NULL && fwrite(journal, 1, cut, file) == (size_t)cut);
+		fclose(file);
+
+		int expected = 0;
+		while (expected + 1 < steps && ends[expected + 1] <= cut) expected++;
+
+		serv = recoverService(snapshotPath, journalPath, 0, keepHistory);
+		assert(sameProducts(states[expected], getRepo(serv)) == 1);
+		assert(ftell(serv->journal->file) == ends[expected]);
+		if (keepHistory == 1) assert(serv->undoLength == undoLengths[expected]);
+		destroyService(serv);
+	}
+
+	// Running out of memory in the middle of the replay must leave every committed record in place
+	file = fopen(journalPath, "wb");
+	assert(file != NULL && fwrite(journal, 1, size, file) == (size_t)size);
+	fclose(file);
+
+	for (int limit = 0; limit < 6; limit++)
+	{
+		uint64_t sequence = 0;
+		serv = createService(createRepo(), 0);
+
+		limitReplayAllocations(limit);
+		assert(replayJournal(serv, journalPath, &sequence, limit % 2) == -1);
+		limitReplayAllocations(limit);
+		assert(recoverService(snapshotPath, journalPath, 0, 0) == NULL);
+		limitReplayAllocations(-1);
+		destroyService(serv);
+
+		file = fopen(journalPath, "rb");
+		assert(file != NULL);
+		fseek(file, 0, SEEK_END);
+		assert(ftell(file) == size);
+		fclose(file);
+	}
+
+	serv = recoverService(snapshotPath, journalPath, 0, 1);
+	assert(sameProducts(states[steps - 1], getRepo(serv)) == 1);
+	assert(serv->undoLength == undoLengths[steps - 1]);
+	destroyService(serv);
+
+	for (int i = 0; i < steps; i++)
+		destroyRepo(states[i]);
+	free(journal);
+	remove(snapshotPath);
+	remove(journalPath);
+}
+
+/// <summary>
+/// Runs tests for importing and exporting products
+/// </summary>
+void testImportExport()
+{
+	char csvPath[FILENAME_MAX];
+	char jsonPath[FILENAME_MAX];
+	testPath("test.csv", csvPath);
+	testPath("test.jsonl", jsonPath);
+	TransferStats stats;
+	Product p;
+
+	char csvLine[] = "\"cheese, \"\"aged\"\"\",dairy,0.5,2022-03-20";
+	assert(parseCsvLine(csvLine, &p) == 1);
+	assert(strcmp(p.name, "cheese, \"aged\"") == 0);
+	assert(p.category == dairy && p.quantity == 0.5);
+	assert(p.expiration.year == 2022 && p.expiration.month == 3 && p.expiration.day == 20);
+
+	char badCategory[] = "milk,drinks,1,2022-03-20";
+	char badDate[] = "milk,dairy,1,2022-02-30";
+	char extraField[] = "milk,dairy,1,2022-03-20,x";
+	assert(parseCsvLine(badCategory, &p) == 0);
+	assert(parseCsvLine(badDate, &p) == 0);
+	assert(parseCsvLine(extraField, &p) == 0);
+
+	char jsonLine[] = "{ \"quantity\": 2 , \"name\":\"ice \\\"cream\\\"\", \"expiration\":\"2023/01/31\",\"category\":\"sweets\"}";
+	assert(parseJsonLine(jsonLine, &p) == 1);
+	assert(strcmp(p.name, "ice \"cream\"") == 0);
+	assert(p.category == sweets && p.quantity == 2 && p.expiration.day == 31);
+
+	char missingKey[] = "{\"name\":\"milk\",\"category\":\"dairy\",\"quantity\":1}";
+	assert(parseJsonLine(missingKey, &p) == 0);
+
+	FILE* file = fopen(csvPath, "wb");
+	assert(file != NULL);
+	fputs("name,category,quantity,expiration\r\n", file);
+	fputs("milk,dairy,1,2022-03-15\r\n", file);
+	fputs("milk,dairy,0.25,2022-03-15\n", file);
+	fputs("not a product\n\n", file);
+	fputs("flour,sweets,9007199254.740993,2022-03-17\n", file);
+	fputs("beef,meat,2.5,2022-03-17", file);
+	fclose(file);
+
+	Service* serv = createService(createRepo(), 0);
+	assert(importProducts(serv, csvPath, csvFormat, &stats) == 1);
+	assert(stats.products == 4 && stats.rejected == 1);
+	assert(getLength(getRepo(serv)) == 3);
+	assert(findProductRepo(getRepo(serv), "milk", dairy)->quantity == 1.25);
+	assert(findProductRepo(getRepo(serv), "flour", sweets)->units == (1LL << 53) + 1);
+
+	assert(exportProducts(getRepo(serv), jsonPath, jsonLinesFormat, &stats) == 1);
+	assert(stats.products == 3);
+
+	Service* copy = createService(createRepo(), 0);
+	assert(importProducts(copy, jsonPath, jsonLinesFormat, &stats) == 1);
+	assert(sameProducts(getRepo(serv), getRepo(copy)) == 1);
+
+	assert(exportProducts(getRepo(copy), csvPath, csvFormat, &stats) == 1);
+	destroyService(copy);
+	copy = createService(createRepo(), 0);
+	assert(importProducts(copy, csvPath, csvFormat, &stats) == 1);
+	assert(sameProducts(getRepo(serv), getRepo(copy)) == 1);
+	assert(findProductRepo(getRepo(copy), "flour", sweets)->units == (1LL << 53) + 1);
+
+	destroyService(copy);
+	destroyService(serv);
+	remove(csvPath);
+	remove(jsonPath);
+}
+
+/// <summary>
+/// Runs tests for the buffered output formatting
+/// </summary>
+void testWriter()
+{
+	double quantities[] = { 1, 3.25, 1.33, 0.5, 0.0001, 0.00001, 123456, 1234567, 999999.5, -2.125, 0, 1e-7, 1000.125, 0.000125, 2.5e-4 };
+	char expected[PRODUCT_STRING_SIZE + 1];
+	char actual[4096];
+
+	FILE* file = tmpfile();
+	assert(file != NULL);
+	Writer* out = createWriter(file);
+
+	for (int i = 0; i < (int)(sizeof(quantities) / sizeof(quantities[0])); i++)
+	{
+		Product* product = createProduct("test", dairy, quantities[i], date(2022, 3, 5));
+		toString(product, expected);
+		strcat(expected, "\n");
+
+		out->length = 0;
+		writeProduct(out, product);
+		assert(out->length == strlen(expected));
+		assert(memcmp(out->buffer, expected, out->length) == 0);
+
+		destroyProduct(product);
+	}
+	out->length = 0;
+
+	// Quantities with a seventh digit of 5 are rounded like printf rounds their binary value
+	for (int i = 1000000; i < 1200000; i++)
+	{
+		double quantity = i / 1000.0;
+		int length = snprintf(expected, sizeof(expected), "%g", quantity);
+
+		out->length = 0;
+		writeQuantity(out, quantity);
+		assert(out->length == (size_t)length && memcmp(out->buffer, expected, length) == 0);
+	}
+	out->length = 0;
+
+	// Names longer than the buffer are written in chunks
+	char* name = malloc(WRITER_BUFFER_SIZE * 2);
+	assert(name != NULL);
+	memset(name, 'x', WRITER_BUFFER_SIZE * 2 - 1);
+	name[WRITER_BUFFER_SIZE * 2 - 1] = '\0';
+
+	writeText(out, name);
+	writeInteger(out, -1234567890123LL);
+	assert(flushWriter(out) == 1);
+
+	rewind(file);
+	size_t read = fread(actual, 1, sizeof(actual), file);
+	assert(read == sizeof(actual) && actual[0] == 'x');
+	fseek(file, -14, SEEK_END);
+	assert(fread(actual, 1, 14, file) == 14);
+	assert(memcmp(actual, "-1234567890123", 14) == 0);
+
+	free(name);
+	destroyWriter(out);
+	fclose(file);
+}
+
+/// <summary>
+/// Runs tests for the scripted command mode
+/// </summary>
+void testScript()
+{
+	Service* serv = createService(createRepo(), 0);
+	FILE* file = tmpfile();
+	assert(file != NULL);
+	Writer* out = createWriter(file);
+	ScriptStats stats;
+
+	char add[] = "add milk dairy 1.5 2022-03-15\n";
+	char update[] = "  update\tmilk dairy 2 2022/03/16";
+	char missing[] = "delete cheese dairy";
+	char badDate[] = "add milk dairy 1 2022-13-01";
+	char usage[] = "add milk dairy";
+	char comment[] = "# add milk dairy 1 2022-03-15";
+	char undo[] = "undo";
+
+	assert(executeCommand(serv, out, add, 1) == 1);
+	assert(findProductRepo(getRepo(serv), "milk", dairy)->quantity == 1.5);
+	assert(executeCommand(serv, out, update, 1) == 1);
+	assert(findProductRepo(getRepo(serv), "milk", dairy)->expiration.day == 16);
+	assert(executeCommand(serv, out, missing, 1) == 0);
+	assert(executeCommand(serv, out, badDate, 1) == 0);
+	assert(executeCommand(serv, out, usage, 1) == 0);
+	assert(executeCommand(serv, out, comment, 1) == -1);
+	assert(serv->undoLength == 2);
+	assert(executeCommand(serv, out, undo, 1) == 1);
+	assert(findProductRepo(getRepo(serv), "milk", dairy)->quantity == 1.5);
+
+	FILE* script = tmpfile();
+	FILE* results = tmpfile();
+	assert(script != NULL && results != NULL);
+	fputs("add beef meat 2 2022-03-17\nfilter-exp meat 100000\n\nfilter e\nredo\nnonsense\n", script);
+	rewind(script);
+	destroyWriter(out);
+	out = createWriter(results);
+
+	assert(runScript(serv, script, out, 0, 0, &stats) == 0);
+	assert(stats.commands == 5 && stats.failures == 2);
+	assert(getLength(getRepo(serv)) == 2);
+	assert(serv->undoLength == 0 && serv->redoLength == 0);
+
+	char expected[] = "OK\nProduct beef is part of the \"meat\" category, there is 2 of it in the fridge, and it expires on 2022/03/17.\nOK\n";
+	char actual[sizeof(expected)] = { 0 };
+	rewind(results);
+	assert(fread(actual, 1, sizeof(expected) - 1, results) == sizeof(expected) - 1);
+	assert(strcmp(actual, expected) == 0);
+
+	destroyWriter(out);
+	fclose(results);
+	fclose(script);
+	fclose(file);
+	destroyService(serv);
+}
+
+/// <summary>
+/// Runs tests for the handling of pipelined server requests
+/// </summary>
+void testServer()
+{
+	Service* serv = createService(createRepo(), 0);
+	ServerConnection* conn = createConnection(-1);
+	assert(conn != NULL);
+
+	// Requests may arrive split at any byte and several at once
+	const char* data = "add milk dairy 1 2022-03-15\nadd milk da";
+	assert(receiveRequests(serv, conn, data, strlen(data), 1) == 1);
+	assert(conn->inputLength == strlen("add milk da"));
+
+	data = "iry 2 2022-03-15\n\n# comment\nfilter milk\ndelete x dairy\n";
+	assert(receiveRequests(serv, conn, data, strlen(data), 1) == 3);
+	assert(findProductRepo(getRepo(serv), "milk", dairy)->quantity == 3);
+
+	char expected[] = "OK\nOK\nProduct milk is part of the \"dairy\" category, there is 3 of it in the fridge, and it expires on 2022/03/15.\nOK\nERROR: The product does not exist!\n";
+	assert(conn->out->length == strlen(expected));
+	assert(memcmp(conn->out->buffer, expected, conn->out->length) == 0);
+	discardWriter(conn->out, conn->out->length);
+
+	// A request that is too long is answered once and dropped up to its end
+	char* tooLong = malloc(SCRIPT_MAX_LINE + 1);
+	assert(tooLong != NULL);
+	memset(tooLong, 'a', SCRIPT_MAX_LINE + 1);
+	assert(receiveRequests(serv, conn, tooLong, SCRIPT_MAX_LINE + 1, 1) == 1);
+	assert(receiveRequests(serv, conn, tooLong, 16, 1) == 0);
+	data = "aaa\nundo\nshutdown\nlist\n";
+	assert(receiveRequests(serv, conn, data, strlen(data), 1) == -1);
+	assert(findProductRepo(getRepo(serv), "milk", dairy)->quantity == 1);
+
+	char after[] = "ERROR: Line too long!\nOK\nOK\n";
+	assert(conn->out->length == strlen(after));
+	assert(memcmp(conn->out->buffer, after, conn->out->length) == 0);
+
+	free(tooLong);
+	destroyConnection(conn);
+	destroyService(serv);
+}
+
+#define TEST_SHARED_READERS 4
+#define TEST_SHARED_WRITES 500
+
+/// <summary>
+/// Reads the shared service while it is being changed and checks every version it sees
+/// </summary>
+/// <param name="arg">A pointer to the shared service</param>
+/// <returns>0</returns>
+int readSharedVersions(void* arg)
+{
+	SharedService* shared = arg;
+	int reader = registerReader(shared);
+	assert(reader != -1);
+
+	char name[32];
+	int lastLength = 0;
+	while (lastLength < TEST_SHARED_WRITES)
+	{
+		// Products are only ever added as product0, product1, ... with their index as quantity
+		ProductRepo* version = beginRead(shared, reader);
+		int length = getLength(version);
+		assert(length >= lastLength);
+
+		if (length > 0)
+		{
+			sprintf(name, "product%d", length - 1);
+			Product* last = findProductRepo(version, name, dairy);
+			assert(last != NULL && last->quantity == length - 1);
+		}
+		endRead(shared, reader);
+
+		ProductRepo* filtered = sharedFilterByString(shared, reader, "product");
+		assert(getLength(filtered) >= length);
+		destroyRepo(filtered);
+
+		lastLength = length;
+	}
+
+	unregisterReader(shared, reader);
+	return 0;
+}
+
+/// <summary>
+/// Runs a stress test of concurrent readers and a writer on the shared service
+/// </summary>
+void testSharedService()
+{
+	SharedService* shared = createSharedService(createService(createRepo(), 0));
+	assert(shared != NULL);
+
+	thrd_t readers[TEST_SHARED_READERS];
+	for (int i = 0; i < TEST_SHARED_READERS; i++)
+		assert(thrd_create(&readers[i], readSharedVersions, shared) == thrd_success);
+
+	char name[32];
+	for (int i = 0; i < TEST_SHARED_WRITES; i++)
+	{
+		sprintf(name, "product%d", i);
+		assert(sharedAddProduct(shared, name, dairy, i, date(2022, 3, 15)) == 1);
+	}
+
+	for (int i = 0; i < TEST_SHARED_READERS; i++)
+		assert(thrd_join(readers[i], NULL) == thrd_success);
+
+	// Nobody is reading, so the next change frees every replaced version
+	assert(sharedUndo(shared) == 1);
+	assert(shared->retiredLength == 0);
+	assert(getLength(atomic_load(&shared->current)) == TEST_SHARED_WRITES - 1);
+	assert(sharedRedo(shared) == 1);
+	assert(sharedDeleteProduct(shared, "missing", dairy) == 0);
+	assert(getLength(atomic_load(&shared->current)) == TEST_SHARED_WRITES);
+
+	destroySharedService(shared);
+}
+
+#define TEST_SENSORS 4
+#define TEST_SENSOR_EVENTS 10000
+
+typedef struct
+{
+	EventQueue* queue;
+	int sensor;
+} TestSensor;
+
+/// <summary>
+/// Pushes increasing readings of one product, retrying the ones that are dropped
+/// </summary>
+/// <param name="arg">A pointer to the test sensor</param>
+/// <returns>0</returns>
+int pushSensorEvents(void* arg)
+{
+	TestSensor* sensor = arg;
+	char name[32];
+	sprintf(name, "sensor%d", sensor->sensor);
+
+	for (int i = 0; i < TEST_SENSOR_EVENTS; i++)
+		while (pushEvent(sensor->queue, name, meat, i) == 0) thrd_yield();
+
+	return 0;
+}
+
+/// <summary>
+/// Runs tests for the sensor event queue
+/// </summary>
+void testEventQueue()
+{
+	char journalPath[FILENAME_MAX];
+	testPath("events.journal", journalPath);
+	remove(journalPath);
+
+	Service* serv = createService(createRepo(), 0);
+	addProductService(serv, "milk", dairy, 1, date(2022, 3, 15));
+	addProductService(serv, "cheese", dairy, 1, date(2022, 3, 15));
+	addProductService(serv, "butter", dairy, 1, date(2022, 3, 15));
+	attachJournal(serv, openJournal(journalPath, 0));
+	SharedService* shared = createSharedService(serv);
+	EventQueue* queue = createEventQueue();
+	EventStats stats;
+	char name[EVENT_MAX_NAME + 1];
+
+	// Repeated readings of a product in a batch are applied once
+	assert(pushEvent(queue, "milk", dairy, 2) == 1);
+	assert(pushEvent(queue, "cheese", dairy, 5) == 1);
+	assert(pushEvent(queue, "milk", dairy, 3) == 1);
+	assert(pushEvent(queue, "ham", meat, 1) == 1);
+	assert(drainEvents(queue, shared) == 4);
+	assert(drainEvents(queue, shared) == 0);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->quantity == 3);
+	assert(findProductRepo(atomic_load(&shared->current), "cheese", dairy)->quantity == 5);
+	getEventStats(queue, &stats);
+	assert(stats.pushed == 4 && stats.applied == 3 && stats.coalesced == 1 && stats.batches == 1);
+
+	// A batch is one journaled operation, undone and redone as a whole without copying the other products
+	assert(serv->journal->sequence == 1);
+	assert(serv->undoLength == 1 && serv->undoStack[0].kind == stateUpdate && getLength(serv->undoStack[0].repo) == 2);
+	assert(sharedUndo(shared) == 1);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->quantity == 1);
+	assert(findProductRepo(atomic_load(&shared->current), "cheese", dairy)->quantity == 1);
+	assert(sharedRedo(shared) == 1 && sharedRedo(shared) == 0);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->quantity == 3);
+	assert(findProductRepo(atomic_load(&shared->current), "cheese", dairy)->quantity == 5);
+	assert(serv->journal->sequence == 3);
+
+	// A reading after an undo drops the redo states, like any other change
+	assert(sharedUndo(shared) == 1);
+	assert(pushEvent(queue, "butter", dairy, 2) == 1 && drainEvents(queue, shared) == 1);
+	assert(sharedRedo(shared) == 0 && sharedUndo(shared) == 1);
+	assert(findProductRepo(atomic_load(&shared->current), "butter", dairy)->quantity == 1);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->quantity == 1);
+	attachJournal(serv, NULL);
+	remove(journalPath);
+
+	// A full queue drops events instead of waiting
+	for (int i = 0; i < EVENT_QUEUE_SIZE; i++)
+		assert(pushEvent(queue, "milk", dairy, i) == 1);
+	assert(pushEvent(queue, "milk", dairy, 0) == 0);
+	memset(name, 'a', EVENT_MAX_NAME);
+	name[EVENT_MAX_NAME] = '\0';
+	assert(pushEvent(queue, name, dairy, 0) == 0);
+	getEventStats(queue, &stats);
+	assert(stats.dropped == 2 && stats.backpressure == EVENT_QUEUE_SIZE - EVENT_HIGH_WATER);
+	while (drainEvents(queue, shared) > 0);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->quantity == EVENT_QUEUE_SIZE - 1);
+
+	// Concurrent sensors, each one's last reading is the one that stays
+	TestSensor sensors[TEST_SENSORS];
+	thrd_t threads[TEST_SENSORS];
+	for (int i = 0; i < TEST_SENSORS; i++)
+	{
+		sprintf(name, "sensor%d", i);
+		assert(sharedAddProduct(shared, name, meat, -1, date(2022, 3, 15)) == 1);
+	}
+
+	assert(startApplier(queue, shared) == 1);
+	for (int i = 0; i < TEST_SENSORS; i++)
+	{
+		sensors[i].queue = queue;
+		sensors[i].sensor = i;
+		assert(thrd_create(&threads[i], pushSensorEvents, &sensors[i]) == thrd_success);
+	}
+	for (int i = 0; i < TEST_SENSORS; i++)
+		thrd_join(threads[i], NULL);
+	stopApplier(queue);
+
+	for (int i = 0; i < TEST_SENSORS; i++)
+	{
+		sprintf(name, "sensor%d", i);
+		assert(findProductRepo(atomic_load(&shared->current), name, meat)->quantity == TEST_SENSOR_EVENTS - 1);
+	}
+
+	destroyEventQueue(queue);
+	destroySharedService(shared);
+}
+
+/// <summary>
+/// Runs tests for the parallel filters and sorts, comparing them with the sequential ones
+/// </summary>
+void testParallel()
+{
+	ThreadPool* pool = createThreadPool(4);
+	assert(pool != NULL);
+	char name[32];
+
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 3000; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductRepo(repo, createProduct(name, CATEGORY_START + i % CATEGORY_END, i % 100 / 4.0, date(2022 + i % 3, 1 + i % 12, 1 + i % 28)));
+	}
+
+	ProductRepo* expected[4];
+	ProductRepo* actual[4];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		ProductRepo** results = pass == 0 ? expected : actual;
+		setDefaultPool(pass == 0 ? NULL : pool, 100);
+
+		results[0] = filterRepoByString(repo, "1");
+		results[1] = filterRepoByCategoryAndExpiration(repo, meat, 100000);
+		results[2] = filterRepoByString(repo, "");
+		sortByQuantity(results[2], 1);
+		results[3] = filterRepoByString(repo, "");
+		sortByName(results[3], 0);
+	}
+	setDefaultPool(NULL, POOL_DEFAULT_THRESHOLD);
+
+	// Same products in the same order, ties included
+	for (int i = 0; i < 4; i++)
+	{
+		assert(getLength(expected[i]) == getLength(actual[i]) && getLength(actual[i]) > 0);
+		for (int j = 0; j < getLength(actual[i]); j++)
+		{
+			Product* first = getProductAt(expected[i], j);
+			Product* second = getProductAt(actual[i], j);
+			assert(strcmp(first->name, second->name) == 0 && first->category == second->category);
+		}
+		assert(findProductRepo(actual[i], getProductAt(actual[i], 0)->name, getProductAt(actual[i], 0)->category) != NULL);
+
+		destroyRepo(expected[i]);
+		destroyRepo(actual[i]);
+	}
+
+	destroyRepo(repo);
+	destroyThreadPool(pool);
+}
+
+/// <summary>
+/// Fails on fridge 8, used to test fleet queries that fail on one fridge
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="arg">Unused</param>
+/// <returns>A pointer to a copy of the repository,
+///			 NULL, for the repository of fridge 8</returns>
+static ProductRepo* filterFailing(ProductRepo* repo, void* arg)
+{
+	(void)arg;
+	return getLength(repo) == 20 ? NULL : filterRepoByString(repo, "");
+}
+
+/// <summary>
+/// Runs tests for the fleet, merging the results of several fridges
+/// </summary>
+void testFleet()
+{
+	ThreadPool* pool = createThreadPool(3);
+	Fleet* fleet = createFleet(pool);
+	assert(fleet != NULL && getFleetSize(fleet) == 0);
+	char name[32];
+
+	// Fridge 7 gets the quantities 0, 3, 6..., fridge 8 gets 1, 4, 7... and fridge 9 gets 2, 5, 8...
+	for (int i = 0; i < 60; i++)
+	{
+		sprintf(name, "milk%d", i);
+		assert(fleetAddProduct(fleet, 7 + i % 3, name, dairy, i, date(2022, 1, 1)) == 1);
+	}
+	assert(fleetAddProduct(fleet, 7, "milk0", dairy, 1, date(2022, 1, 1)) == 1);
+	assert(getFleetSize(fleet) == 3);
+
+	FridgeShard* shard = acquireFridge(fleet, 8);
+	assert(shard != NULL && shard->fridgeId == 8 && getLength(getRepo(shard->serv)) == 20);
+	releaseFridge(shard);
+
+	// The merge keeps the order across fridges, ties go to the fridge that was added first
+	FleetResult* result = fleetFilterByString(fleet, "milk", compareByQuantity, 0);
+	assert(result->length == 60 && result->partCount == 3);
+	assert(result->items[0].fridgeId == 7 && result->items[0].product->quantity == 1);
+	assert(result->items[1].fridgeId == 8 && result->items[1].product->quantity == 1);
+	for (int i = 2; i < 60; i++)
+	{
+		assert(result->items[i].product->quantity == i);
+		assert(result->items[i].fridgeId == 7 + i % 3);
+	}
+	destroyFleetResult(result);
+
+	result = fleetFilterByString(fleet, "milk1", compareByQuantity, 1);
+	assert(result->length == 11 && result->items[0].product->quantity == 19 && result->items[10].product->quantity == 1);
+	destroyFleetResult(result);
+
+	// Without an order the products of every fridge stay together
+	result = fleetFilterByString(fleet, "milk5", NULL, 0);
+	assert(result->length == 11);
+	for (int i = 1; i < result->length; i++)
+		assert(result->items[i - 1].fridgeId <= result->items[i].fridgeId);
+	destroyFleetResult(result);
+
+	result = fleetFilterByCategoryAndExpiration(fleet, meat, 100000, compareByExpiration, 0);
+	assert(result->length == 0);
+	destroyFleetResult(result);
+
+	// A fridge that cannot be queried fails the whole query, the other parts are freed
+	assert(fleetQuery(fleet, filterFailing, NULL, compareByQuantity, 0) == NULL);
+	assert(fleetQuery(fleet, filterFailing, NULL, NULL, 0) == NULL);
+
+	destroyFleet(fleet);
+	destroyThreadPool(pool);
+}
+
+typedef struct
+{
+	int count;
+	int wrong; // Alerts that did not fire exactly at the threshold
+	int daysLeft;
+	char name[32];
+} AlertLog;
+
+/// <summary>
+/// Records an alert of the timer wheel
+/// </summary>
+/// <param name="context">A pointer to the alert log</param>
+/// <param name="entry">A pointer to the entry of the product</param>
+/// <param name="daysLeft">The days until the product expires</param>
+void recordAlert(void* context, ExpiryEntry* entry, int daysLeft)
+{
+	AlertLog* log = context;
+
+	log->count++;
+	log->daysLeft = daysLeft;
+	if (daysLeft != 3) log->wrong++;
+	strcpy(log->name, entry->name);
+}
+
+/// <summary>
+/// Runs tests for the timer wheel and its integration with the service
+/// </summary>
+void testExpiryWheel()
+{
+	AlertLog log = { 0 };
+	ExpiryWheel* wheel = createExpiryWheel(3, date(2022, 3, 1), recordAlert, &log);
+	assert(wheel != NULL);
+
+	// Already within the threshold, so it alerts on the first advance
+	assert(scheduleExpiry(wheel, "milk", dairy, date(2022, 3, 3)) == 1);
+	assert(scheduleExpiry(wheel, "beef", meat, date(2022, 3, 10)) == 1);
+	assert(scheduleExpiry(wheel, "jam", sweets, date(2022, 9, 1)) == 1);
+	assert(scheduleExpiry(wheel, "honey", sweets, date(2040, 1, 1)) == 1);
+	assert(getPendingExpiries(wheel) == 4);
+
+	assert(advanceExpiryWheel(wheel, date(2022, 3, 1)) == 1 && strcmp(log.name, "milk") == 0 && log.daysLeft == 2);
+	assert(advanceExpiryWheel(wheel, date(2022, 3, 6)) == 0);
+
+	// Rescheduling moves the alert, an unchanged date does not alert again
+	assert(scheduleExpiry(wheel, "beef", meat, date(2022, 3, 20)) == 1);
+	assert(scheduleExpiry(wheel, "milk", dairy, date(2022, 3, 3)) == 1);
+	assert(advanceExpiryWheel(wheel, date(2022, 3, 16)) == 0);
+	assert(advanceExpiryWheel(wheel, date(2022, 3, 17)) == 1 && strcmp(log.name, "beef") == 0 && log.daysLeft == 3);
+
+	assert(scheduleExpiry(wheel, "old", dairy, date(2021, 1, 1)) == 1);
+	assert(advanceExpiryWheel(wheel, date(2022, 3, 18)) == 1 && strcmp(log.name, "old") == 0 && log.daysLeft < 0);
+
+	assert(cancelExpiry(wheel, "jam", sweets) == 1 && cancelExpiry(wheel, "jam", sweets) == 0);
+	assert(getPendingExpiries(wheel) == 1);
+	assert(advanceExpiryWheel(wheel, date(2040, 1, 1)) == 1 && strcmp(log.name, "honey") == 0 && log.daysLeft == 0);
+	destroyExpiryWheel(wheel);
+
+	// Every alert across all levels fires exactly on its day
+	char name[32];
+	log.count = 0;
+	log.wrong = 0;
+	wheel = createExpiryWheel(3, date(2022, 1, 1), recordAlert, &log);
+	for (int i = 0; i < 2000; i++)
+	{
+		sprintf(name, "product%d", i);
+		assert(scheduleExpiry(wheel, name, CATEGORY_START + i % CATEGORY_END, date(2023 + i % 49, 1 + i * 7 % 12, 1 + i % 31 % 28)) == 1);
+	}
+	for (Date day = date(2022, 1, 1); day.year < 2072; day.year++)
+		for (day.month = 1; day.month <= 12; day.month++)
+			for (day.day = 1; day.day <= 31; day.day++)
+				if (isValidDate(day)) advanceExpiryWheel(wheel, day);
+	assert(log.count == 2000 && log.wrong == 0 && getPendingExpiries(wheel) == 0);
+	destroyExpiryWheel(wheel);
+
+	// The service keeps the wheel in step with its products, undo and redo included
+	log.count = 0;
+	Service* serv = createService(createRepo(), 0);
+	attachExpiryWheel(serv, createExpiryWheel(3, date(2022, 3, 1), recordAlert, &log));
+
+	addToUndoStack(serv);
+	assert(addProductService(serv, "milk", dairy, 1, date(2022, 3, 10)) == 1);
+	assert(getPendingExpiries(serv->wheel) == 1);
+	assert(undoOperation(serv) == 1 && getPendingExpiries(serv->wheel) == 0);
+	assert(redoOperation(serv) == 1 && getPendingExpiries(serv->wheel) == 1);
+
+	assert(updateProductService(serv, "milk", dairy, 2, date(2022, 3, 5)) == 1);
+	assert(advanceExpiryWheel(serv->wheel, date(2022, 3, 2)) == 1 && log.daysLeft == 3);
+	assert(deleteProductService(serv, "milk", dairy) == 1 && serv->wheel->count == 0);
+
+	destroyService(serv);
+}
+
+#define TEST_VIEW_WRITES 500
+
+/// <summary>
+/// Reads a low stock view while products are being added and checks every result it sees
+/// </summary>
+/// <param name="arg">A pointer to the view</param>
+/// <returns>0</returns>
+int readViewResults(void* arg)
+{
+	MaterializedView* view = arg;
+	char name[32];
+	int lastLength = 0;
+
+	while (lastLength < TEST_VIEW_WRITES)
+	{
+		int ticket;
+		ProductRepo* rows = beginViewRead(view, &ticket);
+		int length = getLength(rows);
+		assert(length >= lastLength);
+
+		if (length > 0)
+		{
+			sprintf(name, "product%d", length - 1);
+			assert(findProductRepo(rows, name, dairy) != NULL);
+		}
+		endViewRead(view, ticket);
+
+		lastLength = length;
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Runs tests for the materialized views, through the service and with a concurrent reader
+/// </summary>
+void testViews()
+{
+	Service* serv = createService(createRepo(), 0);
+	MaterializedView* expiring = registerView(serv, createExpiringView(&serv->repo, dairy, 3, date(2022, 3, 1)));
+	MaterializedView* low = registerView(serv, createLowStockView(&serv->repo, none, 2));
+	assert(expiring != NULL && low != NULL);
+	assert(findView(serv, viewExpiring, dairy, 3, 0) == expiring && findView(serv, viewExpiring, dairy, 4, 0) == NULL);
+	assert(findView(serv, viewLowStock, none, 0, 2) == low);
+
+	int ticket;
+	assert(addProductService(serv, "milk", dairy, 1, date(2022, 3, 3)) == 1);
+	assert(addProductService(serv, "yogurt", dairy, 5, date(2022, 3, 10)) == 1);
+	assert(addProductService(serv, "beef", meat, 1, date(2022, 3, 2)) == 1);
+
+	ProductRepo* rows = beginViewRead(expiring, &ticket);
+	assert(getLength(rows) == 1 && findProductRepo(rows, "milk", dairy) != NULL);
+	endViewRead(expiring, ticket);
+	rows = beginViewRead(low, &ticket);
+	assert(getLength(rows) == 2 && findProductRepo(rows, "yogurt", dairy) == NULL);
+	endViewRead(low, ticket);
+
+	// Updates move products in and out, the days passing bring them into the window
+	assert(updateProductService(serv, "yogurt", dairy, 1.5, date(2022, 3, 10)) == 1);
+	assert(getLength(atomic_load(&low->published)) == 3);
+	assert(updateProductService(serv, "milk", dairy, 3, date(2022, 3, 3)) == 1);
+	assert(getLength(atomic_load(&low->published)) == 2);
+	advanceViews(serv, date(2022, 3, 7));
+	assert(getLength(atomic_load(&expiring->published)) == 2);
+
+	addToUndoStack(serv);
+	assert(deleteProductService(serv, "milk", dairy) == 1);
+	assert(getLength(atomic_load(&expiring->published)) == 1);
+	assert(undoOperation(serv) == 1 && getLength(atomic_load(&expiring->published)) == 2);
+	assert(redoOperation(serv) == 1 && getLength(atomic_load(&expiring->published)) == 1);
+
+	// The script language registers views and answers from them
+	Writer* out = createWriter(NULL);
+	char watch[] = "watch-low meat 5";
+	char missing[] = "filter-low fruit 5";
+	char filter[] = "filter-low meat 5";
+	assert(executeCommand(serv, out, watch, 0) == 1 && serv->viewLength == 3);
+	assert(executeCommand(serv, out, missing, 0) == 0);
+	discardWriter(out, out->length);
+	assert(executeCommand(serv, out, filter, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "beef") != NULL && strstr(out->buffer, "yogurt") == NULL);
+	destroyWriter(out);
+
+	assert(unregisterView(serv, expiring) == 1 && unregisterView(serv, expiring) == 0);
+	destroyService(serv);
+
+	// Readers never see a result go backwards while the writer publishes
+	serv = createService(createRepo(), 0);
+	low = registerView(serv, createLowStockView(&serv->repo, none, 1));
+
+	thrd_t reader;
+	assert(thrd_create(&reader, readViewResults, low) == thrd_success);
+
+	char name[32];
+	for (int i = 0; i < TEST_VIEW_WRITES; i++)
+	{
+		sprintf(name, "product%d", i);
+		assert(addProductService(serv, name, dairy, 0, date(2022, 3, 15)) == 1);
+	}
+	assert(thrd_join(reader, NULL) == thrd_success);
+
+	destroyService(serv);
+}
+
+/// <summary>
+/// Checks the aggregates of every category against a scan of the repository
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+void checkAggregates(ProductRepo* repo)
+{
+	for (Category category = none; category <= CATEGORY_END; category++)
+	{
+		CategorySummary summary = summarizeCategory(repo, category);
+		int count = 0;
+		double quantity = 0;
+		Product* earliest = NULL;
+		Product* latest = NULL;
+
+		for (int i = 0; i < getLength(repo); i++)
+		{
+			Product* current = getProductAt(repo, i);
+			if (category != none && current->category != category) continue;
+
+			count++;
+			quantity += current->quantity;
+			if (earliest == NULL || compareByExpiration(current, earliest) < 0) earliest = current;
+			if (latest == NULL || compareByExpiration(current, latest) > 0) latest = current;
+		}
+
+		assert(summary.count == count && fabs(summary.quantity - quantity) < 1e-6);
+		assert(earliest == NULL ? summary.earliest == NULL : compareByExpiration(summary.earliest, earliest) == 0);
+		assert(latest == NULL ? summary.latest == NULL : compareByExpiration(summary.latest, latest) == 0);
+	}
+}
+
+/// <summary>
+/// Runs tests for the per category aggregates of the repository
+/// </summary>
+void testAggregates()
+{
+	ProductRepo* repo = createRepo();
+	CategorySummary summary = summarizeCategory(repo, dairy);
+	assert(summary.count == 0 && summary.quantity == 0 && summary.earliest == NULL);
+
+	addProductRepo(repo, createProduct("milk", dairy, 1, date(2022, 3, 15)));
+	addProductRepo(repo, createProduct("yogurt", dairy, 3.25, date(2022, 3, 14)));
+	addProductRepo(repo, createProduct("eggs", dairy, 6, date(2022, 3, 28)));
+	addProductRepo(repo, createProduct("beef", meat, 1.5, date(2022, 3, 17)));
+	addProductRepo(repo, createProduct("milk", dairy, 1, date(2022, 3, 1)));
+
+	summary = summarizeCategory(repo, dairy);
+	assert(summary.count == 3 && summary.quantity == 11.25);
+	assert(strcmp(summary.earliest->name, "yogurt") == 0 && strcmp(summary.latest->name, "eggs") == 0);
+	summary = summarizeCategory(repo, none);
+	assert(summary.count == 4 && summary.quantity == 12.75 && strcmp(summary.latest->name, "eggs") == 0);
+
+	updateProductRepo(repo, "eggs", dairy, 2, date(2022, 3, 10));
+	summary = summarizeCategory(repo, dairy);
+	assert(summary.quantity == 7.25 && strcmp(summary.earliest->name, "eggs") == 0 && strcmp(summary.latest->name, "milk") == 0);
+
+	removeProductRepo(repo, "eggs", dairy);
+	removeProductRepo(repo, "beef", meat);
+	summary = summarizeCategory(repo, dairy);
+	assert(summary.count == 2 && strcmp(summary.earliest->name, "yogurt") == 0);
+	summary = summarizeCategory(repo, meat);
+	assert(summary.count == 0 && summary.quantity == 0 && summary.latest == NULL);
+	destroyRepo(repo);
+
+	// The compensated sum does not lose the small quantities
+	char name[32];
+	repo = createRepo();
+	for (int i = 0; i < 1000; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductRepo(repo, createProduct(name, fruit, 0.1, date(2022, 1, 1)));
+	}
+	assert(fabs(summarizeCategory(repo, fruit).quantity - 100) < 1e-12);
+	destroyRepo(repo);
+
+	// Random changes keep every aggregate equal to a scan
+	repo = createRepo();
+	srand(38);
+	for (int i = 0; i < 3000; i++)
+	{
+		sprintf(name, "product%d", rand() % 300);
+		Category category = CATEGORY_START + rand() % CATEGORY_END;
+		Date expiration = date(2022 + rand() % 3, 1 + rand() % 12, 1 + rand() % 28);
+
+		switch (rand() % 3)
+		{
+			case 0:
+				addProductRepo(repo, createProduct(name, category, rand() % 100 / 8.0, expiration));
+				break;
+			case 1:
+				updateProductRepo(repo, name, category, rand() % 100 / 8.0, expiration);
+				break;
+			default:
+				removeProductRepo(repo, name, category);
+		}
+	}
+	checkAggregates(repo);
+	destroyRepo(repo);
+
+	// Undo and redo restore repositories with their aggregates
+	Service* serv = createService(createRepo(), 1);
+	summary = summarizeCategory(getRepo(serv), none);
+	assert(summary.count == 10);
+
+	addToUndoStack(serv);
+	assert(deleteProductService(serv, "yogurt", dairy) == 1);
+	assert(summarizeCategory(getRepo(serv), dairy).count == 2);
+	assert(strcmp(summarizeCategory(getRepo(serv), dairy).earliest->name, "milk") == 0);
+	assert(undoOperation(serv) == 1);
+	assert(strcmp(summarizeCategory(getRepo(serv), dairy).earliest->name, "yogurt") == 0);
+	assert(redoOperation(serv) == 1);
+	checkAggregates(getRepo(serv));
+
+	destroyService(serv);
+}
+
+/// <summary>
+/// Runs tests for the query cache, on its own and through the service
+/// </summary>
+void testQueryCache()
+{
+	CacheStats stats;
+	QueryCache* cache = createQueryCache(2);
+
+	assert(findCachedResult(cache, queryString, "m", none, 0, 1, 10) == NULL);
+	assert(storeCachedResult(cache, queryString, "m", none, 0, 1, 10, NULL) == NULL);
+	assert(cache->length == 0);
+	ProductRepo* first = storeCachedResult(cache, queryString, "m", none, 0, 1, 10, createRepo());
+	assert(findCachedResult(cache, queryString, "m", none, 0, 1, 10) == first);
+	releaseCachedResult(cache, first);
+	assert(findCachedResult(cache, queryExpiration, NULL, dairy, 3, 1, 10) == NULL);
+	ProductRepo* second = storeCachedResult(cache, queryExpiration, NULL, dairy, 3, 1, 10, createRepo());
+	releaseCachedResult(cache, second);
+
+	// The least recently used result is evicted, it stays valid until it is released
+	ProductRepo* third = storeCachedResult(cache, queryString, "y", none, 0, 1, 10, createRepo());
+	assert(cache->length == 2 && cache->detached != NULL && cache->detached->result == first);
+	releaseCachedResult(cache, first);
+	assert(cache->detached == NULL);
+	assert(findCachedResult(cache, queryString, "m", none, 0, 1, 10) == NULL);
+	assert(findCachedResult(cache, queryExpiration, NULL, dairy, 3, 1, 10) == second);
+	releaseCachedResult(cache, second);
+
+	// A new version or a new day invalidates the old results
+	assert(findCachedResult(cache, queryExpiration, NULL, dairy, 3, 1, 11) == NULL);
+	assert(findCachedResult(cache, queryString, "y", none, 0, 2, 10) == NULL);
+	assert(cache->length == 0 && cache->detached->result == third);
+	releaseCachedResult(cache, third);
+	assert(cache->detached == NULL);
+
+	getCacheStats(cache, &stats);
+	assert(stats.hits == 2 && stats.misses == 5 && stats.evictions == 1 && stats.invalidations == 2);
+	destroyQueryCache(cache);
+
+	// The service serves repeated queries from the cache until it changes
+	Service* serv = createService(createRepo(), 1);
+	ProductRepo* result = cachedFilterByString(serv, "o");
+	assert(result == cachedFilterByString(serv, "o") && getLength(result) == 4);
+	releaseResult(serv, result);
+	releaseResult(serv, result);
+
+	ProductRepo* expiring = cachedFilterByCategoryAndExpiration(serv, dairy, 1000000);
+	assert(getLength(expiring) == 3 && cachedFilterByCategoryAndExpiration(serv, dairy, 1000000) == expiring);
+	releaseResult(serv, expiring);
+	releaseResult(serv, expiring);
+
+	// A result that is still in use survives the change that invalidates it
+	result = cachedFilterByString(serv, "o");
+	addToUndoStack(serv);
+	assert(deleteProductService(serv, "yogurt", dairy) == 1);
+	ProductRepo* changed = cachedFilterByString(serv, "o");
+	assert(getLength(result) == 4 && getLength(changed) == 3);
+	releaseResult(serv, changed);
+	releaseResult(serv, result);
+
+	assert(undoOperation(serv) == 1);
+	result = cachedFilterByString(serv, "o");
+	assert(getLength(result) == 4);
+	releaseResult(serv, result);
+
+	// The script language reports the counters
+	Writer* out = createWriter(NULL);
+	char command[] = "cache-stats";
+	assert(executeCommand(serv, out, command, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "3 hits, 4 misses") != NULL);
+	destroyWriter(out);
+
+	destroyService(serv);
+}
+
+/// <summary>
+/// Runs tests for the top-K pages and their continuation tokens
+/// </summary>
+void testPages()
+{
+	char name[32];
+	Page page;
+	PageCursor cursor = { 0 };
+	ProductRepo* repo = createRepo();
+
+	// Many equal quantities, the name and category break the ties
+	srand(40);
+	for (int i = 0; i < 500; i++)
+	{
+		sprintf(name, "product%d", rand() % 200);
+		addProductRepo(repo, createProduct(name, CATEGORY_START + rand() % CATEGORY_END, rand() % 10, date(2022, 1 + rand() % 12, 1 + rand() % 28)));
+	}
+
+	// Walking the pages gives every match once, in the order of a full sort
+	for (PageOrder order = orderByQuantity; order <= orderByExpiration; order++)
+	{
+		ProductRepo* sorted = filterRepoByString(repo, "1");
+		for (int i = 0; i < getLength(sorted); i++)
+			for (int j = i + 1; j < getLength(sorted); j++)
+			{
+				Product* first = getProductAt(sorted, i);
+				Product* second = getProductAt(sorted, j);
+				int result = order == orderByQuantity ? compareByQuantity(first, second) : order == orderByExpiration ? compareByExpiration(first, second) : 0;
+				if (result == 0) result = compareByName(first, second);
+				if (result == 0) result = (int)first->category - (int)second->category;
+				if (result > 0)
+				{
+					sorted->products[i] = second;
+					sorted->products[j] = first;
+				}
+			}
+
+		int seen = 0;
+		cursor.valid = 0;
+		do
+		{
+			assert(pageByString(repo, "1", matchSubstring, order, 7, &cursor, &page) == 1);
+			assert(getLength(page.rows) <= 7 && (page.next.valid == 0 || getLength(page.rows) == 7));
+			for (int i = 0; i < getLength(page.rows); i++, seen++)
+			{
+				Product* p = getProductAt(page.rows, i);
+				assert(strcmp(p->name, getProductAt(sorted, seen)->name) == 0 && p->category == getProductAt(sorted, seen)->category);
+			}
+			takeNextCursor(&page, &cursor);
+			destroyPage(&page);
+		} while (cursor.valid == 1);
+		assert(seen == getLength(sorted));
+
+		destroyRepo(sorted);
+	}
+
+	// Changes between pages neither repeat nor skip the products that were already there
+	assert(pageByString(repo, "", matchSubstring, orderByName, 5, NULL, &page) == 1);
+	takeNextCursor(&page, &cursor);
+	Product* last = getProductAt(page.rows, 4);
+	addProductRepo(repo, createProduct("a", dairy, 1, date(2022, 1, 1)));
+	removeProductRepo(repo, last->name, last->category);
+	destroyPage(&page);
+	assert(pageByString(repo, "", matchSubstring, orderByName, 5, &cursor, &page) == 1);
+	Product start = { cursor.name, cursor.category, fromQuantity(cursor.units), cursor.expiration, { -1, -1 }, NULL, cursor.units };
+	for (int i = 0; i < getLength(page.rows); i++)
+	{
+		Product* p = getProductAt(page.rows, i);
+		int result = compareByName(p, &start);
+		assert(result > 0 || (result == 0 && p->category > start.category));
+	}
+	destroyPage(&page);
+	clearCursor(&cursor);
+
+	// Expiring products, ordered by expiration
+	assert(pageByCategoryAndExpiration(repo, dairy, 10, date(2022, 6, 1), orderByExpiration, 3, NULL, &page) == 1);
+	for (int i = 0; i < getLength(page.rows); i++)
+	{
+		Product* p = getProductAt(page.rows, i);
+		assert(p->category == dairy && daysFromCivil(p->expiration) <= daysFromCivil(date(2022, 6, 11)));
+		assert(i == 0 || compareByExpiration(getProductAt(page.rows, i - 1), p) <= 0);
+	}
+	destroyPage(&page);
+	destroyRepo(repo);
+
+	// Names longer than a product string still give every product once at a page boundary
+	char longName[PRODUCT_STRING_SIZE * 2];
+	char token[PAGE_CURSOR_SIZE + sizeof(longName)];
+	PageCursor parsed = { 0 };
+	int seen = 0;
+
+	repo = createRepo();
+	memset(longName, 'x', sizeof(longName) - 2);
+	longName[sizeof(longName) - 1] = '\0';
+	for (char last = 'a'; last <= 'c'; last++)
+	{
+		longName[sizeof(longName) - 2] = last;
+		addProductRepo(repo, createProduct(longName, none, 1, date(2022, 1, 1)));
+	}
+	do
+	{
+		assert(pageByString(repo, "x", matchSubstring, orderByName, 1, seen == 0 ? NULL : &parsed, &page) == 1);
+		assert(getLength(page.rows) == 1 && getProductAt(page.rows, 0)->name[sizeof(longName) - 2] == 'a' + seen++);
+		if (page.next.valid == 1)
+		{
+			assert(strcmp(page.next.name, getProductAt(page.rows, 0)->name) == 0);
+			assert(formatCursor(&page.next, token, sizeof(token)) == 1 && parseCursor(token, &parsed) == 1);
+			assert(parsed.category == none && strcmp(parsed.name, page.next.name) == 0);
+		}
+		else clearCursor(&parsed);
+		destroyPage(&page);
+	} while (parsed.valid == 1);
+	assert(seen == 3);
+	destroyRepo(repo);
+
+	// Tokens bring back the exact cursor, the name may contain slashes
+	PageCursor original = { 1, (1LL << 53) + 1, { 2022, 3, 15 }, meat, "half/chicken" };
+	assert(formatCursor(&original, token, sizeof(token)) == 1 && parseCursor(token, &parsed) == 1);
+	assert(parsed.units == (1LL << 53) + 1 && parsed.category == meat && parsed.expiration.day == 15 && strcmp(parsed.name, "half/chicken") == 0);
+	assert(parseCursor("1/2022-13-01/meat/a", &parsed) == 0 && parseCursor("1/2022-01-01/fish/a", &parsed) == 0);
+	assert(parseCursor("x/2022-01-01/meat/a", &parsed) == 0 && parseCursor("1/2022-01-01/meat/", &parsed) == 0);
+	assert(parseCursor("1/2022-01-01/none/a", &parsed) == 1 && parsed.category == none);
+	assert(formatCursor(&original, token, 8) == 0);
+	clearCursor(&parsed);
+
+	// The script language returns the token of the next page
+	Service* serv = createService(createRepo(), 1);
+	Writer* out = createWriter(NULL);
+	char top[] = "top quantity 2 o";
+	assert(executeCommand(serv, out, top, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "chocolate") != NULL && strstr(out->buffer, "sour_candy") == NULL);
+	assert(strstr(out->buffer, "NEXT 3.25/2022-03-14/dairy/yogurt\n") != NULL);
+
+	char after[64] = "top-after quantity 5 ";
+	strcat(after, strstr(out->buffer, "NEXT ") + 5);
+	after[strcspn(after, "\n")] = '\0';
+	strcat(after, " o");
+	discardWriter(out, out->length);
+	assert(executeCommand(serv, out, after, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "yogurt") == NULL && strstr(out->buffer, "sour_candy") != NULL && strstr(out->buffer, "oranges") != NULL);
+	assert(strstr(out->buffer, "NEXT") == NULL);
+
+	char invalid[] = "top size 2";
+	assert(executeCommand(serv, out, invalid, 0) == 0);
+	destroyWriter(out);
+	destroyService(serv);
+}
+
+/// <summary>
+/// Checks the completions of a prefix against a scan of the repository
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="prefix">The prefix</param>
+void checkCompletions(ProductRepo* repo, const char* prefix)
+{
+	Product* completions[TRIE_TOP_COUNT];
+	Product* expected[TRIE_TOP_COUNT];
+	int length = 0;
+
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		Product* p = getProductAt(repo, i);
+		if (strncmp(p->name, prefix, strlen(prefix)) != 0) continue;
+
+		// Insertion into the list of the best products seen so far
+		int position = length < TRIE_TOP_COUNT ? length++ : TRIE_TOP_COUNT;
+		while (position > 0)
+		{
+			Product* other = expected[position - 1];
+			int result = other->quantity != p->quantity ? (other->quantity < p->quantity ? 1 : -1) : strcmp(other->name, p->name);
+			if (result == 0) result = (int)other->category - (int)p->category;
+			if (result < 0) break;
+
+			if (position < TRIE_TOP_COUNT) expected[position] = other;
+			position--;
+		}
+		if (position < TRIE_TOP_COUNT) expected[position] = p;
+	}
+
+	assert(completeRepoNames(repo, prefix, completions, TRIE_TOP_COUNT) == length);
+	for (int i = 0; i < length; i++)
+		assert(completions[i] == expected[i]);
+}
+
+/// <summary>
+/// Runs tests for the name completion of the repository
+/// </summary>
+void testNameTrie()
+{
+	Product* completions[TRIE_TOP_COUNT];
+	ProductRepo* repo = createRepo();
+	addProductRepo(repo, createProduct("chicken", meat, 2.5, date(2022, 3, 26)));
+	addProductRepo(repo, createProduct("chocolate", sweets, 2, date(2022, 8, 22)));
+	addProductRepo(repo, createProduct("cheese", dairy, 4, date(2022, 4, 1)));
+	addProductRepo(repo, createProduct("chocolate", dairy, 1, date(2022, 5, 1)));
+
+	assert(completeRepoNames(repo, "ch", completions, 2) == 2);
+	assert(strcmp(completions[0]->name, "cheese") == 0 && strcmp(completions[1]->name, "chicken") == 0);
+	assert(completeRepoNames(repo, "cho", completions, TRIE_TOP_COUNT) == 2 && completions[1]->category == dairy);
+	assert(completeRepoNames(repo, "chocolate", completions, TRIE_TOP_COUNT) == 2);
+	assert(completeRepoNames(repo, "chocolates", completions, TRIE_TOP_COUNT) == 0);
+	assert(completeRepoNames(repo, "x", completions, TRIE_TOP_COUNT) == 0);
+
+	// The index follows merges, updates and removals once it is built
+	addProductRepo(repo, createProduct("chocolate", dairy, 5, date(2022, 5, 1)));
+	assert(completeRepoNames(repo, "ch", completions, 1) == 1 && completions[0]->category == dairy);
+	updateProductRepo(repo, "cheese", dairy, 10, date(2022, 4, 1));
+	assert(completeRepoNames(repo, "c", completions, 1) == 1 && strcmp(completions[0]->name, "cheese") == 0);
+	removeProductRepo(repo, "cheese", dairy);
+	removeProductRepo(repo, "chicken", meat);
+	assert(completeRepoNames(repo, "ch", completions, TRIE_TOP_COUNT) == 2 && repo->names->count == 2);
+	assert(repo->names->root->childLength == 1 && repo->names->root->children[0]->labelLength == 9);
+	destroyRepo(repo);
+
+	// Random changes keep every completion equal to a scan
+	char name[32];
+	char prefix[8];
+	repo = createRepo();
+	srand(41);
+	for (int i = 0; i < 3000; i++)
+	{
+		sprintf(name, "p%d", rand() % 400);
+		Category category = CATEGORY_START + rand() % CATEGORY_END;
+
+		switch (rand() % 4)
+		{
+			case 0:
+			case 1:
+				addProductRepo(repo, createProduct(name, category, rand() % 20, date(2022, 1, 1)));
+				break;
+			case 2:
+				updateProductRepo(repo, name, category, rand() % 20, date(2022, 1, 1));
+				break;
+			default:
+				removeProductRepo(repo, name, category);
+		}
+
+		if (i % 10 == 0)
+		{
+			sprintf(prefix, "p%d", rand() % 40);
+			prefix[1 + rand() % (strlen(prefix))] = '\0';
+			checkCompletions(repo, prefix);
+		}
+	}
+	checkCompletions(repo, "");
+	assert(repo->names->count == getLength(repo));
+	destroyRepo(repo);
+
+	// The script language completes names
+	Service* serv = createService(createRepo(), 1);
+	Writer* out = createWriter(NULL);
+	char command[] = "complete ch 1";
+	assert(executeCommand(serv, out, command, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "chicken") != NULL && strstr(out->buffer, "chocolate") == NULL);
+	destroyWriter(out);
+	destroyService(serv);
+}
+
+/// <summary>
+/// Runs tests for the "did you mean" suggestions of the repository
+/// </summary>
+void testBkTree()
+{
+	assert(editDistance("yoghurt", "yogurt") == 1 && editDistance("kitten", "sitting") == 3);
+	assert(editDistance("", "abc") == 3 && editDistance("milk", "milk") == 0);
+
+	Suggestion suggestions[BK_SUGGESTIONS];
+	Service* serv = createService(createRepo(), 1);
+	ProductRepo* repo = getRepo(serv);
+
+	assert(suggestRepoNames(repo, "yoghurt", BK_MAX_DISTANCE, suggestions, BK_SUGGESTIONS) == 1);
+	assert(strcmp(suggestions[0].name, "yogurt") == 0 && suggestions[0].distance == 1);
+	assert(suggestRepoNames(repo, "chiken", 1, suggestions, BK_SUGGESTIONS) == 1 && strcmp(suggestions[0].name, "chicken") == 0);
+	assert(suggestRepoNames(repo, "xyz", BK_MAX_DISTANCE, suggestions, BK_SUGGESTIONS) == 0);
+
+	// Removed names are not suggested, added ones are
+	assert(deleteProductService(serv, "yogurt", dairy) == 1);
+	assert(suggestRepoNames(getRepo(serv), "yoghurt", BK_MAX_DISTANCE, suggestions, BK_SUGGESTIONS) == 0);
+	assert(addProductService(serv, "yoghurt", dairy, 1, date(2022, 3, 14)) == 1);
+	assert(suggestRepoNames(getRepo(serv), "yogurt", BK_MAX_DISTANCE, suggestions, BK_SUGGESTIONS) == 1);
+
+	Writer* out = createWriter(NULL);
+	char command[] = "suggest pear";
+	assert(executeCommand(serv, out, command, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "pears 1\n") != NULL);
+	destroyWriter(out);
+	destroyService(serv);
+
+	// Random changes keep every search equal to a scan of the distinct names
+	char name[8];
+	Suggestion all[64];
+	repo = createRepo();
+	srand(42);
+	for (int i = 0; i < 4000; i++)
+	{
+		for (int j = 0; j < 5; j++) name[j] = 'a' + rand() % 4;
+		name[3 + rand() % 3] = '\0';
+		Category category = CATEGORY_START + rand() % CATEGORY_END;
+
+		if (rand() % 3 != 0) addProductRepo(repo, createProduct(name, category, 1, date(2022, 1, 1)));
+		else removeProductRepo(repo, name, category);
+
+		if (i % 20 != 0) continue;
+
+		int maxDistance = rand() % 3;
+		int found = suggestRepoNames(repo, name, maxDistance, all, 64);
+		int expected = 0;
+		for (int j = 0; j < getLength(repo); j++)
+		{
+			Product* p = getProductAt(repo, j);
+			int first = 1;
+			for (int k = 0; k < j; k++)
+				if (strcmp(getProductAt(repo, k)->name, p->name) == 0) first = 0;
+			if (first == 1 && editDistance(name, p->name) <= maxDistance) expected++;
+		}
+		assert(found == (expected < 64 ? expected : 64));
+		for (int j = 1; j < found; j++)
+			assert(all[j - 1].distance < all[j].distance || (all[j - 1].distance == all[j].distance && strcmp(all[j - 1].name, all[j].name) < 0));
+	}
+	destroyRepo(repo);
+
+	// A close search compares against a fraction of the names
+	repo = createRepo();
+	char longName[32];
+	for (int i = 0; i < 5000; i++)
+	{
+		sprintf(longName, "product%d", i * 7919 % 100000);
+		addProductRepo(repo, createProduct(longName, dairy, 1, date(2022, 1, 1)));
+	}
+	assert(suggestRepoNames(repo, "prodoct1234", 1, all, 64) >= 0);
+	long long comparisons = repo->similar->comparisons;
+	assert(suggestRepoNames(repo, "prodoct4321", 1, all, 64) >= 0);
+	assert(repo->similar->comparisons - comparisons < repo->similar->live);
+	destroyRepo(repo);
+}
+
+/// <summary>
+/// Runs tests for the searches that ignore case over the folded names
+/// </summary>
+void testFoldedSearch()
+{
+	Product* p = createProduct("Sour_Candy", sweets, 1, date(2022, 1, 1));
+	assert(strcmp(p->name, "Sour_Candy") == 0 && strcmp(p->folded, "sour_candy") == 0);
+	assert(matchName(p, "candy", matchIgnoreCase) == 1 && matchName(p, "candy", matchSubstring) == 0);
+	assert(matchName(p, "sour_candy", matchEqualIgnoreCase) == 1 && matchName(p, "sour", matchEqualIgnoreCase) == 0);
+	destroyProduct(p);
+
+	Service* serv = createService(createRepo(), 1);
+	assert(addProductService(serv, "MILK", dairy, 3, date(2022, 3, 20)) == 1);
+
+	// The query is folded, the names were folded when they were added
+	ProductRepo* result = filterByStringMatch(serv, "Milk", matchEqualIgnoreCase);
+	assert(getLength(result) == 2);
+	destroyRepo(result);
+	result = filterByStringMatch(serv, "ILK", matchSubstring);
+	assert(getLength(result) == 1 && strcmp(getProductAt(result, 0)->name, "MILK") == 0);
+	destroyRepo(result);
+	result = filterByStringMatch(serv, "O", matchIgnoreCase);
+	assert(getLength(result) == 4);
+	destroyRepo(result);
+
+	// An updated product keeps its folded name
+	assert(updateProductService(serv, "MILK", dairy, 5, date(2022, 3, 21)) == 1);
+	assert(strcmp(findProductRepo(getRepo(serv), "MILK", dairy)->folded, "milk") == 0);
+
+	Writer* out = createWriter(NULL);
+	char command[] = "filter-i MIL";
+	assert(executeCommand(serv, out, command, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "milk") != NULL && strstr(out->buffer, "MILK") > strstr(out->buffer, "milk"));
+	destroyWriter(out);
+
+	out = createWriter(NULL);
+	char exact[] = "find-i Chicken";
+	assert(executeCommand(serv, out, exact, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "chicken") != NULL && strstr(out->buffer, "milk") == NULL);
+	destroyWriter(out);
+	destroyService(serv);
+
+	// The parallel filter scans the same folded names
+	ThreadPool* pool = createThreadPool(2);
+	ProductRepo* repo = createRepo();
+	char name[32];
+	for (int i = 0; i < 3000; i++)
+	{
+		sprintf(name, i % 2 == 0 ? "Product%d" : "PRODUCT%d", i);
+		addProductRepo(repo, createProduct(name, dairy, 1, date(2022, 1, 1)));
+	}
+	ProductRepo* expected = filterRepoByStringMatch(repo, "ct1", matchIgnoreCase);
+	setDefaultPool(pool, 100);
+	ProductRepo* actual = filterRepoByStringMatch(repo, "CT1", matchIgnoreCase);
+	setDefaultPool(NULL, POOL_DEFAULT_THRESHOLD);
+	assert(getLength(expected) == 1111 && getLength(actual) == getLength(expected));
+	for (int i = 0; i < getLength(actual); i++)
+		assert(strcmp(getProductAt(expected, i)->name, getProductAt(actual, i)->name) == 0);
+
+	destroyRepo(expected);
+	destroyRepo(actual);
+	destroyRepo(repo);
+	destroyThreadPool(pool);
+}
+
+/// <summary>
+/// Runs tests for the consumption history and the run out forecasts
+/// </summary>
+void testConsumption()
+{
+	Date leap = civilFromDays(daysFromCivil(date(2024, 2, 29)));
+	assert(leap.year == 2024 && leap.month == 2 && leap.day == 29);
+	assert(civilFromDays(0).year == 1970 && civilFromDays(-1).month == 12);
+
+	ConsumptionLog* log = createConsumptionLog();
+	Forecast forecasts[4];
+	Sample samples[HISTORY_RAW_SAMPLES + HISTORY_HOURLY_SAMPLES + HISTORY_DAILY_SAMPLES];
+	int start = daysFromCivil(date(2022, 3, 1)) * 1440;
+
+	// One unit a day leaves five units for five more days
+	for (int day = 0; day <= 5; day++)
+		assert(recordConsumption(log, "milk", dairy, 10 - day, start + day * 1440) == 1);
+
+	// Restocking does not count as consumption: six units in five days, the last two without a change
+	assert(recordConsumption(log, "eggs", dairy, 6, start) == 1);
+	assert(recordConsumption(log, "eggs", dairy, 3, start + 1440) == 1);
+	assert(recordConsumption(log, "eggs", dairy, 12, start + 2 * 1440) == 1);
+	assert(recordConsumption(log, "eggs", dairy, 9, start + 3 * 1440) == 1);
+	assert(recordConsumption(log, "salt", sweets, 1, start) == 1);
+
+	int now = start + 5 * 1440;
+	assert(forecastConsumption(log, now, 7, forecasts, 4) == 2);
+	assert(strcmp(forecasts[0].name, "eggs") == 0 && forecasts[0].daysLeft == 5 && fabs(forecasts[0].rate - 1.2) < 1e-6);
+	assert(strcmp(forecasts[1].name, "milk") == 0 && forecasts[1].daysLeft == 5 && fabs(forecasts[1].rate - 1) < 1e-6);
+	assert(forecasts[1].runOut.year == 2022 && forecasts[1].runOut.month == 3 && forecasts[1].runOut.day == 11);
+	assert(forecastConsumption(log, now, 4, forecasts, 4) == 0 && forecastConsumption(log, now, 7, forecasts, 1) == 1);
+
+	// Frequent changes are kept in full only for the latest samples
+	for (int i = 0; i < 300; i++)
+		assert(recordConsumption(log, "water", fruit, 1000 - i, start + i * 10) == 1);
+	int found = getHistorySamples(log, "water", fruit, samples, 64);
+	assert(found > HISTORY_RAW_SAMPLES && found < 300 && samples[found - 1].quantity == 701);
+	for (int i = 1; i < found; i++)
+		assert(samples[i - 1].minute < samples[i].minute && samples[i - 1].quantity > samples[i].quantity);
+
+	// The last product takes the place of a forgotten one
+	assert(forgetConsumption(log, "milk", dairy) == 1 && forgetConsumption(log, "milk", dairy) == 0);
+	assert(getHistorySamples(log, "milk", dairy, samples, 64) == 0);
+	assert(getHistorySamples(log, "water", fruit, samples, 64) == found && log->length == 3);
+	destroyConsumptionLog(log);
+
+	// The service records every change, undone ones included
+	Service* serv = createService(createRepo(), 1);
+	assert(serv->consumption->length == 10);
+	assert(updateProductService(serv, "eggs", dairy, 4, date(2022, 3, 28)) == 1);
+	assert(getHistorySamples(serv->consumption, "eggs", dairy, samples, 64) == 2 && samples[1].quantity == 4);
+	assert(deleteProductService(serv, "pears", fruit) == 1 && serv->consumption->length == 9);
+
+	Writer* out = createWriter(NULL);
+	char command[] = "history eggs dairy";
+	assert(executeCommand(serv, out, command, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, " 6\n") != NULL && strstr(out->buffer, " 4\n") != NULL);
+	destroyWriter(out);
+	destroyService(serv);
+}
+
+/// <summary>
+/// Checks the quantity index of a repository against a scan of its products
+/// </summary>
+/// <param name="repo">A pointer to the repository</param>
+/// <param name="low">The lowest quantity of the range</param>
+/// <param name="high">The highest quantity of the range</param>
+void checkQuantities(ProductRepo* repo, double low, double high)
+{
+	int inRange = 0;
+	int below = 0;
+	for (int i = 0; i < getLength(repo); i++)
+	{
+		double quantity = getProductAt(repo, i)->quantity;
+		if (quantity >= low && quantity <= high) inRange++;
+		if (quantity < low) below++;
+	}
+
+	assert(countRepoQuantities(repo, low, high) == inRange && rankRepoQuantity(repo, low) == below);
+	assert(repo->quantities == NULL || getQuantityTreeSize(repo->quantities) == getLength(repo));
+
+	Product* products[64];
+	int found = rangeRepoQuantities(repo, low, high, 0, products, 64);
+	assert(found == (inRange < 64 ? inRange : 64));
+	for (int i = 0; i < found; i++)
+	{
+		assert(products[i]->quantity >= low && products[i]->quantity <= high);
+		assert(i == 0 || products[i - 1]->quantity <= products[i]->quantity);
+		assert(selectRepoQuantity(repo, below + i) == products[i]);
+	}
+}
+
+/// <summary>
+/// Runs tests for the range, rank and select queries on quantities
+/// </summary>
+void testQuantityTree()
+{
+	Service* serv = createService(createRepo(), 1);
+	ProductRepo* repo = getRepo(serv);
+	Product* products[16];
+
+	// milk 1, beef 1.33 and chocolate 2 are the low stock, yogurt 3.25 is in the middle
+	assert(countRepoQuantities(repo, 0, 2) == 3 && rankRepoQuantity(repo, 2.5) == 3);
+	assert(rangeRepoQuantities(repo, 0, 2, 1, products, 16) == 2);
+	assert(strcmp(products[0]->name, "beef") == 0 && strcmp(products[1]->name, "chocolate") == 0);
+	assert(strcmp(selectRepoQuantity(repo, getLength(repo) / 2)->name, "yogurt") == 0);
+	assert(selectRepoQuantity(repo, getLength(repo)) == NULL && countRepoQuantities(repo, 3, 2) == 0);
+
+	// Updates, merges and removals move the products in the index
+	assert(updateProductService(serv, "eggs", dairy, 0.5, date(2022, 3, 28)) == 1);
+	assert(addProductService(serv, "milk", dairy, 2, date(2022, 3, 15)) == 1);
+	assert(deleteProductService(serv, "beef", meat) == 1);
+	assert(countRepoQuantities(getRepo(serv), 0, 2) == 2 && strcmp(selectRepoQuantity(getRepo(serv), 0)->name, "eggs") == 0);
+
+	Writer* out = createWriter(NULL);
+	char command[] = "range 0 3";
+	assert(executeCommand(serv, out, command, 0) == 1);
+	writeChars(out, "", 1);
+	assert(strstr(out->buffer, "Count: 5\n") != NULL && strstr(out->buffer, "eggs") < strstr(out->buffer, "chocolate"));
+	destroyWriter(out);
+	destroyService(serv);
+
+	// Random changes, undone and redone ones included, keep the index equal to a scan
+	char name[8];
+	serv = createService(createRepo(), 0);
+	srand(45);
+	for (int i = 0; i < 3000; i++)
+	{
+		sprintf(name, "p%d", rand() % 60);
+		Category category = CATEGORY_START + rand() % CATEGORY_END;
+		double quantity = rand() % 16 / 4.0;
+		int operation = rand() % 10;
+
+		if (operation < 4) addToUndoStack(serv);
+		if (operation < 2) addProductService(serv, name, category, quantity, date(2022, 1, 1));
+		else if (operation < 3 && updateProductService(serv, name, category, quantity, date(2022, 1, 1)) == 0) popUndoStack(serv);
+		else if (operation < 4 && deleteProductService(serv, name, category) == 0) popUndoStack(serv);
+		else if (operation < 6) undoOperation(serv);
+		else if (operation < 7) redoOperation(serv);
+
+		if (i % 10 == 0) checkQuantities(getRepo(serv), rand() % 8 / 4.0, rand() % 16 / 4.0);
+	}
+	destroyService(serv);
+}
+
+/// <summary>
+/// Runs tests for the fixed point quantities
+/// </summary>
+void testFixedQuantity()
+{
+	const char* texts[] = { "0", "3.25", "-2.125", "0.1", "1e3", "2.5E-1", "+7.", ".5", "0.0000004", "0.0000005", "-0.0000005", "1.333333333" };
+	Quantity expected[] = { 0, 3250000, -2125000, 100000, 1000000000, 250000, 7000000, 500000, 0, 1, -1, 1333333 };
+	const char* invalid[] = { "", "-", ".", "abc", "1,5", "1e", "1e+", "2x", "inf", "nan", "0x10", "99999999999999" };
+	char text[32];
+	Quantity units;
+
+	for (int i = 0; i < (int)(sizeof(texts) / sizeof(texts[0])); i++)
+	{
+		assert(parseFixedQuantity(texts[i], &units) == 1 && units == expected[i]);
+
+		// Formatting and parsing again gives the same quantity, and the double agrees with strtod
+		assert(formatQuantity(units, text, sizeof(text)) == 1);
+		Quantity parsed;
+		assert(parseFixedQuantity(text, &parsed) == 1 && parsed == units);
+		assert(fromQuantity(units) == strtod(text, NULL) && toQuantity(fromQuantity(units)) == units);
+	}
+	for (int i = 0; i < (int)(sizeof(invalid) / sizeof(invalid[0])); i++)
+		assert(parseFixedQuantity(invalid[i], &units) == 0);
+
+	assert(formatQuantity(-2125000, text, sizeof(text)) == 1 && strcmp(text, "-2.125") == 0);
+	assert(formatQuantity(-500000, text, sizeof(text)) == 1 && strcmp(text, "-0.5") == 0);
+	assert(formatQuantity(1000000000, text, sizeof(text)) == 1 && strcmp(text, "1000") == 0);
+	assert(formatQuantity(1250000, text, 4) == 0);
+	assert(toQuantity(0.1) == 100000 && toQuantity(-2.125) == -2125000 && toQuantity(1e300) > 0);
+
+	// Restocking in small steps adds up exactly, in the product and in the category totals
+	ProductRepo* repo = createRepo();
+	for (int i = 0; i < 10000; i++)
+		addProductRepo(repo, createProduct("grapes", fruit, 0.1, date(2022, 1, 1)));
+	addProductRepo(repo, createProduct("kiwi", fruit, 0.2, date(2022, 1, 1)));
+
+	Product* grapes = findProductRepo(repo, "grapes", fruit);
+	assert(grapes->units == 1000 * QUANTITY_SCALE && grapes->quantity == 1000);
+	assert(summarizeCategory(repo, fruit).quantity == 1000.2);
+
+	updateProductRepo(repo, "grapes", fruit, 0.1, date(2022, 1, 1));
+	assert(summarizeCategory(repo, none).quantity == 0.3);
+	removeProductRepo(repo, "kiwi", fruit);
+	assert(repo->aggregates[fruit].units == 100000);
+
+	// The radix sort orders like the comparator, negative quantities first and ties stable
+	double quantities[] = { 2.5, -1, 0, 1e9, 2.5, 0.000001, -1e9, 3 };
+	for (int i = 0; i < (int)(sizeof(quantities) / sizeof(quantities[0])); i++)
+	{
+		sprintf(text, "item%d", i);
+		appendProductRepo(repo, createProduct(text, dairy, quantities[i], date(2022, 1, 1)));
+	}
+
+	for (int descending = 0; descending <= 1; descending++)
+	{
+		sortByQuantity(repo, descending);
+		for (int i = 0; i < getLength(repo) - 1; i++)
+		{
+			Product* current = getProductAt(repo, i);
+			Product* next = getProductAt(repo, i + 1);
+			int result = compareByQuantity(current, next);
+			assert(descending == 0 ? result <= 0 : result >= 0);
+			if (current->units == 2500000 && next->units == 2500000) assert(strcmp(current->name, "item0") == 0);
+		}
+	}
+	destroyRepo(repo);
+
+	// The scale follows the configured decimals
+	long long scale = 1;
+	for (int i = 0; i < QUANTITY_DECIMALS; i++)
+		scale *= 10;
+	assert(scale == QUANTITY_SCALE);
+
+	// A merge that would overflow stays at the largest quantity, the category total goes on counting
+	repo = createRepo();
+	addProductRepo(repo, createProductUnits("salt", sweets, LLONG_MAX - 1, date(2022, 1, 1)));
+	addProductRepo(repo, createProductUnits("salt", sweets, 5, date(2022, 1, 1)));
+	assert(findProductRepo(repo, "salt", sweets)->units == LLONG_MAX);
+	assert(addQuantity(-LLONG_MAX, -1) == -LLONG_MAX && addQuantity(LLONG_MAX, -1) == LLONG_MAX - 1);
+	removeProductRepo(repo, "salt", sweets);
+	assert(repo->aggregates[sweets].units == 0);
+	destroyRepo(repo);
+
+	// Quantities a double can not tell apart are ordered and ranked exactly, by every sort
+	repo = createRepo();
+	QuantityTree* tree = createQuantityTree();
+	for (int i = 0; i < 3; i++)
+	{
+		sprintf(text, "item%d", i);
+		Product* p = createProductUnits(text, dairy, (1LL << 53) + (2 - i), date(2022, 1, 1));
+		appendProductRepo(repo, p);
+		insertQuantityTree(tree, p);
+	}
+	assert(compareByQuantity(getProductAt(repo, 1), getProductAt(repo, 2)) > 0);
+	assert(rankQuantityTree(tree, (1LL << 53) + 1, 0) == 1 && rankQuantityTree(tree, (1LL << 53) + 1, 1) == 2);
+
+	sortByQuantity(repo, 0);
+	assert(getProductAt(repo, 0)->units == 1LL << 53 && getProductAt(repo, 2)->units == (1LL << 53) + 2);
+	parallelSort(NULL, repo, compareByQuantity, 1);
+	assert(getProductAt(repo, 0)->units == (1LL << 53) + 2 && getProductAt(repo, 2)->units == 1LL << 53);
+	destroyQuantityTree(tree);
+	destroyRepo(repo);
+
+	// Quantities past the precision of a double come back exactly from a snapshot and a journal
+	char snapshotPath[FILENAME_MAX];
+	char journalPath[FILENAME_MAX];
+	testPath("test.snapshot", snapshotPath);
+	testPath("test.journal", journalPath);
+	Quantity exact = (1LL << 53) + 1;
+	remove(snapshotPath);
+	remove(journalPath);
+
+	Service* serv = createService(createRepo(), 0);
+	attachJournal(serv, openJournal(journalPath, 0));
+	assert(addProductUnitsService(serv, "flour", sweets, exact, date(2022, 1, 1)) == 1);
+	assert(checkpointService(serv, snapshotPath) == 1);
+	assert(updateProductUnitsService(serv, "flour", sweets, exact + 2, date(2022, 1, 1)) == 1);
+	assert(addProductUnitsService(serv, "sugar", sweets, exact, date(2022, 1, 1)) == 1);
+	destroyService(serv);
+
+	repo = loadSnapshot(snapshotPath);
+	assert(repo != NULL && findProductRepo(repo, "flour", sweets)->units == exact);
+	destroyRepo(repo);
+
+	serv = recoverService(snapshotPath, journalPath, 0, 0);
+	assert(serv != NULL);
+	assert(findProductRepo(getRepo(serv), "flour", sweets)->units == exact + 2);
+	assert(findProductRepo(getRepo(serv), "sugar", sweets)->units == exact);
+	destroyService(serv);
+
+	remove(snapshotPath);
+	remove(journalPath);
+}
+
+#define TEST_PUBLICATION_NAME "/fridge.test"
+#define TEST_PUBLICATION_IMAGES 2000
+
+/// <summary>
+/// Maps the test publication a second time and checks every image it reads while the images change
+/// </summary>
+/// <param name="arg">Not used</param>
+/// <returns>0</returns>
+int readPublishedImages(void* arg)
+{
+	(void)arg;
+	Publication* pub = openPublication(TEST_PUBLICATION_NAME);
+	assert(pub != NULL);
+
+	char name[32];
+	PublishedImage image;
+	unsigned long long last = 0;
+	while (last < TEST_PUBLICATION_IMAGES)
+	{
+		if (beginPublishedRead(pub, &image) == 0) continue;
+
+		// Image i holds product0, product1, ... up to i % 8 + 1 products, all with quantity i
+		int consistent = image.length == (int)(image.version % 8 + 1);
+		for (int i = 0; consistent == 1 && i < image.length; i++)
+		{
+			sprintf(name, "product%d", i);
+			consistent = image.records[i].units == (long long)image.version * QUANTITY_SCALE && strcmp(getPublishedName(&image, i), name) == 0;
+		}
+		if (endPublishedRead(&image) == 0) continue;
+
+		assert(consistent == 1 && image.version >= last);
+		last = image.version;
+	}
+
+	closePublication(pub);
+	return 0;
+}
+
+/// <summary>
+/// Runs tests for the repository published to shared memory
+/// </summary>
+void testPublication()
+{
+	char name[32];
+	PublishedImage image;
+
+	Publication* pub = createPublication(TEST_PUBLICATION_NAME, 4096);
+	assert(pub != NULL);
+	Publication* reader = openPublication(TEST_PUBLICATION_NAME);
+	assert(reader != NULL && beginPublishedRead(reader, &image) == 0);
+	assert(openPublication("/fridge.missing") == NULL);
+
+	thrd_t thread;
+	assert(thrd_create(&thread, readPublishedImages, NULL) == thrd_success);
+	for (int version = 1; version <= TEST_PUBLICATION_IMAGES; version++)
+	{
+		ProductRepo* repo = createRepo();
+		for (int i = 0; i <= version % 8; i++)
+		{
+			sprintf(name, "product%d", i);
+			appendProductRepo(repo, createProduct(name, dairy, version, date(2022, 3, 15)));
+		}
+		assert(publishRepo(pub, repo, version) == 1);
+		destroyRepo(repo);
+	}
+	assert(thrd_join(thread, NULL) == thrd_success);
+
+	// An image that does not fit is refused and readers keep the previous one
+	ProductRepo* large = createRepo();
+	for (int i = 0; i < 200; i++)
+	{
+		sprintf(name, "product%d", i);
+		appendProductRepo(large, createProduct(name, dairy, i, date(2022, 3, 15)));
+	}
+	assert(publishRepo(pub, large, TEST_PUBLICATION_IMAGES + 1) == 0);
+	assert(publishRepo(reader, large, TEST_PUBLICATION_IMAGES + 1) == 0);
+	assert(beginPublishedRead(reader, &image) == 1 && image.version == TEST_PUBLICATION_IMAGES && endPublishedRead(&image) == 1);
+	assert(image.staleSince == TEST_PUBLICATION_IMAGES + 1);
+	assert(publishRepo(pub, large, TEST_PUBLICATION_IMAGES + 2) == 0);
+	assert(beginPublishedRead(reader, &image) == 1 && image.staleSince == TEST_PUBLICATION_IMAGES + 1);
+
+	// Images sized for the repository fit it
+	Publication* sized = createPublication("/fridge.sized", getPublicationCapacity(large));
+	assert(sized != NULL && publishRepo(sized, large, 1) == 1);
+	closePublication(sized);
+	destroyRepo(large);
+
+	// The service publishes after every change, undo and redo included, and the image is current again
+	Service* serv = createService(createRepo(), 1);
+	attachPublication(serv, pub);
+	assert(beginPublishedRead(reader, &image) == 1 && image.length == 10 && image.version == serv->version);
+	assert(image.staleSince == 0);
+
+	addToUndoStack(serv);
+	assert(deleteProductService(serv, "milk", dairy) == 1);
+	assert(beginPublishedRead(reader, &image) == 1 && image.length == 9 && image.version == serv->version);
+	for (int i = 0; i < image.length; i++)
+		assert(strcmp(getPublishedName(&image, i), "milk") != 0);
+	assert(endPublishedRead(&image) == 1);
+
+	assert(undoOperation(serv) == 1);
+	assert(beginPublishedRead(reader, &image) == 1 && image.length == 10 && endPublishedRead(&image) == 1);
+
+	closePublication(reader);
+	destroyService(serv);
+	assert(openPublication(TEST_PUBLICATION_NAME) == NULL);
+}
+
+/// <summary>
+/// Runs tests for shipping the changes of a primary to a standby
+/// </summary>
+void testReplication()
+{
+	int fds[2];
+	assert(createReplicationPipe(fds) == 1);
+
+	// Everything fits in the pipe, so the standby can follow once the primary is gone
+	Service* primary = createService(createRepo(), 1);
+	attachShipper(primary, createShipper(fds[1], 4));
+	Shipper* shipper = primary->shipper;
+	assert(shipper != NULL && shipper->batches == 1 && shipper->sequence == 1);
+
+	addToUndoStack(primary);
+	assert(addProductService(primary, "kiwi", fruit, 3, date(2022, 5, 1)) == 1);
+	addToUndoStack(primary);
+	assert(updateProductService(primary, "milk", dairy, 0.25, date(2022, 3, 20)) == 1);
+	addToUndoStack(primary);
+	assert(deleteProductService(primary, "beef", meat) == 1);
+	assert(undoOperation(primary) == 1);
+	assert(redoOperation(primary) == 1);
+	assert(undoOperation(primary) == 1);
+
+	Product* batch[] = { createProduct("grapes", fruit, 1, date(2022, 6, 1)), createProduct("kiwi", fruit, 2, date(2022, 5, 1)) };
+	assert(addProductsService(primary, batch, 2) == 2);
+
+	// Operations are sent four at a time, the rest once the server loop or the owner flushes
+	assert(shipper->operations == 8 && shipper->batches == 2 && shipper->pending == 3);
+	assert(flushShipper(shipper) == 1 && shipper->batches == 3 && shipper->pending == 0);
+	assert(addProductService(primary, "lemons", fruit, 1, date(2022, 7, 1)) == 1);
+
+	// An operation that is not committed when the primary goes away is never applied
+	Product* torn = createProduct("torn", dairy, 1, date(2022, 1, 1));
+	assert(shipRecord(shipper, journalPut, journalAdd, torn) == 1);
+	destroyProduct(torn);
+	attachShipper(primary, NULL);
+
+	Service* standby = createService(createRepo(), 0);
+	FILE* input = openReplicationStream(fds[0]);
+	assert(input != NULL);
+	uint64_t sequence = 0;
+	atomic_ullong applied = 0;
+	assert(followJournal(standby, input, &sequence, &applied) == 9);
+	fclose(input);
+
+	assert(sequence == 9 && atomic_load(&applied) == 9);
+	assert(sameProducts(getRepo(primary), getRepo(standby)) == 1);
+	assert(findProductRepo(getRepo(standby), "beef", meat) != NULL && findProductRepo(getRepo(standby), "torn", dairy) == NULL);
+	assert(findProductRepo(getRepo(standby), "kiwi", fruit)->quantity == 5);
+
+	// A standby that is gone stops the shipping without affecting the primary
+	assert(createReplicationPipe(fds) == 1);
+	input = openReplicationStream(fds[0]);
+	fclose(input);
+#ifdef SIGPIPE
+	void (*previous)(int) = signal(SIGPIPE, SIG_IGN);
+#endif
+	attachShipper(primary, createShipper(fds[1], 1));
+	assert(primary->shipper->failed == 1);
+	assert(addProductService(primary, "melon", fruit, 1, date(2022, 7, 1)) == 1);
+#ifdef SIGPIPE
+	signal(SIGPIPE, previous);
+#endif
+
+	destroyService(standby);
+	destroyService(primary);
+}
+
+#define TEST_SESSION_THREADS 4
+#define TEST_SESSION_INCREMENTS 200
+
+/// <summary>
+/// Increments a counter product in its own session, retrying every transaction that conflicts
+/// </summary>
+/// <param name="arg">A pointer to the shared service</param>
+/// <returns>0</returns>
+int incrementInSession(void* arg)
+{
+	Session* session = openSession(arg);
+	assert(session != NULL);
+
+	Quantity units;
+	Date expiration;
+	for (int i = 0; i < TEST_SESSION_INCREMENTS; i++)
+	{
+		do
+		{
+			assert(readSessionProduct(session, "counter", meat, &units, &expiration) == 1);
+			assert(sessionUpdateProduct(session, "counter", meat, fromQuantity(units) + 1, expiration) == 1);
+		} while (commitSession(session) == 0);
+	}
+
+	closeSession(session);
+	return 0;
+}
+
+/// <summary>
+/// Tests the isolation, the conflicts and the undo histories of sessions
+/// </summary>
+void testSessions()
+{
+	SharedService* shared = createSharedService(createService(createRepo(), 0));
+	Session* first = openSession(shared);
+	Session* second = openSession(shared);
+	assert(first != NULL && second != NULL);
+
+	Quantity units;
+	Date expiration;
+
+	// Operations are only seen by their session until it commits
+	assert(sessionAddProduct(first, "milk", dairy, 2, date(2022, 3, 15)) == 1);
+	assert(sessionAddProduct(first, "eggs", dairy, 6, date(2022, 3, 28)) == 1);
+	assert(sessionAddProduct(first, "milk", dairy, 0.5, date(2022, 3, 30)) == 1);
+	assert(readSessionProduct(first, "milk", dairy, &units, &expiration) == 1);
+	assert(units == toQuantity(2.5) && expiration.day == 15);
+	assert(readSessionProduct(second, "milk", dairy, &units, &expiration) == 0);
+	assert(commitSession(first) == 1);
+	assert(getLength(atomic_load(&shared->current)) == 2);
+
+	// The other session keeps reading the version it started with
+	assert(readSessionProduct(second, "milk", dairy, &units, &expiration) == 0);
+	abortSession(second);
+	assert(readSessionProduct(second, "milk", dairy, &units, &expiration) == 1);
+	assert(sessionDeleteProduct(second, "missing", dairy) == 0);
+
+	// Both change milk, the first to commit wins and the whole second transaction is discarded
+	assert(sessionUpdateProduct(first, "milk", dairy, 5, date(2022, 3, 20)) == 1);
+	assert(sessionUpdateProduct(second, "milk", dairy, 7, date(2022, 3, 20)) == 1);
+	assert(sessionAddProduct(second, "kiwi", fruit, 3, date(2022, 5, 1)) == 1);
+	assert(commitSession(first) == 1);
+	assert(commitSession(second) == 0 && second->conflicts == 1 && second->undoLength == 0);
+	assert(findProductRepo(atomic_load(&shared->current), "kiwi", fruit) == NULL);
+
+	// Changes of different products do not conflict
+	assert(sessionAddProduct(second, "kiwi", fruit, 3, date(2022, 5, 1)) == 1);
+	assert(sessionAddProduct(first, "eggs", dairy, 4, date(2022, 4, 1)) == 1);
+	assert(commitSession(first) == 1 && commitSession(second) == 1);
+
+	// Undo takes back the operations of its own session, and keeps what the other one added
+	assert(sessionAddProduct(second, "eggs", dairy, 2, date(2022, 4, 1)) == 1);
+	assert(commitSession(second) == 1);
+	assert(undoSession(first) == 1);
+	assert(findProductRepo(atomic_load(&shared->current), "eggs", dairy)->units == toQuantity(8));
+	assert(redoSession(first) == 1 && undoSession(first) == 1);
+	assert(undoSession(first) == 1);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->units == toQuantity(2.5));
+
+	// An update can not be undone once someone else changed the product
+	assert(redoSession(first) == 1);
+	assert(sessionUpdateProduct(second, "milk", dairy, 9, date(2022, 3, 20)) == 1);
+	assert(commitSession(second) == 1);
+	assert(undoSession(first) == 0 && first->undoLength == 2);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->units == toQuantity(9));
+
+	// Undoing the second session's deletes puts the products back
+	assert(sessionDeleteProduct(second, "kiwi", fruit) == 1);
+	assert(sessionDeleteProduct(second, "milk", dairy) == 1);
+	assert(commitSession(second) == 1 && getLength(atomic_load(&shared->current)) == 1);
+	assert(undoSession(second) == 1 && getLength(atomic_load(&shared->current)) == 3);
+	assert(findProductRepo(atomic_load(&shared->current), "kiwi", fruit)->units == toQuantity(3));
+
+	// Redo is only allowed between transactions, and a new commit drops it
+	assert(sessionAddProduct(second, "kiwi", fruit, 1, date(2022, 5, 1)) == 1);
+	assert(redoSession(second) == 0);
+	assert(commitSession(second) == 1 && redoSession(second) == 0);
+
+	// A session only pins a version while it reads, so an idle one does not keep replaced versions alive
+	assert(readSessionProduct(first, "kiwi", fruit, &units, &expiration) == 1 && units == toQuantity(4));
+	assert(sessionAddProduct(first, "kiwi", fruit, 1, date(2022, 5, 1)) == 1);
+	assert(sessionAddProduct(second, "eggs", dairy, 1, date(2022, 4, 1)) == 1);
+	assert(commitSession(second) == 1 && shared->retiredLength == 0);
+	assert(commitSession(first) == 1 && shared->retiredLength == 0);
+	assert(findProductRepo(atomic_load(&shared->current), "kiwi", fruit)->units == toQuantity(5));
+
+	closeSession(first);
+	closeSession(second);
+
+	// Concurrent increments of one product are never lost, conflicting ones are retried
+	Service* serv = beginWrite(shared);
+	addProductService(serv, "counter", meat, 0, date(2022, 6, 1));
+	endWrite(shared, 1);
+
+	thrd_t threads[TEST_SESSION_THREADS];
+	for (int i = 0; i < TEST_SESSION_THREADS; i++)
+		assert(thrd_create(&threads[i], incrementInSession, shared) == thrd_success);
+	for (int i = 0; i < TEST_SESSION_THREADS; i++)
+		assert(thrd_join(threads[i], NULL) == thrd_success);
+
+	Product* counter = findProductRepo(atomic_load(&shared->current), "counter", meat);
+	assert(counter->units == toQuantity(TEST_SESSION_THREADS * TEST_SESSION_INCREMENTS));
+
+	destroySharedService(shared);
+}
+
+#define TEST_SWEEPER_PRODUCTS 50
+
+/// <summary>
+/// Tests moving cold products to the archive, querying them and bringing them back with undo
+/// </summary>
+void testArchive()
+{
+	Service* serv = createService(createRepo(), 0);
+	Date today = date(2022, 3, 20);
+	addProductService(serv, "milk", dairy, 1, date(2022, 3, 15));
+	addProductService(serv, "eggs", dairy, 6, date(2022, 3, 28));
+	addProductService(serv, "kiwi", fruit, 0, date(2030, 1, 1));
+	addProductService(serv, "apples", fruit, 4, date(2030, 1, 1));
+
+	// Without an archive nothing is swept
+	assert(sweepService(serv, today, 10) == 0);
+	attachArchive(serv, createArchive());
+	assert(serv->archive != NULL);
+
+	// Cold products are found from the aggregates of the categories
+	assert(getRepo(serv)->aggregates[fruit].empty == 1 && getRepo(serv)->aggregates[dairy].empty == 0);
+	assert(hasColdProducts(getRepo(serv), daysFromCivil(today)) == 1);
+	assert(hasColdProducts(getRepo(serv), daysFromCivil(date(2022, 3, 1))) == 1);
+
+	// Batches are limited, the empty kiwi goes first and the expired milk next
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 1) == 1);
+	assert(findProductRepo(getRepo(serv), "kiwi", fruit) == NULL);
+	assert(getRepo(serv)->aggregates[fruit].empty == 0);
+	assert(hasColdProducts(getRepo(serv), daysFromCivil(date(2022, 3, 1))) == 0);
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 10) == 1);
+	assert(sweepService(serv, today, 10) == 0);
+	assert(hasColdProducts(getRepo(serv), daysFromCivil(today)) == 0);
+	assert(getLength(getRepo(serv)) == 2 && getArchiveLength(serv->archive) == 2);
+
+	// The undo state of a sweep does not copy the products
+	assert(serv->undoLength == 2 && serv->undoStack[1].repo == NULL);
+
+	// Archived products can still be found
+	ProductRepo* archived = filterArchiveByString(serv->archive, "i");
+	assert(getLength(archived) == 2);
+	assert(findProductRepo(archived, "milk", dairy)->quantity == 1);
+	assert(findProductRepo(archived, "kiwi", fruit)->expiration.year == 2030);
+	destroyRepo(archived);
+
+	// Undo brings the products back and takes them out of the archive, redo moves them again
+	assert(undoOperation(serv) == 1 && getArchiveLength(serv->archive) == 1);
+	assert(findProductRepo(getRepo(serv), "milk", dairy) != NULL);
+	assert(undoOperation(serv) == 1 && getArchiveLength(serv->archive) == 0);
+	assert(getLength(getRepo(serv)) == 4);
+	assert(redoOperation(serv) == 1 && getArchiveLength(serv->archive) == 1);
+	archived = filterArchiveByString(serv->archive, "");
+	assert(getLength(archived) == 1 && findProductRepo(archived, "kiwi", fruit) != NULL);
+	destroyRepo(archived);
+
+	// A sweep keeps the redo states, redo skips the products it moved meanwhile
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 10) == 1 && serv->redoLength == 1);
+	assert(redoOperation(serv) == 1 && getArchiveLength(serv->archive) == 2);
+	assert(undoOperation(serv) == 1 && undoOperation(serv) == 1 && getArchiveLength(serv->archive) == 1);
+	assert(findProductRepo(getRepo(serv), "milk", dairy) != NULL);
+
+	// A new sweep after an undo replaces the entries that were cut off
+	addToUndoStack(serv);
+	assert(updateProductService(serv, "apples", fruit, 0, date(2030, 1, 1)) == 1);
+	assert(sweepService(serv, today, 10) == 2 && getArchiveLength(serv->archive) == 3);
+	assert(redoOperation(serv) == 0);
+
+	// The archive is queried and swept through scripts too
+	FILE* file = tmpfile();
+	assert(file != NULL);
+	Writer* out = createWriter(file);
+	char list[] = "archived apple";
+	char sweep[] = "sweep";
+	char undo[] = "undo";
+	assert(executeCommand(serv, out, list, 1) == 1);
+	assert(executeCommand(serv, out, undo, 1) == 1 && getArchiveLength(serv->archive) == 1);
+	assert(executeCommand(serv, out, sweep, 1) == 1);
+	assert(getLength(getRepo(serv)) == 1 && getArchiveLength(serv->archive) == 3);
+	destroyWriter(out);
+	fclose(file);
+	destroyService(serv);
+
+	// Sweeps are journaled with the entries they archived, so a restart rebuilds the
+	// archive from the snapshot and the journal, with or without the undo history
+	char snapshotPath[FILENAME_MAX];
+	char journalPath[FILENAME_MAX];
+	testPath("archive.snapshot", snapshotPath);
+	testPath("archive.journal", journalPath);
+	remove(snapshotPath);
+	remove(journalPath);
+
+	serv = createService(createRepo(), 0);
+	attachArchive(serv, createArchive());
+	attachJournal(serv, openJournal(journalPath, 0));
+	addProductService(serv, "milk", dairy, 1, date(2022, 3, 15));
+	addProductService(serv, "kiwi", fruit, 0, date(2030, 1, 1));
+	addProductService(serv, "eggs", dairy, 6, date(2022, 3, 28));
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 1) == 1);
+	assert(checkpointService(serv, snapshotPath) == 1);
+
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 10) == 1);
+	assert(undoOperation(serv) == 1 && redoOperation(serv) == 1 && undoOperation(serv) == 1);
+	addToUndoStack(serv);
+	assert(updateProductService(serv, "eggs", dairy, 0, date(2022, 3, 28)) == 1);
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 10) == 2 && getArchiveLength(serv->archive) == 3);
+	assert(undoOperation(serv) == 1 && getArchiveLength(serv->archive) == 1);
+
+	ProductRepo* expected = filterByString(serv, "");
+	destroyService(serv);
+
+	for (int keepHistory = 0; keepHistory <= 1; keepHistory++)
+	{
+		serv = recoverService(snapshotPath, journalPath, 0, keepHistory);
+		assert(serv != NULL && serv->archive != NULL && getArchiveLength(serv->archive) == 1);
+		assert(sameProducts(getRepo(serv), expected) == 1);
+
+		archived = filterArchiveByString(serv->archive, "");
+		assert(getLength(archived) == 1 && findProductRepo(archived, "kiwi", fruit) != NULL);
+		destroyRepo(archived);
+
+		// The entries cut off by the undo are still there for redo, which is not journaled here
+		attachJournal(serv, NULL);
+		if (keepHistory == 1) assert(redoOperation(serv) == 1 && getArchiveLength(serv->archive) == 3);
+		destroyService(serv);
+	}
+	destroyRepo(expected);
+
+	// A checkpoint saves the archive with the products
+	serv = recoverService(snapshotPath, journalPath, 0, 0);
+	assert(serv != NULL && checkpointService(serv, snapshotPath) == 1);
+	destroyService(serv);
+	serv = recoverService(snapshotPath, journalPath, 0, 0);
+	assert(serv != NULL && serv->archive != NULL && getArchiveLength(serv->archive) == 1);
+
+	// A standby gets the archive with the first shipment and follows the sweeps after it
+	int fds[2];
+	assert(createReplicationPipe(fds) == 1);
+	attachShipper(serv, createShipper(fds[1], 1));
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 10) == 2);
+	attachShipper(serv, NULL);
+
+	Service* standby = createService(createRepo(), 0);
+	FILE* input = openReplicationStream(fds[0]);
+	assert(input != NULL);
+	uint64_t sequence = 0;
+	assert(followJournal(standby, input, &sequence, NULL) == 2);
+	fclose(input);
+
+	assert(standby->archive != NULL && getArchiveLength(standby->archive) == 3);
+	assert(sameProducts(getRepo(serv), getRepo(standby)) == 1);
+	destroyService(standby);
+	destroyService(serv);
+
+	// Undo and redo of other changes across a sweep journal the archive length they move it to
+	remove(snapshotPath);
+	remove(journalPath);
+	serv = createService(createRepo(), 0);
+	attachArchive(serv, createArchive());
+	attachJournal(serv, openJournal(journalPath, 0));
+	addProductService(serv, "apples", fruit, 4, date(2030, 1, 1));
+	addProductService(serv, "milk", dairy, 1, date(2022, 3, 15));
+	assert(checkpointService(serv, snapshotPath) == 1);
+
+	addToUndoStack(serv);
+	assert(updateProductService(serv, "apples", fruit, 2, date(2030, 1, 1)) == 1);
+	assert(undoOperation(serv) == 1);
+	addSweepToUndoStack(serv);
+	assert(sweepService(serv, today, 10) == 1 && getArchiveLength(serv->archive) == 1);
+	assert(redoOperation(serv) == 1 && getArchiveLength(serv->archive) == 0);
+	assert(findProductRepo(getRepo(serv), "milk", dairy) != NULL);
+
+	expected = filterByString(serv, "");
+	destroyService(serv);
+	for (int keepHistory = 0; keepHistory <= 1; keepHistory++)
+	{
+		serv = recoverService(snapshotPath, journalPath, 0, keepHistory);
+		assert(serv != NULL && serv->archive != NULL && getArchiveLength(serv->archive) == 0);
+		assert(sameProducts(getRepo(serv), expected) == 1);
+		destroyService(serv);
+	}
+	destroyRepo(expected);
+	remove(snapshotPath);
+	remove(journalPath);
+
+	// The background sweeper empties the shared service of cold products while it is changed
+	serv = createService(createRepo(), 0);
+	char name[32];
+	for (int i = 0; i < TEST_SWEEPER_PRODUCTS; i++)
+	{
+		sprintf(name, "product%d", i);
+		addProductService(serv, name, dairy, i % 5, i % 2 == 0 ? date(2022, 3, 15) : date(2999, 1, 1));
+	}
+	SharedService* shared = createSharedService(serv);
+	Sweeper* sweeper = createSweeper(shared, 4, 1);
+	assert(sweeper != NULL && serv->archive != NULL);
+
+	// A round gives up instead of waiting for a writer
+	SweeperStats stats;
+	beginWrite(shared);
+	assert(sweepRound(sweeper, currentDate()) == 0);
+	endWrite(shared, 0);
+	getSweeperStats(sweeper, &stats);
+	assert(stats.deferred == 1 && stats.rounds == 0);
+
+	// Every product with an even number expired, every fifth one is empty
+	int cold = 0;
+	for (int i = 0; i < TEST_SWEEPER_PRODUCTS; i++)
+		cold += i % 2 == 0 || i % 5 == 0;
+
+	assert(startSweeper(sweeper) == 1);
+	for (int i = 0; i < TEST_SWEEPER_PRODUCTS; i++)
+		assert(sharedAddProduct(shared, "milk", dairy, 1, date(2999, 1, 1)) == 1);
+
+	struct timespec pause = { 0, 1000000 };
+	for (int i = 0; i < 5000 && getLength(atomic_load(&shared->current)) > TEST_SWEEPER_PRODUCTS + 1 - cold; i++)
+		thrd_sleep(&pause, NULL);
+	stopSweeper(sweeper);
+
+	getSweeperStats(sweeper, &stats);
+	assert(getLength(atomic_load(&shared->current)) == TEST_SWEEPER_PRODUCTS + 1 - cold);
+	assert(stats.swept == cold && stats.rounds >= cold / 4);
+
+	// A sweep of the shared service is undone like any other change
+	assert(sharedUpdateProduct(shared, "milk", dairy, 0, date(2999, 1, 1)) == 1);
+	assert(sweepRound(sweeper, currentDate()) == 1 && getArchiveLength(serv->archive) == cold + 1);
+	assert(sharedUndo(shared) == 1 && getArchiveLength(serv->archive) == cold);
+	assert(findProductRepo(atomic_load(&shared->current), "milk", dairy)->units == 0);
+
+	destroySweeper(sweeper);
+	destroySharedService(shared);
+}
+
+/// <summary>
+/// Runts all tests, the files they write go to a temporary directory
+/// </summary>
+/// <returns>1 if the tests ran,
+///			 0 if the temporary directory could not be created</returns>
+int runAllTests()
+{
+	if (createTestDirectory() == 0) return 0;
+
+	testDomain();
+	testRepo();
+	testService();
+	testSnapshot();
+	testRecovery();
+	testImportExport();
+	testWriter();
+	testScript();
+	testServer();
+	testSharedService();
+	testEventQueue();
+	testParallel();
+	testFleet();
+	testExpiryWheel();
+	testViews();
+	testAggregates();
+	testQueryCache();
+	testPages();
+	testNameTrie();
+	testBkTree();
+	testFoldedSearch();
+	testConsumption();
+	testQuantityTree();
+	testFixedQuantity();
+	testPublication();
+	testReplication();
+	testSessions();
+	testArchive();
+
+	// Every test removes its own files
+#ifdef _WIN32
+	_rmdir(testDirectory);
+#else
+	rmdir(testDirectory);
+#endif
+	return 1;
 }
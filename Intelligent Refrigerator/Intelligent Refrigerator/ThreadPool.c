@@ -0,0 +1,326 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "ThreadPool.h"
+
+static thread_local ThreadPool* currentPool = NULL;
+static thread_local int currentWorker = -1;
+
+static ThreadPool* defaultPool = NULL;
+static int defaultThreshold = POOL_DEFAULT_THRESHOLD;
+
+/// <summary>
+/// Adds a task to the back of a deque
+/// </summary>
+/// <param name="deque">A pointer to the deque</param>
+/// <param name="task">The task</param>
+static void pushBack(TaskDeque* deque, Task task)
+{
+	mtx_lock(&deque->lock);
+
+	if (deque->length == deque->capacity)
+	{
+		int capacity = deque->capacity * 2;
+		Task* tmp = NULL;
+
+		// The ring is unrolled into the new array
+		while (tmp == NULL) tmp = malloc(capacity * sizeof(Task));
+		for (int i = 0; i < deque->length; i++)
+			tmp[i] = deque->tasks[(deque->first + i) % deque->capacity];
+
+		free(deque->tasks);
+		deque->tasks = tmp;
+		deque->capacity = capacity;
+		deque->first = 0;
+	}
+
+	deque->tasks[(deque->first + deque->length) % deque->capacity] = task;
+	deque->length++;
+
+	mtx_unlock(&deque->lock);
+}
+
+/// <summary>
+/// Takes a task from a deque
+/// </summary>
+/// <param name="deque">A pointer to the deque</param>
+/// <param name="back">1 to take the newest task, 0 to take the oldest</param>
+/// <param name="task">Where to store the task</param>
+/// <returns>1 if a task was taken,
+///			 0 if the deque is empty</returns>
+static int takeFrom(TaskDeque* deque, int back, Task* task)
+{
+	mtx_lock(&deque->lock);
+
+	int taken = deque->length > 0;
+	if (taken == 1)
+	{
+		if (back == 1)
+		{
+			*task = deque->tasks[(deque->first + deque->length - 1) % deque->capacity];
+		}
+		else
+		{
+			*task = deque->tasks[deque->first];
+			deque->first = (deque->first + 1) % deque->capacity;
+		}
+		deque->length--;
+	}
+
+	mtx_unlock(&deque->lock);
+	return taken;
+}
+
+/// <summary>
+/// Finds a task for a thread: its own newest task first, then the oldest task of any other deque
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+/// <param name="index">The deque of the thread</param>
+/// <param name="task">Where to store the task</param>
+/// <returns>1 if a task was found,
+///			 0, otherwise</returns>
+static int takeTask(ThreadPool* pool, int index, Task* task)
+{
+	if (atomic_load(&pool->queued) == 0) return 0;
+
+	int found = takeFrom(&pool->deques[index], 1, task);
+	for (int i = 1; i <= pool->threadCount && found == 0; i++)
+		found = takeFrom(&pool->deques[(index + i) % (pool->threadCount + 1)], 0, task);
+
+	if (found == 1) atomic_fetch_sub(&pool->queued, 1);
+	return found;
+}
+
+/// <summary>
+/// Runs a task and marks it as done
+/// </summary>
+/// <param name="task">The task</param>
+static void runTask(Task task)
+{
+	task.function(task.arg);
+	atomic_fetch_sub(task.pending, 1);
+}
+
+/// <summary>
+/// Runs tasks until the pool is destroyed
+/// </summary>
+/// <param name="arg">A pointer to the pool</param>
+/// <returns>0</returns>
+static int runWorker(void* arg)
+{
+	ThreadPool* pool = arg;
+	Task task;
+
+	currentPool = pool;
+	currentWorker = atomic_fetch_add(&pool->started, 1);
+
+	while (1)
+	{
+		if (takeTask(pool, currentWorker, &task) == 1)
+		{
+			runTask(task);
+			continue;
+		}
+
+		mtx_lock(&pool->idleLock);
+		while (atomic_load(&pool->queued) == 0 && atomic_load(&pool->stopping) == 0)
+			cnd_wait(&pool->idle, &pool->idleLock);
+		mtx_unlock(&pool->idleLock);
+
+		if (atomic_load(&pool->stopping) == 1 && atomic_load(&pool->queued) == 0) return 0;
+	}
+}
+
+/// <summary>
+/// Creates a pool of worker threads
+/// </summary>
+/// <param name="threads">The number of workers</param>
+/// <returns>A pointer to the pool,
+///			 NULL if the threads could not be started</returns>
+ThreadPool* createThreadPool(int threads)
+{
+	if (threads < 1) threads = 1;
+	if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+	ThreadPool* pool = malloc(sizeof(ThreadPool));
+	if (pool == NULL) return NULL;
+
+	pool->threads = malloc(threads * sizeof(thrd_t));
+	pool->deques = calloc(threads + 1, sizeof(TaskDeque));
+	if (pool->threads == NULL || pool->deques == NULL)
+	{
+		free(pool->threads);
+		free(pool->deques);
+		free(pool);
+		return NULL;
+	}
+
+	for (int i = 0; i <= threads; i++)
+	{
+		mtx_init(&pool->deques[i].lock, mtx_plain);
+		pool->deques[i].capacity = POOL_INITIAL_TASKS;
+		while (pool->deques[i].tasks == NULL) pool->deques[i].tasks = malloc(POOL_INITIAL_TASKS * sizeof(Task));
+	}
+
+	atomic_init(&pool->started, 0);
+	atomic_init(&pool->queued, 0);
+	atomic_init(&pool->stopping, 0);
+	mtx_init(&pool->idleLock, mtx_plain);
+	cnd_init(&pool->idle);
+
+	pool->threadCount = 0;
+	while (pool->threadCount < threads && thrd_create(&pool->threads[pool->threadCount], runWorker, pool) == thrd_success)
+		pool->threadCount++;
+
+	if (pool->threadCount < threads)
+	{
+		for (int i = pool->threadCount + 1; i <= threads; i++)
+		{
+			free(pool->deques[i].tasks);
+			mtx_destroy(&pool->deques[i].lock);
+		}
+		destroyThreadPool(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+/// <summary>
+/// Waits for the queued tasks, then stops the workers and destroys the pool
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+void destroyThreadPool(ThreadPool* pool)
+{
+	if (pool == NULL) return;
+	if (defaultPool == pool) defaultPool = NULL;
+
+	mtx_lock(&pool->idleLock);
+	atomic_store(&pool->stopping, 1);
+	cnd_broadcast(&pool->idle);
+	mtx_unlock(&pool->idleLock);
+
+	for (int i = 0; i < pool->threadCount; i++)
+		thrd_join(pool->threads[i], NULL);
+
+	for (int i = 0; i < pool->threadCount + 1; i++)
+	{
+		free(pool->deques[i].tasks);
+		mtx_destroy(&pool->deques[i].lock);
+	}
+
+	cnd_destroy(&pool->idle);
+	mtx_destroy(&pool->idleLock);
+	free(pool->deques);
+	free(pool->threads);
+	free(pool);
+
+	pool = NULL;
+}
+
+/// <summary>
+/// Gets the number of processors that are online
+/// </summary>
+/// <returns>The number of processors, at least 1</returns>
+int getProcessorCount()
+{
+#ifdef _WIN32
+	const char* count = getenv("NUMBER_OF_PROCESSORS");
+	int processors = count != NULL ? atoi(count) : 1;
+#else
+	int processors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return processors > 0 ? processors : 1;
+}
+
+/// <summary>
+/// Queues a task, workers of the pool queue it on their own deque
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+/// <param name="function">The function to run</param>
+/// <param name="arg">The argument of the function</param>
+/// <param name="pending">The counter of unfinished tasks, it must already include this task</param>
+void submitTask(ThreadPool* pool, TaskFunction function, void* arg, atomic_int* pending)
+{
+	Task task = { function, arg, pending };
+	int index = currentPool == pool ? currentWorker : pool->threadCount;
+
+	pushBack(&pool->deques[index], task);
+	atomic_fetch_add(&pool->queued, 1);
+
+	mtx_lock(&pool->idleLock);
+	cnd_signal(&pool->idle);
+	mtx_unlock(&pool->idleLock);
+}
+
+/// <summary>
+/// Waits until a counter of unfinished tasks reaches 0, running queued tasks meanwhile
+/// </summary>
+/// <param name="pool">A pointer to the pool</param>
+/// <param name="pending">The counter of unfinished tasks</param>
+void waitTasks(ThreadPool* pool, atomic_int* pending)
+{
+	int index = currentPool == pool ? currentWorker : pool->threadCount;
+	Task task;
+
+	while (atomic_load(pending) > 0)
+	{
+		if (takeTask(pool, index, &task) == 1) runTask(task);
+		else thrd_yield();
+	}
+}
+
+/// <summary>
+/// Runs a function on every element of an array of arguments and waits for all of them
+/// </summary>
+/// <param name="pool">A pointer to the pool, NULL to run on the calling thread</param>
+/// <param name="function">The function to run</param>
+/// <param name="args">The array of arguments</param>
+/// <param name="argSize">The size of an argument</param>
+/// <param name="count">The number of arguments</param>
+void parallelFor(ThreadPool* pool, TaskFunction function, void* args, size_t argSize, int count)
+{
+	if (pool == NULL)
+	{
+		for (int i = 0; i < count; i++)
+			function((char*)args + i * argSize);
+		return;
+	}
+
+	atomic_int pending;
+	atomic_init(&pending, count);
+
+	for (int i = 0; i < count; i++)
+		submitTask(pool, function, (char*)args + i * argSize, &pending);
+	waitTasks(pool, &pending);
+}
+
+/// <summary>
+/// Sets the pool the repository operations switch to for large inputs
+/// </summary>
+/// <param name="pool">A pointer to the pool, NULL to always run on the calling thread</param>
+/// <param name="threshold">The number of rows from which the pool is used</param>
+void setDefaultPool(ThreadPool* pool, int threshold)
+{
+	defaultPool = pool;
+	defaultThreshold = threshold;
+}
+
+/// <summary>
+/// Gets the pool to use for an operation on a number of rows
+/// </summary>
+/// <param name="rows">The number of rows of the operation</param>
+/// <returns>A pointer to the default pool,
+///			 NULL if the operation should run on the calling thread</returns>
+ThreadPool* getParallelPool(int rows)
+{
+	return rows >= defaultThreshold ? defaultPool : NULL;
+}
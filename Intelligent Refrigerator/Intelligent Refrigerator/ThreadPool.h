@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#define POOL_MAX_THREADS 64
+#define POOL_DEFAULT_THRESHOLD 10000
+#define POOL_INITIAL_TASKS 64
+
+typedef void (*TaskFunction)(void* arg);
+
+typedef struct
+{
+	TaskFunction function;
+	void* arg;
+	atomic_int* pending; // Decremented once the task has run
+} Task;
+
+// Owners take their newest task from the back, idle threads steal the
+// oldest one from the front of another deque
+typedef struct
+{
+	mtx_t lock;
+	Task* tasks;
+	int capacity;
+	int first;
+	int length;
+} TaskDeque;
+
+typedef struct
+{
+	int threadCount;
+	thrd_t* threads;
+	TaskDeque* deques; // One per worker, the last one for threads outside the pool
+	atomic_int started; // Hands out the worker indexes
+	atomic_int queued;
+	atomic_int stopping;
+	mtx_t idleLock;
+	cnd_t idle;
+} ThreadPool;
+
+ThreadPool* createThreadPool(int threads);
+void destroyThreadPool(ThreadPool* pool);
+int getProcessorCount();
+
+void submitTask(ThreadPool* pool, TaskFunction function, void* arg, atomic_int* pending);
+void waitTasks(ThreadPool* pool, atomic_int* pending);
+void parallelFor(ThreadPool* pool, TaskFunction function, void* args, size_t argSize, int count);
+
+void setDefaultPool(ThreadPool* pool, int threshold);
+ThreadPool* getParallelPool(int rows);
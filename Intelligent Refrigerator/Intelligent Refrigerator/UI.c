@@ -4,17 +4,49 @@
 #include <time.h>
 
 #include "UI.h"
+#include "ImportExport.h"
+#include "Page.h"
+
+/// <summary>
+/// Prints an alert for a product that expires soon, called by the timer wheel
+/// </summary>
+/// <param name="context">Unused</param>
+/// <param name="entry">A pointer to the entry of the product</param>
+/// <param name="daysLeft">The days until the product expires</param>
+static void printExpiryAlert(void* context, ExpiryEntry* entry, int daysLeft)
+{
+	(void)context;
+
+	if (daysLeft < 0)
+		printf("ALERT: %s (%s) has expired on %04d-%02d-%02d.\n", entry->name, category_name[entry->category],
+			entry->expiration.year, entry->expiration.month, entry->expiration.day);
+	else
+		printf("ALERT: %s (%s) expires in %d days, on %04d-%02d-%02d.\n", entry->name, category_name[entry->category], daysLeft,
+			entry->expiration.year, entry->expiration.month, entry->expiration.day);
+}
 
 /// <summary>
 /// Creates the user interface
 /// </summary>
 /// <param name="serv">The service</param>
+/// <param name="alertDays">Alerts are shown for products that expire within this many days, negative to disable them</param>
 /// <returns>A pointer to the user interface</returns>
-UI* createUI(Service* serv)
+UI* createUI(Service* serv, int alertDays)
 {
 	UI* ui = malloc(sizeof(UI));
 	if (ui == NULL) return NULL;
+
+	ui->out = createWriter(stdout);
+	if (ui->out == NULL)
+	{
+		free(ui);
+		return NULL;
+	}
 	
+	// The wheel alerts once per product instead of scanning the fridge before every menu
+	if (alertDays >= 0)
+		attachExpiryWheel(serv, createExpiryWheel(alertDays, currentDate(), printExpiryAlert, NULL));
+
 	ui->serv = serv;
 	return ui;
 }
@@ -28,6 +60,7 @@ void destroyUI(UI* ui)
 	if (ui == NULL) return;
 
 	destroyService(ui->serv);
+	destroyWriter(ui->out);
 	free(ui);
 
 	ui = NULL;
@@ -79,6 +112,29 @@ double readDouble(const char* message)
 	return conversionResult;
 }
 
+/// <summary>
+/// Reads a valid quantity from the user, parsed exactly to fixed point
+/// </summary>
+/// <param name="message">The message to display as a prompt</param>
+/// <returns>A valid quantity, in units of 1 / QUANTITY_SCALE</returns>
+Quantity readQuantity(const char* message)
+{
+	char input[32] = { 0 };
+	Quantity units = 0;
+
+	int flag = 0;
+	while (flag == 0)
+	{
+		printf(message);
+		scanf("%31s", input);
+
+		flag = parseFixedQuantity(input, &units);
+		if (flag == 0) printf("ERROR: Invalid input!\n");
+	}
+
+	return units;
+}
+
 /// <summary>
 /// Reads a valid date from the user
 /// </summary>
@@ -140,7 +196,7 @@ int addProductUI(UI* ui)
 {
 	char name[64];
 	Category category;
-	double quantity;
+	Quantity units;
 	Date expiration;
 
 	printf("Name: ");
@@ -157,10 +213,28 @@ int addProductUI(UI* ui)
 		category = readInteger("Category: ");
 	}
 	
-	quantity = readDouble("Quantity: ");
+	units = readQuantity("Quantity: ");
 	expiration = readDate("Expiration date:");
 
-	return addProductService(ui->serv, name, category, quantity, expiration);
+	return addProductUnitsService(ui->serv, name, category, units, expiration);
+}
+
+/// <summary>
+/// Prints the names that are close to a name that was not found
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+/// <param name="name">The name that was not found</param>
+static void printSuggestions(UI* ui, char* name)
+{
+	Suggestion suggestions[BK_SUGGESTIONS];
+
+	int count = suggestRepoNames(getRepo(ui->serv), name, BK_MAX_DISTANCE, suggestions, BK_SUGGESTIONS);
+	if (count <= 0) return;
+
+	printf("INFO: Did you mean");
+	for (int i = 0; i < count; i++)
+		printf("%s %s", i == 0 ? "" : (i == count - 1 ? " or" : ","), suggestions[i].name);
+	printf("?\n");
 }
 
 /// <summary>
@@ -188,7 +262,10 @@ int deleteProductUI(UI* ui)
 		category = readInteger("Category: ");
 	}
 
-	return deleteProductService(ui->serv, name, category);
+	int ret = deleteProductService(ui->serv, name, category);
+	if (ret == 0) printSuggestions(ui, name);
+
+	return ret;
 }
 
 /// <summary>
@@ -201,7 +278,7 @@ int updateProductUI(UI* ui)
 {
 	char name[64];
 	Category category;
-	double quantity;
+	Quantity units;
 	Date expiration;
 
 	printf("Name: ");
@@ -218,10 +295,13 @@ int updateProductUI(UI* ui)
 		category = readInteger("Category: ");
 	}
 
-	quantity = readDouble("Quantity: ");
+	units = readQuantity("Quantity: ");
 	expiration = readDate("Expiration date:");
 
-	return updateProductService(ui->serv, name, category, quantity, expiration);
+	int ret = updateProductUnitsService(ui->serv, name, category, units, expiration);
+	if (ret == 0) printSuggestions(ui, name);
+
+	return ret;
 }
 
 /// <summary>
@@ -238,13 +318,46 @@ void listProducts(UI* ui)
 	else
 	{
 		for (int i = 0; i < getLength(repo); i++)
+			writeProduct(ui->out, getProductAt(repo, i));
+		flushWriter(ui->out);
+	}
+}
+
+/// <summary>
+/// Prints the products that contain a given string in their name one page at a time,
+/// only the rows of a page are selected and sorted
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+/// <param name="name">A string to be found in the product names</param>
+/// <param name="match">How the product names are compared to the string</param>
+/// <param name="order">The order of the rows</param>
+/// <param name="message">The message to print if there are no products</param>
+static void printPages(UI* ui, char* name, StringMatch match, PageOrder order, const char* message)
+{
+	PageCursor cursor = { 0 };
+	Page page;
+
+	do
+	{
+		if (pageByString(getRepo(ui->serv), name, match, order, PAGE_DEFAULT_SIZE, &cursor, &page) == 0)
 		{
-			Product* product = getProductAt(repo, i);
-			char productString[256];
-			toString(product, productString);
-			printf("%s\n", productString);
+			printf("ERROR: Could not list the products due to memory issues.\n");
+			clearCursor(&cursor);
+			return;
 		}
-	}
+
+		if (cursor.valid == 0 && getLength(page.rows) == 0)
+			printf("%s\n", message);
+
+		for (int i = 0; i < getLength(page.rows); i++)
+			writeProduct(ui->out, getProductAt(page.rows, i));
+		flushWriter(ui->out);
+
+		takeNextCursor(&page, &cursor);
+		destroyPage(&page);
+	} while (cursor.valid == 1 && readInteger("Show the next page? (1 = yes, 0 = no): ") == 1);
+
+	clearCursor(&cursor);
 }
 
 /// <summary>
@@ -252,7 +365,8 @@ void listProducts(UI* ui)
 /// and sorts them in ascending order by quantity
 /// </summary>
 /// <param name="ui">A pointer to the user interface</param>
-void listProductsQuantity(UI* ui)
+/// <param name="match">matchSubstring to compare the names exactly, matchIgnoreCase to ignore case</param>
+void listProductsQuantity(UI* ui, StringMatch match)
 {
 	char input[64];
 	int c;
@@ -263,25 +377,7 @@ void listProductsQuantity(UI* ui)
 	fgets(input, sizeof(input), stdin);
 	input[strcspn(input, "\n")] = 0;
 
-	ProductRepo* repo = filterByString(ui->serv, input);
-	if (getLength(repo) == 0)
-	{
-		printf("INFO: There are no product names that contain the given string.\n");
-	}
-	else
-	{
-		sortByQuantity(repo, 0);
-
-		for (int i = 0; i < getLength(repo); i++)
-		{
-			Product* product = getProductAt(repo, i);
-			char productString[256];
-			toString(product, productString);
-			printf("%s\n", productString);
-		}
-	}
-
-	destroyRepo(repo);
+	printPages(ui, input, match, orderByQuantity, "INFO: There are no product names that contain the given string.");
 }
 
 /// <summary>
@@ -290,25 +386,7 @@ void listProductsQuantity(UI* ui)
 /// <param name="ui">A pointer to the user interface</param>
 void listProductsName(UI* ui)
 {
-	ProductRepo* repo = getRepo(ui->serv);
-	if (getLength(repo) == 0)
-	{
-		printf("INFO: The repository is empty.\n");
-	}
-	else
-	{
-		sortByName(repo, 0);
-
-		for (int i = 0; i < getLength(repo); i++)
-		{
-			Product* product = getProductAt(repo, i);
-			char productString[256];
-			toString(product, productString);
-			printf("%s\n", productString);
-		}
-	}
-
-	destroyRepo(repo);
+	printPages(ui, "", matchSubstring, orderByName, "INFO: The repository is empty.");
 }
 
 /// <summary>
@@ -334,7 +412,13 @@ void listProductsExpiring(UI* ui)
 
 	expiration = readInteger("Expires within days: ");
 
-	ProductRepo* repo = filterByCategoryAndExpiration(ui->serv, category, expiration);
+	ProductRepo* repo = cachedFilterByCategoryAndExpiration(ui->serv, category, expiration);
+	if (repo == NULL)
+	{
+		printf("ERROR: Could not list the products due to memory issues.\n");
+		return;
+	}
+
 	if (getLength(repo) == 0)
 	{
 		printf("INFO: There are no products from the given category that expire in %d days in the fridge.\n", expiration);
@@ -342,15 +426,165 @@ void listProductsExpiring(UI* ui)
 	else
 	{
 		for (int i = 0; i < getLength(repo); i++)
-		{
-			Product* product = getProductAt(repo, i);
-			char productString[256];
-			toString(product, productString);
-			printf("%s\n", productString);
-		}
+			writeProduct(ui->out, getProductAt(repo, i));
+		flushWriter(ui->out);
+	}
+
+	releaseResult(ui->serv, repo);
+}
+
+/// <summary>
+/// Displays the number of products, the total quantity and the expiration range of every category
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+void listCategorySummaries(UI* ui)
+{
+	// The repository keeps the totals up to date, so no product is visited
+	for (Category category = CATEGORY_START; category <= CATEGORY_END; category++)
+	{
+		CategorySummary summary = summarizeCategory(getRepo(ui->serv), category);
+		writeSummary(ui->out, category, &summary);
+	}
+
+	CategorySummary total = summarizeCategory(getRepo(ui->serv), none);
+	writeSummary(ui->out, none, &total);
+	flushWriter(ui->out);
+}
+
+/// <summary>
+/// Completes the beginning of a product name with the products that have the highest quantities
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+void listCompletions(UI* ui)
+{
+	char prefix[64];
+	Product* completions[TRIE_TOP_COUNT];
+
+	printf("Beginning of the name: ");
+	scanf("%63s", prefix);
+
+	int count = completeRepoNames(getRepo(ui->serv), prefix, completions, TRIE_TOP_COUNT);
+	if (count < 0)
+	{
+		printf("ERROR: Could not complete the name due to memory issues.\n");
+	}
+	else if (count == 0)
+	{
+		printf("INFO: There are no product names that start with the given text.\n");
+	}
+	else
+	{
+		for (int i = 0; i < count; i++)
+			writeProduct(ui->out, completions[i]);
+		flushWriter(ui->out);
+	}
+}
+
+/// <summary>
+/// Prints when the products run out at the rate they were consumed recently, the earliest first
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+void listForecasts(UI* ui)
+{
+	ConsumptionLog* log = ui->serv->consumption;
+	int days = readInteger("Days ahead: ");
+
+	Forecast* forecasts = malloc((log->length + 1) * sizeof(Forecast));
+	if (forecasts == NULL)
+	{
+		printf("ERROR: Could not forecast due to memory issues.\n");
+		return;
+	}
+
+	int found = forecastConsumption(log, currentMinute(), days, forecasts, log->length);
+	if (found == 0) printf("INFO: No product is expected to run out in the given number of days.\n");
+
+	for (int i = 0; i < found; i++)
+	{
+		if (forecasts[i].daysLeft < 0)
+			printf("INFO: %s (%s) has probably run out already.\n", forecasts[i].name, category_name[forecasts[i].category]);
+		else
+			printf("INFO: %s (%s) runs out in %d days, on %04d-%02d-%02d, at %g per day.\n", forecasts[i].name,
+				category_name[forecasts[i].category], forecasts[i].daysLeft, forecasts[i].runOut.year,
+				forecasts[i].runOut.month, forecasts[i].runOut.day, forecasts[i].rate);
+	}
+	free(forecasts);
+}
+
+/// <summary>
+/// Prints the products whose quantity is within a range, the lowest quantity first,
+/// and the median quantity of the fridge
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+void listQuantityRange(UI* ui)
+{
+	ProductRepo* repo = getRepo(ui->serv);
+	double low = readDouble("Lowest quantity: ");
+	double high = readDouble("Highest quantity: ");
+
+	int total = countRepoQuantities(repo, low, high);
+	Product** products = malloc((total > 0 ? total : 1) * sizeof(Product*));
+	if (total < 0 || products == NULL)
+	{
+		printf("ERROR: Could not list the products due to memory issues.\n");
+		free(products);
+		return;
 	}
 
-	destroyRepo(repo);
+	if (total == 0) printf("INFO: There are no products with a quantity in the given range.\n");
+
+	int found = rangeRepoQuantities(repo, low, high, 0, products, total);
+	for (int i = 0; i < found; i++)
+		writeProduct(ui->out, products[i]);
+	flushWriter(ui->out);
+	free(products);
+
+	Product* median = selectRepoQuantity(repo, getLength(repo) / 2);
+	if (median != NULL) printf("INFO: %d of %d products are in the range, the median quantity is %g.\n", total, getLength(repo), median->quantity);
+}
+
+/// <summary>
+/// Imports products from a CSV or JSON lines file
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+/// <returns>The number of imported products,
+///			 -1 if the file could not be read</returns>
+int importProductsUI(UI* ui)
+{
+	char path[256];
+	TransferStats stats;
+
+	printf("File (.csv or .jsonl): ");
+	scanf("%255s", path);
+
+	if (importProducts(ui->serv, path, formatFromPath(path), &stats) == 0)
+		return -1;
+
+	printf("INFO: Read %.2f MB in %.3f seconds (%.2f MB/s), %d lines were rejected.\n",
+		stats.bytes / (1024.0 * 1024.0), stats.seconds, getThroughput(&stats), stats.rejected);
+	return stats.products;
+}
+
+/// <summary>
+/// Exports all products to a CSV or JSON lines file
+/// </summary>
+/// <param name="ui">A pointer to the user interface</param>
+/// <returns>1 if the products were exported successfully,
+///			 0, otherwise</returns>
+int exportProductsUI(UI* ui)
+{
+	char path[256];
+	TransferStats stats;
+
+	printf("File (.csv or .jsonl): ");
+	scanf("%255s", path);
+
+	if (exportProducts(getRepo(ui->serv), path, formatFromPath(path), &stats) == 0)
+		return 0;
+
+	printf("INFO: Wrote %d products, %.2f MB at %.2f MB/s.\n",
+		stats.products, stats.bytes / (1024.0 * 1024.0), getThroughput(&stats));
+	return 1;
 }
 
 /// <summary>
@@ -370,7 +604,14 @@ void startUI(UI* ui)
 		"6. List products sorted in ascending order by name",
 		"7. Display all products in given category (none = all) that have expired or expire in the given number of days",
 		"8. Undo the previous operation",
-		"9. Redo the previously undone operation"
+		"9. Redo the previously undone operation",
+		"10. Import products from a CSV or JSON lines file",
+		"11. Export all products to a CSV or JSON lines file",
+		"12. Display the number of products, the total quantity and the expiration range of every category",
+		"13. Complete a product name with the products that have the highest quantities",
+		"14. Forecast which products run out in the given number of days at their recent consumption",
+		"15. Display the products whose quantity is in the given range and the median quantity",
+		"16. Display products containing text in any case (empty = all) sorted in ascending order by quantity"
 	};
 	int menu_length = sizeof(menu_options) / sizeof(menu_options[0]);
 	int menu_selection = -1;
@@ -378,6 +619,9 @@ void startUI(UI* ui)
 	printf("Welcome to the Admin Panel of the Intelligent Refrigerator by Home SmartApps.\n");
 	while (menu_selection != 0)
 	{
+		if (ui->serv->wheel != NULL && advanceExpiryWheel(ui->serv->wheel, currentDate()) > 0)
+			printf("\n");
+
 		print_menu(menu_options, &menu_length);
 		menu_selection = readInteger("Option: ");
 
@@ -390,7 +634,7 @@ void startUI(UI* ui)
 				listProducts(ui);
 				break;
 			case 2:
-				listProductsQuantity(ui);
+				listProductsQuantity(ui, matchSubstring);
 				break;
 			case 3:
 				addToUndoStack(ui->serv);
@@ -443,6 +687,44 @@ void startUI(UI* ui)
 				else
 					printf("ERROR: Failed to redo previous operation.\n");
 				break;
+			case 10:
+			{
+				addToUndoStack(ui->serv);
+
+				int imported = importProductsUI(ui);
+				if (imported > 0)
+					printf("INFO: %d products imported successfully.\n", imported);
+				else
+				{
+					popUndoStack(ui->serv);
+					if (imported == 0)
+						printf("ERROR: The file does not contain any valid products!\n");
+					else
+						printf("ERROR: The file could not be read!\n");
+				}
+				break;
+			}
+			case 11:
+				if (exportProductsUI(ui) == 1)
+					printf("INFO: Products exported successfully.\n");
+				else
+					printf("ERROR: The file could not be written!\n");
+				break;
+			case 12:
+				listCategorySummaries(ui);
+				break;
+			case 13:
+				listCompletions(ui);
+				break;
+			case 14:
+				listForecasts(ui);
+				break;
+			case 15:
+				listQuantityRange(ui);
+				break;
+			case 16:
+				listProductsQuantity(ui, matchIgnoreCase);
+				break;
 			default:
 				printf("ERROR: Invalid menu option!\n");
 		}
@@ -1,12 +1,14 @@
 #pragma once
 #include "Service.h"
+#include "Writer.h"
 
 typedef struct
 {
 	Service* serv;
+	Writer* out;
 } UI;
 
-UI* createUI(Service* serv);
+UI* createUI(Service* serv, int alertDays);
 void destroyUI(UI* ui);
 
 void startUI(UI* ui);
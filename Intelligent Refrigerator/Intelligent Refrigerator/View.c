@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <threads.h>
+
+#include "View.h"
+
+/// <summary>
+/// Checks if a product belongs to the result of a view
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+/// <param name="p">A pointer to the product</param>
+/// <returns>1 if the product belongs to the result,
+///			 0, otherwise</returns>
+static int matchView(MaterializedView* view, Product* p)
+{
+	if (view->category != none && p->category != view->category) return 0;
+
+	if (view->kind == viewExpiring)
+		return daysFromCivil(p->expiration) - view->today <= view->days;
+	return p->units < view->units;
+}
+
+/// <summary>
+/// Adds a product to the result of a view, called by the wheel when the product enters the window
+/// </summary>
+/// <param name="context">A pointer to the view</param>
+/// <param name="entry">A pointer to the entry of the product</param>
+/// <param name="daysLeft">The days until the product expires</param>
+static void enterView(void* context, ExpiryEntry* entry, int daysLeft)
+{
+	MaterializedView* view = context;
+	(void)daysLeft;
+
+	Product* current = findProductRepo(*view->source, entry->name, entry->category);
+	if (current == NULL) return;
+
+	Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
+	if (p != NULL && appendProductRepo(view->rows, p) == 0) destroyProduct(p);
+	view->changed = 1;
+}
+
+/// <summary>
+/// Creates a view and computes its first result
+/// </summary>
+/// <param name="kind">The kind of the view</param>
+/// <param name="source">A pointer to the repository field of the service</param>
+/// <param name="category">The category of the products, none for every category</param>
+/// <param name="days">The window of expiring views</param>
+/// <param name="quantity">The threshold of low stock views</param>
+/// <param name="today">The current date</param>
+/// <returns>A pointer to the view</returns>
+static MaterializedView* createView(ViewKind kind, ProductRepo** source, Category category, int days, double quantity, Date today)
+{
+	MaterializedView* view = malloc(sizeof(MaterializedView));
+	if (view == NULL) return NULL;
+
+	view->kind = kind;
+	view->category = category;
+	view->days = days;
+	view->units = toQuantity(quantity);
+	view->source = source;
+	view->today = daysFromCivil(today);
+	view->changed = 1;
+	view->rows = createRepo();
+	view->wheel = kind == viewExpiring ? createExpiryWheel(days, today, enterView, view) : NULL;
+
+	atomic_init(&view->published, NULL);
+	atomic_init(&view->active, 0);
+	atomic_init(&view->readers[0], 0);
+	atomic_init(&view->readers[1], 0);
+
+	if (view->rows == NULL || (kind == viewExpiring && view->wheel == NULL))
+	{
+		destroyView(view);
+		return NULL;
+	}
+
+	for (int i = 0; i < getLength(*source); i++)
+	{
+		Product* current = getProductAt(*source, i);
+		refreshView(view, current->name, current->category, current);
+	}
+
+	if (publishView(view) == 0)
+	{
+		destroyView(view);
+		return NULL;
+	}
+
+	return view;
+}
+
+/// <summary>
+/// Creates a view of the products that have expired or expire within the given days
+/// </summary>
+/// <param name="source">A pointer to the repository field of the service</param>
+/// <param name="category">The category of the products, none for every category</param>
+/// <param name="days">The amount of days until products expire</param>
+/// <param name="today">The current date</param>
+/// <returns>A pointer to the view</returns>
+MaterializedView* createExpiringView(ProductRepo** source, Category category, int days, Date today)
+{
+	return createView(viewExpiring, source, category, days, 0, today);
+}
+
+/// <summary>
+/// Creates a view of the products with a quantity below the given threshold
+/// </summary>
+/// <param name="source">A pointer to the repository field of the service</param>
+/// <param name="category">The category of the products, none for every category</param>
+/// <param name="quantity">The threshold</param>
+/// <returns>A pointer to the view</returns>
+MaterializedView* createLowStockView(ProductRepo** source, Category category, double quantity)
+{
+	return createView(viewLowStock, source, category, 0, quantity, currentDate());
+}
+
+/// <summary>
+/// Destroys a view, no reader may still be using it
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+void destroyView(MaterializedView* view)
+{
+	if (view == NULL) return;
+
+	destroyRepo(view->rows);
+	destroyRepo(atomic_load(&view->published));
+	destroyExpiryWheel(view->wheel);
+	free(view);
+
+	view = NULL;
+}
+
+/// <summary>
+/// Brings the result of a view up to date with one changed product
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+/// <param name="name">The name of the product</param>
+/// <param name="category">The category of the product</param>
+/// <param name="current">A pointer to the product as it is now, NULL if it was removed</param>
+void refreshView(MaterializedView* view, char* name, Category category, Product* current)
+{
+	if (view->category != none && category != view->category) return;
+
+	int matches = current != NULL && matchView(view, current);
+	Product* row = findProductRepo(view->rows, name, category);
+
+	if (row != NULL && matches == 1)
+	{
+		updateProductUnitsRepo(view->rows, name, category, current->units, current->expiration);
+		view->changed = 1;
+	}
+	else if (row != NULL)
+	{
+		removeProductRepo(view->rows, name, category);
+		view->changed = 1;
+	}
+	else if (matches == 1)
+	{
+		Product* p = createProductUnits(current->name, current->category, current->units, current->expiration);
+		if (p != NULL && appendProductRepo(view->rows, p) == 0) destroyProduct(p);
+		view->changed = 1;
+	}
+
+	// Products outside the window wait in the wheel until they enter it
+	if (view->wheel == NULL) return;
+	if (current != NULL && matches == 0)
+		scheduleExpiry(view->wheel, name, category, current->expiration);
+	else
+		cancelExpiry(view->wheel, name, category);
+}
+
+/// <summary>
+/// Moves the window of an expiring view to a new day
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+/// <param name="today">The current date</param>
+void advanceView(MaterializedView* view, Date today)
+{
+	if (view->wheel == NULL || daysFromCivil(today) <= view->today) return;
+
+	view->today = daysFromCivil(today);
+	advanceExpiryWheel(view->wheel, today);
+}
+
+/// <summary>
+/// Publishes the result of a view to the readers if it changed, then frees the
+/// replaced version once the readers that might be using it have left
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+/// <returns>1 if the result is published,
+///			 0 if there is not enough memory</returns>
+int publishView(MaterializedView* view)
+{
+	if (view->changed == 0) return 1;
+
+	ProductRepo* next = copyRepo(view->rows);
+	if (next == NULL) return 0;
+
+	ProductRepo* previous = atomic_exchange(&view->published, next);
+	int counter = atomic_load(&view->active);
+	atomic_store(&view->active, 1 - counter);
+
+	// Readers that arrive now use the other counter, so this one only drains
+	while (atomic_load(&view->readers[counter]) > 0) thrd_yield();
+
+	destroyRepo(previous);
+	view->changed = 0;
+
+	return 1;
+}
+
+/// <summary>
+/// Starts reading the result of a view, never waits for the writer
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+/// <param name="ticket">Where to store the ticket that endViewRead needs</param>
+/// <returns>A pointer to the result, it must not be changed and is valid until endViewRead</returns>
+ProductRepo* beginViewRead(MaterializedView* view, int* ticket)
+{
+	while (1)
+	{
+		int counter = atomic_load(&view->active);
+		atomic_fetch_add(&view->readers[counter], 1);
+
+		// The writer switched counters meanwhile and might not wait for this one
+		if (atomic_load(&view->active) == counter)
+		{
+			*ticket = counter;
+			return atomic_load(&view->published);
+		}
+
+		atomic_fetch_sub(&view->readers[counter], 1);
+	}
+}
+
+/// <summary>
+/// Stops reading the result of a view
+/// </summary>
+/// <param name="view">A pointer to the view</param>
+/// <param name="ticket">The ticket returned by beginViewRead</param>
+void endViewRead(MaterializedView* view, int ticket)
+{
+	atomic_fetch_sub(&view->readers[ticket], 1);
+}
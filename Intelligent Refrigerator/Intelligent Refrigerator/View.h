@@ -0,0 +1,42 @@
+#pragma once
+#include <stdatomic.h>
+
+#include "ExpiryWheel.h"
+
+#define VIEW_INITIAL_COUNT 4
+
+typedef enum { viewExpiring = 1, viewLowStock } ViewKind;
+
+// A standing query whose result is kept up to date with every change of the
+// service instead of being recomputed on every request. The writer changes
+// its own copy of the result and publishes a new read only version when the
+// result changed. Readers never wait: they announce themselves on one of two
+// counters, and a replaced version is freed once its counter drains.
+typedef struct
+{
+	ViewKind kind;
+	Category category; // none for every category
+	int days; // Expiring views: the products that have expired or expire within this many days
+	Quantity units; // Low stock views: the products with a lower quantity, exactly
+
+	ProductRepo** source; // The repository field of the service, so undo and redo are followed
+	ProductRepo* rows; // Only used by the writer
+	ExpiryWheel* wheel; // Expiring views: brings products into the window as the days pass
+	int today;
+	int changed;
+
+	_Atomic(ProductRepo*) published;
+	atomic_int active; // The counter new readers announce themselves on
+	atomic_int readers[2];
+} MaterializedView;
+
+MaterializedView* createExpiringView(ProductRepo** source, Category category, int days, Date today);
+MaterializedView* createLowStockView(ProductRepo** source, Category category, double quantity);
+void destroyView(MaterializedView* view);
+
+void refreshView(MaterializedView* view, char* name, Category category, Product* current);
+void advanceView(MaterializedView* view, Date today);
+int publishView(MaterializedView* view);
+
+ProductRepo* beginViewRead(MaterializedView* view, int* ticket);
+void endViewRead(MaterializedView* view, int ticket);
@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "Writer.h"
+
+/// <summary>
+/// Creates a writer that buffers output for a file
+/// </summary>
+/// <param name="file">The output file, NULL to keep all output in memory</param>
+/// <returns>A pointer to the writer</returns>
+Writer* createWriter(FILE* file)
+{
+	Writer* out = malloc(sizeof(Writer));
+	if (out == NULL) return NULL;
+
+	out->buffer = malloc(WRITER_BUFFER_SIZE);
+	if (out->buffer == NULL)
+	{
+		free(out);
+		return NULL;
+	}
+
+	out->file = file;
+	out->length = 0;
+	out->capacity = WRITER_BUFFER_SIZE;
+	return out;
+}
+
+/// <summary>
+/// Flushes and destroys the writer, the file stays open
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+void destroyWriter(Writer* out)
+{
+	if (out == NULL) return;
+
+	flushWriter(out);
+	free(out->buffer);
+	free(out);
+
+	out = NULL;
+}
+
+/// <summary>
+/// Writes the buffered output to the file
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <returns>1 if everything was written,
+///			 0, otherwise</returns>
+int flushWriter(Writer* out)
+{
+	if (out->file == NULL) return 1;
+
+	size_t written = fwrite(out->buffer, 1, out->length, out->file);
+	int result = written == out->length && fflush(out->file) == 0;
+
+	out->length = 0;
+	return result;
+}
+
+/// <summary>
+/// Removes output from the start of the buffer once it was sent elsewhere
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="count">The number of characters to remove</param>
+void discardWriter(Writer* out, size_t count)
+{
+	if (count >= out->length)
+	{
+		out->length = 0;
+		return;
+	}
+
+	memmove(out->buffer, out->buffer + count, out->length - count);
+	out->length -= count;
+}
+
+/// <summary>
+/// Writes a number of characters, of any length
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="text">The characters to write</param>
+/// <param name="length">The number of characters</param>
+void writeChars(Writer* out, const char* text, size_t length)
+{
+	while (length > 0)
+	{
+		if (out->length == out->capacity)
+		{
+			if (out->file != NULL) flushWriter(out);
+			else
+			{
+				char* tmp = NULL;
+				while (tmp == NULL)
+					tmp = realloc(out->buffer, out->capacity * 2);
+
+				out->buffer = tmp;
+				out->capacity *= 2;
+			}
+		}
+
+		size_t chunk = out->capacity - out->length;
+		if (chunk > length) chunk = length;
+
+		memcpy(out->buffer + out->length, text, chunk);
+		out->length += chunk;
+		text += chunk;
+		length -= chunk;
+	}
+}
+
+/// <summary>
+/// Writes a null terminated string
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="text">The string to write</param>
+void writeText(Writer* out, const char* text)
+{
+	writeChars(out, text, strlen(text));
+}
+
+/// <summary>
+/// Writes an integer in base 10
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="value">The integer to write</param>
+void writeInteger(Writer* out, long long value)
+{
+	char digits[24];
+	int position = sizeof(digits);
+	unsigned long long magnitude = value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value;
+
+	do
+	{
+		digits[--position] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	if (value < 0) digits[--position] = '-';
+	writeChars(out, digits + position, sizeof(digits) - position);
+}
+
+/// <summary>
+/// Writes a quantity the way printf does with %g. printf rounds the exact binary value,
+/// so a quantity whose scaled value is too close to a half to tell is left to it.
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="quantity">The quantity to write</param>
+void writeQuantity(Writer* out, double quantity)
+{
+	static const double limits[] = { 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6 };
+	static const double scales[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+	double magnitude = fabs(quantity);
+
+	if (quantity == 0)
+	{
+		writeChars(out, "0", 1);
+		return;
+	}
+
+	// Six significant digits in fixed notation cover exponents from -4 to 5
+	int exponent = -5;
+	long long digits = 0;
+	int halfway = 0;
+	if (magnitude >= limits[0] && magnitude < limits[10])
+	{
+		exponent = -4;
+		while (exponent < 5 && limits[exponent + 5] <= magnitude) exponent++;
+
+		// The product is off by at most half an ulp, which only matters next to a half
+		double scaled = magnitude * scales[5 - exponent];
+		halfway = fabs(scaled - floor(scaled) - 0.5) <= scaled * DBL_EPSILON;
+
+		digits = llround(scaled);
+		if (digits == 1000000)
+		{
+			digits = 100000;
+			exponent++;
+		}
+	}
+
+	// Scientific notation is rare for quantities and is left to printf, like halves
+	if (exponent < -4 || exponent > 5 || halfway == 1)
+	{
+		char text[32];
+		int length = snprintf(text, sizeof(text), "%g", quantity);
+		writeChars(out, text, length);
+		return;
+	}
+
+	char significant[6];
+	for (int i = 5; i >= 0; i--)
+	{
+		significant[i] = (char)('0' + digits % 10);
+		digits /= 10;
+	}
+
+	int last = 5;
+	while (last > (exponent > 0 ? exponent : 0) && significant[last] == '0') last--;
+
+	char text[16];
+	int length = 0;
+	if (quantity < 0) text[length++] = '-';
+
+	if (exponent < 0)
+	{
+		text[length++] = '0';
+		text[length++] = '.';
+		for (int i = -1; i > exponent; i--) text[length++] = '0';
+		for (int i = 0; i <= last; i++) text[length++] = significant[i];
+	}
+	else
+	{
+		for (int i = 0; i <= exponent; i++) text[length++] = significant[i];
+		if (last > exponent) text[length++] = '.';
+		for (int i = exponent + 1; i <= last; i++) text[length++] = significant[i];
+	}
+
+	writeChars(out, text, length);
+}
+
+/// <summary>
+/// Writes a date as YYYY/MM/DD
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="date">The date to write</param>
+void writeDate(Writer* out, Date date)
+{
+	char text[10] = { 0 };
+
+	text[0] = (char)('0' + date.year / 1000 % 10);
+	text[1] = (char)('0' + date.year / 100 % 10);
+	text[2] = (char)('0' + date.year / 10 % 10);
+	text[3] = (char)('0' + date.year % 10);
+	text[4] = '/';
+	text[5] = (char)('0' + date.month / 10 % 10);
+	text[6] = (char)('0' + date.month % 10);
+	text[7] = '/';
+	text[8] = (char)('0' + date.day / 10 % 10);
+	text[9] = (char)('0' + date.day % 10);
+
+	writeChars(out, text, sizeof(text));
+}
+
+/// <summary>
+/// Writes the string representation of a product on its own line
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="p">A pointer to the product</param>
+void writeProduct(Writer* out, Product* p)
+{
+	if (p == NULL) return;
+
+	writeText(out, "Product ");
+	writeText(out, p->name);
+	writeText(out, " is part of the \"");
+	writeText(out, category_name[p->category]);
+	writeText(out, "\" category, there is ");
+	writeQuantity(out, p->quantity);
+	writeText(out, " of it in the fridge, and it expires on ");
+	writeDate(out, p->expiration);
+	writeText(out, ".\n");
+}
+
+/// <summary>
+/// Writes the summary of a category on its own line
+/// </summary>
+/// <param name="out">A pointer to the writer</param>
+/// <param name="category">The category, none for the whole fridge</param>
+/// <param name="summary">A pointer to the summary</param>
+void writeSummary(Writer* out, Category category, CategorySummary* summary)
+{
+	writeText(out, category == none ? "The fridge" : "Category \"");
+	if (category != none)
+	{
+		writeText(out, category_name[category]);
+		writeText(out, "\"");
+	}
+
+	if (summary->count == 0)
+	{
+		writeText(out, " has no products.\n");
+		return;
+	}
+
+	writeText(out, " has ");
+	writeInteger(out, summary->count);
+	writeText(out, summary->count == 1 ? " product" : " products");
+	writeText(out, " with a total quantity of ");
+	writeQuantity(out, summary->quantity);
+	writeText(out, ", the first expires on ");
+	writeDate(out, summary->earliest->expiration);
+	writeText(out, " and the last on ");
+	writeDate(out, summary->latest->expiration);
+	writeText(out, ".\n");
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdio.h>
+
+#include "ProductRepository.h"
+
+#define WRITER_BUFFER_SIZE 65536
+
+typedef struct
+{
+	FILE* file;
+	char* buffer;
+	size_t length;
+	size_t capacity; // Only grows when there is no file to flush to
+} Writer;
+
+Writer* createWriter(FILE* file);
+void destroyWriter(Writer* out);
+int flushWriter(Writer* out);
+void discardWriter(Writer* out, size_t count);
+
+void writeChars(Writer* out, const char* text, size_t length);
+void writeText(Writer* out, const char* text);
+void writeInteger(Writer* out, long long value);
+void writeQuantity(Writer* out, double quantity);
+void writeDate(Writer* out, Date date);
+void writeProduct(Writer* out, Product* p);
+void writeSummary(Writer* out, Category category, CategorySummary* summary);
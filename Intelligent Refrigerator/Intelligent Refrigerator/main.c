@@ -1,23 +1,318 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 #include <crtdbg.h>
 
+#include "Benchmark.h"
+#include "Publication.h"
+#include "Recovery.h"
+#include "Script.h"
+#include "Server.h"
+#include "Snapshot.h"
 #include "Test.h"
+#include "ThreadPool.h"
 #include "UI.h"
 
+/// <summary>
+/// Runs commands from a file or the standard input without the menu
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="argc">The number of batch arguments</param>
+/// <param name="argv">The batch arguments: [file] [--timing] [--no-history]</param>
+/// <returns>0 if every command succeeded,
+///			 1, otherwise</returns>
+int runBatch(Service* serv, int argc, char* argv[])
+{
+	FILE* input = stdin;
+	int timing = 0;
+	int history = 1;
+	ScriptStats stats;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--timing") == 0)
+			timing = 1;
+		else if (strcmp(argv[i], "--no-history") == 0)
+			history = 0;
+		else if (input == stdin)
+			input = fopen(argv[i], "r");
+	}
+
+	if (input == NULL)
+	{
+		fprintf(stderr, "ERROR: The script could not be opened!\n");
+		return 1;
+	}
+
+	Writer* out = createWriter(stdout);
+	int result = runScript(serv, input, out, timing, history, &stats);
+	destroyWriter(out);
+
+	if (input != stdin) fclose(input);
+	fprintf(stderr, "INFO: %lld commands, %lld failed, in %.3f seconds.\n", stats.commands, stats.failures, stats.seconds);
+
+	return result == 1 ? 0 : 1;
+}
+
+/// <summary>
+/// Serves the service to clients on a local socket until a shutdown is requested
+/// </summary>
+/// <param name="serv">A pointer to the service</param>
+/// <param name="argc">The number of server arguments</param>
+/// <param name="argv">The server arguments: [socket] [--no-history] [--publish] [--ship] [--archive]</param>
+/// <returns>0 if the server stopped on request,
+///			 1, otherwise</returns>
+int runServe(Service* serv, int argc, char* argv[])
+{
+	const char* path = SERVER_DEFAULT_PATH;
+	int history = 1;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-history") == 0)
+			history = 0;
+		else if (strcmp(argv[i], "--publish") == 0)
+			attachPublication(serv, createPublication(PUBLICATION_DEFAULT_NAME, getPublicationCapacity(getRepo(serv))));
+		else if (strcmp(argv[i], "--ship") == 0)
+		{
+#ifdef SIGPIPE
+			// A standby that is gone makes shipping fail instead of ending the process
+			signal(SIGPIPE, SIG_IGN);
+#endif
+			attachShipper(serv, createShipper(1, SHIPPER_DEFAULT_BATCH));
+		}
+		else if (strcmp(argv[i], "--archive") == 0)
+		{
+			// An archive that was recovered or followed from the primary is kept
+			if (serv->archive == NULL) attachArchive(serv, createArchive());
+		}
+		else
+			path = argv[i];
+	}
+
+	if (serv->publication != NULL)
+		fprintf(stderr, "INFO: Publishing the products as %s.\n", PUBLICATION_DEFAULT_NAME);
+
+	fprintf(stderr, "INFO: Serving on %s, send \"shutdown\" to stop.\n", path);
+	if (runServer(serv, path, history) == 0)
+	{
+		fprintf(stderr, "ERROR: The server could not be started on %s!\n", path);
+		return 1;
+	}
+
+	if (serv->archive != NULL)
+		fprintf(stderr, "INFO: %d expired or empty products were archived.\n", getArchiveLength(serv->archive));
+	if (serv->shipper != NULL)
+		fprintf(stderr, "INFO: Shipped %lld operations in %lld batches (%lld bytes)%s.\n", serv->shipper->operations,
+			serv->shipper->batches, serv->shipper->bytes, serv->shipper->failed == 1 ? ", the standby was lost" : "");
+
+	return 0;
+}
+
+/// <summary>
+/// Follows a primary that ships its changes to the standard input, as in
+/// "fridge --serve --ship | fridge --standby", and serves in its place once it is gone
+/// </summary>
+/// <param name="argc">The number of server arguments</param>
+/// <param name="argv">The server arguments to take over with: [socket] [--no-history] [--publish] [--ship] [--archive]</param>
+/// <returns>0 if the server stopped on request after the takeover,
+///			 1, otherwise</returns>
+int runStandby(int argc, char* argv[])
+{
+	Service* serv = createService(createRepo(), 0);
+	FILE* input = openReplicationStream(0);
+	if (serv == NULL || input == NULL)
+	{
+		fprintf(stderr, "ERROR: The standby could not be started!\n");
+		if (input != NULL) fclose(input);
+		destroyService(serv);
+		return 1;
+	}
+
+	uint64_t sequence = 0;
+	fprintf(stderr, "INFO: Following the primary on the standard input.\n");
+	int followed = followJournal(serv, input, &sequence, NULL);
+	fclose(input);
+
+	// Operations after the one that could not be applied are lost, so this state must not serve
+	if (followed == -1)
+	{
+		fprintf(stderr, "ERROR: The standby ran out of memory after operation %llu and does not take over!\n", (unsigned long long)sequence);
+		destroyService(serv);
+		return 1;
+	}
+	fprintf(stderr, "INFO: The primary is gone after %d operations, taking over with %d products.\n", followed, getLength(getRepo(serv)));
+
+	// The state came from the primary, so it starts a fresh snapshot and journal of its own
+	attachJournal(serv, openJournal(JOURNAL_DEFAULT_PATH, sequence));
+	if (checkpointService(serv, SNAPSHOT_DEFAULT_PATH) == 0)
+		fprintf(stderr, "WARNING: The products could not be saved, changes will not survive a restart.\n");
+
+	int result = runServe(serv, argc, argv);
+	if (checkpointService(serv, SNAPSHOT_DEFAULT_PATH) == 0)
+		fprintf(stderr, "WARNING: The products could not be saved.\n");
+
+	destroyService(serv);
+	return result;
+}
+
+/// <summary>
+/// Measures the requests per second and the latency of a running server
+/// </summary>
+/// <param name="argc">The number of load generator arguments</param>
+/// <param name="argv">The load generator arguments: [socket] [clients] [requests per client] [pipeline depth]</param>
+/// <returns>0 if every request was answered,
+///			 1, otherwise</returns>
+int runLoad(int argc, char* argv[])
+{
+	const char* path = argc > 0 ? argv[0] : SERVER_DEFAULT_PATH;
+	int clients = argc > 1 ? atoi(argv[1]) : 8;
+	int requests = argc > 2 ? atoi(argv[2]) : 10000;
+	int pipeline = argc > 3 ? atoi(argv[3]) : 16;
+	LoadStats stats;
+
+	int result = runLoadGenerator(path, clients, requests, pipeline, &stats);
+	printf("%lld requests (%lld failed) in %.3f seconds: %.0f requests/s, p50 %.3f ms, p99 %.3f ms\n",
+		stats.requests, stats.errors, stats.seconds, stats.seconds > 0 ? stats.requests / stats.seconds : 0, stats.p50, stats.p99);
+
+	if (result == 0) fprintf(stderr, "ERROR: The load generator could not reach the server on %s!\n", path);
+	return result == 1 ? 0 : 1;
+}
+
+/// <summary>
+/// Reads the products another process publishes and prints a summary of them
+/// </summary>
+/// <param name="argc">The number of inventory arguments</param>
+/// <param name="argv">The inventory arguments: [segment]</param>
+/// <returns>0 if an image was read,
+///			 1, otherwise</returns>
+int runInventory(int argc, char* argv[])
+{
+	const char* name = argc > 0 ? argv[0] : PUBLICATION_DEFAULT_NAME;
+	Publication* pub = openPublication(name);
+	if (pub == NULL)
+	{
+		fprintf(stderr, "ERROR: Nothing is published as %s!\n", name);
+		return 1;
+	}
+
+	PublishedImage image;
+	int counts[CATEGORY_END + 1];
+	Quantity quantity;
+	int published;
+
+	// The records are summed up in place and the sums thrown away if the image changed meanwhile
+	do
+	{
+		memset(counts, 0, sizeof(counts));
+		quantity = 0;
+
+		published = beginPublishedRead(pub, &image);
+		for (int i = 0; published == 1 && i < image.length; i++)
+		{
+			int category = image.records[i].category;
+			if (category >= none && category <= CATEGORY_END) counts[category]++;
+			quantity = addQuantity(quantity, image.records[i].units);
+		}
+	} while (published == 1 && endPublishedRead(&image) == 0);
+
+	if (published == 1)
+	{
+		char total[32];
+		formatQuantity(quantity, total, sizeof(total));
+		printf("Version %llu: %d products with a total quantity of %s\n", image.version, image.length, total);
+		if (image.staleSince != 0)
+			fprintf(stderr, "WARNING: Version %llu and later did not fit, this image is stale!\n", image.staleSince);
+		for (int i = CATEGORY_START; i <= CATEGORY_END; i++)
+			printf("%12s: %d\n", category_name[i], counts[i]);
+	}
+	else
+	{
+		fprintf(stderr, "ERROR: No products were published yet!\n");
+	}
+
+	closePublication(pub);
+	return published == 1 ? 0 : 1;
+}
+
 // Program entry point
-int main()
+int main(int argc, char* argv[])
 {
-	// Run the tests
-	runAllTests();
+	if (argc > 1 && strcmp(argv[1], "--test") == 0)
+	{
+		if (runAllTests() == 0)
+		{
+			fprintf(stderr, "ERROR: The temporary directory of the tests could not be created!\n");
+			return 1;
+		}
+
+		if (_CrtDumpMemoryLeaks() == 1)
+			printf("WARNING: Memory leaks were detected. See the Output tab for more information.\n");
+		else
+			printf("INFO: No memory leaks were detected. The program executed correctly.\n");
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		runAllBenchmarks();
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--loadgen") == 0)
+		return runLoad(argc - 2, argv + 2);
+
+	if (argc > 1 && strcmp(argv[1], "--inventory") == 0)
+		return runInventory(argc - 2, argv + 2);
+
+	// Large filters and sorts are split across one worker per processor
+	ThreadPool* pool = createThreadPool(getProcessorCount());
+	setDefaultPool(pool, POOL_DEFAULT_THRESHOLD);
+
+	if (argc > 1 && strcmp(argv[1], "--standby") == 0)
+	{
+		int result = runStandby(argc - 2, argv + 2);
+		destroyThreadPool(pool);
+		return result;
+	}
+
+	// Init program from the last snapshot and the changes journaled after it,
+	// then start a fresh journal on top of a new snapshot
+	Service* serv = recoverService(SNAPSHOT_DEFAULT_PATH, JOURNAL_DEFAULT_PATH, 1, 0);
+	if (serv == NULL)
+	{
+		fprintf(stderr, "ERROR: The products could not be recovered, the journal was left as it is!\n");
+		destroyThreadPool(pool);
+		return 1;
+	}
+	if (checkpointService(serv, SNAPSHOT_DEFAULT_PATH) == 0)
+		fprintf(stderr, "WARNING: The products could not be saved, changes will not survive a restart.\n");
+
+	if (argc > 1 && (strcmp(argv[1], "--batch") == 0 || strcmp(argv[1], "--serve") == 0))
+	{
+		int result = argv[1][2] == 'b' ? runBatch(serv, argc - 2, argv + 2) : runServe(serv, argc - 2, argv + 2);
+		if (checkpointService(serv, SNAPSHOT_DEFAULT_PATH) == 0)
+			fprintf(stderr, "WARNING: The products could not be saved.\n");
 
-	// Init program
-	ProductRepo* repo = createRepo();
-	Service* serv = createService(repo, 1);
+		destroyService(serv);
+		destroyThreadPool(pool);
+		return result;
+	}
 
-	UI* ui = createUI(serv);
+	// Products that expire within the given days are announced once, --alert-days -1 turns the alerts off
+	int alertDays = argc > 2 && strcmp(argv[1], "--alert-days") == 0 ? atoi(argv[2]) : WHEEL_DEFAULT_DAYS;
+	UI* ui = createUI(serv, alertDays);
 
 	startUI(ui);
+	if (checkpointService(serv, SNAPSHOT_DEFAULT_PATH) == 0)
+		printf("WARNING: The products could not be saved.\n");
 	destroyUI(ui);
+	destroyThreadPool(pool);
 
 	// Check for leaks
 	if (_CrtDumpMemoryLeaks() == 1)